@@ -0,0 +1,80 @@
+/*
+ * Summary of every column of a run log, optionally over a time range:
+ *   analyse-run_log <run log file> [from] [to]
+ * Prints the number of samples, minimum, mean and maximum of each field and how fast the columns
+ * were scanned. Also an example of using RunLog.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "clock.hpp"
+#include "run_log.hpp"
+
+struct Summary
+{
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  double sum = 0.0;
+};
+
+Summary summarize(ColumnSpan<double> column)
+{
+  Summary s;
+  for (double v : column)
+  {
+    s.min = std::min(s.min, v);
+    s.max = std::max(s.max, v);
+    s.sum += v;
+  }
+  return s;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s <run log file> [from] [to]\n", argv[0]);
+    return 1;
+  }
+  double t0 = argc > 2 ? atof(argv[2]) : -std::numeric_limits<double>::infinity();
+  double t1 = argc > 3 ? atof(argv[3]) : std::numeric_limits<double>::infinity();
+  RunLog log;
+  if (!log.open(argv[1]))
+  {
+    printf("%s is not a run log (version %d)\n", argv[1], RUN_LOG_VERSION);
+    return 1;
+  }
+
+  double start = Clock::get().now();
+  size_t bytes = 0;
+  for (int c = 0; c < log.get_num_channels(); ++c)
+  {
+    size_t first, last;
+    log.find_range(c, t0, t1, first, last);
+    ColumnSpan<double> t = log.get_timestamps(c).subspan(first, last);
+    printf("%s: %zu samples", log.get_channel_name(c).c_str(), t.size());
+    if (t.empty())
+    {
+      printf("\n");
+      continue;
+    }
+    printf(" from %.6fs to %.6fs\n", t[0], t[t.size() - 1]);
+    std::vector<std::string> names = log.get_field_names(c);
+    for (unsigned int f = 0; f < names.size(); ++f)
+    {
+      ColumnSpan<double> column = log.get_column(c, f).subspan(first, last);
+      Summary s = summarize(column);
+      printf("  %-16s min %14.6g  mean %14.6g  max %14.6g\n", names[f].c_str(), s.min,
+          s.sum / column.size(), s.max);
+      bytes += column.size() * sizeof(double);
+    }
+  }
+  double elapsed = Clock::get().now() - start;
+  printf("\nScanned %.1f MB in %.3fs (%.0f MB/s)\n", bytes / 1.0e+6, elapsed,
+      bytes / 1.0e+6 / elapsed);
+  return 0;
+}
@@ -0,0 +1,344 @@
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "bench.hpp"
+#include "master-slave-comms/master/BaseCommunicator.hpp"
+#include "master-slave-comms/master/NetworkMaster.hpp"
+#include "master-slave-comms/master/ShmTransport.hpp"
+#include "network_proxi.hpp"
+
+// Round trips over loopback to stand-ins for the base station and a slave: BaseCommunicator
+// messages (sending a preformatted message, and ones the communicator encodes itself; the
+// difference is the cost of the encoding) and NetworkProxi readings, then NetworkProxi readings
+// from a slave stand-in offering shared memory, then one proxi on each of 4 slaves which take
+// 200 us to read it, one slave after the other and all at once through a NetworkMultiplexer,
+// then 4 proxis on one slave, one after the other and as one NetworkProxiSnapshot group (one
+// request for all 4), then NetworkProxi readings from a slave which drops the link after every
+// reply (each costs a reconnection and the request sent again), then batches of 3 requests
+// queued on a link the slave drops before answering (all 3 are sent again together after
+// reconnecting). Needs the base station's port (5695) to be free.
+
+#define BASE_STATION_PORT 5695
+
+/// Listens on `port` of the loopback interface (0 for any free port, see get_port); returns the
+/// socket or -1
+int listen_loopback(int port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 1) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int get_port(int fd)
+{
+  struct sockaddr_in addr;
+  socklen_t length = sizeof(addr);
+  getsockname(fd, (struct sockaddr*) &addr, &length);
+  return ntohs(addr.sin_port);
+}
+
+/// Takes the complete commands (lines) at the start of `received` out of it; returns the
+/// replies to them, a `reply` per space-separated command as a slave answers a batch of proxis
+std::string answer_lines(std::string& received, const char* reply)
+{
+  std::string replies;
+  size_t end;
+  while ((end = received.find('\n')) != std::string::npos)
+  {
+    replies += reply;
+    for (size_t i = 0; i < end; ++i)
+      if (received[i] == ' ')
+        replies += reply;
+    received.erase(0, end + 1);
+  }
+  return replies;
+}
+
+/// Accepts one connection and answers every command with `reply` (after `delay` microseconds)
+/// until it is closed
+void serve(int listen_fd, const char* reply, int delay)
+{
+  int fd = accept(listen_fd, nullptr, nullptr);
+  close(listen_fd);
+  char buffer[4096];
+  ssize_t n;
+  std::string received, replies;
+  while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+  {
+    received.append(buffer, n);
+    replies = answer_lines(received, reply);
+    if (replies.empty())
+      continue;
+    if (delay > 0)
+      usleep(delay);
+    send(fd, replies.c_str(), replies.length(), 0);
+  }
+  close(fd);
+}
+
+/// Answers one message of each master connecting, then closes its connection
+void serve_dropping(int listen_fd, const char* reply)
+{
+  char buffer[4096];
+  while (true)
+  {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (recv(fd, buffer, sizeof(buffer), 0) > 0)
+      send(fd, reply, std::strlen(reply), 0);
+    close(fd);
+  }
+}
+
+/// Answers every command of one master with `reply` until it detaches
+void serve_shm(ShmTransport* shm, const char* reply)
+{
+  shm->accept();
+  char buffer[4096];
+  size_t n;
+  std::string received, replies;
+  while ((n = shm->receive(buffer, sizeof(buffer))) > 0)
+  {
+    received.append(buffer, n);
+    replies = answer_lines(received, reply);
+    if (!replies.empty())
+      shm->send(replies.c_str(), replies.length());
+  }
+}
+
+/// Answers the `queued` commands sent again on each connection after the first with `reply`,
+/// then takes `queued` more and drops the connection without answering them
+void serve_dropping_queued(int listen_fd, const char* reply, int queued)
+{
+  char buffer[4096];
+  bool replayed = false;
+  while (true)
+  {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    std::string received, replies;
+    int answered = 0, taken = 0;
+    ssize_t n;
+    while (taken < queued && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+      received.append(buffer, n);
+      size_t end;
+      while (taken < queued && (end = received.find('\n')) != std::string::npos)
+      {
+        if (replayed && answered < queued)
+        {
+          replies += reply;
+          ++answered;
+        }
+        else
+          ++taken;
+        received.erase(0, end + 1);
+      }
+      if (!replies.empty())
+        send(fd, replies.c_str(), replies.length(), 0);
+      replies.clear();
+    }
+    replayed = true;
+    close(fd);
+  }
+}
+
+int main()
+{
+  int base_fd = listen_loopback(BASE_STATION_PORT);
+  int slave_fd = listen_loopback(0);
+  if (base_fd < 0 || slave_fd < 0)
+  {
+    fprintf(stderr, "Can't listen on the loopback interface (is port %d in use?)\n",
+        BASE_STATION_PORT);
+    return 1;
+  }
+  int slave_port = get_port(slave_fd);
+  // NetworkMaster never closes its connection, so the servers are left running until exit
+  std::thread(serve, base_fd, "1", 0).detach();
+  std::thread(serve, slave_fd, "100\n", 0).detach();
+
+  {
+    BaseCommunicator base((char*) "127.0.0.1");
+    if (!base.setUp())
+      return 1;
+    bench("base_communicator.send_data", [&]() {
+      int r = base.sendData("CMD011.5\n");
+      do_not_optimize(r);
+    });
+    bench("base_communicator.send_acceleration", [&]() {
+      int r = base.sendAcceleration(1.5f);
+      do_not_optimize(r);
+    });
+    bench("base_communicator.send_acceleration_xyz", [&]() {
+      int r = base.sendAccelerationXYZ(1.5f, -0.25f, 9.81f);
+      do_not_optimize(r);
+    });
+  }
+
+  {
+    NetworkMaster master;
+    if (!master.setup("127.0.0.1", slave_port))
+      return 1;
+    NetworkProxi proxi(master, "proxi-gnd-frontski-front");
+    bench("network_proxi.get_distance", [&]() {
+      int r = proxi.get_distance();
+      do_not_optimize(r);
+    });
+  }
+
+  {
+    // The port only names the segment; nothing listens on it, so a master failing to attach
+    // can't fall back to TCP
+    int shm_port = slave_port + 1;
+    ShmTransport slave(shm_port);
+    if (!slave.create())
+    {
+      perror("Can't create the shared memory segment");
+      return 1;
+    }
+    std::thread server(serve_shm, &slave, "100\n");
+    {
+      NetworkMaster master;
+      if (!master.setup("127.0.0.1", shm_port))
+        return 1;
+      NetworkProxi proxi(master, "proxi-gnd-frontski-front");
+      bench("network_proxi.get_distance_shm", [&]() {
+        int r = proxi.get_distance();
+        do_not_optimize(r);
+      });
+    }
+    server.join();
+  }
+
+  {
+    // The stand-ins serve one connection each, so the masters and the multiplexer get their own
+    std::vector<int> ports;
+    for (int i = 0; i < 8; ++i)
+    {
+      int fd = listen_loopback(0);
+      if (fd < 0)
+        return 1;
+      ports.push_back(get_port(fd));
+      std::thread(serve, fd, "100\n", 200).detach();
+    }
+    std::vector<NetworkMaster> masters(4);
+    std::vector<NetworkProxi> proxis;
+    proxis.reserve(4);
+    NetworkMultiplexer slaves;
+    NetworkProxiSnapshot snapshot(slaves);
+    for (int i = 0; i < 4; ++i)
+    {
+      if (!masters[i].setup("127.0.0.1", ports[i]) || !slaves.is_connected(
+          slaves.add_slave("127.0.0.1", ports[4 + i])))
+        return 1;
+      proxis.emplace_back(masters[i], "proxi-gnd-frontski-front");
+      snapshot.add_proxi(i, "proxi-gnd-frontski-front");
+    }
+    bench("network_proxi.4_slaves_sequential", [&]() {
+      for (NetworkProxi& p : proxis)
+      {
+        int r = p.get_distance();
+        do_not_optimize(r);
+      }
+    });
+    bench("network_proxi.4_slaves_snapshot", [&]() {
+      int r = snapshot.read();
+      do_not_optimize(r);
+    });
+  }
+
+  {
+    // 4 proxis on one slave which ranges them together in 200 us
+    int sequential_fd = listen_loopback(0);
+    int group_fd = listen_loopback(0);
+    if (sequential_fd < 0 || group_fd < 0)
+      return 1;
+    int sequential_port = get_port(sequential_fd);
+    int group_port = get_port(group_fd);
+    std::thread(serve, sequential_fd, "100\n", 200).detach();
+    std::thread(serve, group_fd, "100\n", 200).detach();
+    NetworkMaster master;
+    NetworkMultiplexer slaves;
+    if (!master.setup("127.0.0.1", sequential_port)
+        || !slaves.is_connected(slaves.add_slave("127.0.0.1", group_port)))
+      return 1;
+    const char* descs[] = {"proxi-gnd-frontski-front", "proxi-gnd-frontski-rear",
+        "proxi-gnd-rearski-front", "proxi-gnd-rearski-rear"};
+    std::vector<NetworkProxi> proxis;
+    proxis.reserve(4);
+    NetworkProxiSnapshot group(slaves);
+    for (const char* desc : descs)
+    {
+      proxis.emplace_back(master, desc);
+      group.add_proxi(0, desc);
+    }
+    std::vector<ProxiReading> readings(group.size());
+    bench("network_proxi.4_proxis_sequential", [&]() {
+      for (NetworkProxi& p : proxis)
+      {
+        int r = p.get_distance();
+        do_not_optimize(r);
+      }
+    });
+    bench("network_proxi.4_proxis_group", [&]() {
+      int r = group.get_distances(readings.data());
+      do_not_optimize(r);
+    });
+  }
+
+  {
+    int fd = listen_loopback(0);
+    if (fd < 0)
+      return 1;
+    std::thread(serve_dropping, fd, "100\n").detach();
+    NetworkMaster master;
+    if (!master.setup("127.0.0.1", get_port(fd)))
+      return 1;
+    NetworkProxi proxi(master, "proxi-gnd-frontski-front");
+    bench("network_proxi.get_distance_reconnecting", [&]() {
+      int r = proxi.get_distance();
+      do_not_optimize(r);
+    });
+  }
+
+  {
+    int fd = listen_loopback(0);
+    if (fd < 0)
+      return 1;
+    const int queued = 3;
+    std::thread(serve_dropping_queued, fd, "100\n", queued).detach();
+    NetworkMaster master;
+    if (!master.setup("127.0.0.1", get_port(fd)))
+      return 1;
+    unsigned long lost = 0;
+    bench("network_master.replay_queued", [&]() {
+      for (int i = 0; i < queued; ++i)
+        master.Send("proxi-gnd-frontski-front");
+      for (int i = 0; i < queued; ++i)
+        lost += master.read() != "100\n";
+    });
+    // Every request is sent again separately, or the replies stop matching them
+    if (lost > 0)
+    {
+      fprintf(stderr, "network_master.replay_queued: %lu replies lost\n", lost);
+      return 1;
+    }
+  }
+  return 0;
+}
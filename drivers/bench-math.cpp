@@ -0,0 +1,119 @@
+#include <cmath>
+#include <random>
+
+#include "bench.hpp"
+#include "data_point.hpp"
+#include "proxi_attitude.hpp"
+#include "quaternion.hpp"
+#include "vector3d.hpp"
+
+// Vector3D and Quaternion operators, DataPoint::integrate and the proxi attitude (rotor) from 4
+// ground proxis with and without 2 braking skis, as used by MotionTracker. Inputs are cycled
+// through a table of random values so nothing can be computed at compile time.
+
+const int n = 1024; // inputs, a power of 2
+
+int main()
+{
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> value(-10.0, 10.0);
+  std::normal_distribution<double> noise(0.0, 1.0); // mm
+  static Vector3D<double> v[n];
+  static Quaternion q[n];
+  static double d[n];
+  for (int i = 0; i < n; ++i)
+  {
+    v[i] = Vector3D<double>(value(gen), value(gen), value(gen));
+    q[i] = Quaternion(value(gen), value(gen), value(gen), value(gen));
+    q[i] /= Quaternion::norm(q[i]);
+    d[i] = value(gen);
+  }
+  unsigned int i = 0;
+
+  bench("vector3d.add", [&]() {
+    Vector3D<double> r = v[i % n] + v[(i + 1) % n];
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("vector3d.scale", [&]() {
+    Vector3D<double> r = v[i % n] * d[i % n];
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("vector3d.divide", [&]() {
+    Vector3D<double> r = v[i % n] / d[i % n];
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("quaternion.multiply", [&]() {
+    Quaternion r = q[i % n] * q[(i + 1) % n];
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("quaternion.norm", [&]() {
+    double r = Quaternion::norm(q[i % n]);
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("quaternion.rotate", [&]() {
+    Vector3D<double> r = q[i % n] * Quaternion(v[i % n]) * Quaternion::inv(q[i % n]);
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("quaternion.pow", [&]() {
+    Quaternion r = Quaternion::pow(q[i % n], 0.02);
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("data_point.integrate.double", [&]() {
+    DataPoint<double> r = DataPoint<double>::integrate(DataPoint<double>(i * 0.001, d[i % n]),
+        DataPoint<double>((i + 1) * 0.001, d[(i + 1) % n]));
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("data_point.integrate.vector3d", [&]() {
+    DataPoint<Vector3D<double>> r = DataPoint<Vector3D<double>>::integrate(
+        DataPoint<Vector3D<double>>(i * 0.001, v[i % n]),
+        DataPoint<Vector3D<double>>((i + 1) * 0.001, v[(i + 1) % n]));
+    do_not_optimize(r);
+    ++i;
+  });
+
+  // Readings of a slightly tilted pod, 10mm above the track
+  ProxiAttitude<4, 2> ground, ground_brakes;
+  const Vector3D<double> positions[4] = {
+    Vector3D<double>(500, 1000, 0), Vector3D<double>(500, -1000, 0),
+    Vector3D<double>(-500, -1000, 0), Vector3D<double>(-500, 1000, 0)};
+  for (int j = 0; j < 4; ++j)
+  {
+    ground.add_ground_position(positions[j]);
+    ground_brakes.add_ground_position(positions[j]);
+  }
+  ground_brakes.add_brake();
+  ground_brakes.add_brake();
+  static double distances[n][4], front[n][2], rear[n][2];
+  for (int k = 0; k < n; ++k)
+  {
+    double a = value(gen) / 1000.0, b = value(gen) / 1000.0;
+    for (int j = 0; j < 4; ++j)
+      distances[k][j] = 10.0 + a * positions[j].x + b * positions[j].y + noise(gen);
+    for (int j = 0; j < 2; ++j)
+    {
+      front[k][j] = 20.0 + noise(gen);
+      rear[k][j] = 20.0 + noise(gen);
+    }
+  }
+  bench("proxi_attitude.get_rotor.4_ground", [&]() {
+    Quaternion r;
+    ground.get_rotor(distances[i % n], front[i % n], rear[i % n], r);
+    do_not_optimize(r);
+    ++i;
+  });
+  bench("proxi_attitude.get_rotor.4_ground_2_brakes", [&]() {
+    Quaternion r;
+    ground_brakes.get_rotor(distances[i % n], front[i % n], rear[i % n], r);
+    do_not_optimize(r);
+    ++i;
+  });
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "bench.hpp"
+#include "instrumentation.hpp"
+#include "interfaces.hpp"
+#include "motion_tracker.hpp"
+#include "vector3d.hpp"
+
+// MotionTracker tracking a pod at rest with simulated sensors (2 IMUs, 4 ground proxis and 2
+// braking skis), in each navigation mode. Sensor reads cost next to nothing, so the iteration
+// times are those of the tracking itself. Results come from the histograms MotionTracker records
+// to (see instrumentation.hpp). The Keyence still uses its GPIO pins, so this needs wiringPi;
+// what it prints goes to stderr, leaving stdout to the results (one JSON record per line).
+
+const double TRACK_TIME = 5.0; // s per mode
+
+/// Sends what is printed to stdout to stderr instead while it exists
+class StdoutToStderr
+{
+  public:
+    StdoutToStderr()
+    {
+      fflush(stdout);
+      this->saved = dup(STDOUT_FILENO);
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+    ~StdoutToStderr()
+    {
+      fflush(stdout);
+      dup2(this->saved, STDOUT_FILENO);
+      close(this->saved);
+    }
+
+  private:
+    int saved;
+};
+
+class SimImu : public Imu
+{
+  public:
+    SimImu(int seed) : gen(seed), noise(0.0, 0.01)
+    {}
+
+    Vector3D<double> get_acceleration() override
+    {
+      return Vector3D<double>(noise(gen), noise(gen), 9.80665 + noise(gen));
+    }
+    void calibrate_gyro(int n) override
+    {}
+    Vector3D<double> get_angular_velocity() override
+    {
+      return Vector3D<double>(noise(gen), noise(gen), noise(gen)) / 10.0;
+    }
+    ImuData get_imu_data() override
+    {
+      return ImuData(this->get_acceleration(), this->get_angular_velocity());
+    }
+
+  private:
+    std::mt19937 gen;
+    std::normal_distribution<double> noise;
+};
+
+class SimProxi : public Proxi
+{
+  public:
+    SimProxi(int seed, int distance) : gen(seed), noise(-1, 1), distance(distance)
+    {}
+
+    int get_distance() override
+    {
+      return this->distance + noise(gen);
+    }
+
+  private:
+    std::mt19937 gen;
+    std::uniform_int_distribution<int> noise;
+    int distance;
+};
+
+void track(NavMode mode, const std::string& name)
+{
+  const char* stages[] = {"motion_tracker.iteration", "motion_tracker.wake_latency",
+      "sensor.imu", "sensor.gyro", "sensor.proxis"};
+  const int num_stages = sizeof(stages) / sizeof(stages[0]);
+  std::vector<HistogramSnapshot> before(num_stages), after(num_stages);
+
+  SimImu imu1(1), imu2(2);
+  SimProxi ground[4] = {SimProxi(3, 10), SimProxi(4, 10), SimProxi(5, 10), SimProxi(6, 10)};
+  SimProxi front(7, 20), rear(8, 20);
+  MotionTracker mt(mode);
+  mt.add_imu(imu1);
+  mt.add_imu(imu2);
+  mt.add_ground_proxi(ground[0], Vector3D<double>(500, 1000, 0));
+  mt.add_ground_proxi(ground[1], Vector3D<double>(500, -1000, 0));
+  mt.add_ground_proxi(ground[2], Vector3D<double>(-500, -1000, 0));
+  mt.add_ground_proxi(ground[3], Vector3D<double>(-500, 1000, 0));
+  mt.add_brake_proxis(front, rear, RailSide::left);
+  {
+    // Calibrating the Keyence prints a line
+    StdoutToStderr redirect;
+    mt.start();
+  }
+  for (int i = 0; i < num_stages; ++i)
+    Instrumentation::get_histogram(stages[i]).snapshot(before[i]);
+  std::this_thread::sleep_for(std::chrono::duration<double>(TRACK_TIME));
+  for (int i = 0; i < num_stages; ++i)
+    Instrumentation::get_histogram(stages[i]).snapshot(after[i]);
+  mt.stop();
+
+  for (int i = 0; i < num_stages; ++i)
+    bench_histogram(name + "." + stages[i], after[i] - before[i]);
+}
+
+int main()
+{
+  track(NavMode::complementary, "complementary");
+  track(NavMode::ekf, "ekf");
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include "bench.hpp"
+#include "i2c.hpp"
+#include "mpu6050.hpp"
+
+// MPU6050 reads through the driver on an in-memory bus (fake_i2c.cpp), i.e. the cost of the
+// driver itself without the I2C transfer, and the decoding of a raw reading on its own.
+// Construction takes 2s (the driver waits for the sensor to reset).
+
+int main()
+{
+  I2C i2c;
+  Mpu6050 imu(&i2c);
+  RawSensorData raw = imu.get_raw_sensor_data();
+
+  bench("mpu6050.get_acceleration", [&]() {
+    Vector3D<double> r = imu.get_acceleration();
+    do_not_optimize(r);
+  });
+  bench("mpu6050.get_angular_velocity", [&]() {
+    Vector3D<double> r = imu.get_angular_velocity();
+    do_not_optimize(r);
+  });
+  bench("mpu6050.get_imu_data", [&]() {
+    ImuData r = imu.get_imu_data();
+    do_not_optimize(r);
+  });
+  bench("mpu6050.get_raw_sensor_data", [&]() {
+    RawSensorData r = imu.get_raw_sensor_data();
+    do_not_optimize(r);
+  });
+  bench("mpu6050.decode", [&]() {
+    do_not_optimize(raw);
+    SensorData r = imu.get_sensor_data(raw);
+    do_not_optimize(r);
+  });
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "nav_ekf.hpp"
+#include "quaternion.hpp"
+#include "vector3d.hpp"
+
+// Per-update cost and accuracy of NavEkf on a simulated run: 1kHz IMU (8 gyro samples per
+// accelerometer sample, as MotionTracker reads the MPU6050), 100Hz proxi attitude and a stripe
+// every 30m. The pod accelerates at 10m/s^2 for 5s, then brakes at 10m/s^2.
+
+const double IMU_PERIOD = 0.001;
+const double RUN_TIME = 10.0;
+const double STRIPE_SPACING = 30.0;
+const Vector3D<double> GRAVITY(0, 0, -9.80665);
+
+double truth_acceleration(double t)
+{
+  return (t < RUN_TIME / 2.0) ? 10.0 : -10.0;
+}
+
+int main()
+{
+  std::mt19937 gen(1);
+  std::normal_distribution<double> accl_noise(0.0, 0.05);
+  std::normal_distribution<double> gyro_noise(0.0, 0.002);
+  std::normal_distribution<double> attitude_noise(0.0, 0.01);
+  const Vector3D<double> accl_bias(0.05, -0.02, 0.03);
+  const Vector3D<double> gyro_bias(0.001, 0.0, -0.002);
+
+  NavEkf ekf;
+  ekf.reset(0.0, GRAVITY);
+
+  double x = 0.0, v = 0.0;
+  double next_stripe = STRIPE_SPACING;
+  Vector3D<double> accl;
+  long predicts = 0, stripes = 0, attitudes = 0;
+  double predict_ns = 0.0, stripe_ns = 0.0, attitude_ns = 0.0, max_predict_ns = 0.0;
+  double max_error = 0.0;
+  int n = (int) (RUN_TIME / IMU_PERIOD);
+  for (int i = 1; i <= n; ++i)
+  {
+    double t = i * IMU_PERIOD;
+    double a = truth_acceleration(t);
+    x += v * IMU_PERIOD + a * IMU_PERIOD * IMU_PERIOD / 2.0;
+    v += a * IMU_PERIOD;
+
+    // Specific force in the (level) pod frame, as read from the IMU
+    if (i % 8 == 1)
+      accl = Vector3D<double>(a + accl_noise(gen), accl_noise(gen), 9.80665 + accl_noise(gen))
+          + accl_bias;
+    Vector3D<double> angv = Vector3D<double>(gyro_noise(gen), gyro_noise(gen), gyro_noise(gen))
+        + gyro_bias;
+
+    auto t0 = std::chrono::steady_clock::now();
+    ekf.predict(t, accl, angv);
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    predict_ns += ns;
+    max_predict_ns = std::fmax(max_predict_ns, ns);
+    ++predicts;
+
+    if (i % 10 == 0)
+    {
+      Quaternion measured(1.0, Vector3D<double>(attitude_noise(gen), attitude_noise(gen),
+          attitude_noise(gen)) / 2.0);
+      measured /= Quaternion::norm(measured);
+      t0 = std::chrono::steady_clock::now();
+      ekf.update_attitude(measured);
+      t1 = std::chrono::steady_clock::now();
+      attitude_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+      ++attitudes;
+    }
+    if (x >= next_stripe)
+    {
+      t0 = std::chrono::steady_clock::now();
+      ekf.update_stripe(next_stripe);
+      t1 = std::chrono::steady_clock::now();
+      stripe_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+      ++stripes;
+      next_stripe += STRIPE_SPACING;
+    }
+    max_error = std::fmax(max_error, std::fabs(ekf.get_state().position.x - x));
+  }
+
+  NavState s = ekf.get_state();
+  const NavEkf::Covariance& p = ekf.get_covariance();
+  printf("Predict:          %8.1fns mean, %8.1fns max (%ld calls)\n",
+      predict_ns / predicts, max_predict_ns, predicts);
+  printf("Stripe update:    %8.1fns mean (%ld calls)\n", stripe_ns / stripes, stripes);
+  printf("Attitude update:  %8.1fns mean (%ld calls)\n", attitude_ns / attitudes, attitudes);
+  printf("IMU period budget: %7.1fns per sample\n", IMU_PERIOD * 1e9);
+  printf("Final position: %9.3fm (truth %9.3fm, sigma %.3fm), max error %.3fm\n",
+      s.position.x, x, std::sqrt(p(NAV_EKF_POSITION, NAV_EKF_POSITION)), max_error);
+  printf("Final velocity: %9.3fm/s (truth %9.3fm/s, sigma %.3fm/s)\n",
+      s.velocity.x, v, std::sqrt(p(NAV_EKF_VELOCITY, NAV_EKF_VELOCITY)));
+  printf("Accelerometer bias: (%.3f, %.3f, %.3f) (truth (%.3f, %.3f, %.3f))\n",
+      s.accl_bias.x, s.accl_bias.y, s.accl_bias.z, accl_bias.x, accl_bias.y, accl_bias.z);
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "sample_bus.hpp"
+#include "vector3d.hpp"
+
+// Publishing to and reading from a SampleTopic of IMU-sized samples: alone, then publishing while
+// 1 and 3 reader threads follow the topic (the cost of readers to the producer, which should stay
+// flat), and reading the latest sample while the producer publishes.
+
+/// Threads reading every sample of `topic` until `stop` is set
+class Followers
+{
+  public:
+    Followers(const SampleTopic<Vector3D<double>>& topic, int n)
+    {
+      for (int i = 0; i < n; ++i)
+        this->threads.emplace_back([this, &topic]() {
+          SampleReader<Vector3D<double>> reader(topic);
+          Sample<Vector3D<double>> sample;
+          while (!this->stop)
+            if (reader.next(sample))
+              do_not_optimize(sample);
+        });
+    }
+    ~Followers()
+    {
+      this->stop = true;
+      for (std::thread& t : this->threads)
+        t.join();
+    }
+
+  private:
+    std::atomic_bool stop {false};
+    std::vector<std::thread> threads;
+};
+
+int main()
+{
+  SampleTopic<Vector3D<double>> topic;
+  Vector3D<double> v(0.1, 0.2, 9.8);
+  double t = 0;
+  bench("sample_bus.publish", [&]() {
+    topic.publish(t += 0.001, v);
+  });
+
+  Sample<Vector3D<double>> sample;
+  bench("sample_bus.latest", [&]() {
+    topic.latest(sample);
+    do_not_optimize(sample);
+  });
+
+  bench("sample_bus.publish_and_read", [&]() {
+    static SampleReader<Vector3D<double>> reader(topic);
+    topic.publish(t += 0.001, v);
+    reader.next(sample);
+    do_not_optimize(sample);
+  });
+
+  for (int readers : {1, 3})
+  {
+    Followers followers(topic, readers);
+    bench("sample_bus.publish_" + std::to_string(readers) + "_readers", [&]() {
+      topic.publish(t += 0.001, v);
+    });
+  }
+
+  {
+    std::atomic_bool stop {false};
+    std::thread producer([&]() {
+      double pt = 0;
+      while (!stop)
+        topic.publish(pt += 0.001, v);
+    });
+    bench("sample_bus.latest_while_publishing", [&]() {
+      topic.latest(sample);
+      do_not_optimize(sample);
+    });
+    stop = true;
+    producer.join();
+  }
+  return 0;
+}
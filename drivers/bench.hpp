@@ -0,0 +1,104 @@
+#ifndef HYPED_DRIVERS_BENCH_HPP_
+#define HYPED_DRIVERS_BENCH_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/utsname.h>
+#include <vector>
+
+#include "instrumentation.hpp"
+
+#define BENCH_MIN_BATCHES 15
+#define BENCH_MIN_TIME 0.2     // s, per benchmark
+#define BENCH_BATCH_TIME 0.002 // s, batches are sized to take at least this long
+
+/*
+ * Microbenchmark harness. Every result is printed as one line of JSON:
+ *   {"benchmark":"vector3d.add","machine":"armv7l","tag":"93d17b9","ops":123456,
+ *    "median_ns":1.9,"min_ns":1.8,"max_ns":2.4}
+ * Batched benchmarks report the median, fastest and slowest batch (per op); ones taken from a
+ * LatencyHistogram report its p50, lowest and highest bucket. `tag` is $BENCH_TAG (`make bench`
+ * sets it to the commit), so the output of several commits and machines can be appended to one
+ * file and compared.
+ */
+
+struct BenchResult
+{
+  std::string name;
+  unsigned long ops;
+  double median_ns;
+  double min_ns;
+  double max_ns;
+};
+
+/// Keeps the compiler from optimizing away a value computed only to be measured
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+inline void print_bench_result(const BenchResult& r)
+{
+  struct utsname u;
+  const char* machine = (uname(&u) == 0) ? u.machine : "unknown";
+  const char* tag = std::getenv("BENCH_TAG");
+  printf("{\"benchmark\":\"%s\",\"machine\":\"%s\",\"tag\":\"%s\",\"ops\":%lu,"
+      "\"median_ns\":%.2f,\"min_ns\":%.2f,\"max_ns\":%.2f}\n", r.name.c_str(), machine,
+      tag ? tag : "", r.ops, r.median_ns, r.min_ns, r.max_ns);
+  fflush(stdout);
+}
+
+/// Calls `op` in batches until there have been BENCH_MIN_BATCHES and BENCH_MIN_TIME has passed,
+/// then prints and returns the time per call
+template <typename F>
+BenchResult bench(const std::string& name, F op)
+{
+  using namespace std::chrono;
+  auto run_batch = [&op](unsigned long n) {
+    auto t0 = steady_clock::now();
+    for (unsigned long i = 0; i < n; ++i)
+      op();
+    return duration_cast<nanoseconds>(steady_clock::now() - t0).count() / 1.0e+9;
+  };
+
+  // Batch size; also warms up caches and branch predictors
+  unsigned long n = 1;
+  while (run_batch(n) < BENCH_BATCH_TIME)
+    n *= 2;
+
+  std::vector<double> batches;
+  double total = 0.0;
+  while (batches.size() < BENCH_MIN_BATCHES || total < BENCH_MIN_TIME)
+  {
+    double t = run_batch(n);
+    batches.push_back(t * 1.0e+9 / n);
+    total += t;
+  }
+  std::sort(batches.begin(), batches.end());
+  BenchResult r {name, n * batches.size(), batches[batches.size() / 2], batches.front(),
+      batches.back()};
+  print_bench_result(r);
+  return r;
+}
+
+/// Prints the distribution of samples recorded by instrumented code, e.g. the duration of
+/// MotionTracker's iterations while it tracks (the difference of two snapshots of its histogram)
+inline BenchResult bench_histogram(const std::string& name, const HistogramSnapshot& s)
+{
+  double min = 0.0;
+  for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+    if (s.counts[b])
+    {
+      min = LatencyHistogram::get_bucket_start(b);
+      break;
+    }
+  BenchResult r {name, (unsigned long) s.count, s.get_percentile(0.5), min, s.get_max()};
+  print_bench_result(r);
+  return r;
+}
+
+#endif // HYPED_DRIVERS_BENCH_HPP_
@@ -0,0 +1,186 @@
+#include "brake_controller.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+}
+
+#include "clock.hpp"
+#include "instrumentation.hpp"
+
+#define DERIVATIVE_FILTER 0.3 // weight of the newest gap rate in its low-pass filter
+#define SETTLED_RATE 5.0      // mm/s; slower than this within tolerance counts as on target
+
+
+BrakeController::BrakeController(BrakeActuator& actuator, ProxiSampler& left,
+    ProxiSampler& right, PressureSensor* pressure, BrakeControllerConfig config)
+    : actuator(actuator), pressure(pressure), config(config), target(config.target)
+{
+  this->samplers[static_cast<int>(RailSide::left)] = &left;
+  this->samplers[static_cast<int>(RailSide::right)] = &right;
+  std::memset(this->state, 0, sizeof(this->state));
+  std::memset(&this->status, 0, sizeof(this->status));
+  for (int i = 0; i < 2; ++i)
+  {
+    this->status.brakes[i].command = BrakeCommand::hold;
+    this->status.brakes[i].stale = true;
+  }
+  this->published.store(this->status);
+}
+
+BrakeController::~BrakeController()
+{
+  this->stop();
+}
+
+void BrakeController::start()
+{
+  if (!this->stop_flag)
+    return;
+  this->stop_flag = false;
+  this->control_thread = std::thread(&BrakeController::run, this);
+}
+
+void BrakeController::stop()
+{
+  this->stop_flag = true;
+  if (this->control_thread.joinable())
+    this->control_thread.join();
+}
+
+void BrakeController::set_target(double gap)
+{
+  this->target.store(gap, std::memory_order_relaxed);
+}
+
+BrakeControllerStatus BrakeController::get_status()
+{
+  return this->published.load();
+}
+
+void BrakeController::run()
+{
+  struct sched_param param;
+  param.sched_priority = this->config.priority;
+  this->status.realtime =
+      (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+
+  const double period = 1.0 / this->config.rate;
+  Clock& clock = Clock::get();
+  // Deadlines are counted from the start so rounding doesn't accumulate
+  const double start = clock.now();
+  unsigned long n = 0;
+  LoopMonitor monitor("brake_controller.loop", period);
+  LatencyHistogram& tick_time = Instrumentation::get_histogram("brake_controller.tick");
+  while (!this->stop_flag)
+  {
+    double deadline = start + ++n * period;
+    clock.sleep_until(deadline);
+
+    monitor.tick();
+    double now = clock.now();
+    double lateness = now - deadline;
+    if (lateness > this->status.max_lateness)
+      this->status.max_lateness = lateness;
+    if (lateness >= period)
+    {
+      // Missed at least one whole period: skip the missed ticks instead of running them late
+      long missed = (long) (lateness / period);
+      this->status.deadline_misses += missed;
+      n += missed;
+    }
+
+    {
+      ScopedTimer timer(tick_time);
+      this->tick(now);
+    }
+
+    double exec_time = clock.now() - now;
+    if (exec_time > this->status.max_exec_time)
+      this->status.max_exec_time = exec_time;
+    this->published.store(this->status);
+  }
+
+  for (int i = 0; i < 2; ++i)
+  {
+    this->actuator.actuate(static_cast<RailSide>(i), BrakeCommand::hold);
+    this->status.brakes[i].command = BrakeCommand::hold;
+  }
+  this->published.store(this->status);
+}
+
+void BrakeController::tick(double now)
+{
+  ++this->status.ticks;
+  double p = (this->pressure != nullptr) ? this->pressure->get_pressure() : -1.0;
+  this->status.low_pressure = (p >= 0.0 && p < this->config.min_pressure);
+  for (int i = 0; i < 2; ++i)
+    this->update_side(i, now, this->status.low_pressure);
+}
+
+void BrakeController::update_side(int i, double now, bool low_pressure)
+{
+  SideState& s = this->state[i];
+  BrakeStatus& b = this->status.brakes[i];
+  BrakeCommand command = BrakeCommand::hold;
+
+  ProxiSample sample;
+  bool have_sample = this->samplers[i]->try_get_sample(sample) && sample.count > 0;
+  b.stale = !have_sample || (now - sample.timestamp > this->config.max_sample_age);
+  if (!b.stale)
+  {
+    // Rate of change of the gap, only updated when there is a new reading
+    if (sample.count != s.last_count)
+    {
+      if (s.last_count != 0 && sample.timestamp > s.last_time)
+      {
+        double rate = (sample.distance - s.last_gap) / (sample.timestamp - s.last_time);
+        s.gap_rate += DERIVATIVE_FILTER * (rate - s.gap_rate);
+      }
+      s.last_count = sample.count;
+      s.last_gap = sample.distance;
+      s.last_time = sample.timestamp;
+    }
+    b.gap = sample.distance;
+    b.gap_rate = s.gap_rate;
+
+    // PD control; the valves are on/off so the output is applied as a duty cycle
+    double error = this->target.load(std::memory_order_relaxed) - b.gap;
+    b.on_target = (std::fabs(error) <= this->config.tolerance
+        && std::fabs(b.gap_rate) < SETTLED_RATE);
+    if (b.on_target)
+    {
+      b.duty = 0.0;
+      s.phase = 0;
+    }
+    else
+    {
+      b.duty = this->config.kp * error - this->config.kd * b.gap_rate;
+      if (b.duty > 1.0)
+        b.duty = 1.0;
+      else if (b.duty < -1.0)
+        b.duty = -1.0;
+      int on_ticks = (int) std::ceil(std::fabs(b.duty) * this->config.pwm_ticks);
+      if (s.phase < on_ticks)
+        command = (b.duty > 0.0) ? BrakeCommand::extend : BrakeCommand::retract;
+      s.phase = (s.phase + 1) % this->config.pwm_ticks;
+    }
+    if (command == BrakeCommand::extend && low_pressure)
+      command = BrakeCommand::hold;
+  }
+  else
+  {
+    b.on_target = false;
+    b.duty = 0.0;
+  }
+
+  if (command != b.command || this->status.ticks == 1)
+  {
+    this->actuator.actuate(static_cast<RailSide>(i), command);
+    b.command = command;
+  }
+}
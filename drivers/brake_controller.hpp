@@ -0,0 +1,92 @@
+#ifndef HYPED_DRIVERS_BRAKE_CONTROLLER_HPP_
+#define HYPED_DRIVERS_BRAKE_CONTROLLER_HPP_
+
+#include <atomic>
+#include <thread>
+
+#include "interfaces.hpp"
+#include "proxi_sampler.hpp"
+#include "seqlock.hpp"
+
+struct BrakeControllerConfig
+{
+  double rate = 200.0;          // control loop frequency (Hz)
+  int priority = 80;            // SCHED_FIFO priority of the control thread
+  double target = 110.0;        // desired gap (mm)
+  double tolerance = 2.0;       // gap error considered on target (mm)
+  double kp = 0.05;             // duty cycle per mm of gap error
+  double kd = 0.002;            // duty cycle per mm/s of gap rate
+  int pwm_ticks = 10;           // control ticks per valve duty cycle window
+  double max_sample_age = 0.05; // proxi readings older than this (s) make the brake hold
+  double min_pressure = 0.0;    // extending is inhibited below this accumulator pressure
+};
+
+struct BrakeStatus
+{
+  double gap;           // latest gap reading (mm)
+  double gap_rate;      // mm/s
+  double duty;          // signed duty cycle (positive extends)
+  BrakeCommand command; // valve state currently commanded
+  bool on_target;
+  bool stale;           // no recent proxi reading
+};
+
+struct BrakeControllerStatus
+{
+  BrakeStatus brakes[2]; // indexed by RailSide
+  unsigned long ticks;
+  unsigned long deadline_misses; // periods skipped because a tick ran late
+  double max_lateness;           // worst wake-up latency (s)
+  double max_exec_time;          // worst tick duration (s)
+  bool realtime;                 // SCHED_FIFO was granted
+  bool low_pressure;
+};
+
+/// Holds both brakes at a target gap from the rail. Runs at a fixed rate on its own SCHED_FIFO
+/// thread; the proxis and the pressure sensor are only read through non-blocking snapshots and the
+/// status is published the same way, so displaying or logging it never touches the control thread.
+class BrakeController
+{
+  public:
+    /// `pressure` may be null, in which case extending is never inhibited
+    BrakeController(BrakeActuator& actuator, ProxiSampler& left, ProxiSampler& right,
+        PressureSensor* pressure = nullptr,
+        BrakeControllerConfig config = BrakeControllerConfig());
+    ~BrakeController();
+
+    BrakeController(BrakeController const&) = delete;
+    void operator=(BrakeController const&)  = delete;
+
+    void start();
+    /// Stops the control thread and leaves both brakes holding
+    void stop();
+    void set_target(double gap);
+    BrakeControllerStatus get_status();
+
+  private:
+    struct SideState
+    {
+      unsigned int last_count;
+      double last_gap;
+      double last_time;
+      double gap_rate;
+      int phase;
+    };
+
+    void run();
+    void tick(double now);
+    void update_side(int i, double now, bool low_pressure);
+
+    BrakeActuator& actuator;
+    ProxiSampler* samplers[2];
+    PressureSensor* pressure;
+    BrakeControllerConfig config;
+    std::atomic<double> target;
+    SideState state[2];
+    BrakeControllerStatus status;
+    SeqLock<BrakeControllerStatus> published;
+    std::atomic_bool stop_flag {true};
+    std::thread control_thread;
+};
+
+#endif // HYPED_DRIVERS_BRAKE_CONTROLLER_HPP_
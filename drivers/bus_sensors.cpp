@@ -0,0 +1,263 @@
+#include "bus_sensors.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "instrumentation.hpp"
+
+
+SamplePublisher::SamplePublisher(Clock& clock)
+    : clock(clock), scheduler(PUBLISHER_TICK_RATE)
+{}
+
+SamplePublisher::~SamplePublisher()
+{
+  this->stop();
+}
+
+bool SamplePublisher::add_accelerometer(Accelerometer& sensor,
+    SampleTopic<Vector3D<double>>& topic, double rate)
+{
+  static LatencyHistogram& accl_time = Instrumentation::get_histogram("sensor.accl");
+  return this->scheduler.add(rate, [this, &sensor, &topic]() {
+    double t0 = this->clock.now();
+    Vector3D<double> accl;
+    try
+    {
+      ScopedTimer timer(accl_time);
+      accl = sensor.get_acceleration();
+    }
+    catch (std::exception& e)
+    {
+      this->errors.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    topic.publish((t0 + this->clock.now()) / 2.0, accl);
+  });
+}
+
+bool SamplePublisher::add_gyroscope(Gyroscope& sensor, SampleTopic<Vector3D<double>>& topic,
+    double rate)
+{
+  static LatencyHistogram& gyro_time = Instrumentation::get_histogram("sensor.gyro");
+  return this->scheduler.add(rate, [this, &sensor, &topic]() {
+    double t0 = this->clock.now();
+    Vector3D<double> angv;
+    try
+    {
+      ScopedTimer timer(gyro_time);
+      angv = sensor.get_angular_velocity();
+    }
+    catch (std::exception& e)
+    {
+      this->errors.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    topic.publish((t0 + this->clock.now()) / 2.0, angv);
+  });
+}
+
+bool SamplePublisher::add_imu(Imu& sensor, SampleTopic<Vector3D<double>>& accl_topic,
+    SampleTopic<Vector3D<double>>& gyro_topic, double accl_rate, double gyro_rate)
+{
+  static LatencyHistogram& imu_time = Instrumentation::get_histogram("sensor.imu");
+  static LatencyHistogram& gyro_time = Instrumentation::get_histogram("sensor.gyro");
+  double rate = std::max(gyro_rate, accl_rate);
+  long ratio = std::max(1L, std::lround(rate / accl_rate));
+  long n = 0;
+  return this->scheduler.add(rate, [this, &sensor, &accl_topic, &gyro_topic, ratio, n]() mutable {
+    double t0 = this->clock.now();
+    bool full = n++ % ratio == 0;
+    ImuData data {Vector3D<double>(), Vector3D<double>()};
+    try
+    {
+      ScopedTimer timer(full ? imu_time : gyro_time);
+      if (full)
+        data = sensor.get_imu_data();
+      else
+        data.angular_velocity = sensor.get_angular_velocity();
+    }
+    catch (std::exception& e)
+    {
+      this->errors.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    double t = (t0 + this->clock.now()) / 2.0;
+    gyro_topic.publish(t, data.angular_velocity);
+    if (full)
+      accl_topic.publish(t, data.acceleration);
+  });
+}
+
+bool SamplePublisher::add_proxi(Proxi& sensor, SampleTopic<int>& topic, double rate)
+{
+  static LatencyHistogram& proxi_time = Instrumentation::get_histogram("sensor.proxi");
+  return this->scheduler.add(rate, [this, &sensor, &topic]() {
+    double t0 = this->clock.now();
+    double t;
+    int distance;
+    try
+    {
+      ScopedTimer timer(proxi_time);
+      distance = sensor.get_timed_distance(t);
+    }
+    catch (std::exception& e)
+    {
+      this->errors.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    topic.publish(t >= 0.0 ? t : (t0 + this->clock.now()) / 2.0, distance);
+  });
+}
+
+void SamplePublisher::start()
+{
+  if (!this->stop_flag)
+    return;
+  this->stop_flag = false;
+  this->scheduler.start(this->clock.now());
+  this->publishing_thread = std::thread(&SamplePublisher::run, this);
+}
+
+void SamplePublisher::stop()
+{
+  this->stop_flag = true;
+  if (this->publishing_thread.joinable())
+    this->publishing_thread.join();
+}
+
+unsigned long SamplePublisher::get_error_count() const
+{
+  return this->errors.load(std::memory_order_relaxed);
+}
+
+unsigned long SamplePublisher::get_missed_count() const
+{
+  return this->missed.load(std::memory_order_relaxed);
+}
+
+void SamplePublisher::run()
+{
+  while (!this->stop_flag)
+  {
+    double next = this->scheduler.run_due(this->clock.now());
+    this->missed.store(this->scheduler.get_missed_count(), std::memory_order_relaxed);
+    this->clock.sleep_until(next);
+  }
+}
+
+
+StaleSampleException::StaleSampleException(std::string msg) : message(msg)
+{}
+
+const char* StaleSampleException::what() const noexcept
+{
+  return this->message.c_str();
+}
+
+// Latest sample of `topic`, if at most `max_age` old and not given yet (its sequence is at least
+// `unread`, which then moves past it)
+template <typename T>
+static Sample<T> new_sample(const SampleTopic<T>& topic, double max_age, Clock& clock,
+    uint64_t& unread)
+{
+  Sample<T> sample;
+  if (!topic.latest(sample))
+    throw StaleSampleException("Nothing published yet");
+  if (clock.now() - sample.timestamp > max_age)
+    throw StaleSampleException("Latest sample is too old");
+  if (sample.sequence < unread)
+    throw NoNewReadingException();
+  unread = sample.sequence + 1;
+  return sample;
+}
+
+template <typename T>
+static bool has_new(const SampleTopic<T>& topic, uint64_t unread)
+{
+  return topic.get_count() > unread;
+}
+
+
+BusAccelerometer::BusAccelerometer(const SampleTopic<Vector3D<double>>& topic, double max_age,
+    Clock& clock)
+    : topic(topic), max_age(max_age), clock(clock)
+{}
+
+Vector3D<double> BusAccelerometer::get_acceleration()
+{
+  return this->get_sample().value;
+}
+
+Sample<Vector3D<double>> BusAccelerometer::get_sample()
+{
+  return new_sample(this->topic, this->max_age, this->clock, this->unread);
+}
+
+bool BusAccelerometer::has_new_sample() const
+{
+  return has_new(this->topic, this->unread);
+}
+
+
+BusGyroscope::BusGyroscope(const SampleTopic<Vector3D<double>>& topic, double max_age,
+    Clock& clock)
+    : topic(topic), max_age(max_age), clock(clock)
+{}
+
+Vector3D<double> BusGyroscope::get_angular_velocity()
+{
+  return this->get_sample().value;
+}
+
+Sample<Vector3D<double>> BusGyroscope::get_sample()
+{
+  return new_sample(this->topic, this->max_age, this->clock, this->unread);
+}
+
+bool BusGyroscope::has_new_sample() const
+{
+  return has_new(this->topic, this->unread);
+}
+
+
+BusImu::BusImu(const SampleTopic<Vector3D<double>>& accl_topic,
+    const SampleTopic<Vector3D<double>>& gyro_topic, double max_age, Clock& clock)
+    : accelerometer(accl_topic, max_age, clock), gyroscope(gyro_topic, max_age, clock)
+{}
+
+Vector3D<double> BusImu::get_acceleration()
+{
+  return this->accelerometer.get_acceleration();
+}
+
+Vector3D<double> BusImu::get_angular_velocity()
+{
+  return this->gyroscope.get_angular_velocity();
+}
+
+ImuData BusImu::get_imu_data()
+{
+  // Checked first so that an old gyro sample doesn't use up a new acceleration
+  if (!this->gyroscope.has_new_sample())
+    throw NoNewReadingException();
+  Vector3D<double> accl = this->get_acceleration();
+  return ImuData(accl, this->get_angular_velocity());
+}
+
+
+BusProxi::BusProxi(const SampleTopic<int>& topic, double max_age, Clock& clock)
+    : topic(topic), max_age(max_age), clock(clock)
+{}
+
+int BusProxi::get_distance()
+{
+  return new_sample(this->topic, this->max_age, this->clock, this->unread).value;
+}
+
+int BusProxi::get_timed_distance(double& timestamp)
+{
+  Sample<int> sample = new_sample(this->topic, this->max_age, this->clock, this->unread);
+  timestamp = sample.timestamp;
+  return sample.value;
+}
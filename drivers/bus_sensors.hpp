@@ -0,0 +1,149 @@
+#ifndef HYPED_DRIVERS_BUS_SENSORS_HPP_
+#define HYPED_DRIVERS_BUS_SENSORS_HPP_
+
+#include <atomic>
+#include <exception>
+#include <string>
+#include <thread>
+
+#include "clock.hpp"
+#include "interfaces.hpp"
+#include "sample_bus.hpp"
+#include "sensor_scheduler.hpp"
+#include "vector3d.hpp"
+
+#define PUBLISHER_TICK_RATE 8000.0 // Hz, resolution of the publishing schedule
+#define BUS_SENSOR_MAX_AGE 0.1     // s, older samples count as a failed read
+
+/// Reads sensors at their own rates on one thread and publishes every reading once (stamped with
+/// the middle of the read, or when the proxi says it measured), so any number of consumers share
+/// the readings instead of each of them reading the sensor again. Failed reads aren't published.
+class SamplePublisher
+{
+  public:
+    SamplePublisher(Clock& clock = Clock::get());
+    ~SamplePublisher();
+
+    SamplePublisher(SamplePublisher const&) = delete;
+    void operator=(SamplePublisher const&)  = delete;
+
+    /// These return false if there are already MAX_SCHEDULED_TASKS sensors or the publisher was
+    /// started
+    bool add_accelerometer(Accelerometer& sensor, SampleTopic<Vector3D<double>>& topic,
+        double rate);
+    bool add_gyroscope(Gyroscope& sensor, SampleTopic<Vector3D<double>>& topic, double rate);
+    /// Gyroscope readings at `gyro_rate`, every so often replaced by a full reading so that
+    /// acceleration is published at about `accl_rate` (as MotionTracker reads IMUs)
+    bool add_imu(Imu& sensor, SampleTopic<Vector3D<double>>& accl_topic,
+        SampleTopic<Vector3D<double>>& gyro_topic, double accl_rate, double gyro_rate);
+    bool add_proxi(Proxi& sensor, SampleTopic<int>& topic, double rate);
+    void start();
+    void stop();
+    /// Reads which failed (threw)
+    unsigned long get_error_count() const;
+    /// Reads skipped because the thread fell behind
+    unsigned long get_missed_count() const;
+
+  private:
+    void run();
+
+    Clock& clock;
+    SensorScheduler scheduler;
+    std::atomic<unsigned long> errors {0};
+    std::atomic<unsigned long> missed {0};
+    std::atomic_bool stop_flag {true};
+    std::thread publishing_thread;
+};
+
+/// Thrown by the bus sensors when a topic has no recent sample
+class StaleSampleException : public std::exception
+{
+  public:
+    StaleSampleException(std::string message);
+    virtual const char* what() const noexcept override;
+
+  private:
+    const std::string message;
+};
+
+/*
+ * Sensors giving the latest sample of a topic, so code written against the interfaces (e.g.
+ * MotionTracker, ProxiSampler) can consume published readings. They never block; with no sample
+ * at most `max_age` old they throw StaleSampleException like a failed read. Each sample is given
+ * once: if the latest is one they gave already, they throw NoNewReadingException (interfaces.hpp)
+ * instead of repeating it.
+ */
+
+class BusAccelerometer : public Accelerometer
+{
+  public:
+    BusAccelerometer(const SampleTopic<Vector3D<double>>& topic,
+        double max_age = BUS_SENSOR_MAX_AGE, Clock& clock = Clock::get());
+
+    Vector3D<double> get_acceleration() override;
+    /// The sample get_acceleration() would give, with its sequence and timestamp
+    Sample<Vector3D<double>> get_sample();
+    /// Whether the latest sample (however old) hasn't been given yet
+    bool has_new_sample() const;
+
+  private:
+    const SampleTopic<Vector3D<double>>& topic;
+    double max_age;
+    Clock& clock;
+    uint64_t unread = 0; // sequence of the first sample not given yet
+};
+
+class BusGyroscope : public Gyroscope
+{
+  public:
+    BusGyroscope(const SampleTopic<Vector3D<double>>& topic,
+        double max_age = BUS_SENSOR_MAX_AGE, Clock& clock = Clock::get());
+
+    /// The publisher's sensor is calibrated where it is read
+    void calibrate_gyro(int n) override {}
+    Vector3D<double> get_angular_velocity() override;
+    Sample<Vector3D<double>> get_sample();
+    bool has_new_sample() const;
+
+  private:
+    const SampleTopic<Vector3D<double>>& topic;
+    double max_age;
+    Clock& clock;
+    uint64_t unread = 0;
+};
+
+class BusImu : public Imu
+{
+  public:
+    BusImu(const SampleTopic<Vector3D<double>>& accl_topic,
+        const SampleTopic<Vector3D<double>>& gyro_topic, double max_age = BUS_SENSOR_MAX_AGE,
+        Clock& clock = Clock::get());
+
+    Vector3D<double> get_acceleration() override;
+    void calibrate_gyro(int n) override {}
+    Vector3D<double> get_angular_velocity() override;
+    /// Only if both samples are new; otherwise neither is used up
+    ImuData get_imu_data() override;
+
+  private:
+    BusAccelerometer accelerometer;
+    BusGyroscope gyroscope;
+};
+
+class BusProxi : public Proxi
+{
+  public:
+    BusProxi(const SampleTopic<int>& topic, double max_age = BUS_SENSOR_MAX_AGE,
+        Clock& clock = Clock::get());
+
+    int get_distance() override;
+    int get_timed_distance(double& timestamp) override;
+
+  private:
+    const SampleTopic<int>& topic;
+    double max_age;
+    Clock& clock;
+    uint64_t unread = 0;
+};
+
+#endif // HYPED_DRIVERS_BUS_SENSORS_HPP_
@@ -0,0 +1,236 @@
+#include "calibration.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#include "clock.hpp"
+
+#define CALIBRATION_FORMAT_VERSION 2
+#define CALIBRATION_RETRY_PERIOD 0.0002 // s, between reads of a sensor with no new reading
+
+inline double wall_time()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>
+    (system_clock::now().time_since_epoch()).count() / 1.0e+9;
+}
+
+// `read()` once the sensor has a new reading (see NoNewReadingException)
+template <typename F>
+static auto read_new(F read) -> decltype(read())
+{
+  while (true)
+  {
+    try
+    {
+      return read();
+    }
+    catch (NoNewReadingException& e)
+    {
+      Clock::get().sleep_for(CALIBRATION_RETRY_PERIOD);
+    }
+  }
+}
+
+// Sum of `n` readings of one sensor; the exception (if any) is kept for the calling thread
+struct SensorSum
+{
+  Vector3D<double> accl;
+  Vector3D<double> angv;
+  std::exception_ptr error;
+};
+
+
+Calibration Calibration::measure(
+    std::vector<std::reference_wrapper<Accelerometer>>& accelerometers,
+    std::vector<std::reference_wrapper<Gyroscope>>& gyroscopes,
+    std::vector<std::reference_wrapper<Imu>>& imus, int n, bool parallel)
+{
+  unsigned int na = accelerometers.size(), ng = gyroscopes.size(), ni = imus.size();
+  std::vector<SensorSum> sums(na + ng + ni);
+  std::vector<std::function<void()>> tasks;
+  for (unsigned int i = 0; i < na; ++i)
+    tasks.emplace_back([&accelerometers, &sums, i, n]() {
+      try
+      {
+        for (int j = 0; j < n; ++j)
+          sums[i].accl += read_new([&]() { return accelerometers[i].get().get_acceleration(); });
+      }
+      catch (...)
+      {
+        sums[i].error = std::current_exception();
+      }
+    });
+  for (unsigned int i = 0; i < ng; ++i)
+    tasks.emplace_back([&gyroscopes, &sums, i, na, n]() {
+      try
+      {
+        for (int j = 0; j < n; ++j)
+          sums[na + i].angv +=
+              read_new([&]() { return gyroscopes[i].get().get_angular_velocity(); });
+      }
+      catch (...)
+      {
+        sums[na + i].error = std::current_exception();
+      }
+    });
+  for (unsigned int i = 0; i < ni; ++i)
+    tasks.emplace_back([&imus, &sums, i, na, ng, n]() {
+      try
+      {
+        // One read gives both, instead of separate accelerometer and gyroscope passes
+        for (int j = 0; j < n; ++j)
+        {
+          ImuData data = read_new([&]() { return imus[i].get().get_imu_data(); });
+          sums[na + ng + i].accl += data.acceleration;
+          sums[na + ng + i].angv += data.angular_velocity;
+        }
+      }
+      catch (...)
+      {
+        sums[na + ng + i].error = std::current_exception();
+      }
+    });
+  if (parallel)
+  {
+    std::vector<std::thread> threads;
+    for (std::function<void()>& task : tasks)
+      threads.emplace_back(task);
+    for (std::thread& t : threads)
+      t.join();
+  }
+  else
+    for (std::function<void()>& task : tasks)
+      task();
+
+  Calibration c;
+  c.timestamp = wall_time();
+  c.num_accelerometers = na;
+  c.num_gyroscopes = ng;
+  c.num_imus = ni;
+  for (unsigned int i = 0; i < sums.size(); ++i)
+    if (sums[i].error)
+      std::rethrow_exception(sums[i].error);
+  for (unsigned int i = 0; i < na; ++i)
+    c.accl_offset[i] = sums[i].accl / (double) n;
+  for (unsigned int i = 0; i < ng; ++i)
+    c.gyro_bias[i] = sums[na + i].angv / (double) n;
+  for (unsigned int i = 0; i < ni; ++i)
+  {
+    c.accl_offset[na + i] = sums[na + ng + i].accl / (double) n;
+    c.gyro_bias[ng + i] = sums[na + ng + i].angv / (double) n;
+  }
+  return c;
+}
+
+Vector3D<double> Calibration::get_rest_accl() const
+{
+  int n = this->num_accelerometers + this->num_imus;
+  Vector3D<double> sum;
+  for (int i = 0; i < n; ++i)
+    sum += this->accl_offset[i];
+  return n > 0 ? sum / (double) n : sum;
+}
+
+bool Calibration::load(const std::string& filename, double max_age, int num_accelerometers,
+    int num_gyroscopes, int num_imus, Calibration& calibration)
+{
+  std::ifstream file(filename);
+  int version;
+  Calibration c;
+  if (!(file >> version) || version != CALIBRATION_FORMAT_VERSION)
+    return false;
+  if (!(file >> c.timestamp >> c.num_accelerometers >> c.num_gyroscopes >> c.num_imus))
+    return false;
+  if (c.num_accelerometers != num_accelerometers || c.num_gyroscopes != num_gyroscopes
+      || c.num_imus != num_imus)
+    return false;
+  for (int i = 0; i < c.num_accelerometers + c.num_imus; ++i)
+    if (!(file >> c.accl_offset[i].x >> c.accl_offset[i].y >> c.accl_offset[i].z))
+      return false;
+  for (int i = 0; i < c.num_gyroscopes + c.num_imus; ++i)
+    if (!(file >> c.gyro_bias[i].x >> c.gyro_bias[i].y >> c.gyro_bias[i].z))
+      return false;
+  double age = c.get_age();
+  if (age < 0.0 || age > max_age)
+    return false;
+  calibration = c;
+  return true;
+}
+
+// Writes all of `data` to `fd`; false if that fails
+static bool write_all(int fd, const std::string& data)
+{
+  size_t written = 0;
+  while (written < data.length())
+  {
+    ssize_t n = write(fd, data.c_str() + written, data.length() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+bool Calibration::save(const std::string& filename) const
+{
+  std::ostringstream text;
+  text.precision(17);
+  text << CALIBRATION_FORMAT_VERSION << "\n"
+       << this->timestamp << " " << this->num_accelerometers << " "
+       << this->num_gyroscopes << " " << this->num_imus << "\n";
+  // One line per sensor: accelerometers, then gyroscopes
+  for (int i = 0; i < this->num_accelerometers + this->num_imus; ++i)
+    text << this->accl_offset[i].x << " " << this->accl_offset[i].y << " "
+         << this->accl_offset[i].z << "\n";
+  for (int i = 0; i < this->num_gyroscopes + this->num_imus; ++i)
+    text << this->gyro_bias[i].x << " " << this->gyro_bias[i].y << " "
+         << this->gyro_bias[i].z << "\n";
+
+  // The new file is on the disk before it replaces the old one, and the rename before this
+  // returns, so losing power leaves one calibration or the other
+  std::string tmp = filename + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return false;
+  bool written = write_all(fd, text.str()) && fsync(fd) == 0;
+  if (close(fd) != 0 || !written || std::rename(tmp.c_str(), filename.c_str()) != 0)
+  {
+    unlink(tmp.c_str());
+    return false;
+  }
+  size_t slash = filename.rfind('/');
+  std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash + 1);
+  int dir_fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd < 0)
+    return false;
+  bool synced = fsync(dir_fd) == 0;
+  close(dir_fd);
+  return synced;
+}
+
+void Calibration::refine_accl(int sensor, Vector3D<double> residual, double gain)
+{
+  this->accl_offset[sensor] += gain * residual;
+  this->timestamp = wall_time();
+}
+
+void Calibration::refine_gyro(int sensor, Vector3D<double> residual, double gain)
+{
+  this->gyro_bias[sensor] += gain * residual;
+  this->timestamp = wall_time();
+}
+
+double Calibration::get_age() const
+{
+  return wall_time() - this->timestamp;
+}
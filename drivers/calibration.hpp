@@ -0,0 +1,49 @@
+#ifndef HYPED_DRIVERS_CALIBRATION_HPP_
+#define HYPED_DRIVERS_CALIBRATION_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "interfaces.hpp"
+#include "sensor_fusion.hpp"
+#include "vector3d.hpp"
+
+#define CALIBRATION_MAX_AGE (12 * 3600.0) // s
+
+/// Offsets of each of MotionTracker's sensors, removed from its readings before they are fused
+/// (so sensors with different biases still agree). Accelerometers are indexed as in its
+/// accelerometer fusion (accelerometers, then IMUs) and gyroscopes as in its gyroscope fusion
+/// (gyroscopes, then IMUs)
+struct Calibration
+{
+  double timestamp;              // system clock time it was taken (seconds since epoch)
+  int num_accelerometers;        // sensor set it is valid for
+  int num_gyroscopes;
+  int num_imus;
+  Vector3D<double> accl_offset[MAX_FUSED_SENSORS]; // acceleration of each at rest
+  Vector3D<double> gyro_bias[MAX_FUSED_SENSORS];   // angular velocity of each at rest
+
+  /// Acceleration at rest (gravity) as the accelerometers agree on it, i.e. their mean offset
+  Vector3D<double> get_rest_accl() const;
+  /// Averages `n` readings of every sensor, reading all sensors in parallel (one thread each)
+  /// unless `parallel` is false. Sensor exceptions are passed on to the caller
+  static Calibration measure(std::vector<std::reference_wrapper<Accelerometer>>& accelerometers,
+      std::vector<std::reference_wrapper<Gyroscope>>& gyroscopes,
+      std::vector<std::reference_wrapper<Imu>>& imus, int n, bool parallel = true);
+  /// Loads a calibration saved by save(); returns false if the file is missing or unreadable,
+  /// older than `max_age` seconds or taken with a different number of sensors
+  static bool load(const std::string& filename, double max_age, int num_accelerometers,
+      int num_gyroscopes, int num_imus, Calibration& calibration);
+  /// Replaces the file atomically and durably (fsynced before and after the rename), so a crash
+  /// or power cut leaves either the old calibration or the new one; false if it couldn't
+  bool save(const std::string& filename) const;
+  /// Move one sensor's offset by `gain` times its residual (a reading at rest after its current
+  /// offset was removed) and mark the calibration as current
+  void refine_accl(int sensor, Vector3D<double> residual, double gain);
+  void refine_gyro(int sensor, Vector3D<double> residual, double gain);
+  /// Seconds since it was taken
+  double get_age() const;
+};
+
+#endif // HYPED_DRIVERS_CALIBRATION_HPP_
@@ -0,0 +1,120 @@
+#include "clock.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+
+extern "C" {
+#include <time.h>
+}
+
+std::atomic<Clock*> Clock::current {nullptr};
+
+Clock& Clock::get()
+{
+  Clock* clock = current.load(std::memory_order_acquire);
+  if (clock)
+    return *clock;
+  return RealClock::instance();
+}
+
+void Clock::set(Clock& clock)
+{
+  current.store(&clock, std::memory_order_release);
+}
+
+
+RealClock& RealClock::instance()
+{
+  static RealClock clock;
+  return clock;
+}
+
+double RealClock::now()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(
+      steady_clock::now().time_since_epoch()).count() / 1.0e+9;
+}
+
+void RealClock::sleep_until(double t)
+{
+  // CLOCK_MONOTONIC is the steady clock's; an absolute deadline doesn't drift when interrupted
+  struct timespec deadline;
+  double seconds = std::floor(t);
+  deadline.tv_sec = (time_t) seconds;
+  deadline.tv_nsec = (long) ((t - seconds) * 1.0e+9);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+    ;
+}
+
+
+VirtualClock::VirtualClock(VirtualClockMode mode, double start)
+    : mode(mode), time(start)
+{}
+
+double VirtualClock::now()
+{
+  return this->time.load(std::memory_order_acquire);
+}
+
+void VirtualClock::sleep_until(double t)
+{
+  if (this->mode.load(std::memory_order_acquire) == VirtualClockMode::jump)
+  {
+    this->jump_to(t);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  auto due = [&]() {
+    return this->time.load(std::memory_order_relaxed) >= t
+        || this->mode.load(std::memory_order_relaxed) == VirtualClockMode::jump;
+  };
+  if (!due())
+  {
+    auto wakeup = this->wakeups.insert(t);
+    this->asleep.notify_all();
+    this->wake.wait(lock, due);
+    this->wakeups.erase(wakeup);
+  }
+  this->jump_to(t); // if woken by switching to jump
+}
+
+void VirtualClock::jump_to(double t)
+{
+  double now = this->time.load(std::memory_order_relaxed);
+  while (now < t && !this->time.compare_exchange_weak(now, t, std::memory_order_acq_rel))
+    ;
+}
+
+void VirtualClock::set_mode(VirtualClockMode mode)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->mode.store(mode, std::memory_order_release);
+  this->wake.notify_all();
+}
+
+void VirtualClock::advance(double duration)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->time.store(this->time.load(std::memory_order_relaxed) + duration,
+      std::memory_order_release);
+  this->wake.notify_all();
+}
+
+double VirtualClock::step(int threads)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  double now = this->time.load(std::memory_order_relaxed);
+  // Threads due now may not have left wakeups yet
+  this->asleep.wait(lock, [&]() {
+    return std::count_if(this->wakeups.begin(), this->wakeups.end(),
+        [&](double t) { return t > now; }) >= threads;
+  });
+  double t = *this->wakeups.upper_bound(now);
+  this->time.store(t, std::memory_order_release);
+  this->wake.notify_all();
+  return t;
+}
@@ -0,0 +1,82 @@
+#ifndef HYPED_DRIVERS_CLOCK_HPP_
+#define HYPED_DRIVERS_CLOCK_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+/// Source of time for the drivers: every wait and timestamp goes through Clock::get(), so a
+/// VirtualClock can make tests and simulated runs take no time at all. Timestamps are seconds on
+/// a monotonic timeline (the steady clock's for RealClock).
+class Clock
+{
+  public:
+    virtual ~Clock() {}
+
+    virtual double now() = 0;
+    /// Returns once now() has reached `t`
+    virtual void sleep_until(double t) = 0;
+    void sleep_for(double duration) { this->sleep_until(this->now() + duration); }
+
+    /// The clock used by the drivers, RealClock::instance() unless set() was called
+    static Clock& get();
+    /// Call before creating any drivers; `clock` has to outlive them
+    static void set(Clock& clock);
+
+  private:
+    static std::atomic<Clock*> current;
+};
+
+class RealClock : public Clock
+{
+  public:
+    static RealClock& instance();
+
+    double now() override;
+    void sleep_until(double t) override;
+
+  private:
+    RealClock() {}
+};
+
+/// jump: sleeping moves time straight to the wake-up time, so waits take no time. Suits code
+///   with one sleeping thread at a time (setup, calibration, single-threaded simulations); with
+///   several, each thread's sleeps move time on for the others
+/// stepped: sleeping threads wait until step() moves time on to the earliest wake-up time once
+///   a given number of them are asleep, which runs several threads in lockstep. Switch to jump
+///   before stopping them, or they never wake up to notice
+enum class VirtualClockMode
+{
+  jump,
+  stepped
+};
+
+class VirtualClock : public Clock
+{
+  public:
+    VirtualClock(VirtualClockMode mode = VirtualClockMode::jump, double start = 0.0);
+
+    double now() override;
+    void sleep_until(double t) override;
+
+    /// Moves time forward by `duration`, waking the threads due by then
+    void advance(double duration);
+    /// Switching to jump wakes all sleeping threads
+    void set_mode(VirtualClockMode mode);
+    /// stepped: waits until `threads` threads are asleep, then moves time to the earliest of
+    /// their wake-up times; returns the new time
+    double step(int threads);
+
+  private:
+    void jump_to(double t); // moves time forward to `t` unless it is already past it
+
+    std::atomic<VirtualClockMode> mode;
+    std::atomic<double> time;
+    std::mutex mutex;
+    std::condition_variable wake;      // sleepers, when time moves on
+    std::condition_variable asleep;    // step(), when a thread goes to sleep
+    std::multiset<double> wakeups;     // of the sleeping threads
+};
+
+#endif // HYPED_DRIVERS_CLOCK_HPP_
@@ -0,0 +1,75 @@
+#include "clock_sync.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+ClockSync::ClockSync(int window) : window(std::max(1, window))
+{
+  this->exchanges.reserve(this->window);
+}
+
+void ClockSync::add(double sent, double received, double replied, double returned)
+{
+  Exchange e;
+  e.time = (sent + returned) / 2.0;
+  e.offset = ((received - sent) + (replied - returned)) / 2.0;
+  e.delay = std::max(0.0, (returned - sent) - (replied - received));
+  if (this->exchanges.size() < this->window)
+    this->exchanges.push_back(e);
+  else
+    this->exchanges[this->count % this->window] = e;
+  ++this->count;
+  this->fit();
+}
+
+double ClockSync::to_local(double remote) const
+{
+  return (remote - this->offset + this->drift * this->time) / (1.0 + this->drift);
+}
+
+double ClockSync::to_remote(double local) const
+{
+  return local + this->offset + this->drift * (local - this->time);
+}
+
+void ClockSync::fit()
+{
+  double min_delay = this->exchanges[0].delay;
+  for (const Exchange& e : this->exchanges)
+    min_delay = std::min(min_delay, e.delay);
+  this->error_bound = min_delay / 2.0;
+
+  // Slow exchanges were mostly held up one way, which shifts their offset by up to half the delay
+  double max_delay = 2.0 * min_delay + CLOCK_SYNC_DELAY_SLACK;
+  double first = INFINITY, last = -INFINITY;
+  int n = 0;
+  double mean_t = 0.0, mean_offset = 0.0;
+  for (const Exchange& e : this->exchanges)
+    if (e.delay <= max_delay)
+    {
+      first = std::min(first, e.time);
+      last = std::max(last, e.time);
+      mean_t += e.time;
+      mean_offset += e.offset;
+      ++n;
+    }
+  mean_t /= n;
+  mean_offset /= n;
+
+  // Least squares line through the offsets; until they span long enough to show the drift,
+  // keep the last drift estimate
+  if (last - first >= CLOCK_SYNC_MIN_SPAN)
+  {
+    double stt = 0.0, sto = 0.0;
+    for (const Exchange& e : this->exchanges)
+      if (e.delay <= max_delay)
+      {
+        stt += (e.time - mean_t) * (e.time - mean_t);
+        sto += (e.time - mean_t) * (e.offset - mean_offset);
+      }
+    this->drift = std::max(-CLOCK_SYNC_MAX_DRIFT, std::min(CLOCK_SYNC_MAX_DRIFT, sto / stt));
+  }
+  this->time = last;
+  this->offset = mean_offset + this->drift * (last - mean_t);
+}
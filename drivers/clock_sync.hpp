@@ -0,0 +1,53 @@
+#ifndef HYPED_DRIVERS_CLOCK_SYNC_HPP_
+#define HYPED_DRIVERS_CLOCK_SYNC_HPP_
+
+#include <vector>
+
+#define CLOCK_SYNC_WINDOW 256        // latest exchanges the estimate is fitted to
+#define CLOCK_SYNC_DELAY_SLACK 50e-6 // s, round trips this much over twice the quickest are used
+#define CLOCK_SYNC_MIN_SPAN 1.0      // s, of exchanges needed before the drift is fitted
+#define CLOCK_SYNC_MAX_DRIFT 1e-3    // s/s, fitted drift is limited to this (crystals are ~1e-4)
+
+/// Estimates the offset and drift of a remote clock from request/reply exchanges, as NTP does:
+/// the request is sent and its reply returns at local times, the remote side stamps when it
+/// received the request and when it replied. Each exchange gives the offset to within half its
+/// round trip, so a line is fitted to the offsets of the quickest exchanges in the window.
+class ClockSync
+{
+  public:
+    ClockSync(int window = CLOCK_SYNC_WINDOW);
+
+    /// `sent` and `returned` are local times, `received` and `replied` remote ones (seconds)
+    void add(double sent, double received, double replied, double returned);
+    /// Whether there has been an exchange (before, remote times are taken as local ones)
+    bool is_synced() const { return this->count > 0; }
+    /// Local time at remote time `remote`
+    double to_local(double remote) const;
+    double to_remote(double local) const;
+    /// Remote minus local time at the latest exchange used
+    double get_offset() const { return this->offset; }
+    /// Remote seconds gained per local second
+    double get_drift() const { return this->drift; }
+    /// Half the quickest round trip in the window, a bound on the error of the offset
+    double get_error_bound() const { return this->error_bound; }
+
+  private:
+    struct Exchange
+    {
+      double time;   // local, halfway through the round trip
+      double offset; // remote minus local
+      double delay;  // round trip without the remote side's processing
+    };
+
+    void fit();
+
+    unsigned int window;
+    std::vector<Exchange> exchanges;
+    unsigned int count = 0; // exchanges added so far
+    double time = 0.0;      // local time `offset` applies at
+    double offset = 0.0;
+    double drift = 0.0;
+    double error_bound = 0.0;
+};
+
+#endif // HYPED_DRIVERS_CLOCK_SYNC_HPP_
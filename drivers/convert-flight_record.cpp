@@ -0,0 +1,70 @@
+/*
+ * Converts a file written by FlightRecorder into one CSV per channel:
+ *   convert-flight_record <record file> [output prefix]
+ * writes <prefix>-<channel>.csv with a `timestamp,<fields>...` header row. The prefix defaults to
+ * the record file's name. A truncated last block (e.g. after a power cut) is skipped.
+ * For analysis, pack-run_log turns a record into a run log instead, which is much faster to read.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "flight_recorder.hpp"
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s <record file> [output prefix]\n", argv[0]);
+    return 1;
+  }
+  std::string prefix = argc > 2 ? argv[2] : argv[1];
+  FlightRecordReader reader;
+  if (!reader.open(argv[1]))
+  {
+    printf("%s is not a flight record (version %d)\n", argv[1], RECORDER_FORMAT_VERSION);
+    return 1;
+  }
+
+  const std::vector<RecordChannel>& channels = reader.get_channels();
+  std::vector<FILE*> files(channels.size());
+  std::vector<unsigned long> counts(channels.size(), 0);
+  for (unsigned int i = 0; i < channels.size(); ++i)
+  {
+    std::string filename = prefix + "-" + channels[i].name + ".csv";
+    files[i] = fopen(filename.c_str(), "w");
+    if (!files[i])
+    {
+      printf("Can't write %s\n", filename.c_str());
+      return 1;
+    }
+    fprintf(files[i], "timestamp");
+    for (const std::string& f : channels[i].fields)
+      fprintf(files[i], ",%s", f.c_str());
+    fprintf(files[i], "\n");
+  }
+
+  RecordHeader record;
+  const double* values;
+  while (reader.next(record, values))
+  {
+    FILE* file = files[record.channel];
+    fprintf(file, "%.9f", record.timestamp);
+    for (unsigned int i = 0; i < record.num_values; ++i)
+      fprintf(file, ",%.17g", values[i]);
+    fprintf(file, "\n");
+    ++counts[record.channel];
+  }
+
+  for (unsigned int i = 0; i < channels.size(); ++i)
+  {
+    printf("  %-20s %lu records\n", channels[i].name.c_str(), counts[i]);
+    fclose(files[i]);
+  }
+  if (reader.get_corrupt_blocks())
+    printf("%lu corrupt blocks were skipped\n", reader.get_corrupt_blocks());
+  if (reader.get_bad_records())
+    printf("%lu records not matching their channel were skipped\n", reader.get_bad_records());
+  return 0;
+}
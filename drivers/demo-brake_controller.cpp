@@ -0,0 +1,60 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "brake_controller.hpp"
+#include "proxi_sampler.hpp"
+#include "sim_cylinder.hpp"
+
+// Runs the brake controller against simulated cylinders (no hardware needed). Displaying the
+// status happens on this thread, the control loop runs on its own.
+
+const char* command_name(BrakeCommand c)
+{
+  switch (c)
+  {
+    case BrakeCommand::extend:  return "extend ";
+    case BrakeCommand::retract: return "retract";
+    default:                    return "hold   ";
+  }
+}
+
+int main()
+{
+  SimulatedBrakes brakes(70.0, 150.0);
+  ProxiSampler left(brakes.left, 1000);
+  ProxiSampler right(brakes.right, 1000);
+  left.start();
+  right.start();
+
+  BrakeControllerConfig config;
+  config.target = 110.0;
+  BrakeController controller(brakes, left, right, nullptr, config);
+  controller.start();
+
+  BrakeControllerStatus s;
+  for (int i = 0; i < 40; ++i)
+  {
+    if (i == 20)
+      controller.set_target(90.0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    s = controller.get_status();
+    printf("t=%4.1fs  left %6.1fmm %s%s  right %6.1fmm %s%s\n", (i + 1) / 10.0,
+        brakes.left.get_gap(), command_name(s.brakes[0].command),
+        s.brakes[0].on_target ? " *" : "  ",
+        brakes.right.get_gap(), command_name(s.brakes[1].command),
+        s.brakes[1].on_target ? " *" : "  ");
+  }
+  controller.stop();
+  left.stop();
+  right.stop();
+
+  s = controller.get_status();
+  printf("\nticks: %lu  deadline misses: %lu  max lateness: %.3fms  max tick: %.3fms  %s\n",
+      s.ticks, s.deadline_misses, s.max_lateness * 1000.0, s.max_exec_time * 1000.0,
+      s.realtime ? "(SCHED_FIFO)" : "(not real-time, run as root for SCHED_FIFO)");
+  double left_err = brakes.left.get_gap() - 90.0;
+  double right_err = brakes.right.get_gap() - 90.0;
+  printf("final error: left %.1fmm  right %.1fmm\n", left_err, right_err);
+  return (left_err * left_err < 9.0 && right_err * right_err < 9.0) ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include <chrono>
+#include <cstdio>
+
+#include "gpio.hpp"
+#include "gpio_bank.hpp"
+#include "hydraulics.hpp"
+
+// Compares switching the hydraulics outputs one pin at a time with switching them as a bank.
+// CAUTION: toggles the solenoid and pump pins; only run with the hydraulics disconnected.
+
+const int n = 10000;
+
+double elapsed_us(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - t0).count() / 1000.0;
+}
+
+int main()
+{
+  GpioPin* pins[NUM_HYDRAULIC_OUTPUTS];
+  for (int i = 0; i < NUM_HYDRAULIC_OUTPUTS; ++i)
+    pins[i] = &Gpio::get_pin(i, PinMode::out, PudControl::off);
+  GpioBank& bank = GpioBank::instance();
+  printf("Using %s bank\n",
+      dynamic_cast<MmapGpioBank*>(&bank) != nullptr ? "memory-mapped" : "wiringPi");
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < NUM_HYDRAULIC_OUTPUTS; ++j)
+      pins[j]->write(i & 1);
+  printf("Per pin: %8.3fus per group switch\n", elapsed_us(t0) / n);
+
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+  {
+    if (i & 1)
+      bank.write(ALL_OUTPUTS_BITS, 0);
+    else
+      bank.write(0, ALL_OUTPUTS_BITS);
+  }
+  printf("Bank:    %8.3fus per group switch\n", elapsed_us(t0) / n);
+
+  bank.write(ALL_OUTPUTS_BITS, 0);
+  printf("Levels after shut down: 0x%02x (expected 0x%02x)\n",
+      bank.read() & ALL_OUTPUTS_BITS, ALL_OUTPUTS_BITS);
+
+  // The test double records the same writes without touching hardware
+  FakeGpioBank fake;
+  Hydraulics hydraulics(fake);
+  hydraulics.shut_down();
+  hydraulics.hold(RailSide::left);
+  printf("Fake bank after shut_down + hold(left): 0x%02x in %u writes\n",
+      fake.read(), fake.get_write_count());
+  return 0;
+}
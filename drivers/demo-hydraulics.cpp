@@ -1,31 +1,34 @@
 #include "hydraulics.hpp"
-#include <string>
+#include "hydraulics_sequencer.hpp"
+
+#include <future>
 
 int main()
 {
-
-	std::string left = "left";
-	std::string right = "right";
-
 	Hydraulics hydraulics;
+	HydraulicsSequencer sequencer(hydraulics);
 
+	// Blocking calls
 	hydraulics.spin_up();
 	hydraulics.charge_accumulators();
-	hydraulics.retract(left);
-	hydraulics.retract(right);
+	hydraulics.retract(RailSide::left);
+	hydraulics.retract(RailSide::right);
 	hydraulics.stand_by();
 
-	usleep(3000000); // 2000 milliseconds
+	usleep(3000000); // 3000 milliseconds
 
-	hydraulics.extend(left);
-	hydraulics.extend(right);
+	// Both sides at once through the sequencer
+	std::future<bool> left = sequencer.extend(RailSide::left);
+	std::future<bool> right = sequencer.extend(RailSide::right);
+	left.wait();
+	right.wait();
 
 	usleep(2000000); // 2000 milliseconds
 
-	hydraulics.spin_up();
-	hydraulics.retract(left);
-	hydraulics.retract(right);
-	hydraulics.stand_by();
-	hydraulics.shut_down();
+	sequencer.spin_up().wait();
+	sequencer.retract(RailSide::left);
+	sequencer.retract(RailSide::right);
+	sequencer.stand_by().wait();
+	sequencer.shut_down().wait();
 
 }
@@ -2,13 +2,17 @@
 #include <chrono>
 #include <cmath>
 #include <cstdio>
-#include <fstream>
 #include <functional>
+#include <memory>
 #include <ncurses.h>
 #include <string>
 #include <thread>
+#include <vector>
 
+#include "bus_sensors.hpp"
+#include "flight_recorder.hpp"
 #include "i2c.hpp"
+#include "instrumentation.hpp"
 #include "mpu6050.hpp"
 #include "motion_tracker.hpp"
 #include "quaternion.hpp"
@@ -18,6 +22,10 @@
 #define GYRO_POS 7
 #define ACCL_POS 11 
 
+#define CALIBRATION_FILE "motion_tracker.cal"
+// Full IMU readings are published at the gyro rate, so calibrating doesn't wait for new ones
+#define IMU_PUBLISH_RATE DEFAULT_GYRO_RATE
+
 #define SENSOR1_PIN PIN22
 #define SENSOR2_PIN PIN23
 #define SENSOR3_PIN PIN24
@@ -30,10 +38,17 @@ bool two_imus;
 I2C i2c;
 Mpu6050 imu1(&i2c);
 Mpu6050* imu2 = nullptr;
+// The IMUs are read by the publisher and the tracker takes their readings off the bus, so
+// anything else wanting them can read them there too
+SampleBus bus;
+SamplePublisher publisher;
+std::vector<std::unique_ptr<BusImu>> bus_imus;
+FlightRecorder recorder; // declared before mt so it outlives the tracking thread
 MotionTracker mt;
 Vl6180Factory& factory = Vl6180Factory::instance(&i2c);
 
-void setup();
+void add_imu(Mpu6050& imu, const std::string& name);
+void setup(const std::string& record_file = std::string());
 void finalize();
 void file_output();
 void screen_output();
@@ -77,14 +92,24 @@ int main()
   finalize();
 }
 
-void setup()
+void add_imu(Mpu6050& imu, const std::string& name)
+{
+  SampleTopic<Vector3D<double>>& accl = *bus.topic<Vector3D<double>>(name + ".accl");
+  SampleTopic<Vector3D<double>>& gyro = *bus.topic<Vector3D<double>>(name + ".gyro");
+  publisher.add_imu(imu, accl, gyro, IMU_PUBLISH_RATE, IMU_PUBLISH_RATE);
+  bus_imus.emplace_back(new BusImu(accl, gyro));
+  mt.add_imu(*bus_imus.back());
+}
+
+void setup(const std::string& record_file)
 {
-  mt.add_imu(imu1);
+  add_imu(imu1, "imu1");
   if (two_imus)
   {
     imu2 = new Mpu6050(&i2c, ALTERNATIVE_SLAVE_ADDR);
-    mt.add_imu(*imu2);
+    add_imu(*imu2, "imu2");
   }
+  publisher.start();
 
   // Uncomment to use 6 proxis (4 to ground, 2 to rail from left)
   /*std::array<Vl6180*, 6> sensors;
@@ -107,14 +132,26 @@ void setup()
   mt.add_ground_proxi(*sensors[3], Vector3D<double>(-500, 1000, 0));
   mt.add_brake_proxis(*sensors[4], *sensors[5], RailSide::left);*/
 
-  mt.start();
+  if (!record_file.empty())
+  {
+    mt.set_recorder(recorder);
+    recorder.start(record_file);
+  }
+
+  // Reuses a recent calibration if there is one, so startup doesn't wait for it
+  mt.start(CALIBRATION_FILE);
 }
 
 void finalize()
 {
+  mt.save_calibration(CALIBRATION_FILE);
   mt.stop();
+  publisher.stop();
   if (two_imus)
     delete imu2;
+  printf("IMU reads failed: %lu, skipped: %lu\n", publisher.get_error_count(),
+      publisher.get_missed_count());
+  printf("%s", Instrumentation::report().c_str());
 }
 
 void screen_output()
@@ -166,61 +203,34 @@ void file_output()
 {
   std::string filename;
   if (two_imus)
-    filename = "motion_tracker-double_IMU-data.csv";
+    filename = "motion_tracker-double_IMU.rec";
   else
-    filename = "motion_tracker-single_IMU-data.csv";
-  std::ofstream file(filename);
+    filename = "motion_tracker-single_IMU.rec";
 
-  Vector3D<double> v;
-  Quaternion q;
-  int n = 0;
   std::chrono::seconds test_duration(120); //specifies for how long samples will be taken
-  std::chrono::milliseconds sampling_period(10); //timeout between taking two samples
   std::chrono::time_point<std::chrono::steady_clock> t0, t;
 
   printf("Calibrating...\n");
   t0 = std::chrono::steady_clock::now();
-  setup();
+  setup(filename);
   t = std::chrono::steady_clock::now();
   printf("took %fs\n\n",
       (double) std::chrono::duration_cast<std::chrono::microseconds>(t - t0)
           .count()
       / 1.0e+6);
-
-  printf("Collecting data for about %lld seconds\n", test_duration.count());
-  t = t0 = std::chrono::steady_clock::now();
-  while (t - t0 < test_duration)
+  if (!recorder.is_running())
   {
-    ++n;
-    file << n << ",";
-    t = std::chrono::steady_clock::now();
-    file <<
-        std::chrono::duration_cast<std::chrono::microseconds>(t - t0).count()
-        << ",";
-    v = mt.get_angular_velocity();
-    file << v.x << "," << v.y << "," << v.z << ",";
-    q = mt.get_rotor();
-    file << q.scal << ","
-         << q.vect.x << ","
-         << q.vect.y << ","
-         << q.vect.z << ",";
-    v = mt.get_acceleration();
-    file << v.x << "," << v.y << "," << v.z << ",";
-    v = mt.get_velocity();
-    file << v.x << "," << v.y << "," << v.z << ",";
-    v = mt.get_displacement();
-    file << v.x << "," << v.y << "," << v.z << std::endl;
-
-    std::this_thread::sleep_for(sampling_period);
+    printf("Could not open %s\n", filename.c_str());
+    return;
   }
-  printf("Stored %d samples to the file %s\n", n, filename.c_str());
-  std::chrono::milliseconds time =
-      std::chrono::duration_cast<std::chrono::milliseconds>(t - t0);
-  printf("Desired time: %llds\n", test_duration.count());
-  printf("Actual time:  %fs\n", (double) time.count() / 1000.0);
-  printf("Desired sampling period: %lldms\n", sampling_period.count());
-  printf("Actual sampling period:  %fms\n\n", (double) time.count() / n);
-
-  file.close();
-}
 
+  // Every sensor reading and navigation update is recorded by the tracking thread itself
+  printf("Recording for about %ld seconds\n", (long) test_duration.count());
+  std::this_thread::sleep_for(test_duration);
+  mt.stop();
+  recorder.stop();
+  printf("Stored %lu records to the file %s (%lu dropped)\n", recorder.get_written(),
+      filename.c_str(), recorder.get_dropped());
+  printf("Missed sensor readings: %lu\n", mt.get_missed_readings());
+  printf("Convert with: ./convert-flight_record %s\n\n", filename.c_str());
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+}
+
+#include "serial_session.hpp"
+
+// Run with argument `fake` to test against a fake Arduino on a pseudo-terminal instead of a
+// real one on /dev/ttyACM*
+
+std::atomic_bool fake_stop {false};
+
+// Answers every poll byte with a frame, like the battery monitoring sketch does. Every 10th reply
+// is split into two writes and every 25th is corrupted to exercise the framer.
+void fake_arduino(int master_fd)
+{
+  int i = 0;
+  while (!fake_stop)
+  {
+    struct pollfd pfd = {master_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 50) <= 0)
+      continue;
+    char c;
+    if (read(master_fd, &c, 1) != 1 || c != ARDUINO_POLL_BYTE)
+      continue;
+
+    char frame[ARDUINO_MAX_FRAME_LEN];
+    int len = snprintf(frame, sizeof(frame),
+        "%d.50 3.71 3.72 3.73 3.74 3.75 3.76 3.77 26.18 31.00 12.10 29.50 %d.00 %d.00\r\n",
+        i % 100, 150 + i % 10, 50 + i % 10);
+    if (i % 25 == 24)
+      frame[3] = 'x';
+    if (i % 10 == 9)
+    {
+      write(master_fd, frame, len / 2);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      write(master_fd, frame + len / 2, len - len / 2);
+    }
+    else
+    {
+      write(master_fd, frame, len);
+    }
+    ++i;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  std::string device;
+  int master_fd = -1;
+  std::thread arduino;
+  if (argc > 1 && strcmp(argv[1], "fake") == 0)
+  {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0)
+    {
+      printf("Unable to create pseudo-terminal\n");
+      return 1;
+    }
+    struct termios options;
+    tcgetattr(master_fd, &options);
+    cfmakeraw(&options);
+    tcsetattr(master_fd, TCSANOW, &options);
+    device = ptsname(master_fd);
+    printf("Fake Arduino on %s\n", device.c_str());
+    arduino = std::thread(fake_arduino, master_fd);
+  }
+
+  SerialSession session(device);
+  session.start();
+
+  unsigned int last_count = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < 20; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ArduinoData d = session.get_data();
+    if (d.frame_count == last_count)
+    {
+      printf("%s, no new frame\n", session.is_connected() ? "Connected" : "Disconnected");
+      continue;
+    }
+    last_count = d.frame_count;
+    printf("#%u current %6.2fA  cells %4.2f..%4.2fV  big %5.2fV %4.1fC  small %5.2fV %4.1fC"
+        "  pump %6.1f  acc %6.1f\n", d.frame_count, d.current, d.cell_voltage[0],
+        d.cell_voltage[6], d.big_battery_voltage, d.big_battery_temp, d.small_battery_voltage,
+        d.small_battery_temp, d.pump_pressure, d.accumulator_pressure);
+  }
+  double t = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - t0).count() / 1.0e+6;
+  printf("%u frames in %fs (%f frames/s)\n", last_count, t, last_count / t);
+
+  session.stop();
+  if (master_fd >= 0)
+  {
+    fake_stop = true;
+    arduino.join();
+    close(master_fd);
+  }
+  return last_count > 0 ? 0 : 1;
+}
@@ -1,13 +1,12 @@
 #include "vl6180.hpp"
 
-#include <chrono>
 #include <cstdio>
 #include <fstream>
 #include <ncurses.h>
 #include <string>
-#include <thread>
 #include <vector>
 
+#include "clock.hpp"
 #include "gpio.hpp"
 #include "i2c.hpp"
 
@@ -26,13 +25,6 @@ I2C i2c;
 // Create factory to produce sensor drivers for that bus
 Vl6180Factory& factory = Vl6180Factory::instance(&i2c);
 
-inline double timestamp()
-{
-  using namespace std::chrono;
-  return duration_cast<nanoseconds>(
-      steady_clock::now().time_since_epoch()).count() / 1.0e+9;
-}
-
 void setup()
 {
   // Produce driver instance for the sensor with GPIO0 connected to specified pin
@@ -49,7 +41,7 @@ void setup()
 
   for (unsigned int i = 0; i < sensors.size(); ++i)
   {
-    //std::this_thread::sleep_for(std::chrono::seconds(3));
+    //Clock::get().sleep_for(3.0);
     sensors[i]->turn_on();
     sensors[i]->calibrate(30, 100);
     sensors[i]->set_intermeasurement_period(10);
@@ -61,9 +53,9 @@ void file_output()
 {
   // Initialize sensors
   printf("Initializing...\n");
-  double t, t0 = timestamp();
+  double t, t0 = Clock::get().now();
   setup();
-  t = timestamp();
+  t = Clock::get().now();
   printf("took %fs\n\n", t - t0);
 
   // Setup datastructures
@@ -80,16 +72,16 @@ void file_output()
   // Take readings
   printf("Taking %d readings from each of the %d sensors...\n",
       n, sensors.size());
-  t0 = timestamp();
+  t0 = Clock::get().now();
   for (int i = 0; i < n; ++i)
   {
     for (unsigned int j = 0; j < sensors.size(); ++j)
     {
-      times[j].push_back(timestamp());
+      times[j].push_back(Clock::get().now());
       data[j].push_back(sensors[j]->get_distance());
     }
   }
-  t = timestamp();
+  t = Clock::get().now();
   printf("time = %fs\n", t - t0);
   printf("average period = %fms\n", (t - t0) / (n * sensors.size()) * 1000.0);
   printf("average frequency = %fHz\n\n",
@@ -97,7 +89,7 @@ void file_output()
 
   // Store readings
   printf("Saving to file %s...\n", filename.c_str());
-  t0 = timestamp();
+  t0 = Clock::get().now();
   std::ofstream file(filename);
   file.precision(16);
   for (int i = 0; i < n; ++i)
@@ -108,7 +100,7 @@ void file_output()
     file << std::endl;
   }
   file.close();
-  t = timestamp();
+  t = Clock::get().now();
   printf("took %fs\n", t - t0);
 }
 
@@ -124,9 +116,9 @@ void screen_output()
     int sum = 0;
     for (unsigned int i = 0; i < sensors.size(); ++i)
     {
-      double t0 = timestamp();
+      double t0 = Clock::get().now();
       int dist = sensors[i]->get_distance();
-      double t = timestamp();
+      double t = Clock::get().now();
       sum += dist;
       mvprintw(5 + 3*i, 0, "#%d Distance: %3dmm", i + 1, dist);
       mvprintw(6 + 3*i, 0, "#%d Measurement period: %7.3fms   ",
@@ -182,14 +174,14 @@ int main()
   /*I2C i2c;
   Vl6180Factory& factory = Vl6180Factory::instance(&i2c);
   Vl6180& sensor = factory.make_sensor(PIN18);
-  std::this_thread::sleep_for(std::chrono::seconds(3));
+  Clock::get().sleep_for(3.0);
   sensor.turn_on();
   //sensor.set_continuous_mode(true);
   while(true)
   {
-    double t, t0 = timestamp();
+    double t, t0 = Clock::get().now();
     int d = sensor.get_distance();
-    t = timestamp();
+    t = Clock::get().now();
     printf("Distance: %3dmm  Time: %fms\n", d, (t - t0) * 1000.0);
 
   }//*/
@@ -0,0 +1,62 @@
+/*
+ * Stand-in for i2c.cpp, for running drivers on machines without the bus (link this instead of
+ * i2c.o). Every device address has a file of 256 registers: writes set registers from
+ * `buf[0]` on, reads return registers from the last address written (auto-incrementing, as
+ * MPU6050 and VL6180 do). Registers start with a fixed pattern, so readings are repeatable.
+ */
+
+#include "i2c.hpp"
+
+#include <cstring>
+
+#define NUM_DEVICES 128
+#define NUM_REGISTERS 256
+
+static uint8_t registers[NUM_DEVICES][NUM_REGISTERS];
+static uint8_t pointers[NUM_DEVICES];
+
+void I2C::open_bus()
+{
+  for (int d = 0; d < NUM_DEVICES; ++d)
+    for (int r = 0; r < NUM_REGISTERS; ++r)
+      registers[d][r] = (uint8_t) (r * 37 + d);
+  bus = -1;
+}
+
+void I2C::close_bus()
+{}
+
+void I2C::write(uint16_t device, short length, char *buf) const
+{
+  if (device >= NUM_DEVICES || length < 1)
+    throw I2CException("I2C write failed");
+  uint8_t& p = pointers[device];
+  p = (uint8_t) buf[0];
+  for (int i = 1; i < length; ++i)
+    registers[device][p++] = (uint8_t) buf[i];
+}
+
+void I2C::write_read(uint16_t device, short send_len, char *send_buf,
+                                short recv_len, char *recv_buf) const
+{
+  this->write(device, send_len, send_buf);
+  this->read(device, recv_len, recv_buf);
+}
+
+void I2C::read(uint16_t device, short length, char *buf) const
+{
+  if (device >= NUM_DEVICES)
+    throw I2CException("I2C read failed");
+  uint8_t& p = pointers[device];
+  for (int i = 0; i < length; ++i)
+    buf[i] = (char) registers[device][p++];
+}
+
+
+I2CException::I2CException(std::string msg) : message(msg)
+{}
+
+const char* I2CException::what() const noexcept
+{
+  return this->message.c_str();
+}
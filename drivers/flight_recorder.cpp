@@ -0,0 +1,383 @@
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sstream>
+#include <unistd.h>
+
+#include "clock.hpp"
+
+#define STREAM_MASK (RECORDER_STREAM_SIZE - 1)
+#define BLOCK_ALIGNMENT 4096 // for O_DIRECT
+
+RecorderStream::RecorderStream(const FlightRecorder& recorder)
+    : recorder(recorder), head(0), tail(0), dropped(0)
+{}
+
+bool RecorderStream::record(int channel, double timestamp, const double* values)
+{
+  unsigned int n = this->recorder.get_num_fields(channel);
+  if (n == 0)
+    return false;
+  unsigned int size = sizeof(RecordHeader) + n * sizeof(double);
+  uint64_t h = this->head.load(std::memory_order_relaxed);
+  if (h + size - this->tail.load(std::memory_order_acquire) > RECORDER_STREAM_SIZE)
+  {
+    this->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  RecordHeader header;
+  header.channel = channel;
+  header.num_values = n;
+  header.reserved = 0;
+  header.timestamp = timestamp;
+  this->copy_in(h, &header, sizeof(header));
+  this->copy_in(h + sizeof(header), values, n * sizeof(double));
+  this->head.store(h + size, std::memory_order_release);
+  return true;
+}
+
+bool RecorderStream::record(int channel, double timestamp, Vector3D<double> v)
+{
+  double values[3] = {v.x, v.y, v.z};
+  if (this->recorder.get_num_fields(channel) != 3)
+    return false;
+  return this->record(channel, timestamp, values);
+}
+
+unsigned long RecorderStream::get_dropped() const
+{
+  return this->dropped.load(std::memory_order_relaxed);
+}
+
+void RecorderStream::copy_in(uint64_t pos, const void* src, unsigned int size)
+{
+  unsigned int offset = pos & STREAM_MASK;
+  unsigned int first = std::min(size, (unsigned int) RECORDER_STREAM_SIZE - offset);
+  std::memcpy(this->buffer + offset, src, first);
+  std::memcpy(this->buffer, (const uint8_t*) src + first, size - first);
+}
+
+void RecorderStream::copy_out(uint64_t pos, void* dst, unsigned int size) const
+{
+  unsigned int offset = pos & STREAM_MASK;
+  unsigned int first = std::min(size, (unsigned int) RECORDER_STREAM_SIZE - offset);
+  std::memcpy(dst, this->buffer + offset, first);
+  std::memcpy((uint8_t*) dst + first, this->buffer, size - first);
+}
+
+
+FlightRecorder::FlightRecorder()
+    : num_channels(0), fd(-1), direct(false), block(nullptr), used(0), sequence(0),
+    stop_flag(true), written(0)
+{
+  if (posix_memalign((void**) &this->block, BLOCK_ALIGNMENT, RECORDER_BLOCK_SIZE) != 0)
+    throw std::bad_alloc();
+}
+
+FlightRecorder::~FlightRecorder()
+{
+  this->stop();
+  for (RecorderStream* s : this->streams)
+    delete s;
+  free(this->block);
+}
+
+int FlightRecorder::add_channel(const std::string& name, const std::vector<std::string>& fields)
+{
+  if (this->is_running() || this->num_channels >= RECORDER_MAX_CHANNELS || fields.empty()
+      || fields.size() > RECORDER_MAX_FIELDS)
+    return -1;
+  if (name.empty() || name.find_first_of(" \t\n") != std::string::npos)
+    return -1;
+  for (const std::string& f : fields)
+    if (f.empty() || f.find_first_of(" \t\n") != std::string::npos)
+      return -1;
+  for (const RecordChannel& c : this->channels)
+    if (c.name == name)
+      return -1;
+  this->channels.push_back(RecordChannel {name, fields});
+  this->num_fields[this->num_channels] = fields.size();
+  return this->num_channels++;
+}
+
+RecorderStream* FlightRecorder::add_stream()
+{
+  if (this->is_running() || this->streams.size() >= RECORDER_MAX_STREAMS)
+    return nullptr;
+  this->streams.push_back(new RecorderStream(*this));
+  return this->streams.back();
+}
+
+bool FlightRecorder::start(const std::string& filename)
+{
+  if (this->is_running())
+    return false;
+
+  std::stringstream header;
+  header << "HYPED-FLIGHT-RECORD " << RECORDER_FORMAT_VERSION << "\n"
+         << "block_size " << RECORDER_BLOCK_SIZE << "\n";
+  for (int i = 0; i < this->num_channels; ++i)
+  {
+    header << "channel " << i << " " << this->channels[i].name;
+    for (const std::string& f : this->channels[i].fields)
+      header << " " << f;
+    header << "\n";
+  }
+  header << "end\n";
+  std::string text = header.str();
+  if (text.size() > RECORDER_BLOCK_SIZE)
+    return false;
+
+  this->fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  this->direct = this->fd >= 0;
+  if (this->fd < 0 && errno == EINVAL) // file system without O_DIRECT (e.g. tmpfs)
+    this->fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (this->fd < 0)
+    return false;
+
+  std::memset(this->block, 0, RECORDER_BLOCK_SIZE);
+  std::memcpy(this->block, text.data(), text.size());
+  this->used = sizeof(RecordBlockHeader);
+  this->sequence = 0;
+  if (!this->write_out())
+  {
+    close(this->fd);
+    this->fd = -1;
+    return false;
+  }
+  this->stop_flag = false;
+  this->writer = std::thread(&FlightRecorder::write_loop, this);
+  return true;
+}
+
+void FlightRecorder::stop()
+{
+  if (this->stop_flag)
+    return;
+  this->stop_flag = true;
+  this->writer.join();
+  close(this->fd);
+  this->fd = -1;
+}
+
+bool FlightRecorder::is_running() const
+{
+  return !this->stop_flag;
+}
+
+unsigned int FlightRecorder::get_num_fields(int channel) const
+{
+  if (channel < 0 || channel >= this->num_channels)
+    return 0;
+  return this->num_fields[channel];
+}
+
+unsigned long FlightRecorder::get_dropped() const
+{
+  unsigned long n = 0;
+  for (RecorderStream* s : this->streams)
+    n += s->get_dropped();
+  return n;
+}
+
+unsigned long FlightRecorder::get_written() const
+{
+  return this->written.load(std::memory_order_relaxed);
+}
+
+void FlightRecorder::write_loop()
+{
+  // Paced by disk writes, so always in real time
+  RealClock& clock = RealClock::instance();
+  double last_sync = clock.now();
+  while (true)
+  {
+    bool moved = false;
+    for (RecorderStream* s : this->streams)
+      moved |= this->drain(*s);
+    bool stopping = this->stop_flag;
+    if (stopping || clock.now() - last_sync >= RECORDER_FSYNC_PERIOD)
+    {
+      // Partial blocks are written too, so at most a sync period's worth is lost in a crash
+      if (this->used > sizeof(RecordBlockHeader))
+        this->write_block();
+      fdatasync(this->fd);
+      last_sync = clock.now();
+    }
+    if (stopping && !moved)
+      break;
+    if (!moved)
+      clock.sleep_for(RECORDER_POLL_PERIOD);
+  }
+}
+
+bool FlightRecorder::drain(RecorderStream& stream)
+{
+  uint64_t t = stream.tail.load(std::memory_order_relaxed);
+  uint64_t h = stream.head.load(std::memory_order_acquire);
+  if (t == h)
+    return false;
+  while (t < h)
+  {
+    RecordHeader header;
+    stream.copy_out(t, &header, sizeof(header));
+    unsigned int size = sizeof(RecordHeader) + header.num_values * sizeof(double);
+    if (this->used + size > RECORDER_BLOCK_SIZE)
+      this->write_block();
+    stream.copy_out(t, this->block + this->used, size);
+    this->used += size;
+    t += size;
+    this->written.fetch_add(1, std::memory_order_relaxed);
+  }
+  stream.tail.store(t, std::memory_order_release);
+  return true;
+}
+
+bool FlightRecorder::write_block()
+{
+  RecordBlockHeader* header = (RecordBlockHeader*) this->block;
+  header->magic = RECORDER_BLOCK_MAGIC;
+  header->used = this->used - sizeof(RecordBlockHeader);
+  header->sequence = this->sequence++;
+  std::memset(this->block + this->used, 0, RECORDER_BLOCK_SIZE - this->used);
+  this->used = sizeof(RecordBlockHeader);
+  return this->write_out();
+}
+
+bool FlightRecorder::write_out()
+{
+  ssize_t n = write(this->fd, this->block, RECORDER_BLOCK_SIZE);
+  if (n < 0 && errno == EINVAL && this->direct)
+  {
+    // Some file systems accept O_DIRECT on open but not on write
+    fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL) & ~O_DIRECT);
+    this->direct = false;
+    n = write(this->fd, this->block, RECORDER_BLOCK_SIZE);
+  }
+  return n == RECORDER_BLOCK_SIZE;
+}
+
+
+FlightRecordReader::FlightRecordReader()
+    : block_size(0), pos(0), end(0), corrupt_blocks(0), bad_records(0)
+{}
+
+bool FlightRecordReader::open(const std::string& filename)
+{
+  this->file.close();
+  this->file.clear();
+  this->file.open(filename, std::ios::binary);
+  this->channels.clear();
+  if (!this->file || !this->read_header())
+    return false;
+  this->block.resize(this->block_size);
+  this->rewind();
+  return true;
+}
+
+const std::vector<RecordChannel>& FlightRecordReader::get_channels() const
+{
+  return this->channels;
+}
+
+bool FlightRecordReader::next(RecordHeader& header, const double*& values)
+{
+  while (true)
+  {
+    if (this->pos + sizeof(RecordHeader) > this->end)
+    {
+      if (!this->read_block())
+        return false;
+      continue;
+    }
+    std::memcpy(&header, this->block.data() + this->pos, sizeof(header));
+    unsigned int size = sizeof(header) + header.num_values * sizeof(double);
+    if (this->pos + size > this->end)
+    {
+      ++this->bad_records;
+      this->pos = this->end; // can't find the next record in this block
+      continue;
+    }
+    const char* data = this->block.data() + this->pos + sizeof(header);
+    this->pos += size;
+    if (header.channel >= this->channels.size()
+        || header.num_values != this->channels[header.channel].fields.size())
+    {
+      ++this->bad_records;
+      continue;
+    }
+    this->values.resize(header.num_values);
+    std::memcpy(this->values.data(), data, header.num_values * sizeof(double));
+    values = this->values.data();
+    return true;
+  }
+}
+
+void FlightRecordReader::rewind()
+{
+  this->file.clear();
+  this->file.seekg(this->block_size);
+  this->pos = this->end = 0;
+  this->corrupt_blocks = this->bad_records = 0;
+}
+
+unsigned long FlightRecordReader::get_corrupt_blocks() const
+{
+  return this->corrupt_blocks;
+}
+
+unsigned long FlightRecordReader::get_bad_records() const
+{
+  return this->bad_records;
+}
+
+bool FlightRecordReader::read_header()
+{
+  std::string line, word;
+  int version;
+  if (!std::getline(this->file, line)
+      || sscanf(line.c_str(), "HYPED-FLIGHT-RECORD %d", &version) != 1
+      || version != RECORDER_FORMAT_VERSION)
+    return false;
+  if (!std::getline(this->file, line)
+      || sscanf(line.c_str(), "block_size %u", &this->block_size) != 1
+      || this->block_size <= sizeof(RecordBlockHeader))
+    return false;
+  while (std::getline(this->file, line) && line != "end")
+  {
+    std::stringstream ss(line);
+    unsigned int id;
+    RecordChannel channel;
+    if (!(ss >> word >> id >> channel.name) || word != "channel" || id != this->channels.size())
+      return false;
+    while (ss >> word)
+      channel.fields.push_back(word);
+    this->channels.push_back(channel);
+  }
+  return line == "end";
+}
+
+bool FlightRecordReader::read_block()
+{
+  while (this->file.read(this->block.data(), this->block_size))
+  {
+    RecordBlockHeader header;
+    std::memcpy(&header, this->block.data(), sizeof(header));
+    if (header.magic != RECORDER_BLOCK_MAGIC
+        || header.used > this->block_size - sizeof(RecordBlockHeader))
+    {
+      ++this->corrupt_blocks;
+      continue;
+    }
+    this->pos = sizeof(header);
+    this->end = sizeof(header) + header.used;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,173 @@
+#ifndef HYPED_DRIVERS_FLIGHT_RECORDER_HPP_
+#define HYPED_DRIVERS_FLIGHT_RECORDER_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vector3d.hpp"
+
+#define RECORDER_MAX_CHANNELS 64
+#define RECORDER_MAX_FIELDS 32
+#define RECORDER_MAX_STREAMS 16
+#define RECORDER_STREAM_SIZE (256 * 1024) // bytes buffered per stream, must be a power of 2
+#define RECORDER_BLOCK_SIZE (64 * 1024)   // bytes per write, a multiple of the page size
+#define RECORDER_FSYNC_PERIOD 1.0         // s
+#define RECORDER_POLL_PERIOD 0.005        // s, how often the writer looks for new records
+
+/*
+ * File format (all integers and doubles in the host's byte order, i.e. little-endian on the Pi)
+ *  - Header: text, padded with '\0' to RECORDER_BLOCK_SIZE
+ *      HYPED-FLIGHT-RECORD <version>
+ *      block_size <RECORDER_BLOCK_SIZE>
+ *      channel <id> <name> <field>...      (one line per channel)
+ *      end
+ *  - Data blocks of RECORDER_BLOCK_SIZE bytes: a RecordBlockHeader followed by records, the rest
+ *    of the block is zeros. A record is a RecordHeader followed by the channel's values (doubles).
+ *    Records never span blocks.
+ */
+#define RECORDER_FORMAT_VERSION 1
+#define RECORDER_BLOCK_MAGIC 0x4B4C4252 // "RBLK"
+
+struct RecordBlockHeader
+{
+  uint32_t magic;
+  uint32_t used;     // bytes of records after this header
+  uint64_t sequence; // block number, from 0
+};
+
+struct RecordHeader
+{
+  uint16_t channel;
+  uint16_t num_values;
+  uint32_t reserved;
+  double timestamp;
+};
+
+struct RecordChannel
+{
+  std::string name;
+  std::vector<std::string> fields;
+};
+
+class FlightRecorder;
+
+/// Buffer for the records of one thread (single producer, the recorder's writer thread being the
+/// single consumer). Recording copies into memory and never blocks or makes a system call; if
+/// the buffer is full the record is dropped and counted.
+class RecorderStream
+{
+  public:
+    /// `values` must hold as many values as the channel has fields
+    bool record(int channel, double timestamp, const double* values);
+    bool record(int channel, double timestamp, Vector3D<double> v);
+    unsigned long get_dropped() const;
+
+  private:
+    friend class FlightRecorder;
+    RecorderStream(const FlightRecorder& recorder);
+
+    void copy_in(uint64_t pos, const void* src, unsigned int size);
+    void copy_out(uint64_t pos, void* dst, unsigned int size) const;
+
+    const FlightRecorder& recorder;
+    // Byte positions since the start; padded so producer and writer don't share a cache line
+    std::atomic<uint64_t> head; // written by the producer
+    char padding1[64];
+    std::atomic<uint64_t> tail; // written by the writer thread
+    char padding2[64];
+    std::atomic<unsigned long> dropped;
+    uint8_t buffer[RECORDER_STREAM_SIZE];
+};
+
+/// Records samples from any number of threads (each with its own RecorderStream) to a file in
+/// the background. Memory use is fixed: one buffer per stream plus one block for the writer.
+/// A writer thread drains the streams into aligned blocks, writes them whole (with O_DIRECT where
+/// the file system supports it) and syncs the file every RECORDER_FSYNC_PERIOD.
+/// Channels and streams have to be added before start(). Use convert-flight_record to get CSVs.
+class FlightRecorder
+{
+  public:
+    FlightRecorder();
+    ~FlightRecorder();
+
+    FlightRecorder(FlightRecorder const&) = delete;
+    void operator=(FlightRecorder const&) = delete;
+
+    /// Returns the channel's id, or -1 if there are too many channels or fields, the name is
+    /// taken or contains whitespace, or the recorder was started
+    int add_channel(const std::string& name, const std::vector<std::string>& fields);
+    /// Returns nullptr if there are already RECORDER_MAX_STREAMS streams or the recorder was
+    /// started. The stream belongs to the recorder
+    RecorderStream* add_stream();
+    /// Opens the file, writes the header and starts the writer thread; returns false if the file
+    /// can't be written
+    bool start(const std::string& filename);
+    /// Writes out everything recorded so far and closes the file
+    void stop();
+    bool is_running() const;
+    unsigned int get_num_fields(int channel) const;
+    /// Records dropped by all streams because their buffer was full
+    unsigned long get_dropped() const;
+    /// Records taken from the streams so far; they reach the disk within RECORDER_FSYNC_PERIOD
+    unsigned long get_written() const;
+
+  private:
+    void write_loop();
+    /// Moves complete records from `stream` to the block; returns false if nothing was moved
+    bool drain(RecorderStream& stream);
+    bool write_block();
+    /// Writes the whole block buffer to the file
+    bool write_out();
+
+    std::vector<RecordChannel> channels;
+    int num_channels;
+    unsigned int num_fields[RECORDER_MAX_CHANNELS];
+    std::vector<RecorderStream*> streams;
+    int fd;
+    bool direct; // O_DIRECT
+    uint8_t* block;    // aligned for O_DIRECT
+    unsigned int used; // bytes in the block, header included
+    uint64_t sequence;
+    std::atomic_bool stop_flag;
+    std::atomic<unsigned long> written;
+    std::thread writer;
+};
+
+/// Reads a file written by FlightRecorder back one record at a time. Corrupt blocks and records
+/// that don't match their channel are skipped and counted; a truncated last block is ignored.
+class FlightRecordReader
+{
+  public:
+    FlightRecordReader();
+
+    /// Returns false if the file can't be read or isn't a flight record of this version
+    bool open(const std::string& filename);
+    const std::vector<RecordChannel>& get_channels() const;
+    /// Returns false at the end of the file. `values` (as many as the channel has fields) is only
+    /// valid until the next call
+    bool next(RecordHeader& header, const double*& values);
+    /// Starts again from the first record
+    void rewind();
+    unsigned long get_corrupt_blocks() const;
+    unsigned long get_bad_records() const;
+
+  private:
+    bool read_header();
+    bool read_block();
+
+    std::ifstream file;
+    std::vector<RecordChannel> channels;
+    unsigned int block_size;
+    std::vector<char> block;
+    unsigned int pos; // in the block
+    unsigned int end;
+    std::vector<double> values;
+    unsigned long corrupt_blocks;
+    unsigned long bad_records;
+};
+
+#endif // HYPED_DRIVERS_FLIGHT_RECORDER_HPP_
@@ -1,34 +1,105 @@
 #include "gpio.hpp"
 
+#include <stdexcept>
+#include <thread>
+
 Gpio Gpio::instance;
 
 GpioPin& Gpio::get_pin(GpioPinNumber pin, PinMode mode, PudControl pud)
 {
-  // Check if already in use
-  if (instance.active_pins.count(pin) > 0)
-    return *instance.active_pins[pin];
+  if (pin < 0 || pin >= NUM_GPIO_PINS)
+    throw std::out_of_range("GPIO pin number out of range");
+  PinSlot& slot = instance.slots[pin];
+
+  // Fast path: pin already constructed
+  if (slot.state.load(std::memory_order_acquire) != slot_ready)
+  {
+    // First thread to claim the slot constructs the pin, others wait for it to be ready
+    int expected = slot_free;
+    if (slot.state.compare_exchange_strong(expected, slot_constructing,
+        std::memory_order_acq_rel))
+    {
+      new (&slot.storage) GpioPin(pin, mode, pud);
+      slot.users.fetch_add(1, std::memory_order_relaxed);
+      slot.state.store(slot_ready, std::memory_order_release);
+      return pin_at(slot);
+    }
+  }
+
+  GpioPin& result = pin_at(slot);
+  while (true)
+  {
+    while (slot.state.load(std::memory_order_acquire) != slot_ready)
+      std::this_thread::yield();
+    // Pins in use are shared as they are. Users only go from 0 to 1 in slot_reconfiguring, so
+    // this fails (and is tried again) if the last user released the pin meanwhile
+    int users = slot.users.load(std::memory_order_acquire);
+    if (users > 0)
+    {
+      if (slot.users.compare_exchange_weak(users, users + 1, std::memory_order_acq_rel))
+        return result;
+      continue;
+    }
+    // Pin was released by all its previous users so the new owner gets its own configuration,
+    // before anyone else can use it
+    int expected = slot_ready;
+    if (slot.state.compare_exchange_strong(expected, slot_reconfiguring,
+        std::memory_order_acq_rel))
+    {
+      // Someone else may have taken and set it up since users was read
+      if (slot.users.load(std::memory_order_acquire) > 0)
+      {
+        slot.state.store(slot_ready, std::memory_order_release);
+        continue;
+      }
+      result.set_mode(mode);
+      result.set_pud(pud);
+      slot.users.store(1, std::memory_order_relaxed);
+      slot.state.store(slot_ready, std::memory_order_release);
+      return result;
+    }
+  }
+}
 
-  // Requested pin number not used so allocate the pin
-  instance.active_pins[pin] = new GpioPin(pin, mode, pud);
-  return *instance.active_pins[pin];
+void Gpio::release_pin(GpioPin& pin)
+{
+  PinSlot& slot = instance.slots[pin.pin_num];
+  int users = slot.users.load(std::memory_order_relaxed);
+  while (users > 0 && !slot.users.compare_exchange_weak(users, users - 1,
+      std::memory_order_acq_rel))
+    ;
 }
 
 bool Gpio::is_pin_in_use(GpioPinNumber pin)
 {
-  return (instance.active_pins.count(pin) > 0);
+  if (pin < 0 || pin >= NUM_GPIO_PINS)
+    return false;
+  const PinSlot& slot = instance.slots[pin];
+  return slot.state.load(std::memory_order_acquire) == slot_ready
+      && slot.users.load(std::memory_order_acquire) > 0;
+}
+
+GpioPin& Gpio::pin_at(PinSlot& slot)
+{
+  return *reinterpret_cast<GpioPin*>(&slot.storage);
 }
 
 Gpio::Gpio()
 {
+  // Slots are not initialised here: static storage is zeroed (all slots free) before any
+  // constructor runs, so pins claimed during other static initialisation aren't lost
   wiringPiSetup();
 }
 
 Gpio::~Gpio()
 {
-  // Clear active pins
-  for (auto it = this->active_pins.begin(); it != this->active_pins.end(); ++it)
-    delete (it->second);
-  this->active_pins.clear();
+  // Destroy constructed pins
+  for (int i = 0; i < NUM_GPIO_PINS; ++i)
+    if (this->slots[i].state.load() == slot_ready)
+    {
+      pin_at(this->slots[i]).~GpioPin();
+      this->slots[i].state.store(slot_free);
+    }
 }
 
 
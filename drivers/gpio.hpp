@@ -1,7 +1,8 @@
 #ifndef HYPED_DRIVERS_GPIO_HPP_
 #define HYPED_DRIVERS_GPIO_HPP_
 
-#include <map>
+#include <atomic>
+#include <type_traits>
 #include <wiringPi.h>
 
 #define PIN4 7
@@ -24,6 +25,9 @@
 #define PIN_TXD 15
 #define PIN_RXD 16
 
+// Number of wiringPi pins the registry can hold (valid pin numbers are 0 to NUM_GPIO_PINS - 1)
+#define NUM_GPIO_PINS 32
+
 typedef int GpioPinNumber;
 
 // Input/output setting (possible to add PWM and clock modes)
@@ -41,25 +45,7 @@ enum class PudControl
   up = PUD_UP
 };
 
-class GpioPin; // Declaring here since used by Gpio
-
-class Gpio
-{
-  public:
-    /// Allocates, configures and returns a reference to the `pin`
-    /// If this pin is already in use, a reference to it is return but the pin's configuration is
-    /// left unchanged (possibly different from what was requested)
-    static GpioPin& get_pin(GpioPinNumber pin, PinMode mode, PudControl pud);
-    /// Checks if the `pin` is currently in use
-    static bool is_pin_in_use(GpioPinNumber pin);
-
-  private:
-    Gpio();
-    ~Gpio();
-
-    static Gpio instance;
-    std::map<GpioPinNumber, GpioPin*> active_pins;
-};
+class Gpio; // Declaring here since it is GpioPin's friend
 
 class GpioPin
 {
@@ -88,5 +74,41 @@ class GpioPin
     PudControl pud;
 };
 
+class Gpio
+{
+  public:
+    /// Allocates, configures and returns a reference to the `pin`
+    /// If this pin is already in use, a reference to it is returned but the pin's configuration is
+    /// left unchanged (possibly different from what was requested)
+    /// Safe to call from several threads at once; after the first call for a pin it only waits
+    /// while the pin is being (re)configured for a new user. Throws std::out_of_range if `pin` is not below NUM_GPIO_PINS
+    static GpioPin& get_pin(GpioPinNumber pin, PinMode mode, PudControl pud);
+    /// Gives up one reference obtained through get_pin. The pin object stays valid, but the next
+    /// get_pin on an unused pin applies the requested configuration again
+    static void release_pin(GpioPin& pin);
+    /// Checks if the `pin` is currently in use
+    static bool is_pin_in_use(GpioPinNumber pin);
+
+  private:
+    Gpio();
+    ~Gpio();
+
+    // slot_reconfiguring: a released pin is being set up for its next user, who is the only
+    // one to get it until it's back to slot_ready
+    enum SlotState { slot_free, slot_constructing, slot_ready, slot_reconfiguring };
+
+    struct PinSlot
+    {
+      std::atomic<int> state;
+      std::atomic<int> users;
+      std::aligned_storage<sizeof(GpioPin), alignof(GpioPin)>::type storage;
+    };
+
+    static GpioPin& pin_at(PinSlot& slot);
+
+    static Gpio instance;
+    PinSlot slots[NUM_GPIO_PINS];
+};
+
 #endif // HYPED_DRIVERS_GPIO_HPP_
 
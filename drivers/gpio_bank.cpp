@@ -0,0 +1,137 @@
+#include "gpio_bank.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+#define GPIOMEM_PATH "/dev/gpiomem"
+#define GPIOMEM_SIZE 4096
+#define NUM_WPI_PINS 32
+
+// Word offsets of the BCM2835 GPIO registers
+#define GPSET0 7
+#define GPCLR0 10
+#define GPLEV0 13
+
+
+GpioBank& GpioBank::instance()
+{
+  wiringPiSetup(); // pin number translation needs it; does nothing if already done
+  static MmapGpioBank mmap_bank;
+  static WiringPiGpioBank wpi_bank;
+  if (mmap_bank.is_mapped())
+    return mmap_bank;
+  return wpi_bank;
+}
+
+
+// Memory-mapped bank definitions
+MmapGpioBank::MmapGpioBank() : registers(nullptr)
+{
+  // Precompute the pin number translation so a write costs 4 table lookups per mask
+  for (int byte = 0; byte < 4; ++byte)
+    for (int value = 0; value < 256; ++value)
+    {
+      uint32_t bcm = 0;
+      for (int bit = 0; bit < 8; ++bit)
+      {
+        int gpio = wpiPinToGpio(byte * 8 + bit);
+        if ((value & (1 << bit)) && gpio >= 0 && gpio < 32)
+          bcm |= ((uint32_t) 1) << gpio;
+      }
+      this->bcm_table[byte][value] = bcm;
+    }
+
+  int fd = open(GPIOMEM_PATH, O_RDWR | O_SYNC);
+  if (fd < 0)
+    return;
+  void *map = mmap(NULL, GPIOMEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map != MAP_FAILED)
+    this->registers = (volatile uint32_t *) map;
+}
+
+MmapGpioBank::~MmapGpioBank()
+{
+  if (this->registers != nullptr)
+    munmap((void *) this->registers, GPIOMEM_SIZE);
+}
+
+bool MmapGpioBank::is_mapped()
+{
+  return this->registers != nullptr;
+}
+
+void MmapGpioBank::write(GpioMask high, GpioMask low)
+{
+  if (low)
+    this->registers[GPCLR0] = this->to_bcm(low);
+  if (high)
+    this->registers[GPSET0] = this->to_bcm(high);
+}
+
+GpioMask MmapGpioBank::read()
+{
+  return this->from_bcm(this->registers[GPLEV0]);
+}
+
+uint32_t MmapGpioBank::to_bcm(GpioMask mask)
+{
+  return this->bcm_table[0][mask & 0xFF] | this->bcm_table[1][(mask >> 8) & 0xFF]
+      | this->bcm_table[2][(mask >> 16) & 0xFF] | this->bcm_table[3][mask >> 24];
+}
+
+GpioMask MmapGpioBank::from_bcm(uint32_t mask)
+{
+  GpioMask result = 0;
+  for (int pin = 0; pin < NUM_WPI_PINS; ++pin)
+  {
+    int gpio = wpiPinToGpio(pin);
+    if (gpio >= 0 && gpio < 32 && (mask & (((uint32_t) 1) << gpio)))
+      result |= GPIO_MASK(pin);
+  }
+  return result;
+}
+
+
+// wiringPi bank definitions
+void WiringPiGpioBank::write(GpioMask high, GpioMask low)
+{
+  for (int pin = 0; pin < NUM_WPI_PINS; ++pin)
+    if (low & GPIO_MASK(pin))
+      digitalWrite(pin, LOW);
+  for (int pin = 0; pin < NUM_WPI_PINS; ++pin)
+    if (high & GPIO_MASK(pin))
+      digitalWrite(pin, HIGH);
+}
+
+GpioMask WiringPiGpioBank::read()
+{
+  GpioMask result = 0;
+  for (int pin = 0; pin < NUM_WPI_PINS; ++pin)
+    if (digitalRead(pin) != LOW)
+      result |= GPIO_MASK(pin);
+  return result;
+}
+
+
+// Fake bank definitions
+void FakeGpioBank::write(GpioMask high, GpioMask low)
+{
+  GpioMask old = this->levels.load(std::memory_order_relaxed);
+  while (!this->levels.compare_exchange_weak(old, (old & ~low) | high))
+    ;
+  this->writes.fetch_add(1, std::memory_order_relaxed);
+}
+
+GpioMask FakeGpioBank::read()
+{
+  return this->levels.load();
+}
+
+unsigned int FakeGpioBank::get_write_count()
+{
+  return this->writes.load();
+}
@@ -0,0 +1,76 @@
+#ifndef HYPED_DRIVERS_GPIO_BANK_HPP_
+#define HYPED_DRIVERS_GPIO_BANK_HPP_
+
+#include <atomic>
+#include <cstdint>
+
+#include "gpio.hpp"
+
+// Set of pins, bit n being wiringPi pin n (same numbering as GpioPinNumber)
+typedef uint32_t GpioMask;
+
+#define GPIO_MASK(pin) (((GpioMask) 1) << (pin))
+
+/// Writes many output pins at once. Pins must already be configured as outputs (e.g. through
+/// Gpio::get_pin); the bank only changes their levels.
+class GpioBank
+{
+  public:
+    virtual ~GpioBank() {}
+
+    /// Drives the pins in `low` low and then the pins in `high` high
+    virtual void write(GpioMask high, GpioMask low) = 0;
+    /// Levels of all pins
+    virtual GpioMask read() = 0;
+
+    /// Memory-mapped bank if /dev/gpiomem is available, per-pin wiringPi bank otherwise
+    static GpioBank& instance();
+};
+
+/// Writes the BCM2835 GPSET0/GPCLR0 registers through /dev/gpiomem, so a whole group of pins
+/// switches with a single store per direction
+class MmapGpioBank : public GpioBank
+{
+  public:
+    MmapGpioBank();
+    ~MmapGpioBank();
+
+    MmapGpioBank(MmapGpioBank const&)   = delete;
+    void operator=(MmapGpioBank const&) = delete;
+
+    /// False if /dev/gpiomem could not be mapped (not a Pi, or no permission)
+    bool is_mapped();
+    virtual void write(GpioMask high, GpioMask low);
+    virtual GpioMask read();
+
+  private:
+    uint32_t to_bcm(GpioMask mask);
+    GpioMask from_bcm(uint32_t mask);
+
+    volatile uint32_t *registers;
+    // wiringPi -> BCM pin masks, one table per byte of the mask
+    uint32_t bcm_table[4][256];
+};
+
+/// Fallback for hosts without /dev/gpiomem: one digitalWrite per pin
+class WiringPiGpioBank : public GpioBank
+{
+  public:
+    virtual void write(GpioMask high, GpioMask low);
+    virtual GpioMask read();
+};
+
+/// Test double which only records what was written
+class FakeGpioBank : public GpioBank
+{
+  public:
+    virtual void write(GpioMask high, GpioMask low);
+    virtual GpioMask read();
+    unsigned int get_write_count();
+
+  private:
+    std::atomic<GpioMask> levels {0};
+    std::atomic<unsigned int> writes {0};
+};
+
+#endif // HYPED_DRIVERS_GPIO_BANK_HPP_
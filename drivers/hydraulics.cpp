@@ -1,4 +1,6 @@
 #include "hydraulics.hpp"
+
+#include "clock.hpp"
 // #include "serialData.h"
 
 #define PUMP_SPINUP 400000 // microseconds = 400 miliseconds
@@ -8,8 +10,9 @@
 #define OVER_PRESSURE_ACCUMULATORS 100
 #define OVER_PRESSURE_PUMP 200
 
-Hydraulics::Hydraulics(void)
-    : solenoid_1 { Gpio::get_pin(SOL_1, PinMode::out, PudControl::off) },
+Hydraulics::Hydraulics(GpioBank& bank)
+    : bank(bank),
+    solenoid_1 { Gpio::get_pin(SOL_1, PinMode::out, PudControl::off) },
     solenoid_2 { Gpio::get_pin(SOL_2, PinMode::out, PudControl::off) },
     solenoid_3 { Gpio::get_pin(SOL_3, PinMode::out, PudControl::off) },
     solenoid_4 { Gpio::get_pin(SOL_4, PinMode::out, PudControl::off) },
@@ -19,105 +22,53 @@ Hydraulics::Hydraulics(void)
     pump { Gpio::get_pin(PUMP, PinMode::out, PudControl::off) }
 {}
 
-void Hydraulics::spin_up() {
-    this->pump.write(false);
-    usleep(PUMP_SPINUP);
-    this->solenoid_5.write(false);
-    this->solenoid_7.write(false);
-}
-
-void Hydraulics::hold(const std::string& side) {
-    if (side == "right") {
-        this->solenoid_2.write(false);
-        this->solenoid_1.write(true);
-    } else if (side == "left") {
-        this->solenoid_6.write(false);
-        this->solenoid_4.write(true);
-    }
+void Hydraulics::apply(const ValveStep& step) {
+    this->bank.write(step.high, step.low);
 }
 
-void Hydraulics::retract(const std::string& side) {
-    if (side == "right") {
-        this->solenoid_1.write(false);
-        this->solenoid_2.write(false);
-    } else if (side == "left") {
-        this->solenoid_6.write(false);
-        this->solenoid_4.write(false);
-    } else {
-        this->pump.write(true);
-        this->solenoid_7.write(true);
+void Hydraulics::run(const ValveSequence& sequence) {
+    for (int i = 0; i < sequence.length; ++i) {
+        if (sequence.steps[i].delay > 0)
+            Clock::get().sleep_for(sequence.steps[i].delay / 1.0e+6);
+        this->apply(sequence.steps[i]);
     }
 }
 
-void Hydraulics::extend(const std::string& side) {
-    if (side == "right") {
-        this->solenoid_2.write(true);
-    } else if (side == "left") {
-        this->solenoid_6.write(true);
-    }
+void Hydraulics::spin_up() {
+    this->run(Hydraulics::spin_up_sequence());
 }
 
-void Hydraulics::shut_down() {
-    this->solenoid_1.write(true);
-    this->solenoid_2.write(true);
-    this->solenoid_3.write(true);
-    this->solenoid_4.write(true);
-    this->solenoid_5.write(true);
-    this->solenoid_6.write(true);
-    this->solenoid_7.write(true);
-    this->pump.write(true);
+void Hydraulics::hold(RailSide side) {
+    this->run(Hydraulics::brake_sequence(side, BrakeCommand::hold));
 }
 
-void Hydraulics::stand_by() {
-    this->hold("left");
-    this->hold("right");
-    usleep(50000); // 50 millisecondsi
-    this->solenoid_1.write(false);
-    this->solenoid_2.write(false);
-    this->solenoid_3.write(true);
-    this->solenoid_4.write(false);
-    this->solenoid_5.write(true);
-    this->solenoid_6.write(false);
-    this->solenoid_7.write(true);
-    this->pump.write(true);
+void Hydraulics::retract(RailSide side) {
+    this->run(Hydraulics::brake_sequence(side, BrakeCommand::retract));
 }
 
-void Hydraulics::charge_accumulators() {
-    this->pump.write(false);
+void Hydraulics::extend(RailSide side) {
+    this->run(Hydraulics::brake_sequence(side, BrakeCommand::extend));
+}
+
+void Hydraulics::actuate(RailSide side, BrakeCommand command) {
+    this->run(Hydraulics::brake_sequence(side, command));
+}
 
-    this->solenoid_1.write(true);
-    this->solenoid_2.write(true);
-    this->solenoid_3.write(false);
-    this->solenoid_4.write(true);
-    this->solenoid_5.write(true);
-    this->solenoid_6.write(true);
-    this->solenoid_7.write(false);
+void Hydraulics::shut_down() {
+    this->run(Hydraulics::shut_down_sequence());
+}
 
-    usleep(1500000); // 1500 milliseconds
+void Hydraulics::stand_by() {
+    this->run(Hydraulics::stand_by_sequence());
+}
 
-    this->solenoid_1.write(true);
-    this->solenoid_2.write(true);
-    this->solenoid_3.write(true);
-    this->solenoid_4.write(true);
-    this->solenoid_5.write(true);
-    this->solenoid_6.write(true);
-    this->solenoid_7.write(true);
-    this->pump.write(true);
+void Hydraulics::charge_accumulators() {
+    this->run(Hydraulics::charge_accumulators_sequence());
 }
 
 void Hydraulics::pressure(int pressure)
 {
-    this->pump.write(false);
-
-    delay(PUMP_SPINUP);
-
-    this->solenoid_1.write(true);
-    this->solenoid_2.write(true);
-    this->solenoid_3.write(false);
-    this->solenoid_4.write(true);
-    this->solenoid_5.write(true);
-    this->solenoid_6.write(true);
-    this->solenoid_7.write(false);
+    this->run(Hydraulics::pressure_sequence());
 /*
     float p = 0;
        while(p < pressure || p != -1)//ADD WHEN CURRENT SENSOR WORKS!
@@ -127,13 +78,66 @@ void Hydraulics::pressure(int pressure)
         delay(50);
     }
 */
-    this->solenoid_1.write(true);
-    this->solenoid_2.write(true);
-    this->solenoid_3.write(true);
-    this->solenoid_4.write(true);
-    this->solenoid_5.write(true);
-    this->solenoid_6.write(true);
-    this->solenoid_7.write(true);
-    this->pump.write(true);
+}
+
+
+ValveSequence Hydraulics::spin_up_sequence() {
+    ValveSequence s = {{
+        {0, 0, PUMP_BIT},
+        {PUMP_SPINUP, 0, SOL_5_BIT | SOL_7_BIT}
+    }, 2};
+    return s;
+}
+
+ValveSequence Hydraulics::brake_sequence(RailSide side, BrakeCommand command) {
+    bool right = (side == RailSide::right);
+    ValveSequence s = {{{0, 0, 0}}, 1};
+    switch (command) {
+        case BrakeCommand::hold:
+            s.steps[0].high = right ? SOL_1_BIT : SOL_4_BIT;
+            s.steps[0].low = right ? SOL_2_BIT : SOL_6_BIT;
+            break;
+        case BrakeCommand::retract:
+            s.steps[0].low = right ? (SOL_1_BIT | SOL_2_BIT) : (SOL_4_BIT | SOL_6_BIT);
+            break;
+        case BrakeCommand::extend:
+            s.steps[0].high = right ? SOL_2_BIT : SOL_6_BIT;
+            break;
+    }
+    return s;
+}
+
+ValveSequence Hydraulics::stand_by_sequence() {
+    ValveSequence s = {{
+        {0, SOL_1_BIT | SOL_4_BIT, SOL_2_BIT | SOL_6_BIT}, // hold both sides
+        {50000, SOL_3_BIT | SOL_5_BIT | SOL_7_BIT | PUMP_BIT, // 50 milliseconds
+            SOL_1_BIT | SOL_2_BIT | SOL_4_BIT | SOL_6_BIT}
+    }, 2};
+    return s;
+}
+
+ValveSequence Hydraulics::shut_down_sequence() {
+    ValveSequence s = {{
+        {0, ALL_OUTPUTS_BITS, 0}
+    }, 1};
+    return s;
+}
+
+ValveSequence Hydraulics::charge_accumulators_sequence() {
+    ValveSequence s = {{
+        {0, SOL_1_BIT | SOL_2_BIT | SOL_4_BIT | SOL_5_BIT | SOL_6_BIT,
+            SOL_3_BIT | SOL_7_BIT | PUMP_BIT},
+        {1500000, ALL_OUTPUTS_BITS, 0} // 1500 milliseconds
+    }, 2};
+    return s;
+}
 
+ValveSequence Hydraulics::pressure_sequence() {
+    ValveSequence s = {{
+        {0, 0, PUMP_BIT},
+        {PUMP_SPINUP, SOL_1_BIT | SOL_2_BIT | SOL_4_BIT | SOL_5_BIT | SOL_6_BIT,
+            SOL_3_BIT | SOL_7_BIT},
+        {0, ALL_OUTPUTS_BITS, 0}
+    }, 3};
+    return s;
 }
@@ -2,6 +2,9 @@
 #define HYDRAULICS_HPP
 
 #include "gpio.hpp"
+#include "gpio_bank.hpp"
+#include "interfaces.hpp"
+#include <cstdint>
 #include <string>
 #include <unistd.h>
 
@@ -14,19 +17,65 @@
 #define SOL_7 6 // PIN 25
 #define PUMP 7  // PIN  4
 
-class Hydraulics {
+#define NUM_HYDRAULIC_OUTPUTS 8
+#define MAX_VALVE_STEPS 4
+
+// Bit masks of the outputs within a ValveStep (bit n is the output on wiringPi pin n, so these are
+// also GpioMasks)
+#define SOL_1_BIT (1 << SOL_1)
+#define SOL_2_BIT (1 << SOL_2)
+#define SOL_3_BIT (1 << SOL_3)
+#define SOL_4_BIT (1 << SOL_4)
+#define SOL_5_BIT (1 << SOL_5)
+#define SOL_6_BIT (1 << SOL_6)
+#define SOL_7_BIT (1 << SOL_7)
+#define PUMP_BIT  (1 << PUMP)
+#define ALL_OUTPUTS_BITS 0xFF
+
+struct ValveStep
+{
+  int delay;     // microseconds to wait after the previous step
+  uint8_t high;  // outputs to set high
+  uint8_t low;   // outputs to set low
+};
+
+// Fixed-size so that building and queueing sequences never allocates
+struct ValveSequence
+{
+  ValveStep steps[MAX_VALVE_STEPS];
+  int length;
+};
+
+class Hydraulics : public BrakeActuator {
     public:
         void spin_up();
-        void hold(const std::string& side);
-        void retract(const std::string& side);
-        void extend(const std::string& side);
+        void hold(RailSide side);
+        void retract(RailSide side);
+        void extend(RailSide side);
         void stand_by();
         void shut_down();
         void charge_accumulators();
         void safety_check(std::string frontrear);
         void pressure(int pressure); // not in original .h file but implemented in .c file
-        Hydraulics();
+        virtual void actuate(RailSide side, BrakeCommand command);
+
+        /// Applies a single step immediately, ignoring its delay. All outputs of the step switch
+        /// together (one register write per direction on the memory-mapped bank).
+        void apply(const ValveStep& step);
+        /// Applies all steps of `sequence`, sleeping for the delays in between
+        void run(const ValveSequence& sequence);
+
+        // Step sequences of the actions above (see HydraulicsSequencer for non-blocking use)
+        static ValveSequence spin_up_sequence();
+        static ValveSequence brake_sequence(RailSide side, BrakeCommand command);
+        static ValveSequence stand_by_sequence();
+        static ValveSequence shut_down_sequence();
+        static ValveSequence charge_accumulators_sequence();
+        static ValveSequence pressure_sequence();
+
+        Hydraulics(GpioBank& bank = GpioBank::instance());
     private:
+        GpioBank& bank;
         GpioPin& solenoid_1;
         GpioPin& solenoid_2;
         GpioPin& solenoid_3;
@@ -0,0 +1,183 @@
+#include "hydraulics_sequencer.hpp"
+
+#include <algorithm>
+
+
+HydraulicsSequencer::HydraulicsSequencer(Hydraulics& hydraulics, Clock& clock)
+    : hydraulics(hydraulics), clock(clock)
+{
+  for (int i = 0; i < num_channels; ++i)
+  {
+    this->channels[i].active = false;
+    this->channels[i].has_promise = false;
+  }
+  this->timer_thread = std::thread(&HydraulicsSequencer::run, this);
+}
+
+HydraulicsSequencer::~HydraulicsSequencer()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop_flag = true;
+    for (int i = 0; i < num_channels; ++i)
+      this->cancel_locked(static_cast<Channel>(i));
+  }
+  this->wake.notify_one();
+  this->timer_thread.join();
+}
+
+std::future<bool> HydraulicsSequencer::spin_up()
+{
+  return this->submit(system_channel, Hydraulics::spin_up_sequence());
+}
+
+std::future<bool> HydraulicsSequencer::stand_by()
+{
+  return this->submit(system_channel, Hydraulics::stand_by_sequence());
+}
+
+std::future<bool> HydraulicsSequencer::shut_down()
+{
+  return this->submit(system_channel, Hydraulics::shut_down_sequence());
+}
+
+std::future<bool> HydraulicsSequencer::charge_accumulators()
+{
+  return this->submit(system_channel, Hydraulics::charge_accumulators_sequence());
+}
+
+std::future<bool> HydraulicsSequencer::hold(RailSide side)
+{
+  return this->submit(static_cast<Channel>(side),
+      Hydraulics::brake_sequence(side, BrakeCommand::hold));
+}
+
+std::future<bool> HydraulicsSequencer::retract(RailSide side)
+{
+  return this->submit(static_cast<Channel>(side),
+      Hydraulics::brake_sequence(side, BrakeCommand::retract));
+}
+
+std::future<bool> HydraulicsSequencer::extend(RailSide side)
+{
+  return this->submit(static_cast<Channel>(side),
+      Hydraulics::brake_sequence(side, BrakeCommand::extend));
+}
+
+void HydraulicsSequencer::actuate(RailSide side, BrakeCommand command)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->submit_locked(static_cast<Channel>(side),
+      Hydraulics::brake_sequence(side, command), nullptr);
+}
+
+bool HydraulicsSequencer::is_idle()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  for (int i = 0; i < num_channels; ++i)
+    if (this->channels[i].active)
+      return false;
+  return true;
+}
+
+std::future<bool> HydraulicsSequencer::submit(Channel channel, const ValveSequence& sequence)
+{
+  std::promise<bool> done;
+  std::future<bool> result = done.get_future();
+  bool pending;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->submit_locked(channel, sequence, &done);
+    pending = this->channels[channel].active;
+  }
+  if (pending)
+    this->wake.notify_one();
+  return result;
+}
+
+void HydraulicsSequencer::submit_locked(Channel channel, const ValveSequence& sequence,
+    std::promise<bool>* done)
+{
+  if (channel == system_channel)
+    for (int i = 0; i < num_channels; ++i)
+      this->cancel_locked(static_cast<Channel>(i));
+  else
+    this->cancel_locked(channel);
+
+  PendingSequence& p = this->channels[channel];
+  p.sequence = sequence;
+  p.next_step = 0;
+  p.active = true;
+  p.has_promise = (done != nullptr);
+  if (done != nullptr)
+    p.done = std::move(*done);
+  double now = this->clock.now();
+  p.due = now + sequence.steps[0].delay / 1.0e+6;
+  // Steps due now are applied straight away so actuation latency doesn't depend on the timer
+  this->advance_locked(p, now);
+}
+
+void HydraulicsSequencer::cancel_locked(Channel channel)
+{
+  PendingSequence& p = this->channels[channel];
+  if (p.active && p.has_promise)
+    p.done.set_value(false);
+  p.active = false;
+  p.has_promise = false;
+}
+
+void HydraulicsSequencer::advance_locked(PendingSequence& p, double now)
+{
+  while (p.active && p.due <= now)
+  {
+    this->hydraulics.apply(p.sequence.steps[p.next_step]);
+    ++p.next_step;
+    if (p.next_step >= p.sequence.length)
+    {
+      p.active = false;
+      if (p.has_promise)
+        p.done.set_value(true);
+      p.has_promise = false;
+    }
+    else
+    {
+      // Delays are relative to when the previous step was due, so they don't accumulate lag
+      p.due += p.sequence.steps[p.next_step].delay / 1.0e+6;
+    }
+  }
+}
+
+void HydraulicsSequencer::run()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (!this->stop_flag)
+  {
+    bool any = false;
+    double next = 0.0;
+    for (int i = 0; i < num_channels; ++i)
+    {
+      PendingSequence& p = this->channels[i];
+      if (p.active && (!any || p.due < next))
+      {
+        next = p.due;
+        any = true;
+      }
+    }
+    if (!any)
+    {
+      this->wake.wait(lock);
+      continue;
+    }
+    // The clock may be virtual, so it can't time a wait on the condition variable; sleeping in
+    // short slices still notices commands submitted meanwhile
+    lock.unlock();
+    this->clock.sleep_until(std::min(next, this->clock.now() + SEQUENCER_WAKE_PERIOD));
+    lock.lock();
+    if (this->stop_flag)
+      break;
+
+    double now = this->clock.now();
+    for (int i = 0; i < num_channels; ++i)
+      this->advance_locked(this->channels[i], now);
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef HYPED_DRIVERS_HYDRAULICS_SEQUENCER_HPP_
+#define HYPED_DRIVERS_HYDRAULICS_SEQUENCER_HPP_
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "clock.hpp"
+#include "hydraulics.hpp"
+#include "interfaces.hpp"
+
+#define SEQUENCER_WAKE_PERIOD 0.001 // s, longest the timer sleeps before it notices a new command
+
+/// Runs Hydraulics step sequences without blocking the caller. Steps which are due immediately are
+/// applied in the calling thread; the rest are applied by a single timer thread. Each brake side
+/// and the pump/supply system are separate channels, so both brakes can be actuated concurrently.
+/// A new command on a channel supersedes whatever is still pending on it; system-wide commands
+/// supersede everything. Steps are timed by the given Clock, so a virtual clock can drive them.
+///
+/// Commands return a future which becomes true once the last step has been applied, or false if
+/// the command was superseded (or the sequencer destroyed) first.
+class HydraulicsSequencer : public BrakeActuator
+{
+  public:
+    HydraulicsSequencer(Hydraulics& hydraulics, Clock& clock = Clock::get());
+    ~HydraulicsSequencer();
+
+    HydraulicsSequencer(HydraulicsSequencer const&) = delete;
+    void operator=(HydraulicsSequencer const&)     = delete;
+
+    std::future<bool> spin_up();
+    std::future<bool> stand_by();
+    std::future<bool> shut_down();
+    std::future<bool> charge_accumulators();
+    std::future<bool> hold(RailSide side);
+    std::future<bool> retract(RailSide side);
+    std::future<bool> extend(RailSide side);
+    /// Same as hold/retract/extend but without completion reporting (used by BrakeController)
+    virtual void actuate(RailSide side, BrakeCommand command);
+    /// True when no steps are pending on any channel
+    bool is_idle();
+
+  private:
+    enum Channel
+    {
+      left_channel = 0,  // == RailSide::left
+      right_channel = 1, // == RailSide::right
+      system_channel = 2,
+      num_channels = 3
+    };
+
+    struct PendingSequence
+    {
+      ValveSequence sequence;
+      int next_step;
+      double due; // Clock time next_step is due at
+      bool active;
+      bool has_promise;
+      std::promise<bool> done;
+    };
+
+    std::future<bool> submit(Channel channel, const ValveSequence& sequence);
+    void submit_locked(Channel channel, const ValveSequence& sequence, std::promise<bool>* done);
+    void cancel_locked(Channel channel);
+    void advance_locked(PendingSequence& p, double now);
+    void run();
+
+    Hydraulics& hydraulics;
+    Clock& clock;
+    PendingSequence channels[num_channels];
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop_flag = false;
+    std::thread timer_thread;
+};
+
+#endif // HYPED_DRIVERS_HYDRAULICS_SEQUENCER_HPP_
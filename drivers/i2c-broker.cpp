@@ -0,0 +1,72 @@
+/*
+ * I2C bus broker daemon: owns an adapter and serves every process using the bus (see
+ * i2c_broker.hpp).
+ *   i2c-broker [-b max_batch] [-p priority] [adapter] [segment]
+ * defaults to /dev/i2c-1 and /hyped-i2c-1. Programs use it when started with
+ * I2C_BROKER=<segment> (and optionally I2C_PRIORITY=<n>, higher first) in their environment.
+ * Transfers go one per transaction unless -b allows more, for adapters that can combine messages
+ * to several devices in one transaction (the Pi's can't).
+ * Stops on SIGINT or SIGTERM and prints its statistics.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "i2c_broker.hpp"
+#include "instrumentation.hpp"
+
+I2CBroker* broker = nullptr;
+
+void on_signal(int)
+{
+  if (broker)
+    broker->stop();
+}
+
+int main(int argc, char* argv[])
+{
+  I2CBrokerConfig config;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:p:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b':
+        config.max_batch = atoi(optarg);
+        break;
+      case 'p':
+        config.priority = atoi(optarg);
+        break;
+      default:
+        printf("Usage: %s [-b max_batch] [-p priority] [adapter] [segment]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind < argc)
+    config.adapter = argv[optind++];
+  if (optind < argc)
+    config.name = argv[optind++];
+
+  I2CBroker b(config);
+  if (!b.open())
+  {
+    printf("Can't serve %s at %s: %s\n", config.adapter.c_str(), config.name.c_str(),
+        strerror(errno));
+    return 1;
+  }
+  broker = &b;
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  printf("Serving %s at %s\n", config.adapter.c_str(), config.name.c_str());
+  b.run();
+
+  printf("%lu transfers (%lu failed) in %lu ioctls\n", b.get_transfers(), b.get_failures(),
+      b.get_ioctls());
+  printf("%s", Instrumentation::report().c_str());
+  return 0;
+}
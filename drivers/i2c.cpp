@@ -1,9 +1,19 @@
 #include "i2c.hpp"
 
+#include "i2c_broker.hpp"
+#include "instrumentation.hpp"
+
 #define I2C_DRIVER_PATH "/dev/i2c-1" // CAUTION: may be determined dynamically at boot
 
 void I2C::open_bus()
 {
+    const char *broker_name = getenv("I2C_BROKER");
+    if (broker_name && *broker_name)
+    {
+        const char *priority = getenv("I2C_PRIORITY");
+        connect_broker(broker_name, priority ? atoi(priority) : I2C_BROKER_DEFAULT_PRIORITY);
+        return;
+    }
     if ((bus = open(I2C_DRIVER_PATH, O_RDWR)) < 0)
     {
         printf("Failed to open the i2c bus\n");
@@ -11,9 +21,18 @@ void I2C::open_bus()
     }
 }
 
+void I2C::connect_broker(const std::string& broker_name, int priority)
+{
+    bus = -1;
+    broker = new I2CBrokerClient(broker_name, priority);
+}
+
 void I2C::close_bus()
 {
-    close(bus);
+    if (broker)
+        delete broker;
+    else
+        close(bus);
 }
 
 // Sends the `length` bytes of `buf` to the `device`.
@@ -22,6 +41,10 @@ void I2C::close_bus()
 //       buf    - array of bytes to be sent (NOTE: `buf[0]` will probably be a register address)
 void I2C::write(uint16_t device, short length, char *buf) const
 {
+    static LatencyHistogram& write_time = Instrumentation::get_histogram("i2c.write");
+    ScopedTimer timer(write_time);
+    if (broker)
+        return broker->transfer(I2CBrokerOp::write, device, length, buf, 0, nullptr);
     // structs below defined in /usr/include/linux/i2c-dev.h
     struct i2c_rdwr_ioctl_data data;
     struct i2c_msg msgs[1];
@@ -52,6 +75,11 @@ void I2C::write(uint16_t device, short length, char *buf) const
 void I2C::write_read(uint16_t device, short send_len, char *send_buf,
                                 short recv_len, char *recv_buf) const
 {
+    static LatencyHistogram& write_read_time = Instrumentation::get_histogram("i2c.write_read");
+    ScopedTimer timer(write_read_time);
+    if (broker)
+        return broker->transfer(I2CBrokerOp::write_read, device, send_len, send_buf,
+                                recv_len, recv_buf);
     // structs below defined in /usr/include/linux/i2c-dev.h
     struct i2c_rdwr_ioctl_data data;
     struct i2c_msg msgs[2];
@@ -75,6 +103,10 @@ void I2C::write_read(uint16_t device, short send_len, char *send_buf,
 
 void I2C::read(uint16_t device, short length, char *buf) const
 {
+  static LatencyHistogram& read_time = Instrumentation::get_histogram("i2c.read");
+  ScopedTimer timer(read_time);
+  if (broker)
+    return broker->transfer(I2CBrokerOp::read, device, 0, nullptr, length, buf);
   struct i2c_rdwr_ioctl_data data;
   struct i2c_msg msgs[1];
 
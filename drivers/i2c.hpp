@@ -15,10 +15,17 @@ extern "C"{
 
 typedef int i2c_bus; //file handle
 
+class I2CBrokerClient;
+
+/// The I2C bus, opened directly, or shared with other processes through the bus broker
+/// (i2c_broker.hpp) if the I2C_BROKER environment variable names its segment (e.g.
+/// "/hyped-i2c-1"). I2C_PRIORITY then sets the priority of this process's transfers.
 class I2C
 {
   public:
     I2C () { open_bus(); }
+    /// Uses the broker at `broker`; throws I2CException if there isn't one
+    I2C (const std::string& broker, int priority) { connect_broker(broker, priority); }
     ~I2C () { close_bus(); }
 
     void write(uint16_t device, short length, char *buf) const;
@@ -28,9 +35,11 @@ class I2C
 
   private:
     void open_bus();
+    void connect_broker(const std::string& broker, int priority);
     void close_bus();
 
     i2c_bus bus;
+    I2CBrokerClient *broker = nullptr;
 };
 
 class I2CException : public std::exception
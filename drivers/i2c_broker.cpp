@@ -0,0 +1,418 @@
+#include "i2c_broker.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+#include "i2c.hpp"
+#include "instrumentation.hpp"
+
+#ifndef I2C_RDWR_IOCTL_MAX_MSGS
+#define I2C_RDWR_IOCTL_MAX_MSGS 42
+#endif
+
+#define FUTEX_STEP 0.1    // s, longest sleep between checks that the other side is alive
+#define REAP_INTERVAL 0.1 // s, between checks for clients that exited holding their slot
+
+// The rings are shared between processes, which only works with lock-free atomics
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "process-shared rings need lock-free atomics");
+
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, double timeout)
+{
+  struct timespec ts;
+  ts.tv_sec = (time_t) timeout;
+  ts.tv_nsec = (long) ((timeout - ts.tv_sec) * 1.0e+9);
+  syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>& word)
+{
+  syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+inline bool process_exists(pid_t pid)
+{
+  return pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+inline const char* error_message(I2CBrokerOp op)
+{
+  switch (op)
+  {
+    case I2CBrokerOp::write:
+      return "I2C write failed";
+    case I2CBrokerOp::write_read:
+      return "I2C write-read failed";
+    default:
+      return "I2C read failed";
+  }
+}
+
+
+I2CBrokerClient::I2CBrokerClient(const std::string& name, int priority)
+    : segment(nullptr), slot(nullptr), next_id(0)
+{
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0)
+    throw I2CException("No I2C broker at " + name);
+  struct stat st;
+  void* p = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(I2CBrokerSegment))
+    p = mmap(nullptr, sizeof(I2CBrokerSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    throw I2CException("Can't map the I2C broker's segment " + name);
+  this->segment = (I2CBrokerSegment*) p;
+  if (this->segment->version.load(std::memory_order_acquire) != I2C_BROKER_VERSION
+      || !process_exists(this->segment->broker_pid.load()))
+  {
+    munmap(p, sizeof(I2CBrokerSegment));
+    throw I2CException("I2C broker at " + name + " isn't running");
+  }
+  for (int i = 0; i < I2C_BROKER_MAX_CLIENTS && !this->slot; ++i)
+  {
+    uint32_t expected = 0;
+    I2CBrokerSlot& s = this->segment->slots[i];
+    if (s.claimed.compare_exchange_strong(expected, 1))
+    {
+      s.priority.store(priority);
+      s.pid.store(getpid());
+      this->slot = &s;
+    }
+  }
+  if (!this->slot)
+  {
+    munmap(p, sizeof(I2CBrokerSegment));
+    throw I2CException("I2C broker at " + name + " has no free slots");
+  }
+}
+
+I2CBrokerClient::~I2CBrokerClient()
+{
+  this->slot->pid.store(0);
+  this->slot->claimed.store(0, std::memory_order_release);
+  munmap(this->segment, sizeof(I2CBrokerSegment));
+}
+
+void I2CBrokerClient::transfer(I2CBrokerOp op, uint16_t device, short send_len,
+    const char *send_buf, short recv_len, char *recv_buf)
+{
+  if (op == I2CBrokerOp::read)
+    send_len = 0;
+  if (op == I2CBrokerOp::write)
+    recv_len = 0;
+  if (send_len < 0 || send_len > I2C_BROKER_MAX_DATA || recv_len < 0
+      || recv_len > I2C_BROKER_MAX_DATA)
+    throw I2CException("I2C transfer too long for the broker");
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  I2CBrokerRing<I2CBrokerRequest>& requests = this->slot->requests;
+  uint32_t head = requests.head.load(std::memory_order_relaxed);
+  if (head - requests.tail.load(std::memory_order_acquire) >= I2C_BROKER_RING_SIZE)
+    throw I2CException("I2C broker not responding");
+  I2CBrokerRequest& r = requests.entries[head % I2C_BROKER_RING_SIZE];
+  uint32_t id = this->next_id++;
+  r.id = id;
+  r.device = device;
+  r.op = op;
+  r.send_len = send_len;
+  r.recv_len = recv_len;
+  r.submitted = timestamp_ns();
+  if (send_len > 0)
+    std::memcpy(r.data, send_buf, send_len);
+  requests.head.store(head + 1, std::memory_order_release);
+  this->segment->doorbell.fetch_add(1);
+  if (this->segment->broker_sleeping.load())
+    futex_wake(this->segment->doorbell);
+
+  I2CBrokerRing<I2CBrokerCompletion>& completions = this->slot->completions;
+  uint64_t deadline = r.submitted + (uint64_t) (I2C_BROKER_TIMEOUT * 1.0e+9);
+  while (true)
+  {
+    uint32_t tail = completions.tail.load(std::memory_order_relaxed);
+    if (completions.head.load(std::memory_order_acquire) != tail)
+    {
+      const I2CBrokerCompletion& c = completions.entries[tail % I2C_BROKER_RING_SIZE];
+      bool mine = (c.id == id);
+      int error = c.error;
+      if (mine && error == 0 && recv_len > 0)
+        std::memcpy(recv_buf, c.data, recv_len);
+      completions.tail.store(tail + 1, std::memory_order_release);
+      if (!mine)
+        continue; // completion of an earlier transfer which timed out
+      if (error)
+        throw I2CException(error_message(op));
+      return;
+    }
+    if (timestamp_ns() > deadline
+        || !process_exists(this->segment->broker_pid.load()))
+      throw I2CException("I2C broker not responding");
+    futex_wait(completions.head, tail, FUTEX_STEP);
+  }
+}
+
+
+I2CBroker::I2CBroker(I2CBrokerConfig config)
+    : config(config), bus(-1), segment(nullptr), order(0), stop_flag(false), transfers(0),
+    ioctls(0), failures(0)
+{
+  this->config.max_batch = std::max(1,
+      std::min(this->config.max_batch, I2C_RDWR_IOCTL_MAX_MSGS));
+  this->pending.reserve(I2C_BROKER_MAX_CLIENTS * I2C_BROKER_RING_SIZE);
+}
+
+I2CBroker::~I2CBroker()
+{
+  if (this->segment)
+  {
+    munmap(this->segment, sizeof(I2CBrokerSegment));
+    shm_unlink(this->config.name.c_str());
+  }
+  if (this->bus >= 0)
+    close(this->bus);
+}
+
+bool I2CBroker::open()
+{
+  const char* name = this->config.name.c_str();
+  // Refuse to replace a live broker; a dead one's segment is removed (its clients time out)
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd >= 0)
+  {
+    void* p = mmap(nullptr, sizeof(I2CBrokerSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    bool live = false;
+    if (p != MAP_FAILED)
+    {
+      const I2CBrokerSegment* old = (const I2CBrokerSegment*) p;
+      live = old->version.load() == I2C_BROKER_VERSION && old->broker_pid.load() != getpid()
+          && old->broker_pid.load() > 0 && process_exists(old->broker_pid.load());
+      munmap(p, sizeof(I2CBrokerSegment));
+    }
+    if (live)
+    {
+      errno = EBUSY;
+      return false;
+    }
+    shm_unlink(name);
+  }
+
+  this->bus = ::open(this->config.adapter.c_str(), O_RDWR);
+  if (this->bus < 0)
+    return false;
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+  if (fd < 0)
+    return false;
+  fchmod(fd, 0666); // clients needn't run as the broker's user
+  void* p = MAP_FAILED;
+  if (ftruncate(fd, sizeof(I2CBrokerSegment)) == 0)
+    p = mmap(nullptr, sizeof(I2CBrokerSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+  {
+    shm_unlink(name);
+    return false;
+  }
+  std::memset(p, 0, sizeof(I2CBrokerSegment));
+  this->segment = new (p) I2CBrokerSegment();
+  this->segment->broker_pid.store(getpid());
+  this->segment->version.store(I2C_BROKER_VERSION, std::memory_order_release);
+  return true;
+}
+
+void I2CBroker::run()
+{
+  struct sched_param param;
+  param.sched_priority = this->config.priority;
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+    printf("SCHED_FIFO not granted, running with normal priority\n");
+
+  uint64_t last_reap = timestamp_ns();
+  while (!this->stop_flag)
+  {
+    uint32_t doorbell = this->segment->doorbell.load();
+    this->collect();
+    uint64_t now = timestamp_ns();
+    if (now - last_reap > REAP_INTERVAL * 1.0e+9)
+    {
+      this->reap_clients();
+      last_reap = now;
+    }
+    if (!this->pending.empty())
+    {
+      this->serve();
+      continue;
+    }
+    // Clients check the flag after ringing, so either they wake us or we see the new doorbell
+    this->segment->broker_sleeping.store(1);
+    if (this->segment->doorbell.load() == doorbell && !this->stop_flag)
+      futex_wait(this->segment->doorbell, doorbell, REAP_INTERVAL);
+    this->segment->broker_sleeping.store(0);
+  }
+}
+
+void I2CBroker::stop()
+{
+  this->stop_flag = true;
+  if (this->segment)
+  {
+    this->segment->doorbell.fetch_add(1);
+    futex_wake(this->segment->doorbell);
+  }
+}
+
+void I2CBroker::collect()
+{
+  for (int i = 0; i < I2C_BROKER_MAX_CLIENTS; ++i)
+  {
+    I2CBrokerSlot& s = this->segment->slots[i];
+    if (!s.claimed.load(std::memory_order_acquire))
+      continue;
+    I2CBrokerRing<I2CBrokerRequest>& requests = s.requests;
+    uint32_t tail = requests.tail.load(std::memory_order_relaxed);
+    uint32_t head = requests.head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail)
+    {
+      Pending p;
+      p.request = requests.entries[tail % I2C_BROKER_RING_SIZE];
+      p.slot = i;
+      p.priority = s.priority.load(std::memory_order_relaxed);
+      p.order = this->order++;
+      const I2CBrokerRequest& r = p.request;
+      if (r.send_len < 0 || r.send_len > I2C_BROKER_MAX_DATA || r.recv_len < 0
+          || r.recv_len > I2C_BROKER_MAX_DATA || r.op > I2CBrokerOp::read)
+        this->complete(p, EINVAL);
+      else
+        this->pending.push_back(p);
+    }
+    requests.tail.store(tail, std::memory_order_release);
+  }
+}
+
+void I2CBroker::reap_clients()
+{
+  for (int i = 0; i < I2C_BROKER_MAX_CLIENTS; ++i)
+  {
+    I2CBrokerSlot& s = this->segment->slots[i];
+    if (!s.claimed.load(std::memory_order_acquire) || process_exists(s.pid.load()))
+      continue;
+    // The client exited without releasing its slot: drop what it queued and free the slot
+    this->pending.erase(std::remove_if(this->pending.begin(), this->pending.end(),
+        [i](const Pending& p) { return p.slot == i; }), this->pending.end());
+    s.requests.tail.store(s.requests.head.load());
+    s.completions.tail.store(s.completions.head.load());
+    s.pid.store(0);
+    s.claimed.store(0, std::memory_order_release);
+  }
+}
+
+void I2CBroker::serve()
+{
+  static LatencyHistogram& wait_time = Instrumentation::get_histogram("i2c_broker.wait");
+  std::sort(this->pending.begin(), this->pending.end(), [](const Pending& a, const Pending& b) {
+    return a.priority != b.priority ? a.priority > b.priority : a.order < b.order;
+  });
+
+  // As many transfers as fit in one ioctl, highest priority first
+  int n = 0, msgs = 0;
+  for (const Pending& p : this->pending)
+  {
+    int m = (p.request.op == I2CBrokerOp::write_read) ? 2 : 1;
+    if (n > 0 && msgs + m > this->config.max_batch)
+      break;
+    msgs += m;
+    ++n;
+  }
+  uint64_t now = timestamp_ns();
+  for (int i = 0; i < n; ++i)
+    wait_time.record(now - this->pending[i].request.submitted);
+
+  Pending* batch = this->pending.data();
+  if (this->execute(batch, n))
+    for (int i = 0; i < n; ++i)
+      this->complete(batch[i], 0);
+  else if (n > 1 && errno == EOPNOTSUPP)
+  {
+    // The adapter checks the messages before sending any, so nothing reached the bus: send them
+    // one at a time, now and from now on
+    fprintf(stderr, "I2C adapter can't combine transfers; batching turned off\n");
+    this->config.max_batch = 1;
+    for (int i = 0; i < n; ++i)
+      this->complete(batch[i], this->execute(batch + i, 1) ? 0 : errno);
+  }
+  else
+  {
+    // Some of the transfers may have gone through before one failed, and repeating those could
+    // repeat writes, so every client of the transaction gets the error
+    int error = errno;
+    for (int i = 0; i < n; ++i)
+      this->complete(batch[i], error);
+  }
+  this->pending.erase(this->pending.begin(), this->pending.begin() + n);
+}
+
+bool I2CBroker::execute(Pending* transfers, int n)
+{
+  static LatencyHistogram& ioctl_time = Instrumentation::get_histogram("i2c_broker.ioctl");
+  // structs below defined in /usr/include/linux/i2c-dev.h
+  struct i2c_rdwr_ioctl_data data;
+  struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+  int m = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    Pending& p = transfers[i];
+    if (p.request.op != I2CBrokerOp::read)
+    {
+      msgs[m].addr = p.request.device;
+      msgs[m].flags = 0;
+      msgs[m].len = p.request.send_len;
+      msgs[m].buf = p.request.data;
+      ++m;
+    }
+    if (p.request.op != I2CBrokerOp::write)
+    {
+      msgs[m].addr = p.request.device;
+      msgs[m].flags = I2C_M_RD;
+      msgs[m].len = p.request.recv_len;
+      msgs[m].buf = p.recv;
+      ++m;
+    }
+  }
+  data.msgs = msgs;
+  data.nmsgs = m;
+
+  ++this->ioctls;
+  ScopedTimer timer(ioctl_time);
+  return ioctl(this->bus, I2C_RDWR, &data) >= 0;
+}
+
+void I2CBroker::complete(const Pending& p, int error)
+{
+  ++this->transfers;
+  if (error)
+    ++this->failures;
+  I2CBrokerSlot& s = this->segment->slots[p.slot];
+  I2CBrokerRing<I2CBrokerCompletion>& completions = s.completions;
+  uint32_t head = completions.head.load(std::memory_order_relaxed);
+  if (head - completions.tail.load(std::memory_order_acquire) >= I2C_BROKER_RING_SIZE)
+    return; // the client isn't taking its completions (it will time out)
+  I2CBrokerCompletion& c = completions.entries[head % I2C_BROKER_RING_SIZE];
+  c.id = p.request.id;
+  c.error = error;
+  if (!error && p.request.op != I2CBrokerOp::write)
+    std::memcpy(c.data, p.recv, p.request.recv_len);
+  completions.head.store(head + 1, std::memory_order_release);
+  futex_wake(completions.head);
+}
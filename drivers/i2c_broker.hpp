@@ -0,0 +1,164 @@
+#ifndef HYPED_DRIVERS_I2C_BROKER_HPP_
+#define HYPED_DRIVERS_I2C_BROKER_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define I2C_BROKER_VERSION 1
+#define I2C_BROKER_DEFAULT_NAME "/hyped-i2c-1" // shared memory segment
+#define I2C_BROKER_MAX_CLIENTS 16
+#define I2C_BROKER_RING_SIZE 8 // entries per ring, a power of 2
+#define I2C_BROKER_MAX_DATA 64 // bytes sent or received per transfer
+#define I2C_BROKER_DEFAULT_PRIORITY 50
+#define I2C_BROKER_TIMEOUT 1.0 // s, clients give up on a broker that doesn't answer
+
+/*
+ * I2C bus broker: one process (i2c-broker) owns the adapter and serves every other process that
+ * uses the bus through a shared memory segment. Each client claims a slot holding two
+ * single-producer single-consumer rings: requests (client to broker) and completions (broker to
+ * client). The ring indices are futex words, so waiting sides sleep in the kernel and are woken
+ * directly by the other side. The broker takes all queued requests, orders them by priority
+ * (then by arrival) and sends them as few combined I2C_RDWR ioctls as the batch limit allows.
+ * A combined ioctl which fails can't tell which of its transfers reached their devices, so all of
+ * them fail rather than being repeated (writes may have side effects).
+ */
+
+enum class I2CBrokerOp : uint8_t
+{
+  write,
+  write_read,
+  read
+};
+
+struct I2CBrokerRequest
+{
+  uint32_t id;
+  uint16_t device;
+  I2CBrokerOp op;
+  int16_t send_len;
+  int16_t recv_len;
+  uint64_t submitted; // timestamp_ns()
+  char data[I2C_BROKER_MAX_DATA];
+};
+
+struct I2CBrokerCompletion
+{
+  uint32_t id;
+  int32_t error; // 0, or errno of the failed ioctl
+  char data[I2C_BROKER_MAX_DATA];
+};
+
+/// Indices only increase (entries are at index % I2C_BROKER_RING_SIZE); the consumer sleeps on
+/// `head` while the ring is empty
+template <typename T>
+struct I2CBrokerRing
+{
+  alignas(64) std::atomic<uint32_t> head; // written by the producer
+  alignas(64) std::atomic<uint32_t> tail; // written by the consumer
+  T entries[I2C_BROKER_RING_SIZE];
+};
+
+struct I2CBrokerSlot
+{
+  std::atomic<uint32_t> claimed;
+  std::atomic<int32_t> pid;
+  std::atomic<uint32_t> priority; // higher is served first
+  I2CBrokerRing<I2CBrokerRequest> requests;
+  I2CBrokerRing<I2CBrokerCompletion> completions;
+};
+
+struct I2CBrokerSegment
+{
+  std::atomic<uint32_t> version; // set last, once the segment is initialized
+  std::atomic<int32_t> broker_pid;
+  std::atomic<uint32_t> doorbell; // increased by clients after submitting, the broker sleeps on it
+  std::atomic<uint32_t> broker_sleeping;
+  I2CBrokerSlot slots[I2C_BROKER_MAX_CLIENTS];
+};
+
+/// Client side of the broker, used by I2C when it shares the bus (see i2c.hpp). Transfers are
+/// synchronous and serialized per client; threads wanting to queue transfers concurrently each
+/// use their own I2C instance.
+class I2CBrokerClient
+{
+  public:
+    /// Throws I2CException if there's no broker running or all its slots are taken
+    I2CBrokerClient(const std::string& name, int priority);
+    ~I2CBrokerClient();
+
+    I2CBrokerClient(I2CBrokerClient const&) = delete;
+    void operator=(I2CBrokerClient const&)  = delete;
+
+    /// Throws I2CException if the transfer fails or the broker stops answering
+    void transfer(I2CBrokerOp op, uint16_t device, short send_len, const char *send_buf,
+        short recv_len, char *recv_buf);
+
+  private:
+    I2CBrokerSegment* segment;
+    I2CBrokerSlot* slot;
+    uint32_t next_id;
+    std::mutex mutex;
+};
+
+struct I2CBrokerConfig
+{
+  std::string adapter = "/dev/i2c-1";
+  std::string name = I2C_BROKER_DEFAULT_NAME;
+  // i2c_msgs per ioctl (at most 42). The Pi's adapter can't combine them (a read must be the
+  // last message), so batching is off unless asked for; it is turned off again if the adapter
+  // turns a combined transaction down
+  int max_batch = 1;
+  int priority = 70;  // SCHED_FIFO priority of the serving thread
+};
+
+/// Owns an I2C adapter and serves the clients of its shared memory segment
+class I2CBroker
+{
+  public:
+    I2CBroker(I2CBrokerConfig config = I2CBrokerConfig());
+    ~I2CBroker();
+
+    I2CBroker(I2CBroker const&)      = delete;
+    void operator=(I2CBroker const&) = delete;
+
+    /// Opens the adapter and creates the segment; false if either fails
+    bool open();
+    /// Serves clients until stop() is called (e.g. from a signal handler)
+    void run();
+    void stop();
+
+    unsigned long get_transfers() const { return this->transfers; }
+    unsigned long get_ioctls() const { return this->ioctls; }
+    unsigned long get_failures() const { return this->failures; }
+
+  private:
+    struct Pending
+    {
+      I2CBrokerRequest request;
+      char recv[I2C_BROKER_MAX_DATA];
+      int slot;
+      uint32_t priority;
+      uint64_t order; // arrival
+    };
+
+    void collect();
+    void reap_clients();
+    void serve();
+    bool execute(Pending* transfers, int n);
+    void complete(const Pending& p, int error);
+
+    I2CBrokerConfig config;
+    int bus;
+    I2CBrokerSegment* segment;
+    std::vector<Pending> pending;
+    uint64_t order;
+    std::atomic_bool stop_flag;
+    unsigned long transfers;
+    unsigned long ioctls;
+    unsigned long failures;
+};
+
+#endif // HYPED_DRIVERS_I2C_BROKER_HPP_
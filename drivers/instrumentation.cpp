@@ -0,0 +1,202 @@
+#include "instrumentation.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define MAX_VALUE ((uint64_t(1) << (HISTOGRAM_MAX_BITS + 1)) - 1)
+
+// Registered histograms; a slot is filled (under the mutex) before the count is increased, so
+// readers only need the count
+static std::mutex registry_mutex;
+static std::atomic<int> registry_count(0);
+static LatencyHistogram* registry[MAX_HISTOGRAMS];
+static char registry_names[MAX_HISTOGRAMS][HISTOGRAM_NAME_LENGTH];
+
+inline int highest_bit(uint64_t v)
+{
+  return 63 - __builtin_clzll(v);
+}
+
+
+double HistogramSnapshot::get_percentile(double p) const
+{
+  if (this->count == 0)
+    return 0.0;
+  uint64_t rank = (uint64_t) (p * this->count);
+  if (rank >= this->count)
+    rank = this->count - 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+  {
+    seen += this->counts[b];
+    if (seen > rank)
+      return (LatencyHistogram::get_bucket_start(b) + LatencyHistogram::get_bucket_end(b) - 1)
+          / 2.0;
+  }
+  return this->get_max();
+}
+
+double HistogramSnapshot::get_mean() const
+{
+  return this->count ? (double) this->sum / this->count : 0.0;
+}
+
+double HistogramSnapshot::get_max() const
+{
+  for (int b = HISTOGRAM_BUCKETS - 1; b >= 0; --b)
+    if (this->counts[b])
+      return LatencyHistogram::get_bucket_end(b) - 1;
+  return 0.0;
+}
+
+HistogramSnapshot HistogramSnapshot::operator-(const HistogramSnapshot& earlier) const
+{
+  HistogramSnapshot d;
+  for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+    d.counts[b] = this->counts[b] - earlier.counts[b];
+  d.count = this->count - earlier.count;
+  d.sum = this->sum - earlier.sum;
+  return d;
+}
+
+
+LatencyHistogram::LatencyHistogram()
+    : sum(0)
+{
+  for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+    this->counts[b].store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+  this->counts[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+  this->sum.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(HistogramSnapshot& s) const
+{
+  s.count = 0;
+  for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+  {
+    s.counts[b] = this->counts[b].load(std::memory_order_relaxed);
+    s.count += s.counts[b];
+  }
+  s.sum = this->sum.load(std::memory_order_relaxed);
+}
+
+int LatencyHistogram::get_bucket(uint64_t ns)
+{
+  if (ns < SUB_BUCKETS)
+    return ns;
+  if (ns > MAX_VALUE)
+    ns = MAX_VALUE;
+  int e = highest_bit(ns);
+  int m = (ns >> (e - HISTOGRAM_SUB_BITS)) - SUB_BUCKETS;
+  return SUB_BUCKETS + (e - HISTOGRAM_SUB_BITS) * SUB_BUCKETS + m;
+}
+
+uint64_t LatencyHistogram::get_bucket_start(int bucket)
+{
+  if (bucket < SUB_BUCKETS)
+    return bucket;
+  int e = (bucket - SUB_BUCKETS) / SUB_BUCKETS + HISTOGRAM_SUB_BITS;
+  int m = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+  return uint64_t(SUB_BUCKETS + m) << (e - HISTOGRAM_SUB_BITS);
+}
+
+uint64_t LatencyHistogram::get_bucket_end(int bucket)
+{
+  if (bucket < SUB_BUCKETS)
+    return bucket + 1;
+  int e = (bucket - SUB_BUCKETS) / SUB_BUCKETS + HISTOGRAM_SUB_BITS;
+  return get_bucket_start(bucket) + (uint64_t(1) << (e - HISTOGRAM_SUB_BITS));
+}
+
+
+LoopMonitor::LoopMonitor(const std::string& name, double period)
+    : period_histogram(Instrumentation::get_histogram(name + ".period")),
+    jitter_histogram(Instrumentation::get_histogram(name + ".jitter")),
+    period(period * 1.0e+9), last(0)
+{}
+
+void LoopMonitor::tick()
+{
+  uint64_t now = timestamp_ns();
+  if (this->last)
+  {
+    uint64_t p = now - this->last;
+    this->period_histogram.record(p);
+    this->jitter_histogram.record(p > this->period ? p - this->period : this->period - p);
+  }
+  this->last = now;
+}
+
+
+LatencyHistogram& Instrumentation::get_histogram(const std::string& name)
+{
+  static LatencyHistogram overflow;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  int n = registry_count.load(std::memory_order_relaxed);
+  for (int i = 0; i < n; ++i)
+    if (name == registry_names[i])
+      return *registry[i];
+  if (n >= MAX_HISTOGRAMS)
+    return overflow;
+  registry[n] = new LatencyHistogram();
+  std::strncpy(registry_names[n], name.c_str(), HISTOGRAM_NAME_LENGTH - 1);
+  registry_count.store(n + 1, std::memory_order_release);
+  return *registry[n];
+}
+
+std::string Instrumentation::report()
+{
+  std::stringstream ss;
+  char line[160];
+  snprintf(line, sizeof(line), "%-32s %10s %10s %10s %10s %10s %10s\n", "stage (us)", "count",
+      "mean", "p50", "p99", "p99.9", "max");
+  ss << line;
+  HistogramSnapshot s;
+  for (int i = 0; i < get_count(); ++i)
+  {
+    at(i).snapshot(s);
+    snprintf(line, sizeof(line), "%-32s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+        get_name(i), (unsigned long long) s.count, s.get_mean() / 1.0e+3,
+        s.get_percentile(0.5) / 1.0e+3, s.get_percentile(0.99) / 1.0e+3,
+        s.get_percentile(0.999) / 1.0e+3, s.get_max() / 1.0e+3);
+    ss << line;
+  }
+  return ss.str();
+}
+
+std::string Instrumentation::report_csv()
+{
+  std::stringstream ss;
+  ss << "stage,count,mean_us,p50_us,p99_us,p999_us,max_us\n";
+  HistogramSnapshot s;
+  for (int i = 0; i < get_count(); ++i)
+  {
+    at(i).snapshot(s);
+    ss << get_name(i) << "," << s.count << "," << s.get_mean() / 1.0e+3 << ","
+       << s.get_percentile(0.5) / 1.0e+3 << "," << s.get_percentile(0.99) / 1.0e+3 << ","
+       << s.get_percentile(0.999) / 1.0e+3 << "," << s.get_max() / 1.0e+3 << "\n";
+  }
+  return ss.str();
+}
+
+int Instrumentation::get_count()
+{
+  return registry_count.load(std::memory_order_acquire);
+}
+
+const char* Instrumentation::get_name(int i)
+{
+  return registry_names[i];
+}
+
+LatencyHistogram& Instrumentation::at(int i)
+{
+  return *registry[i];
+}
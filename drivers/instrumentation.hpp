@@ -0,0 +1,118 @@
+#ifndef HYPED_DRIVERS_INSTRUMENTATION_HPP_
+#define HYPED_DRIVERS_INSTRUMENTATION_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Log-linear buckets (as in HdrHistogram): values below 2^HISTOGRAM_SUB_BITS ns are exact, above
+// that every power of 2 is split into 2^HISTOGRAM_SUB_BITS buckets, i.e. about 3% resolution
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_MAX_BITS 40 // values are clamped to 2^40 ns (about 18 minutes)
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 2) << HISTOGRAM_SUB_BITS)
+#define MAX_HISTOGRAMS 128
+#define HISTOGRAM_NAME_LENGTH 48
+
+inline uint64_t timestamp_ns()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/// Copy of a histogram's counts at one moment; subtract two to get the stats of an interval
+struct HistogramSnapshot
+{
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  uint64_t sum; // ns
+
+  /// Value (ns) below which fraction `p` (0 to 1) of the samples lie, to the bucket's resolution
+  double get_percentile(double p) const;
+  double get_mean() const;
+  /// Upper end of the highest non-empty bucket
+  double get_max() const;
+  HistogramSnapshot operator-(const HistogramSnapshot& earlier) const;
+};
+
+/// Latency histogram in nanoseconds. Recording is a few relaxed atomic increments, so any number
+/// of threads can record without waiting for each other or for readers; snapshots read the
+/// counters without locking (a snapshot taken during recording may be off by those samples).
+class LatencyHistogram
+{
+  public:
+    LatencyHistogram();
+
+    LatencyHistogram(LatencyHistogram const&) = delete;
+    void operator=(LatencyHistogram const&)   = delete;
+
+    void record(uint64_t ns);
+    void snapshot(HistogramSnapshot& s) const;
+
+    static int get_bucket(uint64_t ns);
+    static uint64_t get_bucket_start(int bucket);
+    static uint64_t get_bucket_end(int bucket); // exclusive
+
+  private:
+    std::atomic<uint64_t> counts[HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> sum;
+};
+
+/// Records the time from construction to destruction, e.g. of a function or loop body
+class ScopedTimer
+{
+  public:
+    ScopedTimer(LatencyHistogram& histogram)
+        : histogram(&histogram), start(timestamp_ns())
+    {}
+    /// Times nothing if `histogram` is null
+    ScopedTimer(LatencyHistogram* histogram)
+        : histogram(histogram), start(histogram ? timestamp_ns() : 0)
+    {}
+    ~ScopedTimer()
+    {
+      if (this->histogram)
+        this->histogram->record(timestamp_ns() - this->start);
+    }
+
+  private:
+    LatencyHistogram* histogram;
+    uint64_t start;
+};
+
+/// Period and jitter (difference from the intended period) of a loop; call tick() once per
+/// iteration from the loop's thread
+class LoopMonitor
+{
+  public:
+    /// Records to histograms `name`.period and `name`.jitter
+    LoopMonitor(const std::string& name, double period);
+    void tick();
+
+  private:
+    LatencyHistogram& period_histogram;
+    LatencyHistogram& jitter_histogram;
+    uint64_t period; // ns
+    uint64_t last;
+};
+
+/// Registry of named histograms, so that every stage can be exported together
+class Instrumentation
+{
+  public:
+    /// Histogram called `name`, created the first time it's asked for. Keep the reference
+    /// (e.g. in a function-local static) rather than looking it up in a hot loop. Past
+    /// MAX_HISTOGRAMS, returns a histogram which isn't reported
+    static LatencyHistogram& get_histogram(const std::string& name);
+    /// Table of count, mean, p50, p99, p99.9 and max of every histogram, in microseconds
+    static std::string report();
+    /// Same as CSV, with a header row
+    static std::string report_csv();
+
+  private:
+    static int get_count();
+    static const char* get_name(int i);
+    static LatencyHistogram& at(int i);
+};
+
+#endif // HYPED_DRIVERS_INSTRUMENTATION_HPP_
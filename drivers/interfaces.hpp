@@ -1,8 +1,18 @@
 #ifndef HYPED_DRIVERS_INTERFACES_HPP_
 #define HYPED_DRIVERS_INTERFACES_HPP_
 
+#include <exception>
+
 #include "vector3d.hpp"
 
+/// Thrown by sensors which pass on readings taken elsewhere (see bus_sensors.hpp) when there is
+/// nothing new since they were last read. Not a failure: the reading is just skipped
+class NoNewReadingException : public std::exception
+{
+  public:
+    const char* what() const noexcept override { return "No new reading"; }
+};
+
 
 class Accelerometer
 {
@@ -46,6 +56,81 @@ class Proxi
     virtual ~Proxi() {}
 
     virtual int get_distance() = 0;
+    /// Also gives the Clock::get() time the distance was measured at (seconds), or a negative
+    /// time if the proxi can't tell (the time of the call is then as good a guess as any)
+    virtual int get_timed_distance(double& timestamp)
+    {
+      timestamp = -1.0;
+      return this->get_distance();
+    }
+};
+
+struct ProxiReading
+{
+  int distance;     // mm
+  double timestamp; // Clock::get() time it was measured at, negative if unknown (see Proxi)
+  bool fresh;       // false if it couldn't be read this time (the last reading is repeated)
+};
+
+/// Proxis read together in one call, so that drivers can overlap the readings (or ask a slave
+/// for all of its proxis at once) rather than wait for one proxi after the other. Wrap single
+/// Proxis in a ProxiList (proxi_group.hpp)
+class ProxiGroup
+{
+  public:
+    virtual ~ProxiGroup() {}
+
+    virtual int size() = 0;
+    /// Fills `readings[0]` to `readings[size() - 1]`; returns how many are fresh
+    virtual int get_distances(ProxiReading* readings) = 0;
+};
+
+/// Counts the stripes along the track (Keyence, or a simulated one)
+class StripeCounter
+{
+  public:
+    virtual ~StripeCounter() {}
+
+    /// May block for a few seconds
+    virtual void calibrate() = 0;
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    /// Whether a stripe was passed since the last get_count()
+    virtual bool has_new_stripe() = 0;
+    virtual int get_count() = 0;
+    /// Distance travelled according to the count (m)
+    virtual double get_distance() = 0;
+};
+
+class PressureSensor
+{
+  public:
+    virtual ~PressureSensor() {}
+
+    /// Latest known pressure, negative if unknown (must not block)
+    virtual double get_pressure() = 0;
+};
+
+enum class RailSide
+{
+  left,
+  right
+};
+
+enum class BrakeCommand
+{
+  hold,
+  extend,
+  retract
+};
+
+class BrakeActuator
+{
+  public:
+    virtual ~BrakeActuator() {}
+
+    /// Sets the valves for one brake (must not wait for the brake to move)
+    virtual void actuate(RailSide side, BrakeCommand command) = 0;
 };
 
 #endif // HYPED_DRIVERS_INTERFACES_HPP_
@@ -1,18 +1,11 @@
 #include "keyence.hpp"
 
-#include <chrono>
 #include <cstdio>
 
+#include "clock.hpp"
+#include "instrumentation.hpp"
+#include "stripes.hpp"
 
-const int stripe_locations[63] =
-    {0, 100, 200, 300, 400, 500, 600, 700, 800, 900, 
-    1000, 1100, 1200, 1300, 1400, 1500, 1600, 1700, 1800, 1900, 
-    2000, 2100, 2200, 2300, 2400, 2500, 2600, 2700, 2800, 2900, 
-    3000, 3100, 3200, 3300, 3400, 3500, 3600, 3700, 3800, 3900, 
-    4000, 4008, 4016, 4024, 4032, 4040, 4048, 4056, 4064, 4072,
-    4100, 4200, 4300, 4400, 
-    4500, 4508, 4516, 4524, 4532,
-    4600, 4700, 4800, 4900};
 
 Keyence::Keyence(GpioPinNumber config_pin_num, GpioPinNumber output_pin_num)
     : config_pin { Gpio::get_pin(config_pin_num, PinMode::out, PudControl::off) },
@@ -23,12 +16,14 @@ Keyence::Keyence(GpioPinNumber config_pin_num, GpioPinNumber output_pin_num)
 Keyence::~Keyence()
 {
   this->stop();
+  Gpio::release_pin(this->config_pin);
+  Gpio::release_pin(this->output_pin);
 }
 
 void Keyence::calibrate()
 {
   this->config_pin.write(false);
-  std::this_thread::sleep_for(std::chrono::milliseconds(3500));
+  Clock::get().sleep_for(3.5);
   this->config_pin.write(true);
   printf("Setup complete\n");	
 }
@@ -41,8 +36,9 @@ void Keyence::start()
 
 void Keyence::stop()
 {
-  this->stop_flag = false;
-  this->counting_thread.join();
+  this->stop_flag = true;
+  if (this->counting_thread.joinable())
+    this->counting_thread.join();
 }
 
 bool Keyence::has_new_stripe()
@@ -58,15 +54,18 @@ int Keyence::get_count()
 
 double Keyence::get_distance()
 {
-  return this->get_count() * 30.0;
+  return this->get_count() * STRIPE_DISTANCE;
 }
 
 void Keyence::count_stripes()
 {
   int count = 0;
   bool current, previous = false;
+  Clock& clock = Clock::get();
+  LoopMonitor monitor("keyence.loop", 0.001);
   while (!this->stop_flag)
   {
+    monitor.tick();
     current = this->output_pin.read();
     if (current && !previous)
     {
@@ -88,6 +87,6 @@ void Keyence::count_stripes()
 
     previous = current;
     //Change delay to vary the reading frequency
-    std::this_thread::sleep_for(std::chrono::microseconds(1000));
+    clock.sleep_for(0.001);
   }
 }
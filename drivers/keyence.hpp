@@ -1,23 +1,27 @@
+#ifndef HYPED_DRIVERS_KEYENCE_HPP_
+#define HYPED_DRIVERS_KEYENCE_HPP_
+
 #include <atomic>
 #include <thread>
 
 #include "gpio.hpp"
+#include "interfaces.hpp"
 
 #define CTL_SIG_PIN 29
 #define STR_IN_PIN 6
 
 
-class Keyence
+class Keyence : public StripeCounter
 {
   public:
     Keyence(GpioPinNumber config_pin_num, GpioPinNumber output_pin_num);
     ~Keyence();
-    void calibrate();
-    void start();
-    void stop();
-    bool has_new_stripe();
-    int get_count();
-    double get_distance();
+    void calibrate() override;
+    void start() override;
+    void stop() override;
+    bool has_new_stripe() override;
+    int get_count() override;
+    double get_distance() override;
   
   private:
     void count_stripes();
@@ -29,3 +33,5 @@ class Keyence
     std::atomic_bool stop_flag;
     std::thread counting_thread;
 };
+
+#endif // HYPED_DRIVERS_KEYENCE_HPP_
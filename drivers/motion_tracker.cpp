@@ -1,117 +1,218 @@
 #include "motion_tracker.hpp"
-#include <chrono>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
-#include <Eigen/Dense>
-#include <Eigen/SVD>
+#include <exception>
 
+#include "instrumentation.hpp"
 
-inline double timestamp()
+
+
+MotionTracker::MotionTracker(NavMode mode, const MotionTrackerParameters& parameters)
+    : MotionTracker((StripeCounter*) nullptr, mode, parameters, Clock::get())
 {
-  using namespace std::chrono;
-  return duration_cast<nanoseconds>
-    (steady_clock::now().time_since_epoch()).count() / 1.0e+9;
+  this->keyence.reset(new Keyence(CONFIG_PIN, OUTPUT_PIN));
+  this->stripe_counter = this->keyence.get();
 }
 
+MotionTracker::MotionTracker(StripeCounter& stripe_counter, NavMode mode,
+    const MotionTrackerParameters& parameters, Clock& clock)
+    : MotionTracker(&stripe_counter, mode, parameters, clock)
+{}
 
-
-MotionTracker::MotionTracker()
-    : keyence(CONFIG_PIN, OUTPUT_PIN),
+MotionTracker::MotionTracker(StripeCounter* stripe_counter, NavMode mode,
+    const MotionTrackerParameters& parameters, Clock& clock)
+    : mode(mode),
+    parameters(parameters),
+    stripe_counter(stripe_counter),
+    clock(clock),
+    scheduler(SCHEDULER_TICK_RATE),
+    accl_fusion(parameters.accl_noise_floor),
+    gyro_fusion(parameters.gyro_noise_floor),
     time(0),
     angular_velocity(Vector3D<double>()),
     rotor(Quaternion(1, 0, 0, 0)),
     acceleration(Vector3D<double>()),
     velocity(Vector3D<double>()),
-    displacement(Vector3D<double>())
-{}
+    displacement(Vector3D<double>()),
+    count(0),
+    missed_readings(0),
+    failed_sensors(0)
+{
+  this->attitude.set_brake_separation(parameters.brake_separation);
+}
 
 MotionTracker::~MotionTracker()
 {
   this->stop();
 }
 
-void MotionTracker::add_accelerometer(Accelerometer &a)
+bool MotionTracker::add_accelerometer(Accelerometer &a, double rate)
 {
+  if (this->accelerometers.size() + this->imus.size() >= MAX_FUSED_SENSORS)
+    return false;
   this->accelerometers.push_back(a);
+  this->accelerometer_rates.push_back(rate);
+  return true;
 }
 
-void MotionTracker::add_gyroscope(Gyroscope &g)
+bool MotionTracker::add_gyroscope(Gyroscope &g, double rate)
 {
+  if (this->gyroscopes.size() + this->imus.size() >= MAX_FUSED_SENSORS)
+    return false;
   this->gyroscopes.push_back(g);
+  this->gyroscope_rates.push_back(rate);
+  return true;
 }
 
-void MotionTracker::add_imu(Imu &imu)
+bool MotionTracker::add_imu(Imu &imu, double accl_rate, double gyro_rate)
 {
+  if (this->accelerometers.size() + this->imus.size() >= MAX_FUSED_SENSORS
+      || this->gyroscopes.size() + this->imus.size() >= MAX_FUSED_SENSORS)
+    return false;
   this->imus.push_back(imu);
+  this->imu_accl_rates.push_back(accl_rate);
+  this->imu_gyro_rates.push_back(gyro_rate);
+  return true;
+}
+
+bool MotionTracker::add_ground_proxi(Proxi& sensor, Vector3D<double> position, double rate)
+{
+  if (!this->add_ground_proxi(this->single_proxis, this->single_proxis.size(), position, rate))
+    return false;
+  this->single_proxis.add_proxi(sensor);
+  return true;
+}
+
+bool MotionTracker::add_brake_proxis(Proxi& front, Proxi& rear, RailSide side)
+{
+  int n = this->single_proxis.size();
+  if (!this->add_brake_proxis(this->single_proxis, n, n + 1, side))
+    return false;
+  this->single_proxis.add_proxi(front);
+  this->single_proxis.add_proxi(rear);
+  return true;
 }
 
-void MotionTracker::add_ground_proxi(Proxi& sensor, Vector3D<double> position)
+bool MotionTracker::add_ground_proxi(ProxiGroup& group, int index, Vector3D<double> position,
+    double rate)
 {
+  this->proxi_rate = std::max(this->proxi_rate, rate);
   for (unsigned int i = 0; i < this->ground_proxi_positions.size(); ++i)
     if (this->ground_proxi_positions[i] == position)
     {
-      this->ground_proxis[i].push_back(sensor);
-      return;
+      this->ground_proxis[i].push_back(this->get_proxi_slot(group, index));
+      return true;
     }
+  if (this->attitude.add_ground_position(position) < 0)
+    return false;
   this->ground_proxi_positions.push_back(position);
   this->ground_proxis.emplace_back(); //add new vector
-  this->ground_proxis.back().push_back(sensor);
+  this->ground_proxis.back().push_back(this->get_proxi_slot(group, index));
+  return true;
 }
 
-void MotionTracker::add_brake_proxis(Proxi& front, Proxi& rear, RailSide side)
+bool MotionTracker::add_brake_proxis(ProxiGroup& group, int front, int rear, RailSide side)
 {
-  if (side == RailSide::left)
-    this->brakes.emplace_back(front, rear);
-  else if (side == RailSide::right)
-    this->brakes.emplace_back(rear, front);
+  if (this->attitude.add_brake() < 0)
+    return false;
+  BrakingSki ski;
+  ski.front = this->get_proxi_slot(group, side == RailSide::left ? front : rear);
+  ski.rear = this->get_proxi_slot(group, side == RailSide::left ? rear : front);
+  this->brakes.push_back(ski);
+  return true;
+}
+
+ProxiSlot MotionTracker::get_proxi_slot(ProxiGroup& group, int index)
+{
+  ProxiSlot slot;
+  slot.index = index;
+  for (slot.group = 0; slot.group < (int) this->proxi_groups.size(); ++slot.group)
+    if (this->proxi_groups[slot.group] == &group)
+      return slot;
+  this->proxi_groups.push_back(&group);
+  this->proxi_readings.emplace_back();
+  return slot;
 }
 
 bool MotionTracker::start()
 {
-  this->keyence.calibrate();
+  return this->start(std::string());
+}
+
+bool MotionTracker::start(const std::string& calibration_file, double max_age)
+{
   //TODO: check not already started
   //TODO: check enough sensors configured
 
-  const int n = 10000;
-  //Calibrate gyros
-  for (Gyroscope &g : this->gyroscopes)
-    g.calibrate_gyro(n);
-  for (Imu &imu : this->imus)
-    imu.calibrate_gyro(n);
-  // Calibrate accelerometers
-  this->accelerometer_offsets =
-      new Vector3D<double>[this->accelerometers.size()];
-  this->imu_accl_offsets = new Vector3D<double>[this->imus.size()];
-  for (unsigned int i = 0; i < n; ++i)
+  // Keyence calibration is just a wait, so it runs alongside the sensor calibration
+  std::thread keyence_calibration(&StripeCounter::calibrate, this->stripe_counter);
+  try
   {
-    for (unsigned int j = 0; j < this->accelerometers.size(); ++j)
-      this->accelerometer_offsets[j] +=
-          this->accelerometers[j].get().get_acceleration();
-    for (unsigned int j = 0; j < this->imus.size(); ++j)
-      this->imu_accl_offsets[j] += this->imus[j].get().get_acceleration();
+    if (calibration_file.empty()
+        || !Calibration::load(calibration_file, max_age, this->accelerometers.size(),
+            this->gyroscopes.size(), this->imus.size(), this->calibration))
+    {
+      this->calibration = Calibration::measure(this->accelerometers, this->gyroscopes,
+          this->imus, this->parameters.calibration_samples);
+      if (!calibration_file.empty() && !this->calibration.save(calibration_file))
+        printf("Could not save calibration to %s\n", calibration_file.c_str());
+    }
   }
-  for (unsigned int i = 0; i < this->accelerometers.size(); ++i)
-    this->accelerometer_offsets[i] /= (double) n;
-  for (unsigned int i = 0; i < this->imus.size(); ++i)
-    this->imu_accl_offsets[i] /= (double) n;
+  catch (...)
+  {
+    keyence_calibration.join();
+    throw;
+  }
+  keyence_calibration.join();
+  this->published_calibration.store(this->calibration);
 
-  this->start_time = timestamp();
+  this->start_time = this->clock.now();
+  this->moving_time = this->start_time;
   this->stop_flag = false;
   this->tracking_thread = std::thread(&MotionTracker::track, this);
 
-  this->keyence.start();
+  this->stripe_counter->start();
 
   return true;
 }
 
+bool MotionTracker::start_stepped()
+{
+  this->stripe_counter->calibrate();
+  this->calibration = Calibration::measure(this->accelerometers, this->gyroscopes, this->imus,
+      this->parameters.calibration_samples, false);
+  this->published_calibration.store(this->calibration);
+
+  this->start_time = this->clock.now();
+  this->moving_time = this->start_time;
+  this->begin_tracking();
+  this->stripe_counter->start();
+  return true;
+}
+
+double MotionTracker::step()
+{
+  double next = this->scheduler.run_due(this->clock.now());
+  this->publish();
+  return next;
+}
+
 void MotionTracker::stop()
 {
   this->stop_flag = true;
-  this->tracking_thread.join();
-  delete[] this->accelerometer_offsets;
-  this->accelerometer_offsets = nullptr;
-  delete[] this->imu_accl_offsets;
-  this->imu_accl_offsets = nullptr;
+  if (this->tracking_thread.joinable())
+    this->tracking_thread.join();
+}
+
+bool MotionTracker::save_calibration(const std::string& calibration_file)
+{
+  return this->published_calibration.load().save(calibration_file);
+}
+
+Calibration MotionTracker::get_calibration()
+{
+  return this->published_calibration.load();
 }
 
 double MotionTracker::get_time()
@@ -149,159 +250,458 @@ int MotionTracker::get_stripe_count()
   return this->count.load(std::memory_order_relaxed);
 }
 
+NavEkf::Covariance MotionTracker::get_covariance()
+{
+  std::array<double, NAV_EKF_STATE_SIZE * NAV_EKF_STATE_SIZE> p = this->covariance.load();
+  return Eigen::Map<NavEkf::Covariance>(p.data());
+}
+
+bool MotionTracker::set_recorder(FlightRecorder& recorder)
+{
+  if (this->recorder_stream || recorder.is_running())
+    return false;
+  std::vector<std::string> xyz = {"x", "y", "z"};
+  this->accl_channels.clear();
+  for (unsigned int i = 0; i < this->accelerometers.size() + this->imus.size(); ++i)
+    this->accl_channels.push_back(recorder.add_channel("accl" + std::to_string(i), xyz));
+  this->gyro_channels.clear();
+  for (unsigned int i = 0; i < this->gyroscopes.size() + this->imus.size(); ++i)
+    this->gyro_channels.push_back(recorder.add_channel("gyro" + std::to_string(i), xyz));
+  std::vector<std::string> proxi_fields;
+  for (int i = 0; i < this->attitude.get_ground_count(); ++i)
+    proxi_fields.push_back("ground" + std::to_string(i));
+  for (int i = 0; i < this->attitude.get_brake_count(); ++i)
+  {
+    proxi_fields.push_back("brake_front" + std::to_string(i));
+    proxi_fields.push_back("brake_rear" + std::to_string(i));
+  }
+  this->proxi_channel = proxi_fields.empty() ? -1 : recorder.add_channel("proxis", proxi_fields);
+  this->stripe_channel = recorder.add_channel("stripes", {"count", "distance"});
+  this->nav_channel = recorder.add_channel("nav", {"angv_x", "angv_y", "angv_z",
+      "rotor_w", "rotor_x", "rotor_y", "rotor_z", "accl_x", "accl_y", "accl_z",
+      "vel_x", "vel_y", "vel_z", "disp_x", "disp_y", "disp_z"});
+  this->recorder_stream = recorder.add_stream();
+  return this->recorder_stream != nullptr;
+}
+
+unsigned long MotionTracker::get_missed_readings()
+{
+  return this->missed_readings.load(std::memory_order_relaxed);
+}
+
+int MotionTracker::get_failed_sensors()
+{
+  return this->failed_sensors.load(std::memory_order_relaxed);
+}
+
+
+double MotionTracker::begin_tracking()
+{
+  // Until their first reading, sensors are assumed to read what they read during calibration,
+  // which with their offsets removed is nothing
+  this->accl_fusion = SensorFusion(this->parameters.accl_noise_floor);
+  for (unsigned int i = 0; i < this->accelerometers.size() + this->imus.size(); ++i)
+    this->accl_fusion.add_sensor();
+  this->accl_fusion.reset(Vector3D<double>());
+  this->gyro_fusion = SensorFusion(this->parameters.gyro_noise_floor);
+  for (unsigned int i = 0; i < this->gyroscopes.size() + this->imus.size(); ++i)
+    this->gyro_fusion.add_sensor();
+  this->gyro_fusion.reset(Vector3D<double>());
+  double t = this->clock.now();
+  this->gyro_time = t;
+  this->rotor_estimate = Quaternion(1, 0, 0, 0);
+  this->accl0 = DataPoint<Vector3D<double>>(t, Vector3D<double>());
+  this->velocity0 = DataPoint<Vector3D<double>>(t, Vector3D<double>());
+  this->dist = Vector3D<double>();
+  this->kdist0 = DataPoint<double>(t, this->stripe_counter->get_distance());
+  // Calibration offsets are the specific force at rest, i.e. gravity with the sign flipped.
+  // The EKF then estimates biases itself, so the calibration isn't refined online in that mode
+  this->ekf.reset(t, -this->calibration.get_rest_accl());
+
+  this->scheduler.clear();
+  this->schedule_sensors();
+  this->scheduler.start(t);
+  return t;
+}
 
 void MotionTracker::track()
 {
-  Vector3D<double> avg_accl_offset;
-  for (unsigned int i = 0; i < this->accelerometers.size(); ++i)
-    avg_accl_offset += this->accelerometer_offsets[i];
-  for (unsigned int i = 0; i < this->imus.size(); ++i)
-    avg_accl_offset += this->imu_accl_offsets[i];
-  avg_accl_offset /= (double) (this->accelerometers.size() + this->imus.size());
-
-  Quaternion rotor(1, 0, 0, 0);
-  Vector3D<double> dist(0.0, 0.0, 0.0);
-  DataPoint<Vector3D<double>> velocity, new_velocity;
-  DataPoint<Vector3D<double>> accl0, accl, angv0, angv;
-  DataPoint<double> kdist0, kdist;
-  this->get_imu_data_points(accl0, angv0);
-  accl0.value -= avg_accl_offset;
-  velocity.timestamp = accl0.timestamp;
-  double t0 = accl0.timestamp;
-  kdist0.value = this->keyence.get_distance();
-  kdist0.timestamp = t0;
+  static LatencyHistogram& iteration_time =
+      Instrumentation::get_histogram("motion_tracker.iteration");
+  static LatencyHistogram& wake_latency =
+      Instrumentation::get_histogram("motion_tracker.wake_latency");
+  double next = this->begin_tracking();
   while(!this->stop_flag)
   {
-    this->get_imu_data_points(accl, angv);
-    
-    // Update R(t)
-    double l = Quaternion::norm(angv0.value);
-    double theta = (angv.timestamp - angv0.timestamp) * l / 2.0;
-    rotor = cos(theta) * rotor + sin(theta) * rotor * angv0.value / l;
-    
-    // Rotate acceleration
-    accl.value = rotor * accl.value * Quaternion::inv(rotor) - avg_accl_offset;
-    // Update velocity and displacement
-    new_velocity = DataPoint<Vector3D<double>>::integrate(accl0, accl);
-    new_velocity.value += velocity.value;
-    dist +=
-        DataPoint<Vector3D<double>>::integrate(velocity, new_velocity).value;
-    velocity = new_velocity;
-    this->time.store(accl.timestamp - this->start_time, std::memory_order_relaxed);
-    this->angular_velocity.store(angv.value, std::memory_order_relaxed);
-    this->rotor.store(rotor, std::memory_order_relaxed);
-    this->acceleration.store(accl.value, std::memory_order_relaxed);
-    this->velocity.store(velocity.value, std::memory_order_relaxed);
-    this->displacement.store(dist, std::memory_order_relaxed);
-    accl0 = accl;
-    angv0 = angv;
-
-    // MPU6050 does 8 gyro readings per 1 acceleration reading (now hardcoded, in the future might add support for arbitrary ratios)
-    for (int i = 0; i < 7; ++i)
+    double now = this->clock.now();
+    // How late the loop woke up for the earliest due task
+    if (this->parameters.timed)
+      wake_latency.record(now > next ? (uint64_t) ((now - next) * 1.0e+9) : 0);
     {
-      // Update R(t)
-      get_gyro_data_point(angv);
-      l = Quaternion::norm(angv0.value);
-      theta = (angv.timestamp - angv0.timestamp) * l / 2.0;
-      rotor = cos(theta) * rotor + sin(theta) * rotor * angv0.value / l;
-      angv0 = angv;
+      ScopedTimer timer(this->timing(iteration_time));
+      next = this->scheduler.run_due(now);
+      this->publish();
     }
+    this->clock.sleep_until(next);
+  }
+}
 
-    /*if (angv0.timestamp - t0 > 0.01 && this->ground_proxis.size() >= 3)
-    {
-      rotor *= Quaternion::pow(Quaternion::inv(rotor) * this->get_proxi_rotor(),
-          PROXI_WEIGHT);
-      t0 = angv0.timestamp;
-    }//*/
-    if (this->keyence.has_new_stripe())
+void MotionTracker::schedule_sensors()
+{
+  unsigned int num_accelerometers = this->accelerometers.size();
+  unsigned int num_gyroscopes = this->gyroscopes.size();
+  static LatencyHistogram& accl_time = Instrumentation::get_histogram("sensor.accl");
+  static LatencyHistogram& gyro_time = Instrumentation::get_histogram("sensor.gyro");
+  static LatencyHistogram& imu_time = Instrumentation::get_histogram("sensor.imu");
+  for (unsigned int i = 0; i < num_accelerometers; ++i)
+    this->scheduler.add(this->accelerometer_rates[i], [this, i]() {
+      double t0 = this->clock.now();
+      if (!this->accl_fusion.can_read(i, t0))
+        return;
+      Vector3D<double> accl;
+      try
+      {
+        ScopedTimer timer(this->timing(accl_time));
+        accl = this->accelerometers[i].get().get_acceleration();
+      }
+      catch (NoNewReadingException& e)
+      {
+        return;
+      }
+      catch (std::exception& e)
+      {
+        this->accl_fusion.set_failed(i, t0);
+        return;
+      }
+      this->on_accl_reading(i, (t0 + this->clock.now()) / 2.0, accl);
+    });
+  for (unsigned int i = 0; i < num_gyroscopes; ++i)
+    this->scheduler.add(this->gyroscope_rates[i], [this, i]() {
+      double t0 = this->clock.now();
+      if (!this->gyro_fusion.can_read(i, t0))
+        return;
+      Vector3D<double> angv;
+      try
+      {
+        ScopedTimer timer(this->timing(gyro_time));
+        angv = this->gyroscopes[i].get().get_angular_velocity();
+      }
+      catch (NoNewReadingException& e)
+      {
+        return;
+      }
+      catch (std::exception& e)
+      {
+        this->gyro_fusion.set_failed(i, t0);
+        return;
+      }
+      this->on_gyro_reading(i, (t0 + this->clock.now()) / 2.0, angv);
+    });
+  for (unsigned int i = 0; i < this->imus.size(); ++i)
+  {
+    // One task per IMU so that a full reading replaces a gyro reading rather than adding to it
+    double rate = std::max(this->imu_gyro_rates[i], this->imu_accl_rates[i]);
+    long ratio = std::max(1L, std::lround(rate / this->imu_accl_rates[i]));
+    long n = 0;
+    unsigned int a = num_accelerometers + i, g = num_gyroscopes + i;
+    this->scheduler.add(rate, [this, i, a, g, ratio, n]() mutable {
+      double t0 = this->clock.now();
+      if (!this->gyro_fusion.can_read(g, t0))
+        return;
+      bool full = n++ % ratio == 0;
+      ImuData data {Vector3D<double>(), Vector3D<double>()};
+      try
+      {
+        ScopedTimer timer(this->timing(full ? imu_time : gyro_time));
+        if (full)
+          data = this->imus[i].get().get_imu_data();
+        else
+          data.angular_velocity = this->imus[i].get().get_angular_velocity();
+      }
+      catch (NoNewReadingException& e)
+      {
+        return;
+      }
+      catch (std::exception& e)
+      {
+        this->accl_fusion.set_failed(a, t0);
+        this->gyro_fusion.set_failed(g, t0);
+        return;
+      }
+      double t = (t0 + this->clock.now()) / 2.0;
+      this->on_gyro_reading(g, t, data.angular_velocity);
+      if (full)
+        this->on_accl_reading(a, t, data.acceleration);
+    });
+  }
+  if (this->attitude.get_ground_count() >= 3)
+    this->scheduler.add(this->proxi_rate, [this]() {
+      this->on_proxi_readings(this->clock.now());
+    });
+  this->scheduler.add(KEYENCE_POLL_RATE, [this]() {
+    this->on_stripe(this->clock.now());
+  });
+}
+
+// `rotor` turned at angular velocity `angv` for `dt` (if positive)
+static Quaternion rotate(const Quaternion& rotor, Vector3D<double> angv, double dt)
+{
+  double l = Quaternion::norm(angv);
+  double theta = dt * l / 2.0;
+  if (l > 0.0 && theta > 0.0)
+    return cos(theta) * rotor + sin(theta) * rotor * angv / l;
+  return rotor;
+}
+
+void MotionTracker::advance(double t)
+{
+  Vector3D<double> angv = this->get_fused_angv();
+  if (this->mode == NavMode::ekf)
+  {
+    this->ekf.predict(t, this->get_fused_accl(), angv);
+    return;
+  }
+  // Update R(t)
+  this->rotor_estimate = rotate(this->rotor_estimate, angv, t - this->gyro_time);
+  this->gyro_time = std::max(this->gyro_time, t);
+}
+
+void MotionTracker::on_accl_reading(unsigned int index, double t, Vector3D<double> accl)
+{
+  if (this->recorder_stream)
+    this->recorder_stream->record(this->accl_channels[index], t - this->start_time, accl);
+  this->advance(t);
+  // Each sensor's own offset comes off before fusing, so that sensors with different biases
+  // agree and leaving one out doesn't move the estimate
+  Vector3D<double> residual = accl - this->calibration.accl_offset[index];
+  this->accl_fusion.set_reading(index, residual);
+  if (this->mode == NavMode::ekf)
+    return;
+
+  // Rotate acceleration
+  DataPoint<Vector3D<double>> a(t, this->rotor_estimate * this->get_fused_accl()
+      * Quaternion::inv(this->rotor_estimate) - this->calibration.get_rest_accl());
+  // Update velocity and displacement
+  DataPoint<Vector3D<double>> new_velocity = DataPoint<Vector3D<double>>::integrate(this->accl0, a);
+  new_velocity.value += this->velocity0.value;
+  this->dist += DataPoint<Vector3D<double>>::integrate(this->velocity0, new_velocity).value;
+  this->velocity0 = new_velocity;
+  this->accl0 = a;
+  if (this->is_still(t, a.value, this->get_fused_angv()))
+  {
+    this->calibration.refine_accl(index, residual, this->parameters.bias_refine_gain);
+    this->published_calibration.store(this->calibration);
+  }
+}
+
+void MotionTracker::on_gyro_reading(unsigned int index, double t, Vector3D<double> angv)
+{
+  if (this->recorder_stream)
+    this->recorder_stream->record(this->gyro_channels[index], t - this->start_time, angv);
+  this->advance(t);
+  Vector3D<double> residual = angv - this->calibration.gyro_bias[index];
+  this->gyro_fusion.set_reading(index, residual);
+  if (this->mode != NavMode::ekf && this->is_still(t, this->accl0.value, this->get_fused_angv()))
+  {
+    this->calibration.refine_gyro(index, residual, this->parameters.bias_refine_gain);
+    this->published_calibration.store(this->calibration);
+  }
+}
+
+void MotionTracker::on_proxi_readings(double t)
+{
+  double ground[MAX_GROUND_PROXI_POSITIONS];
+  double brake_front[MAX_BRAKING_SKIS], brake_rear[MAX_BRAKING_SKIS];
+  Quaternion proxi_rotor;
+  double measured, fresh;
+  {
+    static LatencyHistogram& proxis_time = Instrumentation::get_histogram("sensor.proxis");
+    ScopedTimer timer(this->timing(proxis_time));
+    fresh = this->sample_proxis(t, ground, brake_front, brake_rear, measured);
+  }
+  if (fresh <= 0.0)
+    return; // nothing new to go on
+  if (this->recorder_stream)
+  {
+    double values[MAX_GROUND_PROXI_POSITIONS + 2 * MAX_BRAKING_SKIS];
+    int n = 0;
+    for (int i = 0; i < this->attitude.get_ground_count(); ++i)
+      values[n++] = ground[i];
+    for (int i = 0; i < this->attitude.get_brake_count(); ++i)
     {
-      this->count.store(this->keyence.get_count(), std::memory_order_relaxed);
-      kdist.value = this->keyence.get_distance();
-      kdist.timestamp = timestamp();
-      rotor = Quaternion(1, 0, 0, 0);
-      velocity.value.x = (kdist.value - kdist0.value) /
-          (kdist.timestamp - kdist0.timestamp);
-      dist.x = kdist.value;
-      kdist0 = kdist;
+      values[n++] = brake_front[i];
+      values[n++] = brake_rear[i];
     }
+    this->recorder_stream->record(this->proxi_channel, t - this->start_time, values);
+  }
+  if (!this->attitude.get_rotor(ground, brake_front, brake_rear, proxi_rotor))
+    return;
+  this->advance(t);
+  // Readings taken earlier (e.g. on a slave, see NetworkProxi) are brought up to date with the
+  // gyroscopes rather than taken as the attitude now
+  proxi_rotor = rotate(proxi_rotor, this->get_fused_angv(), t - measured);
+  if (this->mode == NavMode::ekf)
+  {
+    this->ekf.update_attitude(proxi_rotor);
+    return;
+  }
+  Quaternion delta = Quaternion::inv(this->rotor_estimate) * proxi_rotor;
+  if (delta.scal < 0.0)
+    delta = -delta; // same rotation, but interpolate the short way round
+  // The fewer proxis were read this time, the less the gyroscopes are corrected by them
+  this->rotor_estimate *= Quaternion::pow(delta, (1.0 - this->parameters.gyro_weight) * fresh);
+}
+
+void MotionTracker::on_stripe(double t)
+{
+  if (!this->stripe_counter->has_new_stripe())
+    return;
+  this->count.store(this->stripe_counter->get_count(), std::memory_order_relaxed);
+  if (this->recorder_stream)
+  {
+    double values[2] = {(double) this->stripe_counter->get_count(),
+        this->stripe_counter->get_distance()};
+    this->recorder_stream->record(this->stripe_channel, t - this->start_time, values);
   }
+  this->advance(t);
+  this->moving_time = t;
+  if (this->mode == NavMode::ekf)
+  {
+    this->ekf.update_stripe(this->stripe_counter->get_distance());
+    return;
+  }
+  DataPoint<double> kdist(t, this->stripe_counter->get_distance());
+  this->rotor_estimate = Quaternion(1, 0, 0, 0);
+  this->velocity0.value.x = (kdist.value - this->kdist0.value) /
+      (kdist.timestamp - this->kdist0.timestamp);
+  this->dist.x = kdist.value;
+  this->kdist0 = kdist;
 }
 
-Quaternion MotionTracker::get_proxi_rotor()
+void MotionTracker::publish()
 {
-  Eigen::Matrix<double, 3, Eigen::Dynamic> m(3, this->ground_proxis.size());
+  this->missed_readings.store(this->scheduler.get_missed_count(), std::memory_order_relaxed);
+  // An IMU's accelerometer and gyroscope fail together
+  int failed = this->gyro_fusion.get_failed_count();
+  for (unsigned int i = 0; i < this->accelerometers.size(); ++i)
+    failed += !this->accl_fusion.is_online(i);
+  this->failed_sensors.store(failed, std::memory_order_relaxed);
+
+  double t;
+  Vector3D<double> angv, accl, vel, disp;
+  Quaternion q;
+  if (this->mode == NavMode::ekf)
+  {
+    NavState state = this->ekf.get_state();
+    t = state.timestamp - this->start_time;
+    angv = this->get_fused_angv() - state.gyro_bias;
+    q = state.rotor;
+    accl = state.acceleration;
+    vel = state.velocity;
+    disp = state.position;
+    std::array<double, NAV_EKF_STATE_SIZE * NAV_EKF_STATE_SIZE> p;
+    Eigen::Map<NavEkf::Covariance>(p.data()) = this->ekf.get_covariance();
+    this->covariance.store(p);
+  }
+  else
+  {
+    t = this->gyro_time - this->start_time;
+    angv = this->get_fused_angv();
+    q = this->rotor_estimate;
+    accl = this->accl0.value;
+    vel = this->velocity0.value;
+    disp = this->dist;
+  }
+  this->time.store(t, std::memory_order_relaxed);
+  this->angular_velocity.store(angv, std::memory_order_relaxed);
+  this->rotor.store(q, std::memory_order_relaxed);
+  this->acceleration.store(accl, std::memory_order_relaxed);
+  this->velocity.store(vel, std::memory_order_relaxed);
+  this->displacement.store(disp, std::memory_order_relaxed);
+  if (this->recorder_stream)
+  {
+    double nav[16] = {angv.x, angv.y, angv.z, q.scal, q.vect.x, q.vect.y, q.vect.z,
+        accl.x, accl.y, accl.z, vel.x, vel.y, vel.z, disp.x, disp.y, disp.z};
+    this->recorder_stream->record(this->nav_channel, t, nav);
+  }
+}
+
+Vector3D<double> MotionTracker::get_fused_accl()
+{
+  return this->accl_fusion.get_value() + this->calibration.get_rest_accl();
+}
+
+Vector3D<double> MotionTracker::get_fused_angv()
+{
+  return this->gyro_fusion.get_value();
+}
+
+bool MotionTracker::is_still(double t, Vector3D<double> accl, Vector3D<double> angv)
+{
+  // Only refine once the pod has been still for a while, so slow motion isn't learnt as bias
+  if (Quaternion::norm(angv) > STATIONARY_ANGV || Quaternion::norm(accl) > STATIONARY_ACCL)
+    this->moving_time = t;
+  return t - this->moving_time >= STATIONARY_TIME;
+}
+
+// Distance of a reading, adding when it was measured to `time_sum` (`t` if it can't tell)
+static int timed_distance(const ProxiReading& reading, double t, double& time_sum)
+{
+  time_sum += reading.timestamp >= 0.0 ? reading.timestamp : t;
+  return reading.distance;
+}
+
+double MotionTracker::sample_proxis(double t, double *ground, double *brake_front,
+    double *brake_rear, double& measured)
+{
+  // One call per group
+  for (unsigned int g = 0; g < this->proxi_groups.size(); ++g)
+  {
+    this->proxi_readings[g].resize(this->proxi_groups[g]->size());
+    this->proxi_groups[g]->get_distances(this->proxi_readings[g].data());
+  }
+  auto reading = [this](ProxiSlot slot) -> const ProxiReading& {
+    return this->proxi_readings[slot.group][slot.index];
+  };
+
+  // Proxis which couldn't be read repeat their last reading; it's only used where there's
+  // nothing fresher, and doesn't count towards when the readings were taken
+  double time_sum = 0.0;
+  int n = 0, fresh = 0;
   for (unsigned int i = 0; i < this->ground_proxis.size(); ++i)
   {
-    double avg_dist = 0.0;
-    for (Proxi& p : this->ground_proxis[i])
-      avg_dist += p.get_distance();
-    avg_dist /= this->ground_proxis[i].size();
-    m.col(i) << this->ground_proxi_positions[i].x,
-                this->ground_proxi_positions[i].y,
-                this->ground_proxi_positions[i].z + avg_dist;
+    double fresh_dist = 0.0, stale_dist = 0.0;
+    int fresh_here = 0;
+    for (ProxiSlot p : this->ground_proxis[i])
+    {
+      if (reading(p).fresh)
+      {
+        fresh_dist += timed_distance(reading(p), t, time_sum);
+        ++fresh_here;
+      }
+      else
+        stale_dist += reading(p).distance;
+    }
+    n += this->ground_proxis[i].size();
+    fresh += fresh_here;
+    ground[i] = fresh_here > 0 ? fresh_dist / fresh_here
+        : stale_dist / this->ground_proxis[i].size();
   }
-  Eigen::JacobiSVD<Eigen::MatrixXd> svd(m, Eigen::ComputeThinU);
-  // Normal vector of the best-fit plane:
-  Eigen::Vector3d n = svd.matrixU().col(svd.matrixU().cols() - 1);
-  if (n(2) < 0.0)
-    n = -n;
-  double angle = acos(n(2) / n.norm());
-  Vector3D<double> axis(n(1), -n(0), 0); //cross product of n and (0, 0, 1)
-  double l = Quaternion::norm(axis);
-  Quaternion r1(cos(angle/2.0), sin(angle/2.0) * ((l == 0.0) ? axis : axis / l));
-  
-  angle = 0.0;
+  double stale_time = 0.0;
   for (unsigned int i = 0; i < this->brakes.size(); ++i)
-    angle += atan((double) (this->brakes[i].front->get_distance()
-          - this->brakes[i].rear->get_distance()) / BRAKE_PROXI_SEPARATION);
-  angle /= this->brakes.size();
-  Quaternion r2(cos(angle/2.0), Vector3D<double>(0, 0, sin(angle/2.0)));
-
-  return r2*r1;
-}
-
-void MotionTracker::get_imu_data_points(
-    DataPoint<Vector3D<double>> &accl_dp,
-    DataPoint<Vector3D<double>> &angv_dp)
-{
-  accl_dp.value.x = 0.0;
-  accl_dp.value.y = 0.0;
-  accl_dp.value.z = 0.0;
-  angv_dp.value.x = 0.0;
-  angv_dp.value.y = 0.0;
-  angv_dp.value.z = 0.0;
-  accl_dp.timestamp = timestamp();
-  for (Accelerometer &a : this->accelerometers)
-    accl_dp.value += a.get_acceleration();
-  angv_dp.timestamp = timestamp();
-  for (Imu &imu : this->imus)
   {
-    ImuData data = imu.get_imu_data();
-    accl_dp.value += data.acceleration;
-    angv_dp.value += data.angular_velocity;
+    const ProxiReading& front = reading(this->brakes[i].front);
+    const ProxiReading& rear = reading(this->brakes[i].rear);
+    brake_front[i] = timed_distance(front, t, front.fresh ? time_sum : stale_time);
+    brake_rear[i] = timed_distance(rear, t, rear.fresh ? time_sum : stale_time);
+    fresh += front.fresh + rear.fresh;
+    n += 2;
   }
-  double t = timestamp();
-  for (Gyroscope &g : this->gyroscopes)
-    angv_dp.value += g.get_angular_velocity();
-  angv_dp.timestamp += timestamp();
-  angv_dp.timestamp /= 2.0;
-  accl_dp.timestamp = (accl_dp.timestamp + t) / 2.0;
-  accl_dp.value /= (double) (this->accelerometers.size() + this->imus.size());
-  angv_dp.value /= (double) (this->gyroscopes.size() + this->imus.size());
-}
-
-void MotionTracker::get_gyro_data_point(DataPoint<Vector3D<double>> &angv_dp)
-{
-  angv_dp.value.x = 0.0;
-  angv_dp.value.y = 0.0;
-  angv_dp.value.z = 0.0;
-  angv_dp.timestamp = timestamp();
-  for (Gyroscope &g : this->gyroscopes)
-    angv_dp.value += g.get_angular_velocity();
-  for (Imu &imu : this->imus)
-    angv_dp.value += imu.get_angular_velocity();
-  angv_dp.timestamp += timestamp();
-  angv_dp.timestamp /= 2.0;
-  angv_dp.value /= (double) (this->gyroscopes.size() + this->imus.size());
+  measured = fresh > 0 ? time_sum / fresh : t;
+  return n > 0 ? (double) fresh / n : 0.0;
 }
 
+LatencyHistogram* MotionTracker::timing(LatencyHistogram& histogram)
+{
+  return this->parameters.timed ? &histogram : nullptr;
+}
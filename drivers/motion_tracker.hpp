@@ -4,48 +4,140 @@
 #include <array>
 #include <atomic>
 #include <functional>
+#include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "calibration.hpp"
+#include "clock.hpp"
 #include "data_point.hpp"
+#include "flight_recorder.hpp"
 #include "gpio.hpp"
+#include "instrumentation.hpp"
 #include "interfaces.hpp"
 #include "keyence.hpp"
+#include "nav_ekf.hpp"
+#include "proxi_attitude.hpp"
+#include "proxi_group.hpp"
 #include "quaternion.hpp"
+#include "sensor_fusion.hpp"
+#include "sensor_scheduler.hpp"
+#include "seqlock.hpp"
 #include "vector3d.hpp"
 
-#define BRAKE_PROXI_SEPARATION 250.0 //mm
+#define MAX_GROUND_PROXI_POSITIONS 8
+#define MAX_BRAKING_SKIS 4
+// Default sampling rates; the MPU6050 defaults keep its usual 8 gyro readings per accelerometer
+// reading
+#define DEFAULT_GYRO_RATE 1000.0 // Hz
+#define DEFAULT_ACCL_RATE 125.0 // Hz
+#define DEFAULT_PROXI_RATE 100.0 // Hz
+#define KEYENCE_POLL_RATE 1000.0 // Hz
+#define SCHEDULER_TICK_RATE 8000.0 // Hz, resolution of the sampling schedule
+// Smallest noise assumed for a single sensor when fusing redundant ones. Each sensor's offset
+// (mounting included) is calibrated out before fusing, so this only covers what changes in
+// motion, e.g. the lever arm of sensors away from the centre of rotation
+#define ACCL_NOISE_FLOOR 0.1 // m/s^2
+#define GYRO_NOISE_FLOOR 0.01 // rad/s
+#define CALIBRATION_SAMPLES 10000
+// Online refinement of the calibration while the pod is still
+#define STATIONARY_ANGV 0.02 // rad/s
+#define STATIONARY_ACCL 0.2 // m/s^2
+#define STATIONARY_TIME 1.0 // s, how long readings must stay below the thresholds
+#define BIAS_REFINE_GAIN 0.001 // per sample
 #define CONFIG_PIN PIN24
 #define OUTPUT_PIN PIN23
 
 const double GYRO_WEIGHT = 0.99;
-const double PROXI_WEIGHT = 1 - GYRO_WEIGHT;
 
-enum class RailSide
+/// complementary: trapezoidal integration, stripes overwrite position/velocity and the attitude
+///   from proxis is blended in by 1 - MotionTrackerParameters::gyro_weight
+/// ekf: NavEkf fusing IMU, stripes and proxis, with covariance available
+enum class NavMode
 {
-  left,
-  right
+  complementary,
+  ekf
+};
+
+/// Tuning of the tracker, defaulting to the constants above
+struct MotionTrackerParameters
+{
+  double gyro_weight = GYRO_WEIGHT;                 // complementary: attitude kept from the gyros
+                                                    // at each proxi update (the rest from proxis)
+  double brake_separation = BRAKE_PROXI_SEPARATION; // mm between a braking ski's proxis
+  int calibration_samples = CALIBRATION_SAMPLES;    // readings averaged per sensor
+  double accl_noise_floor = ACCL_NOISE_FLOOR;       // m/s^2
+  double gyro_noise_floor = GYRO_NOISE_FLOOR;       // rad/s
+  double bias_refine_gain = BIAS_REFINE_GAIN;       // per sample
+  bool timed = true; // time sensor reads and iterations (instrumentation.hpp); the shared
+                     // histograms slow down many trackers running at once
+};
+
+/// A proxi of one of the tracker's proxi groups
+struct ProxiSlot
+{
+  int group;
+  int index;
 };
 
 struct BrakingSki
 {
-  BrakingSki(Proxi& front, Proxi& rear) : front(&front), rear(&rear)
-  {}
-  Proxi *front, *rear;
+  ProxiSlot front, rear;
 };
 
 class MotionTracker
 {
   public:
-    MotionTracker();
+    /// Counts stripes with the Keyence on CONFIG_PIN and OUTPUT_PIN
+    MotionTracker(NavMode mode = NavMode::complementary,
+        const MotionTrackerParameters& parameters = MotionTrackerParameters());
+    /// Counts stripes with `stripe_counter` (e.g. a simulated one) and times everything with
+    /// `clock`
+    MotionTracker(StripeCounter& stripe_counter, NavMode mode = NavMode::complementary,
+        const MotionTrackerParameters& parameters = MotionTrackerParameters(),
+        Clock& clock = Clock::get());
     ~MotionTracker();
 
-    void add_accelerometer(Accelerometer &a);
-    void add_gyroscope(Gyroscope &g);
-    void add_imu(Imu &imu);
-    void add_ground_proxi(Proxi& sensor, Vector3D<double> position);
-    void add_brake_proxis(Proxi& front, Proxi& rear, RailSide side);
+    /// Every sensor is read at its own `rate` (Hz) and readings are fed to the estimator in the
+    /// order they were taken. Redundant sensors are fused by SensorFusion, so a sensor that
+    /// disagrees with the others or fails to read is left out until it recovers (one with no new
+    /// reading, see NoNewReadingException, just isn't read that time). These return false if
+    /// there would be more than MAX_FUSED_SENSORS accelerometers (IMUs included) or gyroscopes
+    bool add_accelerometer(Accelerometer &a, double rate = DEFAULT_ACCL_RATE);
+    bool add_gyroscope(Gyroscope &g, double rate = DEFAULT_GYRO_RATE);
+    /// Gyroscope readings at `gyro_rate`, every so often replaced by a full reading so that
+    /// acceleration is read at about `accl_rate`
+    bool add_imu(Imu &imu, double accl_rate = DEFAULT_ACCL_RATE,
+        double gyro_rate = DEFAULT_GYRO_RATE);
+    /// Proxis at the same position are averaged; the attitude from proxis is updated at the
+    /// highest `rate` of all of them. Returns false if there are already
+    /// MAX_GROUND_PROXI_POSITIONS positions
+    bool add_ground_proxi(Proxi& sensor, Vector3D<double> position,
+        double rate = DEFAULT_PROXI_RATE);
+    /// Returns false if there are already MAX_BRAKING_SKIS pairs
+    bool add_brake_proxis(Proxi& front, Proxi& rear, RailSide side);
+    /// The same for proxis of a group (`index` is the proxi's in the group). Every group is read
+    /// in one call per update, letting it overlap or batch the readings; proxis added on their
+    /// own are read as one ProxiList
+    bool add_ground_proxi(ProxiGroup& group, int index, Vector3D<double> position,
+        double rate = DEFAULT_PROXI_RATE);
+    bool add_brake_proxis(ProxiGroup& group, int front, int rear, RailSide side);
+    /// Calibrates all sensors (in parallel) and starts tracking
     bool start();
+    /// Uses the calibration in `calibration_file` if it is at most `max_age` seconds old and for
+    /// the same sensors, otherwise calibrates and saves the result there
+    bool start(const std::string& calibration_file, double max_age = CALIBRATION_MAX_AGE);
+    /// Calibrates on the calling thread (stripe counter included) and starts tracking without a
+    /// thread of its own: step() does the tracking instead. For running many trackers at once on
+    /// simulated or recorded sensors, each on a clock only its caller moves on
+    bool start_stepped();
+    /// Takes the readings due by the clock's now() and returns when the next ones are due. Only
+    /// for trackers started with start_stepped()
+    double step();
+    /// Saves the current calibration, including what was refined while tracking
+    bool save_calibration(const std::string& calibration_file);
+    Calibration get_calibration();
     void stop();
     double get_time(); // Seconds since integration started
     Vector3D<double> get_angular_velocity();
@@ -54,19 +146,57 @@ class MotionTracker
     Vector3D<double> get_velocity();
     Vector3D<double> get_displacement();
     int get_stripe_count();
+    /// Error-state covariance (see NAV_EKF_* for the layout); only updated in NavMode::ekf
+    NavEkf::Covariance get_covariance();
+    /// Sensor readings skipped because the tracking thread fell behind
+    unsigned long get_missed_readings();
+    /// Records every sensor reading and navigation update (channels accl<n>, gyro<n>, proxis,
+    /// stripes and nav, timestamped like get_time()). Call after adding all sensors and before
+    /// starting the recorder and the tracker
+    bool set_recorder(FlightRecorder& recorder);
+    /// Sensors currently left out after failing to read (an IMU counts once)
+    int get_failed_sensors();
 
   private:
     std::vector<std::reference_wrapper<Accelerometer>> accelerometers;
     std::vector<std::reference_wrapper<Gyroscope>> gyroscopes;
     std::vector<std::reference_wrapper<Imu>> imus;
+    std::vector<double> accelerometer_rates;
+    std::vector<double> gyroscope_rates;
+    std::vector<double> imu_accl_rates;
+    std::vector<double> imu_gyro_rates;
+    double proxi_rate = 0;
     std::vector<Vector3D<double>> ground_proxi_positions;
-    std::vector<std::vector< std::reference_wrapper<Proxi>>> ground_proxis;
+    ProxiList single_proxis;
+    std::vector<ProxiGroup*> proxi_groups;
+    std::vector<std::vector<ProxiReading>> proxi_readings; // of each group, at the last update
+    std::vector<std::vector<ProxiSlot>> ground_proxis;
     std::vector<BrakingSki> brakes;
-    Keyence keyence;
+    NavMode mode;
+    MotionTrackerParameters parameters;
+    NavEkf ekf;
+    ProxiAttitude<MAX_GROUND_PROXI_POSITIONS, MAX_BRAKING_SKIS> attitude;
+    std::unique_ptr<Keyence> keyence; // only if the tracker owns it
+    StripeCounter* stripe_counter;
+    Clock& clock;
     std::atomic_bool stop_flag {true};
     std::thread tracking_thread;
-    Vector3D<double> *accelerometer_offsets = nullptr;
-    Vector3D<double> *imu_accl_offsets = nullptr;
+    Calibration calibration; // only changed by the tracking thread once started
+    SeqLock<Calibration> published_calibration;
+    double moving_time = 0; // last time the pod wasn't still
+    SensorScheduler scheduler;
+
+    // Estimator inputs: latest reading of every sensor with its calibration offset removed, held
+    // until its next reading
+    SensorFusion accl_fusion; // accelerometers, then IMUs
+    SensorFusion gyro_fusion; // gyroscopes, then IMUs
+    // Complementary filter state
+    double gyro_time = 0; // time up to which the rotor has been integrated
+    Quaternion rotor_estimate;
+    DataPoint<Vector3D<double>> accl0;
+    DataPoint<Vector3D<double>> velocity0;
+    Vector3D<double> dist;
+    DataPoint<double> kdist0;
 
     double start_time = 0;
     std::atomic<double> time;
@@ -76,12 +206,44 @@ class MotionTracker
     std::atomic<Vector3D<double>> velocity;
     std::atomic<Vector3D<double>> displacement;
     std::atomic<int> count;
+    std::atomic<unsigned long> missed_readings;
+    std::atomic<int> failed_sensors;
+    SeqLock<std::array<double, NAV_EKF_STATE_SIZE * NAV_EKF_STATE_SIZE>> covariance;
+    RecorderStream* recorder_stream = nullptr;
+    std::vector<int> accl_channels;
+    std::vector<int> gyro_channels;
+    int proxi_channel = -1;
+    int stripe_channel = -1;
+    int nav_channel = -1;
+
+    MotionTracker(StripeCounter* stripe_counter, NavMode mode,
+        const MotionTrackerParameters& parameters, Clock& clock);
 
+    /// Resets the estimate and starts the sensor schedule; returns the time it starts from
+    double begin_tracking();
     void track();
-    Quaternion get_proxi_rotor();
-    void get_imu_data_points(DataPoint<Vector3D<double>> &acceleration,
-        DataPoint<Vector3D<double>> &angular_velocity);
-    void get_gyro_data_point(DataPoint<Vector3D<double>> &angular_velocity);
+    /// `histogram`, or null (nothing timed) unless parameters.timed
+    LatencyHistogram* timing(LatencyHistogram& histogram);
+    void schedule_sensors();
+    /// Brings the estimate up to time `t` with the readings held so far
+    void advance(double t);
+    void on_accl_reading(unsigned int index, double t, Vector3D<double> accl);
+    void on_gyro_reading(unsigned int index, double t, Vector3D<double> angv);
+    void on_proxi_readings(double t);
+    void on_stripe(double t);
+    void publish();
+    Vector3D<double> get_fused_accl(); // each sensor's bias removed, gravity kept
+    Vector3D<double> get_fused_angv(); // each sensor's bias removed
+    /// Whether the pod has been still for STATIONARY_TIME, going by the latest fused readings
+    /// (`accl` with gravity removed); while it is, the calibration is refined online
+    bool is_still(double t, Vector3D<double> accl, Vector3D<double> angv);
+    /// Reads all ground and brake proxis (the fresh ground proxis at each position averaged);
+    /// `measured` is the mean time the fresh ones were measured at (`t` for proxis which can't
+    /// tell, see Proxi). Returns the share of proxis which were fresh
+    double sample_proxis(double t, double *ground, double *brake_front, double *brake_rear,
+        double& measured);
+    /// Where `group`'s proxi `index` is read into, adding the group if it's new
+    ProxiSlot get_proxi_slot(ProxiGroup& group, int index);
 };
 
 #endif // MOTION_TRACKER_HPP_
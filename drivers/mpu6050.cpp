@@ -18,6 +18,8 @@
 #include <ios> // for std::hex and std::dec
 #include <sstream> // for std::stringstream
 
+#include "clock.hpp"
+
 // MPU6050's register addresses
 // For more information refer to MPU-6050 Register Map and Descriptions at
 //   https://www.invensense.com/wp-content/uploads/2015/02/MPU-6000-Register-Map1.pdf
@@ -83,10 +85,10 @@ Mpu6050::Mpu6050(I2C *bus, uint8_t slave_addr /*= DEFAULT_SLAVE_ADDR*/)
   {
     // POWER MGMT setup
     this->write8(PWR_MGMT_1, 0x80); //PWR_MGMT_1 - reset
-    sleep(1); //sleep for 1 second, probably not necessary but just in case...
+    Clock::get().sleep_for(1.0); //probably not necessary but just in case...
 
     this->write8(PWR_MGMT_1, 0x03); //PWR_MGMT_1 - set gyro z as clock source
-    sleep(1); //sleep for 1 second, probably not necessary but just in case...
+    Clock::get().sleep_for(1.0); //probably not necessary but just in case...
   }
   catch (I2CException& e)
   {
@@ -174,7 +176,7 @@ SelfTestResult Mpu6050::test_accl()
     uint8_t rng = this->read8(ACCEL_CONFIG) & 0x18; // save current range setting
 
     this->write8(ACCEL_CONFIG, XA_ST | YA_ST | ZA_ST | ACCL_RANGE_8G); // self-test config
-    sleep(2);
+    Clock::get().sleep_for(2.0);
     rad1 = this->get_raw_accl_data();
 
     // Get factory trim (FT)
@@ -191,7 +193,7 @@ SelfTestResult Mpu6050::test_accl()
         ft[i] = 0;
 
     this->write8(ACCEL_CONFIG, ACCL_RANGE_8G); // stop self-test
-    sleep(2);
+    Clock::get().sleep_for(2.0);
     rad2 = this->get_raw_accl_data();
     this->write8(ACCEL_CONFIG, rng); // restore range setting
   }
@@ -226,7 +228,7 @@ SelfTestResult Mpu6050::test_gyro()
     uint8_t rng = this->read8(GYRO_CONFIG) & 0x18; // save current range setting
 
     this->write8(GYRO_CONFIG, XG_ST | YG_ST | ZG_ST | GYRO_RANGE_250DPS); //all tests, 250dps range
-    sleep(1);
+    Clock::get().sleep_for(1.0);
     rgd1 = this->get_raw_gyro_data();
 
     // Get factory trim (FT)
@@ -240,7 +242,7 @@ SelfTestResult Mpu6050::test_gyro()
     ft[1] = -ft[1];
 
     this->write8(GYRO_CONFIG, GYRO_RANGE_250DPS); // stop self-test
-    sleep(1);
+    Clock::get().sleep_for(1.0);
     rgd2 = this->get_raw_gyro_data();
     this->write8(GYRO_CONFIG, rng); // restore range setting
   }
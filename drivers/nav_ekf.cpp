@@ -0,0 +1,185 @@
+#include "nav_ekf.hpp"
+
+#include <cmath>
+#include <Eigen/Dense>
+
+typedef Eigen::Matrix<double, NAV_EKF_STATE_SIZE, 1> ErrorState;
+
+static Eigen::Vector3d to_eigen(const Vector3D<double>& v)
+{
+  return Eigen::Vector3d(v.x, v.y, v.z);
+}
+
+static Vector3D<double> from_eigen(const Eigen::Vector3d& v)
+{
+  return Vector3D<double>(v(0), v(1), v(2));
+}
+
+static Eigen::Matrix3d skew(const Eigen::Vector3d& v)
+{
+  Eigen::Matrix3d m;
+  m <<     0, -v(2),  v(1),
+        v(2),     0, -v(0),
+       -v(1),  v(0),     0;
+  return m;
+}
+
+// Rotation matrix of a unit quaternion
+static Eigen::Matrix3d rotation(const Quaternion& q)
+{
+  double w = q.scal, x = q.vect.x, y = q.vect.y, z = q.vect.z;
+  Eigen::Matrix3d m;
+  m << 1 - 2*(y*y + z*z),     2*(x*y - w*z),     2*(x*z + w*y),
+           2*(x*y + w*z), 1 - 2*(x*x + z*z),     2*(y*z - w*x),
+           2*(x*z - w*y),     2*(y*z + w*x), 1 - 2*(x*x + y*y);
+  return m;
+}
+
+// Rotor rotated by the small angle `theta` (pod frame)
+static Quaternion perturb(const Quaternion& rotor, const Eigen::Vector3d& theta)
+{
+  double l = theta.norm();
+  Quaternion r = rotor;
+  if (l > 0.0)
+    r = cos(l/2.0) * rotor
+        + sin(l/2.0) * rotor * Quaternion(from_eigen(theta / l));
+  return r / Quaternion::norm(r);
+}
+
+
+NavEkf::NavEkf(NavEkfConfig config)
+    : config(config)
+{
+  this->reset(0.0, Vector3D<double>());
+}
+
+void NavEkf::reset(double timestamp, Vector3D<double> gravity)
+{
+  this->state.timestamp = timestamp;
+  this->state.position = Vector3D<double>();
+  this->state.velocity = Vector3D<double>();
+  this->state.acceleration = Vector3D<double>();
+  this->state.rotor = Quaternion(1, 0, 0, 0);
+  this->state.accl_bias = Vector3D<double>();
+  this->state.gyro_bias = Vector3D<double>();
+  this->gravity = gravity;
+
+  ErrorState d;
+  d.segment<3>(NAV_EKF_POSITION).setConstant(this->config.initial_position);
+  d.segment<3>(NAV_EKF_VELOCITY).setConstant(this->config.initial_velocity);
+  d.segment<3>(NAV_EKF_ATTITUDE).setConstant(this->config.initial_attitude);
+  d.segment<3>(NAV_EKF_ACCL_BIAS).setConstant(this->config.initial_accl_bias);
+  d.segment<3>(NAV_EKF_GYRO_BIAS).setConstant(this->config.initial_gyro_bias);
+  this->p = d.cwiseProduct(d).asDiagonal();
+}
+
+void NavEkf::predict(double timestamp, Vector3D<double> acceleration,
+    Vector3D<double> angular_velocity)
+{
+  double dt = timestamp - this->state.timestamp;
+  if (dt <= 0.0)
+    return;
+  this->state.timestamp = timestamp;
+
+  Eigen::Vector3d f = to_eigen(acceleration - this->state.accl_bias);
+  Eigen::Vector3d w = to_eigen(angular_velocity - this->state.gyro_bias);
+  Eigen::Matrix3d r = rotation(this->state.rotor);
+
+  // Nominal state
+  Vector3D<double> a = from_eigen(r * f) + this->gravity;
+  this->state.position += dt * this->state.velocity + (dt * dt / 2.0) * a;
+  this->state.velocity += dt * a;
+  this->state.acceleration = a;
+  this->state.rotor = perturb(this->state.rotor, w * dt);
+
+  // Covariance: P = F P F^T + Q, using the sparsity of F
+  Eigen::Matrix3d dv_dtheta = -dt * r * skew(f);
+  Eigen::Matrix3d dv_dbias = -dt * r;
+  Eigen::Matrix3d dtheta_dtheta = Eigen::Matrix3d::Identity() - dt * skew(w);
+  this->transition(this->p, dv_dtheta, dv_dbias, dtheta_dtheta, dt);
+  this->p.transposeInPlace();
+  this->transition(this->p, dv_dtheta, dv_dbias, dtheta_dtheta, dt);
+
+  double qv = this->config.accl_noise * this->config.accl_noise * dt;
+  double qt = this->config.gyro_noise * this->config.gyro_noise * dt;
+  double qa = this->config.accl_bias_walk * this->config.accl_bias_walk * dt;
+  double qg = this->config.gyro_bias_walk * this->config.gyro_bias_walk * dt;
+  for (int i = 0; i < 3; ++i)
+  {
+    this->p(NAV_EKF_VELOCITY + i, NAV_EKF_VELOCITY + i) += qv;
+    this->p(NAV_EKF_ATTITUDE + i, NAV_EKF_ATTITUDE + i) += qt;
+    this->p(NAV_EKF_ACCL_BIAS + i, NAV_EKF_ACCL_BIAS + i) += qa;
+    this->p(NAV_EKF_GYRO_BIAS + i, NAV_EKF_GYRO_BIAS + i) += qg;
+  }
+}
+
+bool NavEkf::update_stripe(double distance)
+{
+  Eigen::Matrix<double, 1, 1> y;
+  y << distance - this->state.position.x;
+  return this->update<1>(NAV_EKF_POSITION, y, this->config.stripe_noise * this->config.stripe_noise);
+}
+
+bool NavEkf::update_attitude(const Quaternion& rotor)
+{
+  // Rotation from the estimated to the measured attitude, as a small angle in the pod frame
+  Quaternion d = Quaternion::inv(this->state.rotor) * rotor;
+  if (d.scal < 0.0)
+    d = -d;
+  Eigen::Vector3d y = 2.0 * to_eigen(d.vect) / Quaternion::norm(d);
+  return this->update<3>(NAV_EKF_ATTITUDE, y,
+      this->config.attitude_noise * this->config.attitude_noise);
+}
+
+NavState NavEkf::get_state() const
+{
+  return this->state;
+}
+
+const NavEkf::Covariance& NavEkf::get_covariance() const
+{
+  return this->p;
+}
+
+// Update with a measurement of states [first, first + M) (H is a block of the identity)
+template<int M>
+bool NavEkf::update(int first, const Eigen::Matrix<double, M, 1>& residual, double variance)
+{
+  Eigen::Matrix<double, M, M> s = this->p.template block<M, M>(first, first);
+  s.diagonal().array() += variance;
+  Eigen::Matrix<double, M, M> s_inv = s.inverse();
+  if (residual.dot(s_inv * residual) > this->config.gate)
+    return false;
+
+  Eigen::Matrix<double, NAV_EKF_STATE_SIZE, M> k =
+      this->p.template block<NAV_EKF_STATE_SIZE, M>(0, first) * s_inv;
+  ErrorState dx = k * residual;
+  Eigen::Matrix<double, M, NAV_EKF_STATE_SIZE> ph =
+      this->p.template block<M, NAV_EKF_STATE_SIZE>(first, 0);
+  this->p.noalias() -= k * ph;
+  this->p = (this->p + this->p.transpose()) / 2.0;
+  this->inject(dx);
+  return true;
+}
+
+void NavEkf::inject(const ErrorState& dx)
+{
+  this->state.position += from_eigen(dx.segment<3>(NAV_EKF_POSITION));
+  this->state.velocity += from_eigen(dx.segment<3>(NAV_EKF_VELOCITY));
+  this->state.rotor = perturb(this->state.rotor, dx.segment<3>(NAV_EKF_ATTITUDE));
+  this->state.accl_bias += from_eigen(dx.segment<3>(NAV_EKF_ACCL_BIAS));
+  this->state.gyro_bias += from_eigen(dx.segment<3>(NAV_EKF_GYRO_BIAS));
+}
+
+// m = F m, where F is the identity except for the position/velocity/attitude rows
+void NavEkf::transition(Covariance& m, const Eigen::Matrix3d& dv_dtheta,
+    const Eigen::Matrix3d& dv_dbias, const Eigen::Matrix3d& dtheta_dtheta, double dt)
+{
+  // Rows are updated in an order such that each only reads rows not yet updated
+  m.middleRows<3>(NAV_EKF_POSITION) += dt * m.middleRows<3>(NAV_EKF_VELOCITY);
+  m.middleRows<3>(NAV_EKF_VELOCITY) += dv_dtheta * m.middleRows<3>(NAV_EKF_ATTITUDE)
+      + dv_dbias * m.middleRows<3>(NAV_EKF_ACCL_BIAS);
+  Eigen::Matrix<double, 3, NAV_EKF_STATE_SIZE> theta =
+      dtheta_dtheta * m.middleRows<3>(NAV_EKF_ATTITUDE) - dt * m.middleRows<3>(NAV_EKF_GYRO_BIAS);
+  m.middleRows<3>(NAV_EKF_ATTITUDE) = theta;
+}
@@ -0,0 +1,83 @@
+#ifndef HYPED_DRIVERS_NAV_EKF_HPP_
+#define HYPED_DRIVERS_NAV_EKF_HPP_
+
+#include <Eigen/Core>
+
+#include "quaternion.hpp"
+#include "vector3d.hpp"
+
+// Layout of the error state (and of the covariance rows/columns)
+#define NAV_EKF_POSITION   0
+#define NAV_EKF_VELOCITY   3
+#define NAV_EKF_ATTITUDE   6
+#define NAV_EKF_ACCL_BIAS  9
+#define NAV_EKF_GYRO_BIAS  12
+#define NAV_EKF_STATE_SIZE 15
+
+/// Noise parameters (standard deviations, SI units)
+struct NavEkfConfig
+{
+  double accl_noise = 0.1;           // m/s^2 per sqrt(s)
+  double gyro_noise = 0.005;         // rad/s per sqrt(s)
+  double accl_bias_walk = 0.001;     // m/s^2 per sqrt(s)
+  double gyro_bias_walk = 0.0001;    // rad/s per sqrt(s)
+  double stripe_noise = 0.05;        // m
+  double attitude_noise = 0.02;      // rad
+  double initial_position = 0.01;    // m
+  double initial_velocity = 0.01;    // m/s
+  double initial_attitude = 0.01;    // rad
+  double initial_accl_bias = 0.1;    // m/s^2
+  double initial_gyro_bias = 0.01;   // rad/s
+  double gate = 25.0;                // squared Mahalanobis distance above which updates are rejected
+};
+
+struct NavState
+{
+  double timestamp;
+  Vector3D<double> position;
+  Vector3D<double> velocity;
+  Vector3D<double> acceleration;     // bias-corrected, gravity removed
+  Quaternion rotor;                  // pod frame -> track frame
+  Vector3D<double> accl_bias;
+  Vector3D<double> gyro_bias;
+};
+
+/// Error-state extended Kalman filter for position, velocity, attitude and IMU biases.
+/// IMU samples drive the prediction; stripe and proxi attitude measurements are fused as they
+/// arrive, applied to the state at the time of the latest IMU sample. All matrices are fixed size
+/// so nothing is allocated after construction.
+class NavEkf
+{
+  public:
+    typedef Eigen::Matrix<double, NAV_EKF_STATE_SIZE, NAV_EKF_STATE_SIZE> Covariance;
+
+    NavEkf(NavEkfConfig config = NavEkfConfig());
+
+    /// Restarts at rest at the origin. `gravity` is the acceleration measured at rest
+    /// (track frame) with the sign flipped, i.e. what has to be added to cancel it
+    void reset(double timestamp, Vector3D<double> gravity);
+    /// Propagates the state to `timestamp` using accelerometer and gyroscope readings (pod frame)
+    void predict(double timestamp, Vector3D<double> acceleration,
+        Vector3D<double> angular_velocity);
+    /// Distance along the track (x) from a stripe; returns false if rejected as an outlier
+    bool update_stripe(double distance);
+    /// Attitude measured by the proxis; returns false if rejected as an outlier
+    bool update_attitude(const Quaternion& rotor);
+
+    NavState get_state() const;
+    const Covariance& get_covariance() const;
+
+  private:
+    template<int M>
+    bool update(int first, const Eigen::Matrix<double, M, 1>& residual, double variance);
+    void inject(const Eigen::Matrix<double, NAV_EKF_STATE_SIZE, 1>& dx);
+    void transition(Covariance& m, const Eigen::Matrix3d& dv_dtheta,
+        const Eigen::Matrix3d& dv_dbias, const Eigen::Matrix3d& dtheta_dtheta, double dt);
+
+    NavEkfConfig config;
+    NavState state;
+    Vector3D<double> gravity;
+    Covariance p;
+};
+
+#endif // HYPED_DRIVERS_NAV_EKF_HPP_
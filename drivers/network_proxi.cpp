@@ -1,8 +1,36 @@
 #include "network_proxi.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 
-NetworkProxi::NetworkProxi(NetworkMaster& slave, std::string proxi_desc)
-    : slave(slave), command(proxi_desc)
+#include "instrumentation.hpp"
+
+
+// A line of a slave's reply, "<reading> <sampled> <received> <replied>" in the slave's time
+// (older slaves send the reading only); returns how many of the times it has (3, or 0 from an
+// older slave or a line with anything else in it), -1 if it isn't a reading
+static int parse_reading(const std::string& line, int& reading, double remote[3])
+{
+  const char* p = line.c_str();
+  char* end;
+  reading = std::strtol(p, &end, 10);
+  if (end == p)
+    return -1;
+  for (int n = 0; n < 3; ++n)
+  {
+    p = end;
+    remote[n] = std::strtod(p, &end);
+    if (end == p)
+      return 0;
+  }
+  while (std::isspace((unsigned char) *end))
+    ++end;
+  return *end == '\0' ? 3 : 0;
+}
+
+NetworkProxi::NetworkProxi(NetworkMaster& slave, std::string proxi_desc, Clock& clock)
+    : slave(slave), command(proxi_desc), clock(clock)
 {}
 
 NetworkProxi::~NetworkProxi()
@@ -10,9 +38,128 @@ NetworkProxi::~NetworkProxi()
 
 int NetworkProxi::get_distance()
 {
-  this->slave.Send(this->command);
-  std::string response = slave.receive();
-  int reading = std::stoi(response);
-  return reading;
+  double timestamp;
+  return this->get_timed_distance(timestamp);
+}
+
+int NetworkProxi::get_timed_distance(double& timestamp)
+{
+  static LatencyHistogram& round_trip = Instrumentation::get_histogram("network_proxi.round_trip");
+  std::string response;
+  double sent, returned;
+  {
+    ScopedTimer timer(round_trip);
+    sent = this->clock.now();
+    this->slave.Send(this->command);
+    response = this->slave.read();
+    returned = this->clock.now();
+  }
+  // Only a whole line is a reply: read() gives what it has if the slave stops answering mid-line
+  int reading;
+  double remote[3];
+  int times = -1;
+  if (!response.empty() && response.back() == '\n')
+    times = parse_reading(response, reading, remote);
+  if (times >= 0) // else no reply, or not a reading
+  {
+    if (times == 3)
+      this->sync.add(sent, remote[1], remote[2], returned);
+    this->distance = reading;
+    this->timestamp = times == 3 ? this->sync.to_local(remote[0]) : (sent + returned) / 2.0;
+  }
+  timestamp = this->timestamp;
+  return this->distance;
+}
+
+const ClockSync& NetworkProxi::get_clock_sync() const
+{
+  return this->sync;
 }
 
+
+NetworkProxiSnapshot::NetworkProxiSnapshot(NetworkMultiplexer& slaves) : slaves(slaves)
+{}
+
+int NetworkProxiSnapshot::add_proxi(int slave, std::string proxi_desc)
+{
+  int proxi = this->distances.size();
+  unsigned int i = 0;
+  while (i < this->queries.size() && this->queries[i].slave != slave)
+    ++i;
+  if (i == this->queries.size())
+  {
+    SlaveQuery q;
+    q.slave = slave;
+    q.lines = 0;
+    q.answered = false;
+    this->queries.push_back(q);
+    this->query_proxis.emplace_back();
+  }
+  SlaveQuery& q = this->queries[i];
+  q.command += (q.lines > 0 ? " " : "") + proxi_desc;
+  ++q.lines;
+  this->query_proxis[i].push_back(proxi);
+  this->distances.push_back(0);
+  this->timestamps.push_back(-1.0);
+  this->fresh.push_back(false);
+  if (slave >= (int) this->syncs.size())
+    this->syncs.resize(slave + 1);
+  return proxi;
+}
+
+int NetworkProxiSnapshot::read()
+{
+  static LatencyHistogram& round_trip =
+      Instrumentation::get_histogram("network_proxi.snapshot_round_trip");
+  {
+    ScopedTimer timer(round_trip);
+    this->slaves.query(this->queries);
+  }
+  std::fill(this->fresh.begin(), this->fresh.end(), false);
+  int n = 0;
+  for (unsigned int i = 0; i < this->queries.size(); ++i)
+  {
+    SlaveQuery& q = this->queries[i];
+    if (!q.answered)
+      continue;
+    // The slave answers a line per proxi, which all took one exchange to get
+    ClockSync& sync = this->syncs[q.slave];
+    bool synced = false;
+    size_t start = 0;
+    for (int proxi : this->query_proxis[i])
+    {
+      if (start > q.reply.size())
+        break;
+      size_t end = std::min(q.reply.find('\n', start), q.reply.size());
+      this->line.assign(q.reply, start, end - start);
+      start = end + 1;
+      int reading;
+      double remote[3];
+      int times = parse_reading(this->line, reading, remote);
+      if (times < 0)
+        continue; // not a reading
+      if (times == 3 && !synced)
+      {
+        sync.add(q.sent, remote[1], remote[2], q.returned);
+        synced = true;
+      }
+      this->distances[proxi] = reading;
+      this->timestamps[proxi] = times == 3 ? sync.to_local(remote[0]) : (q.sent + q.returned) / 2.0;
+      this->fresh[proxi] = true;
+      ++n;
+    }
+  }
+  return n;
+}
+
+int NetworkProxiSnapshot::get_distances(ProxiReading* readings)
+{
+  int n = this->read();
+  for (unsigned int i = 0; i < this->distances.size(); ++i)
+  {
+    readings[i].distance = this->distances[i];
+    readings[i].timestamp = this->timestamps[i];
+    readings[i].fresh = this->fresh[i];
+  }
+  return n;
+}
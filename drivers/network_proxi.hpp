@@ -2,19 +2,68 @@
 #define NETWORK_PROXI_HPP_
 
 #include <string>
+#include <vector>
+#include "clock.hpp"
+#include "clock_sync.hpp"
 #include "interfaces.hpp"
 #include "master-slave-comms/master/NetworkMaster.hpp"
+#include "master-slave-comms/master/NetworkMultiplexer.hpp"
 
+/// A slave's proxi. Slaves reply with the reading, when they took it and when they received the
+/// request and replied (NetworkSlave::SendReading), so every reading is also a clock sync
+/// exchange and is stamped in the master's time. While the slave can't be reached (its
+/// connection is being remade) the last reading is returned, with the time it was taken
 class NetworkProxi : public Proxi
 {
   public:
-    NetworkProxi(NetworkMaster& slave, std::string proxi_desc);
+    NetworkProxi(NetworkMaster& slave, std::string proxi_desc, Clock& clock = Clock::get());
     virtual ~NetworkProxi();
     virtual int get_distance();
+    virtual int get_timed_distance(double& timestamp);
+    const ClockSync& get_clock_sync() const;
 
   private:
     NetworkMaster& slave;
     std::string command;
+    Clock& clock;
+    ClockSync sync;
+    int distance = 0;
+    double timestamp = -1.0;
+};
+
+/// Proxis on several slaves read together through a NetworkMultiplexer: each slave is asked for
+/// all of its proxis in one command (answered a line per proxi, see NetworkSlave::SendReadings)
+/// and every slave is asked at once, so a snapshot takes one round trip instead of one per proxi.
+/// Readings are stamped in the master's time as NetworkProxi's are
+class NetworkProxiSnapshot : public ProxiGroup
+{
+  public:
+    NetworkProxiSnapshot(NetworkMultiplexer& slaves);
+
+    /// `slave` is the multiplexer's index for it; returns the proxi's index in the snapshot
+    int add_proxi(int slave, std::string proxi_desc);
+    /// Reads every proxi; returns how many answered (the others keep their last reading)
+    int read();
+    int get_distance(int proxi) const { return this->distances[proxi]; }
+    /// When the proxi's last reading was taken, negative if there's none
+    double get_timestamp(int proxi) const { return this->timestamps[proxi]; }
+    /// Whether the proxi answered the last read()
+    bool is_fresh(int proxi) const { return this->fresh[proxi]; }
+    const ClockSync& get_clock_sync(int slave) const { return this->syncs[slave]; }
+
+    virtual int size() { return this->distances.size(); }
+    /// read()s, then gives every proxi's reading
+    virtual int get_distances(ProxiReading* readings);
+
+  private:
+    NetworkMultiplexer& slaves;
+    std::vector<SlaveQuery> queries;              // one per slave with proxis
+    std::vector<std::vector<int>> query_proxis;   // the proxis each asks for, in order
+    std::vector<int> distances;
+    std::vector<double> timestamps;
+    std::vector<bool> fresh;
+    std::vector<ClockSync> syncs; // by slave
+    std::string line;
 };
 
 #endif // NETWORK_PROXI_HPP_
@@ -0,0 +1,31 @@
+/*
+ * Converts a flight record into a run log for analysis:
+ *   pack-run_log <record file> <run log file>
+ */
+
+#include <cstdio>
+
+#include "run_log.hpp"
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    printf("Usage: %s <record file> <run log file>\n", argv[0]);
+    return 1;
+  }
+  if (!RunLog::pack(argv[1], argv[2]))
+  {
+    printf("Could not convert %s to %s\n", argv[1], argv[2]);
+    return 1;
+  }
+  RunLog log;
+  if (!log.open(argv[2]))
+  {
+    printf("%s was written but can't be read back\n", argv[2]);
+    return 1;
+  }
+  for (int i = 0; i < log.get_num_channels(); ++i)
+    printf("  %-20s %zu samples\n", log.get_channel_name(i).c_str(), log.get_num_samples(i));
+  return 0;
+}
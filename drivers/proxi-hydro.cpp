@@ -1,28 +1,26 @@
 #include "vl6180.hpp"
 
-#include "vl6180.hpp"
-//extern "C" {
- //   #include "hydraulic_control.h"
-#include "hydraulics.h"
-//}
-
 
-#include <chrono>
 #include <cstdio>
 #include <fstream>
 #include <ncurses.h>
 #include <string>
-#include <thread>
 #include <vector>
 
+#include "brake_controller.hpp"
+#include "clock.hpp"
 #include "gpio.hpp"
+#include "hydraulics.hpp"
+#include "hydraulics_sequencer.hpp"
 #include "i2c.hpp"
+#include "instrumentation.hpp"
+#include "proxi_sampler.hpp"
+#include "serial_session.hpp"
 
 #define SENSOR_RIGHT_PIN 15
 #define SENSOR_LEFT_PIN 16
 
 #define TARGET 110
-#define accumulator_pressure 50
 
 bool continuous_mode;
 std::vector<Vl6180*> sensors;
@@ -31,13 +29,6 @@ I2C i2c;
 // Create factory to produce sensor drivers for that bus
 Vl6180Factory& factory = Vl6180Factory::instance(&i2c);
 
-inline double timestamp()
-{
-  using namespace std::chrono;
-  return duration_cast<nanoseconds>(
-      steady_clock::now().time_since_epoch()).count() / 1.0e+9;
-}
-
 void setup()
 {
   // Produce driver instance for the sensor with GPIO0 connected to specified pin
@@ -50,7 +41,7 @@ void setup()
 
   for (unsigned int i = 0; i < sensors.size(); ++i)
   {
-    //std::this_thread::sleep_for(std::chrono::seconds(3));
+    //Clock::get().sleep_for(3.0);
     sensors[i]->turn_on();
     sensors[i]->set_intermeasurement_period(10);
     sensors[i]->set_continuous_mode(continuous_mode);
@@ -61,9 +52,9 @@ void file_output()
 {
   // Initialize sensors
   printf("Initializing...\n");
-  double t, t0 = timestamp();
+  double t, t0 = Clock::get().now();
   setup();
-  t = timestamp();
+  t = Clock::get().now();
   printf("took %fs\n\n", t - t0);
 
   // Setup datastructures
@@ -80,16 +71,16 @@ void file_output()
   // Take readings
   printf("Taking %d readings from each of the %d sensors...\n",
       n, sensors.size());
-  t0 = timestamp();
+  t0 = Clock::get().now();
   for (int i = 0; i < n; ++i)
   {
     for (unsigned int j = 0; j < sensors.size(); ++j)
     {
-      times[j].push_back(timestamp());
+      times[j].push_back(Clock::get().now());
       data[j].push_back(sensors[j]->get_distance());
     }
   }
-  t = timestamp();
+  t = Clock::get().now();
   printf("time = %fs\n", t - t0);
   printf("average period = %fms\n", (t - t0) / (n * sensors.size()) * 1000.0);
   printf("average frequency = %fHz\n\n",
@@ -97,7 +88,7 @@ void file_output()
 
   // Store readings
   printf("Saving to file %s...\n", filename.c_str());
-  t0 = timestamp();
+  t0 = Clock::get().now();
   std::ofstream file(filename);
   file.precision(16);
   for (int i = 0; i < n; ++i)
@@ -108,101 +99,69 @@ void file_output()
     file << std::endl;
   }
   file.close();
-  t = timestamp();
+  t = Clock::get().now();
   printf("took %fs\n", t - t0);
 }
 
 void screen_output()
 {
   setup();
+  Hydraulics hydraulics;
+  HydraulicsSequencer sequencer(hydraulics);
+  SerialSession arduino;
+  ProxiSampler proxi_right(*sensors[0]);
+  ProxiSampler proxi_left(*sensors[1]);
+  arduino.start();
+  proxi_right.start();
+  proxi_left.start();
+
+  BrakeControllerConfig config;
+  config.target = TARGET;
+  BrakeController controller(sequencer, proxi_left, proxi_right, &arduino, config);
+
   mvprintw(7 + 3*sensors.size(), 0, "Type any character to exit");
   move(8 + 3*sensors.size(), 0);
   refresh();
   int stop = getch();
-  int proxiright_dist = 0;
-  int proxileft_dist = 0;
-  bool target_ach_1 = FALSE;
-  bool target_ach_2 = FALSE;
-  spinup("front");
+  sequencer.spin_up();
+  controller.start();
+
+  // The control loop runs on its own thread; this one only displays its status
+  const char* command_names[] = {"holding   ", "extending ", "retracting"};
   while (stop == ERR)
   {
-  int sum = 0;
-  if(target_ach_1 == FALSE)
-  {
-      proxiright_dist = sensors[0]->get_distance();
-  }
-  if(target_ach_2 == FALSE)
-    {
-      proxileft_dist = sensors[1]->get_distance();
-}
-      sum = proxiright_dist + proxileft_dist;
-      mvprintw(5, 0, "#%d Distance right 1: %3dmm", 1, proxiright_dist);
-      mvprintw(6, 0, "#%d Distance left 2: %3dmm", 2, proxileft_dist);
-
+    BrakeControllerStatus status = controller.get_status();
+    const BrakeStatus& right = status.brakes[static_cast<int>(RailSide::right)];
+    const BrakeStatus& left = status.brakes[static_cast<int>(RailSide::left)];
+    mvprintw(5, 0, "#%d Distance right 1: %3.0fmm %s", 1, right.gap,
+        right.stale ? "(no reading)" : "            ");
+    mvprintw(6, 0, "#%d Distance left 2: %3.0fmm %s", 2, left.gap,
+        left.stale ? "(no reading)" : "            ");
     mvprintw(5 + 3*sensors.size(), 0, "Average distance: %5.1fmm",
-        (double) sum / sensors.size());
-    move(8 + 3*sensors.size(), 0);
+        (right.gap + left.gap) / 2.0);
+    mvprintw(6 + 3*sensors.size(), 0, "Accumulator pressure: %6.1f", arduino.get_pressure());
     mvprintw(8 + 3*sensors.size(), 0, "hydr test");
-    move(11 + 3*sensors.size(), 0);
-    //Added to move Hydraulics
-////////////////////////////////////////////////////////////////////
-
-
-    if(proxiright_dist +2 < TARGET)
-        {
-        extend("front", "right");
-	// delay(40);
-	// hold("front", "right");
-	// delay(100);
-        mvprintw(11 + 3*sensors.size(), 0, "extending", 1);
-        }
-    else if(proxiright_dist - 2> TARGET)
-        {
-        retract("front", "right");
-	// delay(40);
-	// hold("front", "right");
-	// delay(100);
-  mvprintw(11 + 3*sensors.size(), 0, "retracting", 1);
-        }
+    mvprintw(11 + 3*sensors.size(), 0, "%s",
+        command_names[static_cast<int>(right.command)]);
+    mvprintw(11 + 3*sensors.size(), 20, "%s",
+        command_names[static_cast<int>(left.command)]);
+    mvprintw(13 + 3*sensors.size(), 0, "Control ticks: %lu  deadline misses: %lu%s",
+        status.ticks, status.deadline_misses, status.realtime ? "" : "  (not real-time)");
+    if (right.on_target && left.on_target)
+      mvprintw(20, 0, "Brakes at correct position");
     else
-        {
-        hold("front", "right");
-  	mvprintw(11 + 3*sensors.size(), 0, "holding", 1);
-  	target_ach_1 = TRUE;
-//	delay(100);
-//	target_ach_1 = FALSE;
-        }
-
-    if(proxileft_dist + 2 < TARGET)
-        {
-        extend("front", "left");
-        mvprintw(11 + 3*sensors.size(), 20, "extending", 2);
-        }
-    else if(proxileft_dist - 2 > TARGET)
-        {
-        retract("front", "left");
-        mvprintw(11 + 3*sensors.size(), 20, "retracting", 2);
-        }
-    else
-        {
-        hold("front", "left");
-        mvprintw(11 + 3*sensors.size(), 10, "holding", 2);
-  	target_ach_2 = TRUE;
-//	delay(100);
-//	target_ach_2 = FALSE;
-        }
-    if(target_ach_1 == TRUE && target_ach_2 == TRUE)
-  {
-  standby("front");
-  mvprintw(20, 0, "Brakes at correct position");
-  
-  }
-////////////////////////////////////////////////////////////////////
+      mvprintw(20, 0, "                          ");
+    move(8 + 3*sensors.size(), 0);
     refresh();
+    Clock::get().sleep_for(0.05);
     stop = getch();
   }
 
-  shutDown("front");
+  controller.stop();
+  proxi_right.stop();
+  proxi_left.stop();
+  arduino.stop();
+  sequencer.shut_down().wait();
 }
 
 int main()
@@ -245,20 +204,21 @@ wiringPiSetup();
     screen_output();
     endwin();
   }//*/
+  printf("%s", Instrumentation::report().c_str());
 
 
 
   /*I2C i2c;
   Vl6180Factory& factory = Vl6180Factory::instance(&i2c);
   Vl6180& sensor = factory.make_sensor(PIN18);
-  std::this_thread::sleep_for(std::chrono::seconds(3));
+  Clock::get().sleep_for(3.0);
   sensor.turn_on();
   //sensor.set_continuous_mode(true);
   while(true)
   {
-    double t, t0 = timestamp();
+    double t, t0 = Clock::get().now();
     int d = sensor.get_distance();
-    t = timestamp();
+    t = Clock::get().now();
     printf("Distance: %3dmm  Time: %fms\n", d, (t - t0) * 1000.0);
 
   }//*/
@@ -0,0 +1,151 @@
+#ifndef HYPED_DRIVERS_PROXI_ATTITUDE_HPP_
+#define HYPED_DRIVERS_PROXI_ATTITUDE_HPP_
+
+#include <cmath>
+
+#include "quaternion.hpp"
+#include "vector3d.hpp"
+
+#define BRAKE_PROXI_SEPARATION 250.0 //mm
+
+/// Attitude of the pod from ground-facing proxis (pitch and roll, from the plane fitted through
+/// the measured points) and braking ski proxis (yaw). Sizes are fixed at compile time so nothing
+/// is allocated when the rotor is computed; distances are passed in already sampled.
+template<int MAX_GROUND_POSITIONS, int MAX_BRAKES>
+class ProxiAttitude
+{
+  public:
+    ProxiAttitude() : num_ground(0), num_brakes(0), brake_separation(BRAKE_PROXI_SEPARATION)
+    {}
+
+    /// Returns the index of the new position or -1 if there are already MAX_GROUND_POSITIONS
+    int add_ground_position(Vector3D<double> position)
+    {
+      if (this->num_ground >= MAX_GROUND_POSITIONS)
+        return -1;
+      this->positions[this->num_ground] = position;
+      return this->num_ground++;
+    }
+
+    /// Returns the index of the new braking ski or -1 if there are already MAX_BRAKES
+    int add_brake()
+    {
+      if (this->num_brakes >= MAX_BRAKES)
+        return -1;
+      return this->num_brakes++;
+    }
+
+    int get_ground_count() const { return this->num_ground; }
+    int get_brake_count() const { return this->num_brakes; }
+    /// Distance between the front and rear proxi of a braking ski (mm)
+    void set_brake_separation(double separation) { this->brake_separation = separation; }
+
+    /// `ground_distances[i]` is the distance measured at ground position i, `brake_front[i]` and
+    /// `brake_rear[i]` the distances measured by braking ski i (all in mm).
+    /// Returns false if the ground points don't define a plane (fewer than 3 or collinear)
+    bool get_rotor(const double *ground_distances, const double *brake_front,
+        const double *brake_rear, Quaternion& rotor) const
+    {
+      // Points of the rail, below the proxis (z is up); the rotor takes the rail's normal in the
+      // pod frame to the track's z axis
+      Vector3D<double> points[MAX_GROUND_POSITIONS];
+      for (int i = 0; i < this->num_ground; ++i)
+        points[i] = Vector3D<double>(this->positions[i].x, this->positions[i].y,
+            this->positions[i].z - ground_distances[i]);
+      Vector3D<double> n;
+      if (!fit_plane(points, this->num_ground, n))
+        return false;
+      if (n.z < 0.0)
+        n = -n;
+
+      double angle = acos(n.z > 1.0 ? 1.0 : n.z);
+      Vector3D<double> axis(n.y, -n.x, 0); //cross product of n and (0, 0, 1)
+      double l = std::sqrt(axis.x * axis.x + axis.y * axis.y);
+      Quaternion r1(cos(angle/2.0), sin(angle/2.0) * ((l == 0.0) ? axis : axis / l));
+
+      angle = 0.0;
+      for (int i = 0; i < this->num_brakes; ++i)
+        angle += atan((brake_front[i] - brake_rear[i]) / this->brake_separation);
+      if (this->num_brakes > 0)
+        angle /= this->num_brakes;
+      Quaternion r2(cos(angle/2.0), Vector3D<double>(0, 0, sin(angle/2.0)));
+
+      rotor = r2*r1;
+      return true;
+    }
+
+    /// Unit normal of the least-squares plane through the first `n` `points`: the eigenvector of
+    /// the smallest eigenvalue of their 3x3 covariance, computed in closed form.
+    /// Returns false if the points don't define a plane
+    static bool fit_plane(const Vector3D<double> *points, int n, Vector3D<double>& normal)
+    {
+      if (n < 3)
+        return false;
+      Vector3D<double> mean;
+      for (int i = 0; i < n; ++i)
+        mean += points[i];
+      mean /= (double) n;
+
+      // Upper triangle of the covariance (unnormalised, scale doesn't change the eigenvectors)
+      double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+      for (int i = 0; i < n; ++i)
+      {
+        double x = points[i].x - mean.x, y = points[i].y - mean.y, z = points[i].z - mean.z;
+        xx += x*x; xy += x*y; xz += x*z;
+        yy += y*y; yz += y*z; zz += z*z;
+      }
+
+      // Smallest eigenvalue of a symmetric 3x3 matrix (trigonometric solution of the
+      // characteristic cubic)
+      double q = (xx + yy + zz) / 3.0;
+      double p1 = xy*xy + xz*xz + yz*yz;
+      double p2 = (xx - q)*(xx - q) + (yy - q)*(yy - q) + (zz - q)*(zz - q) + 2.0*p1;
+      if (p2 <= 0.0)
+        return false; // all eigenvalues equal, points don't span a plane
+      double p = std::sqrt(p2 / 6.0);
+      double bxx = (xx - q) / p, byy = (yy - q) / p, bzz = (zz - q) / p;
+      double bxy = xy / p, bxz = xz / p, byz = yz / p;
+      double r = (bxx*(byy*bzz - byz*byz) - bxy*(bxy*bzz - byz*bxz) + bxz*(bxy*byz - byy*bxz))
+          / 2.0;
+      r = (r < -1.0) ? -1.0 : ((r > 1.0) ? 1.0 : r);
+      double lambda = q + 2.0*p*cos(acos(r)/3.0 + 2.0*M_PI/3.0);
+
+      // The eigenvector is orthogonal to the rows of (C - lambda*I): take the cross product of
+      // the pair of rows giving the best-conditioned result
+      Vector3D<double> r0(xx - lambda, xy, xz);
+      Vector3D<double> r1(xy, yy - lambda, yz);
+      Vector3D<double> r2(xz, yz, zz - lambda);
+      Vector3D<double> c[3] = {cross(r0, r1), cross(r0, r2), cross(r1, r2)};
+      int best = 0;
+      double best_norm = norm2(c[0]);
+      for (int i = 1; i < 3; ++i)
+        if (norm2(c[i]) > best_norm)
+        {
+          best = i;
+          best_norm = norm2(c[i]);
+        }
+      // Double smallest eigenvalue means the points are collinear
+      if (best_norm <= 1e-12 * p2 * p2)
+        return false;
+      normal = c[best] / std::sqrt(best_norm);
+      return true;
+    }
+
+  private:
+    static Vector3D<double> cross(const Vector3D<double>& a, const Vector3D<double>& b)
+    {
+      return Vector3D<double>(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+    }
+
+    static double norm2(const Vector3D<double>& v)
+    {
+      return v.x*v.x + v.y*v.y + v.z*v.z;
+    }
+
+    Vector3D<double> positions[MAX_GROUND_POSITIONS];
+    int num_ground;
+    int num_brakes;
+    double brake_separation;
+};
+
+#endif // HYPED_DRIVERS_PROXI_ATTITUDE_HPP_
@@ -0,0 +1,49 @@
+#ifndef HYPED_DRIVERS_PROXI_GROUP_HPP_
+#define HYPED_DRIVERS_PROXI_GROUP_HPP_
+
+#include <exception>
+#include <vector>
+
+#include "interfaces.hpp"
+
+/// Any Proxis as a ProxiGroup, read one after the other
+class ProxiList : public ProxiGroup
+{
+  public:
+    /// Returns the proxi's index in the group
+    int add_proxi(Proxi& proxi)
+    {
+      this->proxis.push_back(&proxi);
+      return this->proxis.size() - 1;
+    }
+
+    virtual int size() { return this->proxis.size(); }
+
+    virtual int get_distances(ProxiReading* readings)
+    {
+      int fresh = 0;
+      for (unsigned int i = 0; i < this->proxis.size(); ++i)
+      {
+        try
+        {
+          double timestamp;
+          readings[i].distance = this->proxis[i]->get_timed_distance(timestamp);
+          readings[i].timestamp = timestamp;
+          readings[i].fresh = true;
+          ++fresh;
+        }
+        catch (std::exception& e)
+        {
+          // Failed, or nothing new since the last call (NoNewReadingException); either way the
+          // last reading is kept for the others to go on with
+          readings[i].fresh = false;
+        }
+      }
+      return fresh;
+    }
+
+  private:
+    std::vector<Proxi*> proxis;
+};
+
+#endif // HYPED_DRIVERS_PROXI_GROUP_HPP_
@@ -0,0 +1,92 @@
+#include "proxi_sampler.hpp"
+
+#include <exception>
+
+#include "clock.hpp"
+
+
+ProxiSampler::ProxiSampler(Proxi& proxi, int period)
+    : proxi(proxi), period(period), latest(ProxiSample {0, 0.0, 0})
+{}
+
+ProxiSampler::~ProxiSampler()
+{
+  this->stop();
+}
+
+void ProxiSampler::start()
+{
+  if (!this->stop_flag)
+    return;
+  this->stop_flag = false;
+  this->sampling_thread = std::thread(&ProxiSampler::sample, this);
+}
+
+void ProxiSampler::stop()
+{
+  this->stop_flag = true;
+  if (this->sampling_thread.joinable())
+    this->sampling_thread.join();
+}
+
+bool ProxiSampler::try_get_sample(ProxiSample& sample)
+{
+  return this->latest.try_load(sample, 4);
+}
+
+ProxiSample ProxiSampler::get_sample()
+{
+  return this->latest.load();
+}
+
+int ProxiSampler::get_distance()
+{
+  return this->latest.load().distance;
+}
+
+int ProxiSampler::get_timed_distance(double& timestamp)
+{
+  ProxiSample s = this->latest.load();
+  timestamp = s.count > 0 ? s.timestamp : -1.0;
+  return s.distance;
+}
+
+unsigned int ProxiSampler::get_error_count()
+{
+  return this->errors.load(std::memory_order_relaxed);
+}
+
+void ProxiSampler::sample()
+{
+  ProxiSample s = this->latest.load();
+  Clock& clock = Clock::get();
+  double next = clock.now();
+  while (!this->stop_flag)
+  {
+    try
+    {
+      double t;
+      s.distance = this->proxi.get_timed_distance(t);
+      s.timestamp = t >= 0.0 ? t : clock.now();
+      ++s.count;
+      this->latest.store(s);
+    }
+    catch (NoNewReadingException& e)
+    {
+      if (this->period <= 0)
+        clock.sleep_for(0.001); // wait for one rather than spin
+    }
+    catch (std::exception& e)
+    {
+      // Keep the last good reading; its timestamp tells consumers how old it is
+      this->errors.fetch_add(1, std::memory_order_relaxed);
+      if (this->period <= 0)
+        clock.sleep_for(0.001); // don't spin on a dead sensor
+    }
+    if (this->period > 0)
+    {
+      next += this->period / 1.0e+6;
+      clock.sleep_until(next);
+    }
+  }
+}
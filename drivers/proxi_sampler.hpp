@@ -0,0 +1,51 @@
+#ifndef HYPED_DRIVERS_PROXI_SAMPLER_HPP_
+#define HYPED_DRIVERS_PROXI_SAMPLER_HPP_
+
+#include <atomic>
+#include <thread>
+
+#include "interfaces.hpp"
+#include "seqlock.hpp"
+
+struct ProxiSample
+{
+  int distance;          // mm
+  double timestamp;      // Clock::get() time of the reading (seconds)
+  unsigned int count;    // number of readings taken so far (0 means no reading yet)
+};
+
+/// Reads a (possibly blocking) proxi continuously on its own thread so that control loops can get
+/// the latest reading without waiting for the bus
+class ProxiSampler : public Proxi
+{
+  public:
+    /// `period` is the minimum time between readings in microseconds (0 reads back to back)
+    ProxiSampler(Proxi& proxi, int period = 0);
+    ~ProxiSampler();
+
+    ProxiSampler(ProxiSampler const&)   = delete;
+    void operator=(ProxiSampler const&) = delete;
+
+    void start();
+    void stop();
+    /// Latest reading; never blocks
+    bool try_get_sample(ProxiSample& sample);
+    ProxiSample get_sample();
+    /// Distance of the latest reading, so a sampler can be used wherever a Proxi is expected
+    virtual int get_distance();
+    virtual int get_timed_distance(double& timestamp);
+    /// Number of readings which failed (e.g. with an I2C error)
+    unsigned int get_error_count();
+
+  private:
+    void sample();
+
+    Proxi& proxi;
+    int period;
+    SeqLock<ProxiSample> latest;
+    std::atomic<unsigned int> errors {0};
+    std::atomic_bool stop_flag {true};
+    std::thread sampling_thread;
+};
+
+#endif // HYPED_DRIVERS_PROXI_SAMPLER_HPP_
@@ -91,9 +91,14 @@ Quaternion Quaternion::inv(const Quaternion& q)
 
 Quaternion Quaternion::pow(const Quaternion base, double exp)
 {
-  double theta = acos(base.scal / Quaternion::norm(base));
-  return std::pow(Quaternion::norm(base), exp) * Quaternion(cos(exp * theta),
-      sin(exp * theta) * base.vect / Quaternion::norm(base.vect));
+  double n = Quaternion::norm(base);
+  double vn = Quaternion::norm(base.vect);
+  // Real base (e.g. identity rotation): no axis, and the division below would give NaN
+  if (vn == 0.0)
+    return Quaternion(std::pow(base.scal, exp), Vector3D<double>());
+  double c = base.scal / n;
+  double theta = acos(c > 1.0 ? 1.0 : (c < -1.0 ? -1.0 : c));
+  return std::pow(n, exp) * Quaternion(cos(exp * theta), sin(exp * theta) * base.vect / vn);
 }
 
 Quaternion operator+(Quaternion lhs, const Quaternion &rhs)
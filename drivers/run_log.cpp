@@ -0,0 +1,335 @@
+#include "run_log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flight_recorder.hpp"
+
+#define RUN_LOG_MAGIC "HYPEDRUN"
+
+inline uint64_t align(uint64_t offset)
+{
+  return (offset + RUN_LOG_ALIGNMENT - 1) / RUN_LOG_ALIGNMENT * RUN_LOG_ALIGNMENT;
+}
+
+inline uint64_t index_size(uint64_t num_samples, uint64_t stride)
+{
+  return (num_samples + stride - 1) / stride;
+}
+
+
+RunLog::RunLog()
+    : base(nullptr), size(0), header(nullptr), channels(nullptr), fields(nullptr)
+{}
+
+RunLog::~RunLog()
+{
+  this->close();
+}
+
+bool RunLog::open(const std::string& filename)
+{
+  this->close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(RunLogHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+  void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps the file open
+  if (p == MAP_FAILED)
+    return false;
+  this->base = (const uint8_t*) p;
+  this->size = st.st_size;
+  this->header = (const RunLogHeader*) this->base;
+  this->channels = (const RunLogChannel*) (this->base + sizeof(RunLogHeader));
+  this->fields = (const RunLogField*) (this->channels + this->header->num_channels);
+  if (!this->check())
+  {
+    this->close();
+    return false;
+  }
+  return true;
+}
+
+void RunLog::close()
+{
+  if (this->base)
+    munmap((void*) this->base, this->size);
+  this->base = nullptr;
+  this->size = 0;
+  this->header = nullptr;
+  this->channels = nullptr;
+  this->fields = nullptr;
+}
+
+int RunLog::get_num_channels() const
+{
+  return this->header ? this->header->num_channels : 0;
+}
+
+int RunLog::find_channel(const std::string& name) const
+{
+  for (int i = 0; i < this->get_num_channels(); ++i)
+    if (name == this->channels[i].name)
+      return i;
+  return -1;
+}
+
+int RunLog::find_field(int channel, const std::string& name) const
+{
+  if (channel < 0 || channel >= this->get_num_channels())
+    return -1;
+  const RunLogChannel& c = this->channels[channel];
+  for (unsigned int i = 0; i < c.num_fields; ++i)
+    if (name == this->fields[c.first_field + i].name)
+      return i;
+  return -1;
+}
+
+std::string RunLog::get_channel_name(int channel) const
+{
+  return this->channels[channel].name;
+}
+
+std::vector<std::string> RunLog::get_field_names(int channel) const
+{
+  const RunLogChannel& c = this->channels[channel];
+  std::vector<std::string> names;
+  for (unsigned int i = 0; i < c.num_fields; ++i)
+    names.push_back(this->fields[c.first_field + i].name);
+  return names;
+}
+
+size_t RunLog::get_num_samples(int channel) const
+{
+  return this->channels[channel].num_samples;
+}
+
+ColumnSpan<double> RunLog::get_timestamps(int channel) const
+{
+  const RunLogChannel& c = this->channels[channel];
+  return ColumnSpan<double>(this->at(c.timestamps), c.num_samples);
+}
+
+ColumnSpan<double> RunLog::get_column(int channel, int field) const
+{
+  const RunLogChannel& c = this->channels[channel];
+  return ColumnSpan<double>(this->at(this->fields[c.first_field + field].values), c.num_samples);
+}
+
+ColumnSpan<double> RunLog::get_column(const std::string& channel, const std::string& field) const
+{
+  int c = this->find_channel(channel);
+  int f = this->find_field(c, field);
+  if (f < 0)
+    return ColumnSpan<double>();
+  return this->get_column(c, f);
+}
+
+Vector3DColumns RunLog::get_vector3d(const std::string& channel) const
+{
+  Vector3DColumns v;
+  int c = this->find_channel(channel);
+  int x = this->find_field(c, "x"), y = this->find_field(c, "y"), z = this->find_field(c, "z");
+  if (x < 0 || y < 0 || z < 0)
+    return v;
+  v.timestamp = this->get_timestamps(c);
+  v.x = this->get_column(c, x);
+  v.y = this->get_column(c, y);
+  v.z = this->get_column(c, z);
+  return v;
+}
+
+size_t RunLog::seek(int channel, double t) const
+{
+  const RunLogChannel& c = this->channels[channel];
+  const double* timestamps = this->at(c.timestamps);
+  const double* index = this->at(c.index);
+  size_t stride = this->header->index_stride;
+  size_t n = c.num_samples;
+  // index[k - 1] < t <= index[k], so the sample is in stride k - 1
+  size_t k = std::lower_bound(index, index + index_size(n, stride), t) - index;
+  size_t first = k == 0 ? 0 : (k - 1) * stride;
+  size_t last = std::min(n, k * stride);
+  return std::lower_bound(timestamps + first, timestamps + last, t) - timestamps;
+}
+
+void RunLog::find_range(int channel, double t0, double t1, size_t& first, size_t& last) const
+{
+  first = this->seek(channel, t0);
+  last = std::max(first, this->seek(channel, t1));
+}
+
+bool RunLog::pack(const std::string& record_file, const std::string& run_log_file)
+{
+  FlightRecordReader reader;
+  if (!reader.open(record_file))
+    return false;
+  const std::vector<RecordChannel>& record_channels = reader.get_channels();
+  unsigned int num_channels = record_channels.size(), num_fields = 0;
+  for (const RecordChannel& c : record_channels)
+  {
+    if (c.name.size() >= RUN_LOG_NAME_LENGTH)
+      return false;
+    for (const std::string& f : c.fields)
+      if (f.size() >= RUN_LOG_NAME_LENGTH)
+        return false;
+    num_fields += c.fields.size();
+  }
+
+  // First pass: count the samples to lay out the columns
+  std::vector<uint64_t> counts(num_channels, 0);
+  RecordHeader record;
+  const double* values;
+  while (reader.next(record, values))
+    ++counts[record.channel];
+
+  std::vector<RunLogChannel> channels(num_channels);
+  std::vector<RunLogField> fields(num_fields);
+  uint64_t offset = align(sizeof(RunLogHeader) + num_channels * sizeof(RunLogChannel)
+      + num_fields * sizeof(RunLogField));
+  for (unsigned int i = 0, f = 0; i < num_channels; ++i)
+  {
+    RunLogChannel& c = channels[i];
+    std::memset(&c, 0, sizeof(c));
+    std::strcpy(c.name, record_channels[i].name.c_str());
+    c.num_samples = counts[i];
+    c.timestamps = offset;
+    offset = align(offset + counts[i] * sizeof(double));
+    c.index = offset;
+    offset = align(offset + index_size(counts[i], RUN_LOG_INDEX_STRIDE) * sizeof(double));
+    c.first_field = f;
+    c.num_fields = record_channels[i].fields.size();
+    for (const std::string& name : record_channels[i].fields)
+    {
+      std::memset(&fields[f], 0, sizeof(RunLogField));
+      std::strcpy(fields[f].name, name.c_str());
+      fields[f++].values = offset;
+      offset = align(offset + counts[i] * sizeof(double));
+    }
+  }
+  uint64_t file_size = offset;
+
+  // The file is written under a temporary name and renamed when complete
+  std::string tmp = run_log_file + ".tmp";
+  int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, file_size) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void* p = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    ::close(fd);
+    return false;
+  }
+  uint8_t* out = (uint8_t*) p;
+  RunLogHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, RUN_LOG_MAGIC, sizeof(header.magic));
+  header.version = RUN_LOG_VERSION;
+  header.num_channels = num_channels;
+  header.num_fields = num_fields;
+  header.index_stride = RUN_LOG_INDEX_STRIDE;
+  header.file_size = file_size;
+  std::memcpy(out, &header, sizeof(header));
+  std::memcpy(out + sizeof(header), channels.data(), num_channels * sizeof(RunLogChannel));
+  std::memcpy(out + sizeof(header) + num_channels * sizeof(RunLogChannel), fields.data(),
+      num_fields * sizeof(RunLogField));
+
+  // Second pass: fill the columns
+  std::vector<uint64_t> next(num_channels, 0);
+  reader.rewind();
+  while (reader.next(record, values))
+  {
+    const RunLogChannel& c = channels[record.channel];
+    uint64_t i = next[record.channel]++;
+    ((double*) (out + c.timestamps))[i] = record.timestamp;
+    for (unsigned int j = 0; j < c.num_fields; ++j)
+      ((double*) (out + fields[c.first_field + j].values))[i] = values[j];
+  }
+
+  for (const RunLogChannel& c : channels)
+  {
+    double* timestamps = (double*) (out + c.timestamps);
+    uint64_t n = c.num_samples;
+    if (!std::is_sorted(timestamps, timestamps + n))
+    {
+      // Samples of one channel recorded from several threads can be out of order
+      std::vector<uint64_t> order(n);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [timestamps](uint64_t a, uint64_t b) {
+        return timestamps[a] < timestamps[b];
+      });
+      std::vector<double> column(n);
+      for (unsigned int j = 0; j <= c.num_fields; ++j)
+      {
+        double* v = j == 0 ? timestamps : (double*) (out + fields[c.first_field + j - 1].values);
+        for (uint64_t i = 0; i < n; ++i)
+          column[i] = v[order[i]];
+        std::copy(column.begin(), column.end(), v);
+      }
+    }
+    double* index = (double*) (out + c.index);
+    for (uint64_t i = 0; i < n; i += RUN_LOG_INDEX_STRIDE)
+      index[i / RUN_LOG_INDEX_STRIDE] = timestamps[i];
+  }
+
+  bool ok = msync(p, file_size, MS_SYNC) == 0;
+  munmap(p, file_size);
+  ok = fsync(fd) == 0 && ok;
+  ::close(fd);
+  return ok && std::rename(tmp.c_str(), run_log_file.c_str()) == 0;
+}
+
+bool RunLog::check() const
+{
+  const RunLogHeader& h = *this->header;
+  if (std::memcmp(h.magic, RUN_LOG_MAGIC, sizeof(h.magic)) != 0 || h.version != RUN_LOG_VERSION
+      || h.file_size != this->size || h.index_stride == 0)
+    return false;
+  uint64_t tables = sizeof(RunLogHeader) + (uint64_t) h.num_channels * sizeof(RunLogChannel)
+      + (uint64_t) h.num_fields * sizeof(RunLogField);
+  if (tables > this->size)
+    return false;
+  // Every column must be aligned and lie within the file
+  auto column_ok = [this](uint64_t offset, uint64_t length) {
+    return offset % sizeof(double) == 0 && offset <= this->size
+        && length <= (this->size - offset) / sizeof(double);
+  };
+  for (unsigned int i = 0; i < h.num_channels; ++i)
+  {
+    const RunLogChannel& c = this->channels[i];
+    if (c.name[RUN_LOG_NAME_LENGTH - 1] != '\0' || c.first_field > h.num_fields
+        || c.num_fields > h.num_fields - c.first_field
+        || !column_ok(c.timestamps, c.num_samples)
+        || !column_ok(c.index, index_size(c.num_samples, h.index_stride)))
+      return false;
+    for (unsigned int j = 0; j < c.num_fields; ++j)
+    {
+      const RunLogField& f = this->fields[c.first_field + j];
+      if (f.name[RUN_LOG_NAME_LENGTH - 1] != '\0' || !column_ok(f.values, c.num_samples))
+        return false;
+    }
+  }
+  return true;
+}
+
+const double* RunLog::at(uint64_t offset) const
+{
+  return (const double*) (this->base + offset);
+}
@@ -0,0 +1,136 @@
+#ifndef HYPED_DRIVERS_RUN_LOG_HPP_
+#define HYPED_DRIVERS_RUN_LOG_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define RUN_LOG_VERSION 1
+#define RUN_LOG_NAME_LENGTH 32  // bytes, including the terminating '\0'
+#define RUN_LOG_ALIGNMENT 64    // bytes, every column starts at a multiple of this
+#define RUN_LOG_INDEX_STRIDE 1024 // samples per sparse index entry
+
+/*
+ * Run log: the samples of a flight record stored by column, for fast analysis. Layout (host byte
+ * order, offsets in bytes from the start of the file):
+ *  - RunLogHeader
+ *  - RunLogChannel[num_channels]
+ *  - RunLogField[num_fields], each channel's fields together starting at its first_field
+ *  - columns of doubles, each aligned to RUN_LOG_ALIGNMENT: per channel its timestamps (sorted),
+ *    its sparse index (the timestamp of every RUN_LOG_INDEX_STRIDE-th sample) and its fields
+ */
+struct RunLogHeader
+{
+  char magic[8]; // "HYPEDRUN"
+  uint32_t version;
+  uint32_t num_channels;
+  uint32_t num_fields;
+  uint32_t index_stride;
+  uint64_t file_size;
+};
+
+struct RunLogChannel
+{
+  char name[RUN_LOG_NAME_LENGTH];
+  uint64_t num_samples;
+  uint64_t timestamps; // offset
+  uint64_t index;      // offset, (num_samples + index_stride - 1) / index_stride entries
+  uint32_t first_field;
+  uint32_t num_fields;
+};
+
+struct RunLogField
+{
+  char name[RUN_LOG_NAME_LENGTH];
+  uint64_t values; // offset
+};
+
+/// Read-only view of `size` consecutive values, e.g. a column of a RunLog (no copy is made)
+template <typename T>
+class ColumnSpan
+{
+  public:
+    ColumnSpan() : values(nullptr), length(0)
+    {}
+    ColumnSpan(const T* values, size_t length) : values(values), length(length)
+    {}
+
+    const T* data() const { return this->values; }
+    size_t size() const { return this->length; }
+    bool empty() const { return this->length == 0; }
+    const T* begin() const { return this->values; }
+    const T* end() const { return this->values + this->length; }
+    const T& operator[](size_t i) const { return this->values[i]; }
+    /// Values [first, last)
+    ColumnSpan<T> subspan(size_t first, size_t last) const
+    {
+      return ColumnSpan<T>(this->values + first, last - first);
+    }
+
+  private:
+    const T* values;
+    size_t length;
+};
+
+/// The four columns of a channel recording a vector (fields x, y and z), e.g. accl<n> or gyro<n>
+/// from MotionTracker::set_recorder
+struct Vector3DColumns
+{
+  ColumnSpan<double> timestamp;
+  ColumnSpan<double> x, y, z;
+};
+
+/// Memory-mapped run log. Columns point straight into the mapping, so they are valid until the
+/// log is closed; the OS pages the file in as it is read.
+class RunLog
+{
+  public:
+    RunLog();
+    ~RunLog();
+
+    RunLog(RunLog const&)          = delete;
+    void operator=(RunLog const&) = delete;
+
+    /// Returns false if the file can't be mapped or isn't a consistent run log of this version
+    bool open(const std::string& filename);
+    void close();
+
+    int get_num_channels() const;
+    /// -1 if there is no such channel
+    int find_channel(const std::string& name) const;
+    /// -1 if the channel has no such field
+    int find_field(int channel, const std::string& name) const;
+    std::string get_channel_name(int channel) const;
+    std::vector<std::string> get_field_names(int channel) const;
+    size_t get_num_samples(int channel) const;
+
+    ColumnSpan<double> get_timestamps(int channel) const;
+    ColumnSpan<double> get_column(int channel, int field) const;
+    /// Empty if the channel or field doesn't exist
+    ColumnSpan<double> get_column(const std::string& channel, const std::string& field) const;
+    /// All columns empty if the channel doesn't exist or hasn't got fields x, y and z
+    Vector3DColumns get_vector3d(const std::string& channel) const;
+
+    /// Index of the first sample of `channel` at or after time `t`; binary search of the sparse
+    /// index, then of one stride of timestamps
+    size_t seek(int channel, double t) const;
+    /// Samples with `t0` <= timestamp < `t1` are [first, last)
+    void find_range(int channel, double t0, double t1, size_t& first, size_t& last) const;
+
+    /// Converts a flight record into a run log (samples of each channel sorted by timestamp).
+    /// Returns false if the record can't be read or the run log can't be written
+    static bool pack(const std::string& record_file, const std::string& run_log_file);
+
+  private:
+    bool check() const;
+    const double* at(uint64_t offset) const;
+
+    const uint8_t* base;
+    size_t size;
+    const RunLogHeader* header;
+    const RunLogChannel* channels;
+    const RunLogField* fields;
+};
+
+#endif // HYPED_DRIVERS_RUN_LOG_HPP_
@@ -0,0 +1,197 @@
+#ifndef HYPED_DRIVERS_SAMPLE_BUS_HPP_
+#define HYPED_DRIVERS_SAMPLE_BUS_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+
+#define SAMPLE_RING_SIZE 64 // samples kept per topic, a power of 2
+
+/*
+ * In-process publish/subscribe for sensor samples. Each topic is a ring of the latest
+ * SAMPLE_RING_SIZE samples with one producer; every slot is a seqlock, so publishing never waits
+ * for readers and any number of readers (each with its own cursor) read without locks. A reader
+ * that falls more than a ring behind skips to the oldest sample still there and counts the
+ * samples it missed. Values are copied out of the ring, so they must be trivially copyable and
+ * should be small.
+ */
+
+template <typename T>
+struct Sample
+{
+  uint64_t sequence; // 0 for the first sample of the topic
+  double timestamp;  // Clock::get() time of the reading (seconds)
+  T value;
+};
+
+template <typename T>
+class SampleTopic
+{
+  public:
+    SampleTopic() : published(0)
+    {
+      for (Slot& s : this->slots)
+        s.version.store(0, std::memory_order_relaxed);
+    }
+
+    SampleTopic(SampleTopic const&)    = delete;
+    void operator=(SampleTopic const&) = delete;
+
+    /// Must only be called from one thread at a time
+    void publish(double timestamp, const T& value);
+    /// Number of samples published so far
+    uint64_t get_count() const { return this->published.load(std::memory_order_acquire); }
+    /// Sample `sequence`; false if it hasn't been published yet or was overwritten
+    bool read(uint64_t sequence, Sample<T>& sample) const;
+    /// Latest sample; false if nothing has been published yet
+    bool latest(Sample<T>& sample) const;
+
+  private:
+    // version is 2 * (sequence + 1) once sample `sequence` is in the slot, odd while writing
+    struct Slot
+    {
+      std::atomic<uint64_t> version;
+      Sample<T> sample;
+    };
+
+    Slot slots[SAMPLE_RING_SIZE];
+    std::atomic<uint64_t> published;
+};
+
+/// Reads every sample of a topic in order, starting with the next one published after it was
+/// created. Each reader belongs to one thread
+template <typename T>
+class SampleReader
+{
+  public:
+    SampleReader(const SampleTopic<T>& topic)
+        : topic(&topic), cursor(topic.get_count())
+    {}
+
+    /// Next unread sample; false if there is none
+    bool next(Sample<T>& sample);
+    /// Samples overwritten before this reader got to them
+    unsigned long get_missed() const { return this->missed; }
+
+  private:
+    const SampleTopic<T>* topic;
+    uint64_t cursor; // sequence of the next sample to read
+    unsigned long missed = 0;
+};
+
+/// Topics by name, for producers and consumers set up in different places. Looking topics up
+/// takes a lock, so do it once when setting up rather than per sample
+class SampleBus
+{
+  public:
+    /// Creates the topic if there is none of that name; nullptr if there is one with values of
+    /// another type
+    template <typename T>
+    SampleTopic<T>* topic(const std::string& name);
+
+  private:
+    struct Entry
+    {
+      std::type_index type;
+      std::shared_ptr<void> topic;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Entry> topics;
+};
+
+
+template <typename T>
+void SampleTopic<T>::publish(double timestamp, const T& value)
+{
+  uint64_t sequence = this->published.load(std::memory_order_relaxed);
+  Slot& slot = this->slots[sequence % SAMPLE_RING_SIZE];
+  slot.version.store(2 * sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  Sample<T> sample = {sequence, timestamp, value};
+  std::memcpy(&slot.sample, &sample, sizeof(Sample<T>));
+  slot.version.store(2 * (sequence + 1), std::memory_order_release);
+  this->published.store(sequence + 1, std::memory_order_release);
+}
+
+template <typename T>
+bool SampleTopic<T>::read(uint64_t sequence, Sample<T>& sample) const
+{
+  const Slot& slot = this->slots[sequence % SAMPLE_RING_SIZE];
+  uint64_t version = 2 * (sequence + 1);
+  while (true)
+  {
+    if (slot.version.load(std::memory_order_acquire) != version)
+      return false; // not published yet, being overwritten or overwritten already
+    Sample<T> copy;
+    std::memcpy(&copy, &slot.sample, sizeof(Sample<T>));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.version.load(std::memory_order_relaxed) == version)
+    {
+      sample = copy;
+      return true;
+    }
+  }
+}
+
+template <typename T>
+bool SampleTopic<T>::latest(Sample<T>& sample) const
+{
+  // The producer can only have moved on if a newer sample exists, so this ends
+  while (true)
+  {
+    uint64_t count = this->get_count();
+    if (count == 0)
+      return false;
+    if (this->read(count - 1, sample))
+      return true;
+  }
+}
+
+template <typename T>
+bool SampleReader<T>::next(Sample<T>& sample)
+{
+  uint64_t count = this->topic->get_count();
+  while (this->cursor < count)
+  {
+    // Samples more than a ring behind are gone; so is the oldest one if a write is under way
+    if (count - this->cursor > SAMPLE_RING_SIZE)
+    {
+      this->missed += count - SAMPLE_RING_SIZE - this->cursor;
+      this->cursor = count - SAMPLE_RING_SIZE;
+    }
+    if (this->topic->read(this->cursor, sample))
+    {
+      ++this->cursor;
+      return true;
+    }
+    ++this->missed;
+    ++this->cursor;
+    count = this->topic->get_count();
+  }
+  return false;
+}
+
+template <typename T>
+SampleTopic<T>* SampleBus::topic(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto i = this->topics.find(name);
+  if (i == this->topics.end())
+  {
+    std::shared_ptr<SampleTopic<T>> topic = std::make_shared<SampleTopic<T>>();
+    this->topics.insert(std::make_pair(name, Entry {std::type_index(typeid(T)), topic}));
+    return topic.get();
+  }
+  if (i->second.type != std::type_index(typeid(T)))
+    return nullptr;
+  return static_cast<SampleTopic<T>*>(i->second.topic.get());
+}
+
+#endif // HYPED_DRIVERS_SAMPLE_BUS_HPP_
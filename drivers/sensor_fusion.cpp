@@ -0,0 +1,178 @@
+#include "sensor_fusion.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#define MAD_TO_SIGMA 1.4826 // standard deviation / median absolute deviation for normal noise
+
+// Median of the first `n` values; reorders them
+inline double median_of(double *values, int n)
+{
+  for (int i = 1; i < n; ++i)
+  {
+    double v = values[i];
+    int j = i;
+    for (; j > 0 && values[j - 1] > v; --j)
+      values[j] = values[j - 1];
+    values[j] = v;
+  }
+  return (n % 2) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+// Median of the values of online sensors and the distance from it beyond which one is an outlier
+inline void robust_stats(const double *values, const bool *online, int num_sensors,
+    double noise_floor, double& median, double& spread)
+{
+  double v[MAX_FUSED_SENSORS];
+  int n = 0;
+  for (int i = 0; i < num_sensors; ++i)
+    if (online[i])
+      v[n++] = values[i];
+  if (n == 0)
+    return;
+  median = median_of(v, n);
+  for (int i = 0; i < n; ++i)
+    v[i] = std::fabs(v[i] - median);
+  spread = OUTLIER_THRESHOLD * std::max(MAD_TO_SIGMA * median_of(v, n), noise_floor);
+}
+
+
+SensorFusion::SensorFusion(double noise_floor)
+    : num_sensors(0), noise_floor(noise_floor)
+{}
+
+int SensorFusion::add_sensor()
+{
+  if (this->num_sensors >= MAX_FUSED_SENSORS)
+    return -1;
+  int i = this->num_sensors++;
+  this->x[i] = this->y[i] = this->z[i] = 0.0;
+  this->variance[i] = this->noise_floor * this->noise_floor;
+  this->health[i] = 1.0;
+  this->failed_time[i] = 0.0;
+  this->online[i] = true;
+  return i;
+}
+
+int SensorFusion::get_count() const
+{
+  return this->num_sensors;
+}
+
+void SensorFusion::reset(Vector3D<double> value)
+{
+  for (int i = 0; i < this->num_sensors; ++i)
+  {
+    this->x[i] = value.x;
+    this->y[i] = value.y;
+    this->z[i] = value.z;
+    this->variance[i] = this->noise_floor * this->noise_floor;
+    this->health[i] = 1.0;
+    this->online[i] = true;
+  }
+  this->median = value;
+  this->spread = Vector3D<double>(1.0, 1.0, 1.0) * (OUTLIER_THRESHOLD * this->noise_floor);
+  this->value = value;
+}
+
+Vector3D<double> SensorFusion::set_reading(int sensor, Vector3D<double> reading)
+{
+  if (!this->online[sensor])
+  {
+    this->online[sensor] = true;
+    this->health[sensor] = 0.0;
+  }
+  this->x[sensor] = reading.x;
+  this->y[sensor] = reading.y;
+  this->z[sensor] = reading.z;
+
+  this->update_stats();
+
+  Vector3D<double> d = reading - this->median;
+  bool outlier = std::fabs(d.x) > this->spread.x || std::fabs(d.y) > this->spread.y
+      || std::fabs(d.z) > this->spread.z;
+  this->health[sensor] += HEALTH_GAIN * ((outlier ? 0.0 : 1.0) - this->health[sensor]);
+  if (!outlier)
+  {
+    double r2 = (d.x*d.x + d.y*d.y + d.z*d.z) / 3.0;
+    this->variance[sensor] = std::max(this->noise_floor * this->noise_floor,
+        this->variance[sensor] + VARIANCE_GAIN * (r2 - this->variance[sensor]));
+  }
+  this->fuse();
+  return this->value;
+}
+
+void SensorFusion::set_failed(int sensor, double t)
+{
+  if (this->online[sensor])
+  {
+    this->online[sensor] = false;
+    this->failed_time[sensor] = t;
+    this->update_stats();
+    this->fuse();
+  }
+  else
+  {
+    this->failed_time[sensor] = t; // failed again on retry
+  }
+}
+
+bool SensorFusion::can_read(int sensor, double t) const
+{
+  return this->online[sensor] || t - this->failed_time[sensor] >= SENSOR_RETRY_DELAY;
+}
+
+Vector3D<double> SensorFusion::get_value() const
+{
+  return this->value;
+}
+
+double SensorFusion::get_health(int sensor) const
+{
+  return this->health[sensor];
+}
+
+bool SensorFusion::is_online(int sensor) const
+{
+  return this->online[sensor];
+}
+
+int SensorFusion::get_failed_count() const
+{
+  int n = 0;
+  for (int i = 0; i < this->num_sensors; ++i)
+    n += !this->online[i];
+  return n;
+}
+
+void SensorFusion::update_stats()
+{
+  robust_stats(this->x, this->online, this->num_sensors, this->noise_floor,
+      this->median.x, this->spread.x);
+  robust_stats(this->y, this->online, this->num_sensors, this->noise_floor,
+      this->median.y, this->spread.y);
+  robust_stats(this->z, this->online, this->num_sensors, this->noise_floor,
+      this->median.z, this->spread.z);
+}
+
+void SensorFusion::fuse()
+{
+  double sum_w = 0.0, sum_x = 0.0, sum_y = 0.0, sum_z = 0.0;
+  for (int i = 0; i < this->num_sensors; ++i)
+  {
+    bool used = this->online[i] && this->health[i] >= HEALTH_MIN
+        && std::fabs(this->x[i] - this->median.x) <= this->spread.x
+        && std::fabs(this->y[i] - this->median.y) <= this->spread.y
+        && std::fabs(this->z[i] - this->median.z) <= this->spread.z;
+    double w = used ? 1.0 / this->variance[i] : 0.0;
+    sum_w += w;
+    sum_x += w * this->x[i];
+    sum_y += w * this->y[i];
+    sum_z += w * this->z[i];
+  }
+  if (sum_w > 0.0)
+    this->value = Vector3D<double>(sum_x, sum_y, sum_z) / sum_w;
+  else if (this->get_failed_count() < this->num_sensors)
+    this->value = this->median; // nobody trusted yet, e.g. all sensors just rejoined
+  // else every sensor failed: hold the last estimate
+}
@@ -0,0 +1,69 @@
+#ifndef HYPED_DRIVERS_SENSOR_FUSION_HPP_
+#define HYPED_DRIVERS_SENSOR_FUSION_HPP_
+
+#include "vector3d.hpp"
+
+#define MAX_FUSED_SENSORS 8
+#define OUTLIER_THRESHOLD 3.5 // robust standard deviations (1.4826 * MAD) from the median
+#define VARIANCE_GAIN 0.01    // per reading, for the running residual variance of each sensor
+#define HEALTH_GAIN 0.02      // per reading
+#define HEALTH_MIN 0.5        // sensors below this are left out of the estimate
+#define SENSOR_RETRY_DELAY 0.5 // s, between attempts to read a failed sensor
+
+/// Fuses the latest readings of up to MAX_FUSED_SENSORS redundant 3-axis sensors.
+/// Every reading is compared with the per-axis median of all sensors; readings further from it
+/// than OUTLIER_THRESHOLD times the median absolute deviation (but at least the noise floor)
+/// count as outliers. Each sensor has a health score, the running fraction of its readings that
+/// weren't outliers, and the estimate is the inverse-variance weighted mean of the healthy
+/// sensors whose current reading is not an outlier. It takes at least 3 online sensors to tell
+/// which one is wrong.
+/// A sensor whose read failed is left out until it gives a reading again, and then rejoins with
+/// zero health, so it has to agree with the others for a while before it's trusted.
+/// Readings must already have each sensor's own bias removed (see Calibration): the median
+/// test and the weighting take the sensors to measure the same thing alike, so an uncorrected
+/// bias makes a sensor an outlier, and whatever is left in the readings shifts the estimate
+/// whenever a sensor drops out or rejoins.
+/// Readings are kept per axis in arrays so the per-sensor loops vectorize.
+class SensorFusion
+{
+  public:
+    /// `noise_floor` is the smallest standard deviation (per axis) assumed for a sensor;
+    /// differences between sensors below a few times this are never outliers
+    SensorFusion(double noise_floor);
+
+    /// Returns the index of the new sensor, or -1 if there are already MAX_FUSED_SENSORS
+    int add_sensor();
+    int get_count() const;
+    /// All sensors read `value` (zero, for bias-corrected readings at rest), are healthy and are
+    /// online
+    void reset(Vector3D<double> value);
+    /// Updates the estimate with a new reading of `sensor` and returns the estimate
+    Vector3D<double> set_reading(int sensor, Vector3D<double> reading);
+    /// Takes `sensor` out of the estimate after a failed read at time `t`
+    void set_failed(int sensor, double t);
+    /// Whether `sensor` should be read at time `t` (online, or failed long enough ago to retry)
+    bool can_read(int sensor, double t) const;
+    Vector3D<double> get_value() const;
+    double get_health(int sensor) const;
+    bool is_online(int sensor) const;
+    /// Number of sensors currently offline after a failed read
+    int get_failed_count() const;
+
+  private:
+    void update_stats();
+    void fuse();
+
+    double x[MAX_FUSED_SENSORS], y[MAX_FUSED_SENSORS], z[MAX_FUSED_SENSORS];
+    double variance[MAX_FUSED_SENSORS]; // per axis
+    double health[MAX_FUSED_SENSORS];
+    double failed_time[MAX_FUSED_SENSORS];
+    bool online[MAX_FUSED_SENSORS];
+    int num_sensors;
+    double noise_floor;
+    // Results of the last fusion
+    Vector3D<double> median;
+    Vector3D<double> spread; // outlier distance per axis
+    Vector3D<double> value;
+};
+
+#endif // HYPED_DRIVERS_SENSOR_FUSION_HPP_
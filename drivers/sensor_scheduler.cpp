@@ -0,0 +1,113 @@
+#include "sensor_scheduler.hpp"
+
+#include <cmath>
+
+#define SLOT_MASK (SCHEDULER_WHEEL_SIZE - 1)
+
+
+SensorScheduler::SensorScheduler(double tick_rate)
+    : num_entries(0), tick(1.0 / tick_rate), start_time(0.0), current(0), started(false),
+    missed(0)
+{
+  for (int i = 0; i < SCHEDULER_WHEEL_SIZE; ++i)
+    this->slots[i] = -1;
+}
+
+bool SensorScheduler::add(double rate, Task task)
+{
+  if (this->started || this->num_entries >= MAX_SCHEDULED_TASKS)
+    return false;
+  Entry& e = this->entries[this->num_entries++];
+  e.task = task;
+  e.period = std::lround(1.0 / (rate * this->tick));
+  if (e.period < 1)
+    e.period = 1;
+  return true;
+}
+
+void SensorScheduler::clear()
+{
+  for (int i = 0; i < this->num_entries; ++i)
+    this->entries[i].task = Task();
+  this->num_entries = 0;
+  this->started = false;
+  this->missed = 0;
+}
+
+void SensorScheduler::start(double now)
+{
+  this->start_time = now;
+  this->current = 0;
+  for (int i = 0; i < SCHEDULER_WHEEL_SIZE; ++i)
+    this->slots[i] = -1;
+  for (int i = 0; i < this->num_entries; ++i)
+  {
+    this->entries[i].due = 0;
+    this->insert(i);
+  }
+  this->started = true;
+}
+
+double SensorScheduler::run_due(double now)
+{
+  // Waking up exactly at the time returned for a tick (as with a VirtualClock) has to count as
+  // that tick even when rounding puts it a hair before
+  long target = (long) std::floor((now - this->start_time) / this->tick + 1.0e-6);
+  for (; this->current <= target; ++this->current)
+  {
+    // Take the entries due in this tick off the slot (entries for later turns of the wheel stay)
+    int *link = &this->slots[this->current & SLOT_MASK];
+    int due = -1, *due_tail = &due;
+    while (*link >= 0)
+    {
+      Entry& e = this->entries[*link];
+      if (e.due == this->current)
+      {
+        *due_tail = *link;
+        due_tail = &e.next;
+        *link = e.next;
+      }
+      else
+      {
+        link = &e.next;
+      }
+    }
+    *due_tail = -1;
+
+    while (due >= 0)
+    {
+      Entry& e = this->entries[due];
+      int next = e.next;
+      e.task();
+      e.due += e.period;
+      if (e.due <= target)
+      {
+        long behind = (target - e.due) / e.period + 1;
+        this->missed += behind;
+        e.due += behind * e.period;
+      }
+      this->insert(due);
+      due = next;
+    }
+  }
+
+  long next = -1;
+  for (int i = 0; i < this->num_entries; ++i)
+    if (next < 0 || this->entries[i].due < next)
+      next = this->entries[i].due;
+  return this->start_time + next * this->tick;
+}
+
+unsigned long SensorScheduler::get_missed_count() const
+{
+  return this->missed;
+}
+
+void SensorScheduler::insert(int entry)
+{
+  int *link = &this->slots[this->entries[entry].due & SLOT_MASK];
+  while (*link >= 0 && *link < entry)
+    link = &this->entries[*link].next;
+  this->entries[entry].next = *link;
+  *link = entry;
+}
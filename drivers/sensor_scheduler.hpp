@@ -0,0 +1,55 @@
+#ifndef HYPED_DRIVERS_SENSOR_SCHEDULER_HPP_
+#define HYPED_DRIVERS_SENSOR_SCHEDULER_HPP_
+
+#include <functional>
+
+#define MAX_SCHEDULED_TASKS 32
+#define SCHEDULER_WHEEL_SIZE 64 // slots, must be a power of 2
+
+/// Runs periodic tasks (typically sensor readings), each at its own rate, from a single thread.
+/// Tasks are kept in a timing wheel with one slot per tick, so finding what is due costs the same
+/// however many tasks there are. Rates are rounded to a whole number of ticks; tasks due in the
+/// same tick run in the order they were added.
+class SensorScheduler
+{
+  public:
+    typedef std::function<void()> Task;
+
+    /// `tick_rate` (Hz) is the resolution of the schedule
+    SensorScheduler(double tick_rate);
+
+    /// Adds a task run `rate` times per second; returns false if there are already
+    /// MAX_SCHEDULED_TASKS tasks or the scheduler was started
+    bool add(double rate, Task task);
+    /// Removes all tasks so the scheduler can be set up again
+    void clear();
+    /// All tasks become due at `now` (seconds, any monotonic clock)
+    void start(double now);
+    /// Runs every task due at `now` or earlier, in order of due time, and returns the time the
+    /// next one is due. A task that fell more than a period behind skips the periods it missed
+    double run_due(double now);
+    /// Number of task runs skipped because the thread fell behind
+    unsigned long get_missed_count() const;
+
+  private:
+    struct Entry
+    {
+      Task task;
+      long period; // ticks
+      long due;    // tick
+      int next;    // next entry in the same slot, -1 if last
+    };
+
+    void insert(int entry);
+
+    Entry entries[MAX_SCHEDULED_TASKS];
+    int num_entries;
+    int slots[SCHEDULER_WHEEL_SIZE]; // first entry of each slot's list, ordered by entry index
+    double tick;                     // seconds
+    double start_time;
+    long current;                    // next tick to be processed
+    bool started;
+    unsigned long missed;
+};
+
+#endif // HYPED_DRIVERS_SENSOR_SCHEDULER_HPP_
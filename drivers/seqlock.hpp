@@ -0,0 +1,73 @@
+#ifndef HYPED_DRIVERS_SEQLOCK_HPP_
+#define HYPED_DRIVERS_SEQLOCK_HPP_
+
+#include <atomic>
+#include <cstring>
+
+/// Single-writer snapshot of a trivially copyable value. The writer never blocks and readers never
+/// block the writer; a reader that races with a write retries.
+template <typename T>
+class SeqLock
+{
+  public:
+    SeqLock() : seq(0), value()
+    {}
+    SeqLock(const T& init) : seq(0), value(init)
+    {}
+
+    SeqLock(SeqLock const&)        = delete;
+    void operator=(SeqLock const&) = delete;
+
+    /// Must only be called from one thread at a time
+    void store(const T& v);
+    /// Retries until a consistent copy is read
+    T load() const;
+    /// Makes at most `attempts` attempts; returns false (leaving `v` unchanged) if all of them
+    /// raced with the writer. Use this from threads which must not spin on a preempted writer.
+    bool try_load(T& v, int attempts = 1) const;
+
+  private:
+    std::atomic<unsigned int> seq;
+    T value;
+};
+
+template <typename T>
+void SeqLock<T>::store(const T& v)
+{
+  unsigned int s = this->seq.load(std::memory_order_relaxed);
+  this->seq.store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&this->value, &v, sizeof(T));
+  this->seq.store(s + 2, std::memory_order_release);
+}
+
+template <typename T>
+T SeqLock<T>::load() const
+{
+  T v;
+  while (!this->try_load(v, 1))
+    ;
+  return v;
+}
+
+template <typename T>
+bool SeqLock<T>::try_load(T& v, int attempts) const
+{
+  T copy;
+  for (int i = 0; i < attempts; ++i)
+  {
+    unsigned int s0 = this->seq.load(std::memory_order_acquire);
+    if (s0 & 1)
+      continue; // write in progress
+    std::memcpy(&copy, &this->value, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->seq.load(std::memory_order_relaxed) == s0)
+    {
+      v = copy;
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif // HYPED_DRIVERS_SEQLOCK_HPP_
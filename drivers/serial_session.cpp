@@ -0,0 +1,265 @@
+#include "serial_session.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+}
+
+#include "clock.hpp"
+
+#define MAX_TTY_ACM 128
+#define FRAME_TIMEOUT 200   // ms to wait for a reply to a poll before polling again
+#define REOPEN_PERIOD 500   // ms between attempts to (re)open the port
+#define MAX_TIMEOUTS 10     // consecutive timeouts after which the port is reopened
+
+
+// Framer definitions
+ArduinoFramer::ArduinoFramer() : line_len(0), overflow(false)
+{}
+
+FrameStatus ArduinoFramer::push(const char *buf, int len, ArduinoData& frame)
+{
+  FrameStatus status = FrameStatus::none;
+  for (int i = 0; i < len; ++i)
+  {
+    char c = buf[i];
+    if (c == '\n')
+    {
+      this->line[this->line_len] = '\0';
+      if (!this->overflow && ArduinoFramer::parse(this->line, frame))
+        status = FrameStatus::valid;
+      else if (status != FrameStatus::valid)
+        status = FrameStatus::invalid;
+      this->line_len = 0;
+      this->overflow = false;
+    }
+    else if (c == '\r')
+    {
+      continue;
+    }
+    else if (this->line_len < ARDUINO_MAX_FRAME_LEN)
+    {
+      this->line[this->line_len++] = c;
+    }
+    else
+    {
+      this->overflow = true; // drop the rest of this frame
+    }
+  }
+  return status;
+}
+
+bool ArduinoFramer::parse(const char *line, ArduinoData& frame)
+{
+  float values[ARDUINO_NUM_FIELDS];
+  int n = 0;
+  const char *p = line;
+  char *end;
+  while (n < ARDUINO_NUM_FIELDS)
+  {
+    float v = strtof(p, &end);
+    if (end == p)
+      break;
+    values[n++] = v;
+    p = end;
+  }
+  // Anything other than whitespace left over means a corrupted frame
+  while (*p == ' ' || *p == '\t')
+    ++p;
+  if (*p != '\0' || n < ARDUINO_NUM_FIELDS - 1)
+    return false;
+
+  frame.current = values[0];
+  for (int i = 0; i < 7; ++i)
+    frame.cell_voltage[i] = values[1 + i];
+  frame.big_battery_voltage = values[8];
+  frame.big_battery_temp = values[9];
+  frame.small_battery_voltage = values[10];
+  frame.small_battery_temp = values[11];
+  frame.pump_pressure = values[12];
+  frame.accumulator_pressure = values[13];
+  frame.small_current = (n == ARDUINO_NUM_FIELDS) ? values[14] : -1.0f;
+  return true;
+}
+
+
+// Session definitions
+SerialSession::SerialSession(std::string device)
+    : requested_device(device)
+{
+  ArduinoData empty;
+  std::memset(&empty, 0, sizeof(empty));
+  this->data.store(empty);
+}
+
+SerialSession::~SerialSession()
+{
+  this->stop();
+}
+
+void SerialSession::start()
+{
+  if (!this->stop_flag)
+    return;
+  this->stop_flag = false;
+  this->reading_thread = std::thread(&SerialSession::run, this);
+}
+
+void SerialSession::stop()
+{
+  this->stop_flag = true;
+  if (this->reading_thread.joinable())
+    this->reading_thread.join();
+}
+
+bool SerialSession::is_connected()
+{
+  return this->connected.load(std::memory_order_relaxed);
+}
+
+ArduinoData SerialSession::get_data()
+{
+  return this->data.load();
+}
+
+double SerialSession::get_pressure()
+{
+  ArduinoData d = this->get_data();
+  return (d.frame_count > 0) ? d.accumulator_pressure : -1.0;
+}
+
+void SerialSession::run()
+{
+  char buf[ARDUINO_MAX_FRAME_LEN];
+  const char poll_byte = ARDUINO_POLL_BYTE;
+  ArduinoData frame = this->data.load();
+  int timeouts = 0;
+
+  // Timeouts are for the Arduino's replies, so always in real time
+  RealClock& clock = RealClock::instance();
+  double next_poll = clock.now();
+  while (!this->stop_flag)
+  {
+    if (this->fd < 0 && !this->open_port())
+    {
+      clock.sleep_for(REOPEN_PERIOD / 1000.0);
+      continue;
+    }
+    // Pressures and battery readings change slowly; don't keep the Arduino and the bus busy
+    clock.sleep_until(next_poll);
+    next_poll = std::max(next_poll + ARDUINO_POLL_PERIOD / 1000.0, clock.now());
+
+    // Request a frame and wait for it to be completed
+    if (::write(this->fd, &poll_byte, 1) != 1)
+    {
+      this->close_port();
+      continue;
+    }
+    bool got_reply = false;
+    double deadline = clock.now() + FRAME_TIMEOUT / 1000.0;
+    while (!got_reply && !this->stop_flag)
+    {
+      int wait = (int) ((deadline - clock.now()) * 1000.0);
+      if (wait <= 0)
+        break;
+      struct pollfd pfd = {this->fd, POLLIN, 0};
+      int ret = poll(&pfd, 1, wait);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0)
+        break;
+      if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+      {
+        this->close_port();
+        break;
+      }
+      ssize_t len = ::read(this->fd, buf, sizeof(buf));
+      if (len <= 0)
+      {
+        if (len < 0 && (errno == EAGAIN || errno == EINTR))
+          continue;
+        this->close_port();
+        break;
+      }
+      FrameStatus status = this->framer.push(buf, (int) len, frame);
+      if (status == FrameStatus::valid)
+      {
+        frame.timestamp = clock.now();
+        ++frame.frame_count;
+        this->data.store(frame);
+      }
+      // A corrupted reply is dropped and the next frame requested straight away
+      got_reply = (status != FrameStatus::none);
+    }
+
+    if (got_reply)
+      timeouts = 0;
+    else if (this->fd >= 0 && ++timeouts >= MAX_TIMEOUTS)
+      this->close_port(); // device probably reset; rediscover it
+  }
+  this->close_port();
+}
+
+bool SerialSession::open_port()
+{
+  this->device = this->requested_device.empty() ?
+      SerialSession::find_port() : this->requested_device;
+  if (this->device.empty())
+    return false;
+
+  this->fd = open(this->device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (this->fd < 0)
+  {
+    fprintf(stderr, "Unable to open serial device %s: %s\n",
+        this->device.c_str(), strerror(errno));
+    return false;
+  }
+
+  // Raw 8N1 at ARDUINO_BAUD_RATE
+  struct termios options;
+  if (tcgetattr(this->fd, &options) == 0)
+  {
+    cfmakeraw(&options);
+    cfsetispeed(&options, B115200);
+    cfsetospeed(&options, B115200);
+    options.c_cflag |= (CLOCAL | CREAD);
+    options.c_cflag &= ~(PARENB | CSTOPB | CSIZE);
+    options.c_cflag |= CS8;
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 0;
+    tcsetattr(this->fd, TCSANOW, &options);
+  }
+  tcflush(this->fd, TCIOFLUSH);
+
+  this->framer = ArduinoFramer();
+  this->connected = true;
+  return true;
+}
+
+void SerialSession::close_port()
+{
+  if (this->fd >= 0)
+    close(this->fd);
+  this->fd = -1;
+  this->connected = false;
+}
+
+std::string SerialSession::find_port()
+{
+  char path[20];
+  for (int i = 0; i < MAX_TTY_ACM; ++i)
+  {
+    snprintf(path, sizeof(path), "/dev/ttyACM%d", i);
+    if (access(path, F_OK) != -1)
+      return path;
+  }
+  return "";
+}
@@ -0,0 +1,99 @@
+#ifndef HYPED_DRIVERS_SERIAL_SESSION_HPP_
+#define HYPED_DRIVERS_SERIAL_SESSION_HPP_
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "interfaces.hpp"
+#include "seqlock.hpp"
+
+#define ARDUINO_BAUD_RATE 115200
+#define ARDUINO_MAX_FRAME_LEN 512
+#define ARDUINO_NUM_FIELDS 15
+#define ARDUINO_POLL_BYTE 1
+#define ARDUINO_POLL_PERIOD 20 // ms, shortest time between polls
+
+// One frame sent by the battery/pressure monitoring Arduino, in the order it is transmitted
+struct ArduinoData
+{
+  float current;
+  std::array<float, 7> cell_voltage;
+  float big_battery_voltage;
+  float big_battery_temp;
+  float small_battery_voltage;
+  float small_battery_temp;
+  float pump_pressure;
+  float accumulator_pressure;
+  float small_current; // -1 if not sent by the Arduino (older sketches send 14 fields)
+
+  double timestamp;         // steady clock time at which the frame was completed (seconds)
+  unsigned int frame_count; // number of valid frames received so far (0 means no data yet)
+};
+
+enum class FrameStatus
+{
+  none,    // no frame completed yet
+  valid,   // a frame was completed and parsed
+  invalid  // a frame was completed but was malformed or too long
+};
+
+/// Splits the byte stream coming from the Arduino into newline-terminated frames and parses them.
+/// Frames longer than ARDUINO_MAX_FRAME_LEN are discarded up to the next newline.
+class ArduinoFramer
+{
+  public:
+    ArduinoFramer();
+
+    /// Consumes `len` bytes of `buf`; valid frames are stored in `frame` as they complete.
+    /// Returns `valid` if any frame in `buf` was valid, else the status of the last one completed
+    FrameStatus push(const char *buf, int len, ArduinoData& frame);
+
+    /// Parses a single frame (without the newline); returns false if it is malformed
+    static bool parse(const char *line, ArduinoData& frame);
+
+  private:
+    char line[ARDUINO_MAX_FRAME_LEN + 1];
+    int line_len;
+    bool overflow;
+};
+
+/// Keeps the serial link to the Arduino open and polls it for frames on a background thread.
+/// The port is discovered once (or given explicitly) and reopened only if it goes away.
+/// Frames are polled at most every ARDUINO_POLL_PERIOD and published without locking.
+/// As a PressureSensor it reports the accumulator pressure.
+class SerialSession : public PressureSensor
+{
+  public:
+    /// If `device` is empty, the first existing /dev/ttyACM* is used
+    SerialSession(std::string device = "");
+    ~SerialSession();
+
+    SerialSession(SerialSession const&)  = delete;
+    void operator=(SerialSession const&) = delete;
+
+    void start();
+    void stop();
+    bool is_connected();
+    /// Returns the latest frame (frame_count == 0 if nothing has been received yet)
+    ArduinoData get_data();
+    virtual double get_pressure();
+
+  private:
+    void run();
+    bool open_port();
+    void close_port();
+    static std::string find_port();
+
+    std::string device;
+    std::string requested_device;
+    int fd = -1;
+    ArduinoFramer framer;
+    SeqLock<ArduinoData> data;
+    std::atomic_bool connected {false};
+    std::atomic_bool stop_flag {true};
+    std::thread reading_thread;
+};
+
+#endif // HYPED_DRIVERS_SERIAL_SESSION_HPP_
@@ -0,0 +1,100 @@
+#ifndef HYPED_DRIVERS_SIM_CYLINDER_HPP_
+#define HYPED_DRIVERS_SIM_CYLINDER_HPP_
+
+#include <cmath>
+#include <mutex>
+#include <random>
+
+#include "clock.hpp"
+#include "interfaces.hpp"
+
+/// Simulated hydraulic brake cylinder with the gap proxi looking at it. The piston moves at a
+/// constant speed while a valve is open, reaching it with a first-order lag, and stops at its end
+/// stops. Time is taken from Clock::get() so it can stand in for the real hardware in loops.
+class SimulatedCylinder : public Proxi
+{
+  public:
+    SimulatedCylinder(double gap = 80.0, unsigned int seed = 1)
+        : gap(gap), noise(0.0, 0.5), rng(seed)
+    {
+      this->last_update = Clock::get().now();
+    }
+
+    double extend_speed = 40.0;  // mm/s
+    double retract_speed = 60.0; // mm/s
+    double valve_lag = 0.02;     // time constant of the piston speed (s)
+    double min_gap = 60.0;       // mm
+    double max_gap = 160.0;      // mm
+
+    void set_command(BrakeCommand command)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->advance();
+      this->command = command;
+    }
+
+    double get_gap()
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->advance();
+      return this->gap;
+    }
+
+    virtual int get_distance()
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->advance();
+      return (int) std::lround(this->gap + this->noise(this->rng));
+    }
+
+  private:
+    void advance()
+    {
+      double now = Clock::get().now();
+      double dt = now - this->last_update;
+      this->last_update = now;
+
+      double target_speed = 0.0;
+      if (this->command == BrakeCommand::extend)
+        target_speed = this->extend_speed;
+      else if (this->command == BrakeCommand::retract)
+        target_speed = -this->retract_speed;
+      this->speed += (target_speed - this->speed) * (1.0 - std::exp(-dt / this->valve_lag));
+      this->gap += this->speed * dt;
+      if (this->gap < this->min_gap || this->gap > this->max_gap)
+      {
+        this->gap = (this->gap < this->min_gap) ? this->min_gap : this->max_gap;
+        this->speed = 0.0;
+      }
+    }
+
+    std::mutex mutex;
+    double gap;
+    double speed = 0.0;
+    BrakeCommand command = BrakeCommand::hold;
+    double last_update;
+    std::normal_distribution<double> noise;
+    std::mt19937 rng;
+};
+
+/// Pair of simulated cylinders driven like the real hydraulics
+class SimulatedBrakes : public BrakeActuator
+{
+  public:
+    SimulatedBrakes(double left_gap = 80.0, double right_gap = 80.0)
+        : left(left_gap, 1), right(right_gap, 2)
+    {}
+
+    virtual void actuate(RailSide side, BrakeCommand command)
+    {
+      if (side == RailSide::left)
+        this->left.set_command(command);
+      else
+        this->right.set_command(command);
+    }
+
+    SimulatedCylinder left;
+    SimulatedCylinder right;
+};
+
+#endif // HYPED_DRIVERS_SIM_CYLINDER_HPP_
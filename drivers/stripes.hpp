@@ -0,0 +1,20 @@
+#ifndef HYPED_DRIVERS_STRIPES_HPP_
+#define HYPED_DRIVERS_STRIPES_HPP_
+
+#define NUM_STRIPES 63
+#define STRIPE_UNIT 0.3048 // m per unit of stripe_locations (ft)
+#define STRIPE_WIDTH 0.1016 // m
+#define STRIPE_DISTANCE 30.0 // m travelled per stripe counted, as assumed by the stripe counters
+
+/// Where the stripes start along the track
+const int stripe_locations[NUM_STRIPES] =
+    {0, 100, 200, 300, 400, 500, 600, 700, 800, 900, 
+    1000, 1100, 1200, 1300, 1400, 1500, 1600, 1700, 1800, 1900, 
+    2000, 2100, 2200, 2300, 2400, 2500, 2600, 2700, 2800, 2900, 
+    3000, 3100, 3200, 3300, 3400, 3500, 3600, 3700, 3800, 3900, 
+    4000, 4008, 4016, 4024, 4032, 4040, 4048, 4056, 4064, 4072,
+    4100, 4200, 4300, 4400, 
+    4500, 4508, 4516, 4524, 4532,
+    4600, 4700, 4800, 4900};
+
+#endif // HYPED_DRIVERS_STRIPES_HPP_
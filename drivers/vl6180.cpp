@@ -2,6 +2,8 @@
 
 #include <sstream>
 
+#include "clock.hpp"
+
 
 // Register addresses
 #define IDENTIFICATION__MODEL_ID              0x0000
@@ -137,10 +139,10 @@ void Vl6180::turn_on()
   if (this->on)
     return;
   // Wait in case the sensor has just been turned off
-  std::this_thread::sleep_for(std::chrono::milliseconds(100)); //datasheet mentions 100ns but not sure
+  Clock::get().sleep_for(0.1); //datasheet mentions 100ns but not sure
   // Turn on and wait for MCU boot
   this->gpio_pin.write(true);
-  std::this_thread::sleep_for(std::chrono::milliseconds(2)); //datasheet says minimum 1.4ms
+  Clock::get().sleep_for(0.002); //datasheet says minimum 1.4ms
   this->on = true;
 
   // Set the I2C slave address
@@ -292,14 +294,24 @@ bool Vl6180::wait_device_ready()
 }
 
 uint8_t Vl6180::poll_measurement()
+{
+  this->start_ranging();
+  while (!this->is_range_ready());
+  return this->finish_ranging();
+}
+
+void Vl6180::start_ranging()
 {
   this->write8(SYSRANGE__START, RANGING_MODE_SINGLESHOT | SYSRANGE__STARTSTOP);
-  uint8_t status;
-  do
-  {
-    status = this->read8(RESULT__INTERRUPT_STATUS_GPIO);
-  }
-  while ((status & RESULT_INT_RANGE_GPIO_MASK) != 4);
+}
+
+bool Vl6180::is_range_ready()
+{
+  return (this->read8(RESULT__INTERRUPT_STATUS_GPIO) & RESULT_INT_RANGE_GPIO_MASK) == 4;
+}
+
+uint8_t Vl6180::finish_ranging()
+{
   this->write8(SYSTEM__INTERRUPT_CLEAR, CLEAR_RANGE_INT);
   return this->get_measurement();
 }
@@ -356,6 +368,80 @@ uint8_t Vl6180::read8(uint16_t reg_addr)
 
 
 
+int Vl6180Group::add_sensor(Vl6180& sensor)
+{
+  this->sensors.push_back(&sensor);
+  this->started.push_back(0.0);
+  this->ranging.push_back(false);
+  this->late.push_back(false);
+  return this->sensors.size() - 1;
+}
+
+int Vl6180Group::get_distances(ProxiReading* readings)
+{
+  Clock& clock = Clock::get();
+  int pending = 0;
+  int fresh = 0;
+  for (unsigned int i = 0; i < this->sensors.size(); ++i)
+  {
+    Vl6180* s = this->sensors[i];
+    this->ranging[i] = false;
+    // A sensor which fails keeps its last reading and doesn't hold up the others
+    readings[i].fresh = false;
+    try
+    {
+      if (s->cont_mode)
+      {
+        readings[i].distance = (int) s->get_measurement() - s->offset;
+        readings[i].timestamp = -1.0;
+        readings[i].fresh = true;
+        ++fresh;
+      }
+      else
+      {
+        // A result which came in after it was given up on would be taken for the new one
+        if (this->late[i])
+          s->write8(SYSTEM__INTERRUPT_CLEAR, CLEAR_RANGE_INT);
+        this->late[i] = false;
+        this->started[i] = clock.now();
+        s->start_ranging();
+        this->ranging[i] = true;
+        ++pending;
+      }
+    }
+    catch (Vl6180Exception& e) {}
+  }
+  // Take results in whatever order the sensors converge in, giving up on a sensor which stops
+  // answering rather than waiting for it for ever
+  double deadline = clock.now() + VL6180_GROUP_TIMEOUT;
+  while (pending > 0 && clock.now() < deadline)
+    for (unsigned int i = 0; i < this->sensors.size(); ++i)
+    {
+      Vl6180* s = this->sensors[i];
+      if (!this->ranging[i])
+        continue;
+      try
+      {
+        if (!s->is_range_ready())
+          continue;
+        readings[i].distance = (int) s->finish_ranging() - s->offset;
+        readings[i].timestamp = (this->started[i] + clock.now()) / 2.0;
+        readings[i].fresh = true;
+        ++fresh;
+      }
+      catch (Vl6180Exception& e) {}
+      this->ranging[i] = false;
+      --pending;
+    }
+  for (unsigned int i = 0; i < this->sensors.size(); ++i)
+    if (this->ranging[i])
+    {
+      this->ranging[i] = false;
+      this->late[i] = true;
+    }
+  return fresh;
+}
+
 Vl6180Exception::Vl6180Exception(std::string msg, int pin_num)
   : wpi_pin_num(pin_num), message(msg)
 {}
@@ -8,6 +8,7 @@
 #include <map>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "gpio.hpp"
 #include "i2c.hpp"
@@ -15,6 +16,7 @@
 
 #define DEFAULT_I2C_SLAVE_ADDR 0x29
 #define MAX_SENSORS 9 //maximum number of VL6180 units which can be connected to a single i2c bus
+#define VL6180_GROUP_TIMEOUT 0.06 // s, longer than the default maximum convergence time (49 ms)
 
 class Vl6180;
 
@@ -42,6 +44,7 @@ class Vl6180Factory
 class Vl6180 : public Proxi
 {
   friend class Vl6180Factory;
+  friend class Vl6180Group;
   public:
     void turn_on();
     void turn_off();
@@ -62,6 +65,10 @@ class Vl6180 : public Proxi
 
     bool wait_device_ready();
     uint8_t poll_measurement();
+    /// A single-shot measurement in three steps, so that several can run at once
+    void start_ranging();
+    bool is_range_ready();
+    uint8_t finish_ranging();
     uint8_t get_measurement();
     bool is_fresh_out_of_reset();
     void write8(uint16_t reg_addr, char data);
@@ -75,6 +82,27 @@ class Vl6180 : public Proxi
     int offset = 0;
 };
 
+/// Vl6180s read together. Sensors in single-shot mode are all started before any is waited
+/// for, so the group takes about one convergence time rather than one per sensor; sensors in
+/// continuous mode range by themselves and their latest results are just read
+class Vl6180Group : public ProxiGroup
+{
+  public:
+    /// Returns the sensor's index in the group
+    int add_sensor(Vl6180& sensor);
+    virtual int size() { return this->sensors.size(); }
+    /// Single-shot readings are stamped halfway between starting and finishing them, continuous
+    /// ones (taken some time in the last intermeasurement period) aren't. Single-shot
+    /// measurements not ready within VL6180_GROUP_TIMEOUT are given up on (not fresh)
+    virtual int get_distances(ProxiReading* readings);
+
+  private:
+    std::vector<Vl6180*> sensors;
+    std::vector<double> started; // when each single-shot measurement was started
+    std::vector<bool> ranging;
+    std::vector<bool> late; // given up on, so its result may still turn up
+};
+
 class Vl6180Exception : public std::exception
 {
   public:
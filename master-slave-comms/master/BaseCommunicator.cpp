@@ -4,51 +4,33 @@
 #include <thread>
 using namespace std;
 
-int sockfd, portNo, n;
-struct sockaddr_in serv_addr;
-struct hostent *server;
-char buffer[256];
-char* ipAddress = "localHost";
-		
-BaseCommunicator :: BaseCommunicator()
+#define BASE_STATION_PORT 5695
+
+BaseCommunicator :: BaseCommunicator() : ipAddress((char*) "localhost"), connection(ipAddress, BASE_STATION_PORT)
 {
 	
 }
 
-BaseCommunicator :: BaseCommunicator(char* ip)
+BaseCommunicator :: BaseCommunicator(char* ip) : ipAddress(ip), connection(ip, BASE_STATION_PORT)
 {
-	ipAddress = ip;
 }
 
 bool BaseCommunicator :: setUp()
 {
-	portNo = 5695;
-	sockfd = socket(AF_INET, SOCK_STREAM, 0);
-	if (sockfd < 0)
-	{
-		printf("ERROR: CANNOT OPEN SOCKET.");
-		return false;
-	}
-	server = gethostbyname(ipAddress);	// Declare static IP constant when known
-	
-	if (server == NULL) 
+	// Resolved once; from here on the link is remade in the background whenever it drops
+	if (connection.get_address() == NULL) 
 	{ 
 		fprintf
 			(
 				stderr,
 				"ERROR: INCORRECT BASE-STATION IP, OR BASE-STATION S/W NOT RUNNING.\n"
 			);
-		return 0;
+		return false;
 	}	
 	
-	bzero((char *) &serv_addr, sizeof(serv_addr));
-	serv_addr.sin_family = AF_INET;
-	bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length);
-	serv_addr.sin_port = htons(portNo);
-	
-	if (connect(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+	if (!connection.open())
 	{	
-		printf("ERROR: CANNOT ESTABLISH CONNECTION TO BASE-STATION.");
+		printf("ERROR: CANNOT ESTABLISH CONNECTION TO BASE-STATION, RETRYING.");
 		return false;
 	}
 	
@@ -58,7 +40,6 @@ bool BaseCommunicator :: setUp()
 BaseCommunicator :: ~BaseCommunicator()
 {
 	// DESTRUCTOR: upon deletion of pointer to object (instance of this class), socket to base will be closed.
-	close(sockfd);
 }
 
 int BaseCommunicator :: setName(int name)
@@ -68,6 +49,8 @@ int BaseCommunicator :: setName(int name)
 			"Master\n", "Slave_0\n", "Slave_1\n", "Slave_2\n", "Slave_3\n", "Slave_4\n"
 		};
 	
+	// Sent again first thing on every reconnection, so the base station knows who it's talking to
+	connection.set_greeting(nameList[name]);
 	return sendData(nameList[name]);
 		
 }
@@ -278,22 +261,18 @@ int BaseCommunicator :: sendBattery3Current(float current)
 int BaseCommunicator :: sendData(string message)
 {
 	// Incoming strings should be terminated by "...\n".
-	bzero(buffer,256);
-	const char *data = message.c_str();
-	n = write(sockfd, data, strlen(data));
-	if (n < 0) printf("ERROR: CANNOT WRITE TO SOCKET.");
-	n = read(sockfd, buffer, 255);
-	if (n < 0) printf("ERROR: CANNOT READ FROM SOCKET.");
-	return atoi(buffer);
+	// Messages which can't be sent are queued and sent once reconnected. Nothing depends on the
+	// echo, so one missing doesn't drop them
+	if (!connection.send(message)) printf("ERROR: CANNOT WRITE TO SOCKET.");
+	string echo = connection.receive(255, false);
+	if (echo.empty()) printf("ERROR: CANNOT READ FROM SOCKET.");
+	return atoi(echo.c_str());
 }
 
 void BaseCommunicator :: sendDataWithoutEcho(string message)
 {
 	// Incoming strings should be terminated by "...\n".
-	bzero(buffer,256);
-	const char *data = message.c_str();
-	n = write(sockfd, data, strlen(data));
-	if (n < 0) printf("ERROR: CANNOT WRITE TO SOCKET.");
+	if (!connection.send(message)) printf("ERROR: CANNOT WRITE TO SOCKET.");
 	//n = read(sockfd, buffer, 255);
 	//if (n < 0) printf("ERROR: CANNOT READ FROM SOCKET.");
 }
@@ -325,24 +304,18 @@ int BaseCommunicator :: sendPositionXYZ(float x, float y, float z)
 string BaseCommunicator :: requestBrakeState()
 {
 	// returns "BRK1" 0 to to retract brakes, "BRK1" to deploy
-	char readBuffer[512];
-	memset(readBuffer, 0x00, sizeof(readBuffer));
 	sendDataWithoutEcho("CMD28\n");
-	int n = read(sockfd, readBuffer, sizeof(readBuffer)); 
-	if (strcmp(readBuffer, "-1") == 0) requestBrakeState();
-	string output = readBuffer;
+	string output = connection.receive(511);
+	if (output == "-1") return requestBrakeState();
 	return output;
 }
 
 string BaseCommunicator :: requestReadyState()
 {
 	// returns "RDY1" when ready to launch
-	char readBuffer[512];
-	memset(readBuffer, 0x00, sizeof(readBuffer));
 	sendDataWithoutEcho("CMD29\n");
-	int n = read(sockfd, readBuffer, sizeof(readBuffer));
-	if (strcmp(readBuffer, "-1") == 0) requestReadyState();
-	string output = readBuffer;
+	string output = connection.receive(511);
+	if (output == "-1") return requestReadyState();
 	return output;
 }
 
@@ -350,12 +323,9 @@ string BaseCommunicator :: requestPowerState()
 {
 	// returns "PWR1" when batteries should be online,
 	//	"PWR0" to take batteries offline
-	char readBuffer[512];
-	memset(readBuffer, 0x00, sizeof(readBuffer));
 	sendDataWithoutEcho("CMD30\n");
-	int n = read(sockfd, readBuffer, sizeof(readBuffer));
-	if (strcmp(readBuffer, "-1") == 0) requestPowerState();
-	string output = readBuffer;
+	string output = connection.receive(511);
+	if (output == "-1") return requestPowerState();
 	return output;
 }
 
@@ -363,42 +333,34 @@ string BaseCommunicator :: requestMotorState()
 {
 	// returns "STOP" for service propulsion OFF,
 	//	"FRWD" to PWM motor forward, and "BACK" for reverse
-	char readBuffer[512];
-	memset(readBuffer, 0x00, sizeof(readBuffer));
 	sendDataWithoutEcho("CMD31\n");
-	int n = read(sockfd, readBuffer, sizeof(readBuffer));
-	if (strcmp(readBuffer, "-1") == 0) requestMotorState();
-	string output = readBuffer;
+	string output = connection.receive(511);
+	if (output == "-1") return requestMotorState();
 	return output;
 }
 
 // Thread must be declared and joined within calling code.
 void BaseCommunicator :: receiverThread()
 {
-	 char readBuffer[512];
+	// Carries on through reconnections
 	while (true) 
 	{
-		memset(readBuffer, 0x00, sizeof(readBuffer));
-		int n = read(sockfd, readBuffer, sizeof(readBuffer));
-		if (n <= 0) /*return*/break;
-		if ( strcmp(readBuffer, "1") != 0 )
-			cout<<readBuffer;
+		string data = connection.receive(511, false);
+		if (!data.empty() && data != "1")
+			cout<<data;
 	}
 }
 
 void BaseCommunicator :: receiverThread(string &message)
 {
-	char readBuffer[512];
-	 
 	/*while (true) 
 	{*/
-		memset(readBuffer, 0x00, sizeof(readBuffer));
-		int n = read(sockfd, readBuffer, sizeof(readBuffer));
-		if (n <= 0) return/*break*//*message = "-1"*/;
-		if ( strcmp(readBuffer, "1") != 0 )
+		string data = connection.receive(511, false);
+		if (data.empty()) return/*break*//*message = "-1"*/;
+		if ( data != "1" )
 			//cout<<readBuffer;
 		{
-			message = readBuffer;
+			message = data;
 		}
 	//}
 }
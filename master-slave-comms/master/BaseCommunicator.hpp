@@ -9,17 +9,17 @@
 #include <netdb.h>
 #include <string>
 #include <iostream>
+
+#include "ConnectionManager.hpp"
+
 using namespace std;
 
 class BaseCommunicator
 {
 	
 	private:
-		int sockfd, portno, n;
-		struct sockaddr_in serv_addr;
-		struct hostent *server;
-		char buffer[256];
 		char* ipAddress;
+		ConnectionManager connection;	// remade whenever the link to the base station drops
 	
 	public:
 		BaseCommunicator();
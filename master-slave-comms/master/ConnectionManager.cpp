@@ -0,0 +1,371 @@
+#include "ConnectionManager.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+
+// Connection deadlines are in real time whatever clock the rest of the pod runs on
+static double seconds()
+{
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int milliseconds(double duration)
+{
+  return std::max(0, (int) std::ceil(duration * 1000.0));
+}
+
+
+ConnectionManager::ConnectionManager(std::string address, int port, ConnectionConfig config)
+    : address(address), port(port), config(config), backoff(config.min_backoff)
+{
+  std::memset(&this->peer, 0, sizeof(this->peer));
+}
+
+ConnectionManager::~ConnectionManager()
+{
+  if (this->fd >= 0)
+    close(this->fd);
+}
+
+bool ConnectionManager::resolve()
+{
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* info;
+  if (getaddrinfo(this->address.c_str(), std::to_string(this->port).c_str(), &hints, &info) != 0)
+    return false;
+  std::memcpy(&this->peer, info->ai_addr, sizeof(this->peer));
+  freeaddrinfo(info);
+  this->resolved = true;
+  return true;
+}
+
+const struct sockaddr_in* ConnectionManager::get_address()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->resolved || this->resolve() ? &this->peer : nullptr;
+}
+
+void ConnectionManager::start_connecting(double now)
+{
+  if (!this->resolved && !this->resolve())
+  {
+    this->fail(now);
+    return;
+  }
+  this->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (this->fd < 0)
+  {
+    this->fail(now);
+    return;
+  }
+  // Keepalives notice a dead link while it's idle, the user timeout while data waits on it
+  int on = 1;
+  setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  setsockopt(this->fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+  setsockopt(this->fd, IPPROTO_TCP, TCP_KEEPIDLE, &this->config.keepalive_idle, sizeof(int));
+  setsockopt(this->fd, IPPROTO_TCP, TCP_KEEPINTVL, &this->config.keepalive_interval, sizeof(int));
+  setsockopt(this->fd, IPPROTO_TCP, TCP_KEEPCNT, &this->config.keepalive_count, sizeof(int));
+#ifdef TCP_USER_TIMEOUT
+  unsigned int user_timeout = this->config.user_timeout;
+  setsockopt(this->fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout, sizeof(user_timeout));
+#endif
+  this->state = State::connecting;
+  this->connect_deadline = now + this->config.connect_timeout;
+  if (::connect(this->fd, (struct sockaddr*) &this->peer, sizeof(this->peer)) == 0)
+    this->connected(now);
+  else if (errno != EINPROGRESS)
+    this->fail(now);
+}
+
+void ConnectionManager::connected(double now)
+{
+  this->state = State::up;
+  ++this->connections;
+  this->backoff = this->config.min_backoff;
+  // Whole lines from the last connection are answers still to be read; the end of one cut
+  // short never comes
+  this->received.erase(this->received.rfind('\n') + 1);
+  this->sent_offset = 0;  // a message cut short is sent again whole
+  // The socket's buffer is empty, so the greeting goes in one send
+  if (!this->greeting.empty() && ::send(this->fd, this->greeting.c_str(), this->greeting.length(),
+      MSG_NOSIGNAL) != (ssize_t) this->greeting.length())
+    this->fail(now);
+}
+
+void ConnectionManager::fail(double now)
+{
+  // A request none of whose answer came may have been lost with the link, so it is sent again
+  // if that's safe. One answered in part reached the peer, and its answer is lost
+  if (this->state == State::up)
+  {
+    for (auto i = this->unanswered.rbegin(); i != this->unanswered.rend(); ++i)
+      if (this->config.replay && i->unanswered == i->replies)
+      {
+        this->queued_bytes += i->text.length();
+        this->queue.push_front(std::move(*i));
+      }
+      else
+        ++this->dropped;
+    this->unanswered.clear();
+    this->unanswered_bytes = 0;
+  }
+  if (this->fd >= 0)
+    close(this->fd);
+  this->fd = -1;
+  // A failed connection attempt may mean the peer has moved
+  if (this->state == State::connecting)
+    this->resolved = false;
+  this->state = State::down;
+  this->sent_offset = 0;
+  this->next_attempt = now + this->backoff;
+  this->backoff = std::min(2.0 * this->backoff, this->config.max_backoff);
+}
+
+void ConnectionManager::abandon(double now)
+{
+  // A reply that doesn't come is as good as a missed heartbeat. The caller has given up on it,
+  // so nothing it sent may be answered late: reconnecting drops a late reply on the way, and
+  // what wasn't sent yet (or would be sent again) goes too
+  this->dropped += this->queue.size();
+  this->queue.clear();
+  this->queued_bytes = 0;
+  this->unanswered.clear();
+  this->unanswered_bytes = 0;
+  this->received.clear();
+  if (this->state != State::down)
+    this->fail(now);
+}
+
+bool ConnectionManager::maintain(double now)
+{
+  if (this->state == State::down && now >= this->next_attempt)
+    this->start_connecting(now);
+  if (this->state == State::connecting)
+  {
+    struct pollfd p = {this->fd, POLLOUT, 0};
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (poll(&p, 1, 0) == 1)
+    {
+      if (getsockopt(this->fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0)
+        this->connected(now);
+      else
+        this->fail(now);
+    }
+    else if (now >= this->connect_deadline)
+      this->fail(now);
+  }
+  return this->state == State::up;
+}
+
+void ConnectionManager::flush(double now)
+{
+  while (this->state == State::up && !this->queue.empty())
+  {
+    const std::string& message = this->queue.front().text;
+    ssize_t n = ::send(this->fd, message.c_str() + this->sent_offset,
+        message.length() - this->sent_offset, MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        this->fail(now);
+      return;
+    }
+    this->sent_offset += n;
+    if (this->sent_offset == message.length())
+    {
+      this->queued_bytes -= message.length();
+      if (this->queue.front().replies > 0)
+      {
+        this->unanswered_bytes += message.length();
+        this->unanswered.push_back(std::move(this->queue.front()));
+      }
+      this->queue.pop_front();
+      this->sent_offset = 0;
+      // The oldest are then taken as answered, should their answers come after all
+      while (this->unanswered_bytes > this->config.replay_bytes)
+      {
+        this->unanswered_bytes -= this->unanswered.front().text.length();
+        this->unanswered.pop_front();
+      }
+    }
+  }
+}
+
+void ConnectionManager::answer(size_t lines)
+{
+  while (lines > 0 && !this->unanswered.empty())
+  {
+    Message& request = this->unanswered.front();
+    size_t n = std::min(lines, (size_t) request.unanswered);
+    request.unanswered -= n;
+    lines -= n;
+    if (request.unanswered == 0)
+    {
+      this->unanswered_bytes -= request.text.length();
+      this->unanswered.pop_front();
+    }
+  }
+}
+
+bool ConnectionManager::fill(std::unique_lock<std::mutex>& lock, double deadline)
+{
+  while (true)
+  {
+    double now = seconds();
+    if (this->maintain(now))
+      this->flush(now);
+    if (now >= deadline)
+      return false;
+
+    // Wait for data (or room for what's queued), the connection or the next attempt at one,
+    // letting other threads in meanwhile
+    int fd = this->fd;
+    State state = this->state;
+    struct pollfd p = {fd, POLLIN, 0};
+    double until = deadline;
+    if (state == State::up && !this->queue.empty())
+      p.events |= POLLOUT;
+    else if (state == State::connecting)
+    {
+      p.events = POLLOUT;
+      until = std::min(deadline, this->connect_deadline);
+    }
+    else if (state == State::down)
+      until = std::min(deadline, this->next_attempt);
+    lock.unlock();
+    int ready = 0;
+    if (state == State::down)
+      std::this_thread::sleep_for(std::chrono::duration<double>(until - now));
+    else
+      ready = poll(&p, 1, milliseconds(until - now));
+    lock.lock();
+    if (ready <= 0 || state != State::up || this->state != State::up || this->fd != fd
+        || !(p.revents & (POLLIN | POLLHUP | POLLERR)))
+      continue;
+
+    bool got = false;
+    char buffer[CONNECTION_BUFFER];
+    while (this->state == State::up)
+    {
+      ssize_t n = recv(this->fd, buffer, sizeof(buffer), 0);
+      if (n > 0)
+      {
+        this->received.append(buffer, n);
+        this->answer(std::count(buffer, buffer + n, '\n'));
+        got = true;
+      }
+      else if (n < 0 && errno == EINTR)
+        continue;
+      else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      else
+        this->fail(seconds()); // closed by the peer, or the kernel gave up on it
+    }
+    if (got)
+      return true;
+  }
+}
+
+bool ConnectionManager::open()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  double now = seconds();
+  // Now, however long the backoff has left
+  if (this->state == State::down)
+    this->start_connecting(now);
+  if (this->state == State::connecting)
+  {
+    struct pollfd p = {this->fd, POLLOUT, 0};
+    poll(&p, 1, milliseconds(this->connect_deadline - now));
+    now = seconds();
+  }
+  if (this->maintain(now))
+    this->flush(now);
+  return this->state == State::up;
+}
+
+bool ConnectionManager::is_connected()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->maintain(seconds());
+}
+
+void ConnectionManager::set_greeting(std::string greeting)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->greeting = greeting;
+}
+
+bool ConnectionManager::send(const std::string& message, int replies)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->queue.push_back(Message {message, replies, replies});
+  this->queued_bytes += message.length();
+  // Oldest first, except one already partly sent (the rest of it must follow)
+  while (this->queued_bytes > this->config.replay_bytes && this->queue.size() > 1)
+  {
+    auto oldest = this->queue.begin() + (this->sent_offset > 0 ? 1 : 0);
+    this->queued_bytes -= oldest->text.length();
+    this->queue.erase(oldest);
+    ++this->dropped;
+  }
+  double now = seconds();
+  if (this->maintain(now))
+    this->flush(now);
+  return this->queue.empty();
+}
+
+std::string ConnectionManager::receive(size_t size, bool reply)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  if (this->received.empty() && !this->fill(lock, seconds() + this->config.reply_timeout) && reply)
+    this->abandon(seconds());
+  std::string data = this->received.substr(0, size);
+  this->received.erase(0, size);
+  return data;
+}
+
+bool ConnectionManager::read_line(std::string& line, bool reply)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  double deadline = seconds() + this->config.reply_timeout;
+  size_t end;
+  while ((end = this->received.find('\n')) == std::string::npos)
+    if (!this->fill(lock, deadline))
+    {
+      if (reply)
+        this->abandon(seconds());
+      return false;
+    }
+  line.assign(this->received, 0, end);
+  this->received.erase(0, end + 1);
+  return true;
+}
+
+unsigned long ConnectionManager::get_reconnect_count()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->connections > 0 ? this->connections - 1 : 0;
+}
+
+unsigned long ConnectionManager::get_dropped_count()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->dropped;
+}
@@ -0,0 +1,120 @@
+#ifndef HYPED_MASTERSLAVECOMMS_MASTER_CONNECTIONMANAGER_HPP_
+#define HYPED_MASTERSLAVECOMMS_MASTER_CONNECTIONMANAGER_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+
+#define CONNECTION_BUFFER 4096 // bytes received per recv()
+
+struct ConnectionConfig
+{
+  double connect_timeout = 0.2; // s, a connection attempt is given up after this
+  double min_backoff = 0.01;    // s, wait before the first reconnection attempt
+  double max_backoff = 1.0;     // s, the wait doubles after every failed attempt up to this
+  double reply_timeout = 0.25;  // s, a reply taking longer means the link or the peer is dead
+  int keepalive_idle = 1;       // s of silence before TCP keepalive probes (idle links)
+  int keepalive_interval = 1;   // s between probes
+  int keepalive_count = 2;      // unanswered probes before the kernel drops the link
+  int user_timeout = 500;       // ms sent data may stay unacknowledged before the same
+  size_t replay_bytes = 65536;  // messages queued while disconnected (oldest dropped first), and
+                                // unanswered ones kept to be sent again
+  bool replay = false;          // the peer's requests can safely be repeated (e.g. a slave's
+                                // readings), so unanswered ones are sent again after reconnecting
+};
+
+/// Keeps a TCP connection to a peer up. The address is resolved once (again only if connecting
+/// fails); connecting never blocks callers for longer than connect_timeout (or at all, when it
+/// happens in the background of send() and receive()). A dead link is noticed by keepalives, by
+/// the kernel giving up on unacknowledged data, or by a reply not arriving in time (every reply
+/// expected is a heartbeat), and is reconnected with exponential backoff. Messages sent while
+/// the link is down are queued and sent after reconnecting, preceded by the greeting and, for
+/// peers whose requests can be repeated (config.replay), by the requests none of whose reply
+/// lines had come (which may never have arrived), so a blip costs only the time to reconnect.
+/// Requests answered in part aren't repeated. Safe to use from several threads.
+class ConnectionManager
+{
+  public:
+    ConnectionManager(std::string address, int port, ConnectionConfig config = ConnectionConfig());
+    ~ConnectionManager();
+
+    ConnectionManager(ConnectionManager const&) = delete;
+    void operator=(ConnectionManager const&)    = delete;
+
+    /// Connects now if it isn't connected, waiting up to connect_timeout
+    bool open();
+    bool is_connected();
+    /// The peer's address, resolved now if it hasn't been; nullptr if it can't be
+    const struct sockaddr_in* get_address();
+    /// Sent first on every connection made after this (e.g. the node's name)
+    void set_greeting(std::string greeting);
+    /// Queues `message` and sends what it can without blocking; false if it is still queued.
+    /// `replies` is how many lines the peer answers it with, which tells requests that were
+    /// answered from those that may be sent again
+    bool send(const std::string& message, int replies = 0);
+    /// Up to `size` bytes, waiting up to reply_timeout for any; empty if none came. A `reply`
+    /// (to what was sent) not coming means the link or the peer is dead: it is reconnected and
+    /// whatever is still queued is dropped with the request. Anything else not coming (e.g.
+    /// unprompted messages, or acknowledgements nothing depends on) only ends the wait
+    std::string receive(size_t size, bool reply = true);
+    /// The next line without its '\n', waiting as receive() does; false if none came
+    bool read_line(std::string& line, bool reply = true);
+    /// Connections made after the first
+    unsigned long get_reconnect_count();
+    /// Messages dropped from a full queue, or with a request which wasn't answered
+    unsigned long get_dropped_count();
+
+  private:
+    enum class State
+    {
+      down,
+      connecting,
+      up
+    };
+
+    struct Message
+    {
+      std::string text;
+      int replies;    // lines the peer answers it with
+      int unanswered; // of those, not received yet
+    };
+
+    bool resolve();
+    void start_connecting(double now);
+    void connected(double now);
+    /// Moves the connection on (reconnecting when due, finishing connecting); true if it is up
+    bool maintain(double now);
+    void fail(double now);
+    void abandon(double now);
+    void flush(double now);
+    /// Counts `lines` received as answers to the oldest requests
+    void answer(size_t lines);
+    /// Waits until `deadline` for data (keeping the connection up meanwhile) and takes what
+    /// came; false if nothing did
+    bool fill(std::unique_lock<std::mutex>& lock, double deadline);
+
+    std::string address;
+    int port;
+    ConnectionConfig config;
+    std::mutex mutex;
+    State state = State::down;
+    int fd = -1;
+    bool resolved = false;
+    struct sockaddr_in peer;
+    double connect_deadline = 0.0;
+    double next_attempt = 0.0;
+    double backoff;
+    std::string greeting;
+    std::deque<Message> queue;
+    size_t queued_bytes = 0;
+    size_t sent_offset = 0; // bytes of queue.front() sent already
+    std::deque<Message> unanswered; // sent requests still waiting for reply lines, oldest first
+    size_t unanswered_bytes = 0;
+    std::string received; // not yet returned
+    unsigned long connections = 0;
+    unsigned long dropped = 0;
+};
+
+#endif // HYPED_MASTERSLAVECOMMS_MASTER_CONNECTIONMANAGER_HPP_
@@ -1,87 +1,149 @@
 #include "NetworkMaster.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 NetworkMaster::NetworkMaster()
 {
-	sock = -1;
 	port = 0;
 	address = "";
 }
 
-bool NetworkMaster::setup(string address , int port)
+bool NetworkMaster::setup(string address , int port, ConnectionConfig config)
 {
-  	if(sock == -1)
+	this->address = address;
+	this->port = port;
+	shm.reset();
+	pending.clear();
+	// Slaves' commands only take readings, so one lost with the link can be sent again
+	config.replay = true;
+	this->config = config;
+	connection.reset(new ConnectionManager(address, port, config));
+	const struct sockaddr_in* server = connection->get_address();
+	if (server == NULL)
+	{
+		cout << "Failed to resolve hostname " << address << endl;
+		return false;
+	}
+	// A slave on this machine (loopback address) is reached through its shared memory if it has any
+	if ((ntohl(server->sin_addr.s_addr) >> 24) == 127)
 	{
-		sock = socket(AF_INET , SOCK_STREAM , 0);
-		if (sock == -1)
+		std::unique_ptr<ShmTransport> local(new ShmTransport(port));
+		if (local->attach())
 		{
-      			cout << "Could not create socket" << endl;
-    		}
-        }
-  	if(inet_addr(address.c_str()) == -1)
-  	{
-    		struct hostent *he;
-    		struct in_addr **addr_list;
-    		if ( (he = gethostbyname( address.c_str() ) ) == NULL)
-    		{
-		      herror("gethostbyname");
-      		      cout<<"Failed to resolve hostname\n";
-		      return false;
-    		}
-	   	addr_list = (struct in_addr **) he->h_addr_list;
-    		for(int i = 0; addr_list[i] != NULL; i++)
-    		{
-      		      server.sin_addr = *addr_list[i];
-		      break;
-    		}
-  	}
-  	else
-  	{
-    		server.sin_addr.s_addr = inet_addr( address.c_str() );
-  	}
-  	server.sin_family = AF_INET;
-  	server.sin_port = htons( port );
-  	if (connect(sock , (struct sockaddr *)&server , sizeof(server)) < 0)
-  	{
-    		perror("connect failed. Error");
-    		return 1;
-  	}
-  	return true;
+			shm = std::move(local);
+			return true;
+		}
+	}
+	if (!connection->open())
+	{
+		cout << "Could not connect to " << address << ":" << port << ", retrying" << endl;
+		return false;
+	}
+	return true;
+}
+
+void NetworkMaster::reattach()
+{
+	// A late reply mustn't be taken for the next one, so the session goes whether or not the
+	// slave is still there; attaching again starts one without the slave's unread replies
+	shm.reset();
+	pending.clear();
+	std::unique_ptr<ShmTransport> local(new ShmTransport(port));
+	if (local->attach())
+		shm = std::move(local);
+	else
+		cout << "Lost the shared memory of " << address << ":" << port << ", using TCP" << endl;
+}
+
+bool NetworkMaster::is_connected()
+{
+	if (shm && !shm->peer_alive())
+		reattach();
+	if (shm)
+		return true;
+	return connection && connection->is_connected();
 }
 
 bool NetworkMaster::Send(string data)
 {
-	if( send(sock , data.c_str() , strlen( data.c_str() ) , 0) < 0)
+	// The slave takes a command to end at its '\n': what is queued or sent again after
+	// reconnecting goes out together, and a long batch may come in parts
+	data += '\n';
+	if (shm)
 	{
+		if (shm->send(data.c_str(), data.length()))
+			return true;
 		cout << "Send failed : " << data << endl;
-		return false;
+		reattach();
+		if (shm)
+			return shm->send(data.c_str(), data.length());
 	}
-	return true;
+	// Queued while the slave can't be reached, so it isn't lost to a reconnection. The slave
+	// answers each of the space-separated commands with a line
+	int replies = 1 + std::count(data.begin(), data.end(), ' ');
+	return connection && connection->send(data, replies);
 }
 
 string NetworkMaster::receive(int size)
 {
-  	char buffer[size];
-  	string reply;
-	if( recv(sock , buffer , size, 0) < 0)// sizeof(buffer) 
-  	{
-	    cout << "receive failed!" << endl;
-  	}
-	buffer[size]='\0';
-  	reply = buffer;
-  	return reply;
+	// What read() took beyond its line comes first
+	if (!pending.empty())
+	{
+		string reply = pending.substr(0, size);
+		pending.erase(0, size);
+		return reply;
+	}
+	if (!shm)
+	{
+		string reply = connection ? connection->receive(size) : "";
+		if (reply.empty())
+			cout << "receive failed!" << endl;
+		return reply;
+	}
+	// Given up on after the same time as a reply over TCP
+	string reply(size, '\0');
+	reply.resize(shm->receive(&reply[0], size, config.reply_timeout));
+	if (reply.empty())
+	{
+		cout << "receive failed!" << endl;
+		reattach();
+	}
+	return reply;
 }
 
 string NetworkMaster::read()
 {
-  	char buffer[1] = {};
-  	string reply;
-  	while (buffer[0] != '\n') {
-    		if( recv(sock , buffer , sizeof(buffer) , 0) < 0)
-    		{
-      			cout << "receive failed!" << endl;
-      			break;
-    		}
-		reply += buffer[0];
+	if (!shm)
+	{
+		string line;
+		if (!connection || !connection->read_line(line))
+		{
+			cout << "receive failed!" << endl;
+			return "";
+		}
+		return line + "\n";
+	}
+	// Takes whatever has arrived rather than a byte at a time, keeping what follows the line
+	auto deadline = std::chrono::steady_clock::now()
+			+ std::chrono::duration<double>(config.reply_timeout);
+	size_t end;
+	while ((end = pending.find('\n')) == string::npos)
+	{
+		char buffer[4096];
+		double left = std::chrono::duration<double>(
+				deadline - std::chrono::steady_clock::now()).count();
+		int n = left > 0.0 ? (int) shm->receive(buffer, sizeof(buffer), left) : 0;
+		if (n <= 0)
+		{
+			cout << "receive failed!" << endl;
+			string reply = pending;
+			reattach();
+			return reply;
+		}
+		pending.append(buffer, n);
 	}
+	string reply = pending.substr(0, end + 1);
+	pending.erase(0, end + 1);
 	return reply;
 }
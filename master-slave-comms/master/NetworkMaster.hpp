@@ -12,24 +12,43 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <netdb.h> 
+#include <memory>
 #include <vector>
 
+#include "ConnectionManager.hpp"
+#include "ShmTransport.hpp"
+
 using namespace std;
 
 class NetworkMaster
 {
   private:
-    int sock;
     std::string address;
     int port;
-    struct sockaddr_in server;
+    ConnectionConfig config;
+    std::unique_ptr<ConnectionManager> connection; // used unless shm is set
+    std::unique_ptr<ShmTransport> shm; // set instead while talking to a slave on this machine
+    std::string pending; // received through shm after the line read() returned
+
+    /// Attaches to the slave's shared memory again (e.g. it was restarted), or falls back to TCP
+    void reattach();
 
   public:
     NetworkMaster();
-    bool setup(string address, int port);
+    /// Slaves on this machine which offer shared memory (see ShmTransport.hpp) are reached
+    /// through it rather than over TCP. False if the slave couldn't be reached yet; the
+    /// connection is then retried in the background of Send() and receive(), as it is whenever
+    /// it drops (see ConnectionManager.hpp). A shared memory slave which goes away or doesn't
+    /// answer in time is attached to again, or reached over TCP if it can't be
+    bool setup(string address, int port, ConnectionConfig config = ConnectionConfig());
+    /// False if the slave can't be reached at the moment; `data` is then sent when it can.
+    /// `data` is one command (or a space-separated batch), and is sent ended by '\n'
     bool Send(string data);
+    /// Empty if the slave didn't answer in time (the connection is then remade)
     string receive(int size = 4096);
+    /// Up to and including the next '\n'
     string read();
+    bool is_connected();
 };
 
 #endif // NETWORKMASTER_HPP_
@@ -0,0 +1,288 @@
+#include "NetworkMultiplexer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 16
+
+
+NetworkMultiplexer::NetworkMultiplexer(Clock& clock, ConnectionConfig config)
+    : clock(clock), config(config), epoll_fd(epoll_create1(EPOLL_CLOEXEC))
+{}
+
+NetworkMultiplexer::~NetworkMultiplexer()
+{
+  for (Slave& s : this->slaves)
+    this->disconnect(s);
+  if (this->epoll_fd >= 0)
+    close(this->epoll_fd);
+}
+
+int NetworkMultiplexer::add_slave(std::string address, int port, double timeout)
+{
+  Slave s;
+  s.address = address;
+  s.port = port;
+  s.timeout = timeout;
+  s.fd = -1;
+  s.connecting = false;
+  s.resolved = false;
+  std::memset(&s.peer, 0, sizeof(s.peer));
+  s.connect_deadline = 0.0;
+  s.next_attempt = 0.0;
+  s.backoff = this->config.min_backoff;
+  s.next = 0;
+  s.lines_in = 0;
+  s.deadline = 0.0;
+  this->slaves.push_back(s);
+  Slave& slave = this->slaves.back();
+  // The first connection is waited for, as ConnectionManager::open() does
+  double now = RealClock::instance().now();
+  if (!this->maintain(slave, now) && slave.connecting)
+  {
+    struct pollfd p = {slave.fd, POLLOUT, 0};
+    poll(&p, 1, std::max(0, (int) std::ceil((slave.connect_deadline - now) * 1000.0)));
+    this->maintain(slave, RealClock::instance().now());
+  }
+  return this->slaves.size() - 1;
+}
+
+bool NetworkMultiplexer::is_connected(int slave) const
+{
+  return slave >= 0 && slave < (int) this->slaves.size() && this->slaves[slave].fd >= 0
+      && !this->slaves[slave].connecting;
+}
+
+bool NetworkMultiplexer::resolve(Slave& slave)
+{
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* info;
+  if (getaddrinfo(slave.address.c_str(), std::to_string(slave.port).c_str(), &hints, &info) != 0)
+    return false;
+  std::memcpy(&slave.peer, info->ai_addr, sizeof(slave.peer));
+  freeaddrinfo(info);
+  slave.resolved = true;
+  return true;
+}
+
+bool NetworkMultiplexer::maintain(Slave& slave, double now)
+{
+  if (slave.fd < 0 && now >= slave.next_attempt)
+    this->start_connecting(slave, now);
+  if (slave.connecting)
+  {
+    struct pollfd p = {slave.fd, POLLOUT, 0};
+    if (poll(&p, 1, 0) == 1)
+      this->finish_connecting(slave, now);
+    else if (now >= slave.connect_deadline)
+      this->disconnect(slave);
+  }
+  return slave.fd >= 0 && !slave.connecting;
+}
+
+void NetworkMultiplexer::start_connecting(Slave& slave, double now)
+{
+  if (this->epoll_fd < 0 || (!slave.resolved && !this->resolve(slave)))
+  {
+    this->disconnect(slave);
+    return;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int on = 1;
+  struct epoll_event event;
+  event.events = EPOLLOUT; // writable once connected (or failed)
+  event.data.u32 = &slave - &this->slaves[0];
+  if (fd < 0 || setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) != 0
+      || epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+  {
+    if (fd >= 0)
+      close(fd);
+    this->disconnect(slave);
+    return;
+  }
+  slave.fd = fd;
+  slave.connecting = true;
+  slave.connect_deadline = now + this->config.connect_timeout;
+  slave.received.clear();
+  if (connect(fd, (struct sockaddr*) &slave.peer, sizeof(slave.peer)) == 0)
+    this->finish_connecting(slave, now);
+  else if (errno != EINPROGRESS)
+    this->disconnect(slave);
+}
+
+void NetworkMultiplexer::finish_connecting(Slave& slave, double now)
+{
+  int error = 0;
+  socklen_t length = sizeof(error);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u32 = &slave - &this->slaves[0];
+  if (getsockopt(slave.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0
+      || epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, slave.fd, &event) != 0)
+  {
+    this->disconnect(slave);
+    return;
+  }
+  slave.connecting = false;
+  slave.backoff = this->config.min_backoff;
+}
+
+void NetworkMultiplexer::disconnect(Slave& slave)
+{
+  if (slave.fd >= 0)
+  {
+    epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, slave.fd, nullptr);
+    close(slave.fd);
+  }
+  // A failed connection attempt may mean the slave has moved
+  if (slave.connecting || slave.fd < 0)
+    slave.resolved = false;
+  slave.fd = -1;
+  slave.connecting = false;
+  slave.next = slave.queue.size(); // the rest of its queries go unanswered
+  slave.next_attempt = RealClock::instance().now() + slave.backoff;
+  slave.backoff = std::min(2.0 * slave.backoff, this->config.max_backoff);
+}
+
+bool NetworkMultiplexer::send_next(Slave& slave, std::vector<SlaveQuery>& queries)
+{
+  SlaveQuery& q = queries[slave.queue[slave.next]];
+  q.sent = this->clock.now();
+  slave.lines_in = 0;
+  slave.deadline = RealClock::instance().now() + slave.timeout;
+  // Commands are far smaller than the socket buffer, so they go in one send, ended by the '\n'
+  // the slave takes a command to end at
+  struct iovec parts[2] = {{(void*) q.command.data(), q.command.length()}, {(void*) "\n", 1}};
+  struct msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = parts;
+  message.msg_iovlen = 2;
+  return sendmsg(slave.fd, &message, MSG_NOSIGNAL) == (ssize_t) q.command.length() + 1;
+}
+
+bool NetworkMultiplexer::receive(Slave& slave, std::vector<SlaveQuery>& queries, int& answered)
+{
+  char buffer[MULTIPLEXER_BUFFER];
+  while (true)
+  {
+    ssize_t n = recv(slave.fd, buffer, sizeof(buffer), 0);
+    if (n > 0)
+      slave.received.append(buffer, n);
+    else if (n == 0)
+      return false;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else if (errno != EINTR)
+      return false;
+  }
+
+  double now = this->clock.now();
+  size_t start = 0, end;
+  bool ok = true;
+  while (ok && (end = slave.received.find('\n', start)) != std::string::npos)
+  {
+    // Lines with no command awaiting them can't be matched to one and are dropped
+    if (slave.next < slave.queue.size())
+    {
+      SlaveQuery& q = queries[slave.queue[slave.next]];
+      if (slave.lines_in++ > 0)
+        q.reply += '\n';
+      q.reply.append(slave.received, start, end - start);
+      if (slave.lines_in >= q.lines)
+      {
+        q.answered = true;
+        q.returned = now;
+        ++answered;
+        if (++slave.next < slave.queue.size())
+          ok = this->send_next(slave, queries);
+      }
+    }
+    start = end + 1;
+  }
+  slave.received.erase(0, start);
+  return ok;
+}
+
+int NetworkMultiplexer::query(std::vector<SlaveQuery>& queries)
+{
+  for (Slave& s : this->slaves)
+  {
+    s.queue.clear();
+    s.next = 0;
+  }
+  for (unsigned int i = 0; i < queries.size(); ++i)
+  {
+    SlaveQuery& q = queries[i];
+    q.reply.clear();
+    q.answered = false;
+    q.sent = q.returned = -1.0;
+    if (q.slave >= 0 && q.slave < (int) this->slaves.size())
+      this->slaves[q.slave].queue.push_back(i);
+  }
+
+  // Deadlines are in real time even if the clock stamping replies is virtual
+  double now = RealClock::instance().now();
+  for (Slave& s : this->slaves)
+  {
+    if (this->maintain(s, now))
+    {
+      if (!s.queue.empty() && !this->send_next(s, queries))
+        this->disconnect(s);
+    }
+    else if (s.connecting)
+      s.deadline = now + s.timeout; // asked once connected, if that's in time
+    else
+      s.next = s.queue.size(); // down until its next attempt
+  }
+
+  int answered = 0;
+  while (true)
+  {
+    now = RealClock::instance().now();
+    double first = INFINITY;
+    for (Slave& s : this->slaves)
+    {
+      if (s.next >= s.queue.size())
+        continue;
+      if (now < s.deadline)
+        first = std::min(first, s.deadline);
+      else if (s.connecting)
+        s.next = s.queue.size(); // this round goes unanswered, the connection attempt goes on
+      else
+        this->disconnect(s);
+    }
+    if (first == INFINITY)
+      return answered;
+
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(this->epoll_fd, events, MAX_EVENTS, (int) std::ceil((first - now) * 1000.0));
+    for (int i = 0; i < n; ++i)
+    {
+      Slave& s = this->slaves[events[i].data.u32];
+      if (s.fd < 0)
+        continue;
+      if (s.connecting)
+      {
+        this->finish_connecting(s, now);
+        if (s.fd >= 0 && s.next < s.queue.size() && !this->send_next(s, queries))
+          this->disconnect(s);
+      }
+      else if (!this->receive(s, queries, answered))
+        this->disconnect(s);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef HYPED_MASTERSLAVECOMMS_MASTER_NETWORKMULTIPLEXER_HPP_
+#define HYPED_MASTERSLAVECOMMS_MASTER_NETWORKMULTIPLEXER_HPP_
+
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+#include "ConnectionManager.hpp"
+#include "drivers/clock.hpp"
+
+#define MULTIPLEXER_TIMEOUT 0.02 // s, default wait for each reply of a slave
+#define MULTIPLEXER_BUFFER 4096  // bytes received per recv()
+
+/// One command for one slave, answered by `lines` lines of text (several for a batch of
+/// readings, see NetworkSlave::SendReadings)
+struct SlaveQuery
+{
+  int slave;            // index returned by NetworkMultiplexer::add_slave
+  std::string command;  // without the '\n' it is sent ended by
+  unsigned int lines = 1;
+  std::string reply;    // the lines the slave answered, joined by '\n' (without the last)
+  bool answered;        // false if the slave failed, timed out or wasn't connected
+  double sent;          // Clock times the command was sent and the reply arrived
+  double returned;
+};
+
+/// Holds connections to many slaves on one epoll loop, so a round of commands to all of them
+/// costs one round trip rather than one per slave. Replies are read in chunks and split into
+/// lines ('\n', see NetworkSlave::SendReading). Each slave answers its commands in order: it
+/// gets its next command as soon as it answers the last, and each reply has the slave's own
+/// timeout. A slave which times out or fails is disconnected (so its late replies can't be taken
+/// for answers to later commands) and reconnected as ConnectionManager reconnects: with the
+/// address resolved once (again only if connecting fails), exponential backoff between attempts
+/// and the connection made on the epoll loop, so a slave that is down never holds up the others.
+/// Its queries go unanswered until it is connected again.
+class NetworkMultiplexer
+{
+  public:
+    /// Uses the connect timeout and backoff of `config`
+    NetworkMultiplexer(Clock& clock = Clock::get(), ConnectionConfig config = ConnectionConfig());
+    ~NetworkMultiplexer();
+
+    NetworkMultiplexer(NetworkMultiplexer const&) = delete;
+    void operator=(NetworkMultiplexer const&)     = delete;
+
+    /// Returns the slave's index; it is connected now if it can be (waiting up to the connect
+    /// timeout), else in the background of later queries
+    int add_slave(std::string address, int port, double timeout = MULTIPLEXER_TIMEOUT);
+    /// Sends every command and waits for all the replies or timeouts; returns how many were
+    /// answered. Commands for the same slave are sent in the order given
+    int query(std::vector<SlaveQuery>& queries);
+    bool is_connected(int slave) const;
+    int get_slave_count() const { return this->slaves.size(); }
+
+  private:
+    struct Slave
+    {
+      std::string address;
+      int port;
+      double timeout;
+      int fd;
+      bool connecting;        // fd is waiting for the connection, not yet up
+      bool resolved;
+      struct sockaddr_in peer;
+      double connect_deadline; // real time the connection attempt is given up
+      double next_attempt;     // real time of the next attempt while fd < 0
+      double backoff;
+      std::string received; // bytes after the last complete line
+      std::vector<int> queue; // queries of the current round, in order
+      unsigned int next;      // queue position of the query awaiting a reply
+      unsigned int lines_in;  // lines of its reply received so far
+      double deadline;
+    };
+
+    bool resolve(Slave& slave);
+    /// Starts connecting the slave if it is down and an attempt is due, and sees whether an
+    /// attempt under way has finished; true if it is connected
+    bool maintain(Slave& slave, double now);
+    void start_connecting(Slave& slave, double now);
+    void finish_connecting(Slave& slave, double now);
+    /// Closes the connection and schedules the next attempt
+    void disconnect(Slave& slave);
+    bool send_next(Slave& slave, std::vector<SlaveQuery>& queries);
+    /// Reads what has arrived, answering queries; false if the connection failed
+    bool receive(Slave& slave, std::vector<SlaveQuery>& queries, int& answered);
+
+    Clock& clock;
+    ConnectionConfig config;
+    int epoll_fd;
+    std::vector<Slave> slaves;
+};
+
+#endif // HYPED_MASTERSLAVECOMMS_MASTER_NETWORKMULTIPLEXER_HPP_
@@ -0,0 +1,270 @@
+#include "ShmTransport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FUTEX_STEP 0.1 // s, longest sleep between checks that the other side is alive
+
+// The rings are shared between processes, which only works with lock-free atomics
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "process-shared rings need lock-free atomics");
+
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, double timeout)
+{
+  struct timespec ts;
+  ts.tv_sec = (time_t) timeout;
+  ts.tv_nsec = (long) ((timeout - ts.tv_sec) * 1.0e+9);
+  syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>& word)
+{
+  syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+inline bool process_exists(pid_t pid)
+{
+  return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+
+ShmTransport::ShmTransport(int port)
+    : name("/hyped-slave-" + std::to_string(port)), segment(nullptr), slave(false), peer(0),
+    session(0)
+{}
+
+ShmTransport::~ShmTransport()
+{
+  if (!this->segment)
+    return;
+  if (this->slave)
+  {
+    this->segment->slave_pid.store(0);
+    futex_wake(this->segment->replies.head);
+    futex_wake(this->segment->replies.tail);
+    futex_wake(this->segment->accepted);
+    shm_unlink(this->name.c_str());
+  }
+  else
+  {
+    int32_t me = getpid();
+    this->segment->master_pid.compare_exchange_strong(me, 0);
+    futex_wake(this->segment->requests.head);
+    futex_wake(this->segment->requests.tail);
+  }
+  munmap(this->segment, sizeof(ShmTransportSegment));
+}
+
+bool ShmTransport::create()
+{
+  const char* name = this->name.c_str();
+  // Refuse to replace a live slave; a dead one's segment is removed (its master gives up on it)
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd >= 0)
+  {
+    void* p = mmap(nullptr, sizeof(ShmTransportSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    bool live = false;
+    if (p != MAP_FAILED)
+    {
+      const ShmTransportSegment* old = (const ShmTransportSegment*) p;
+      live = old->version.load() == SHM_TRANSPORT_VERSION && old->slave_pid.load() != getpid()
+          && process_exists(old->slave_pid.load());
+      munmap(p, sizeof(ShmTransportSegment));
+    }
+    if (live)
+    {
+      errno = EBUSY;
+      return false;
+    }
+    shm_unlink(name);
+  }
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+  if (fd < 0)
+    return false;
+  fchmod(fd, 0666); // masters needn't run as the slave's user
+  void* p = MAP_FAILED;
+  if (ftruncate(fd, sizeof(ShmTransportSegment)) == 0)
+    p = mmap(nullptr, sizeof(ShmTransportSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+  {
+    shm_unlink(name);
+    return false;
+  }
+  std::memset(p, 0, sizeof(ShmTransportSegment));
+  this->segment = new (p) ShmTransportSegment();
+  this->slave = true;
+  this->segment->slave_pid.store(getpid());
+  this->segment->version.store(SHM_TRANSPORT_VERSION, std::memory_order_release);
+  return true;
+}
+
+void ShmTransport::accept()
+{
+  ShmTransportSegment* s = this->segment;
+  while (true)
+  {
+    uint32_t session = s->session.load();
+    int32_t master = s->master_pid.load();
+    if (session != s->accepted.load() && master > 0)
+    {
+      this->peer = master;
+      this->session = session;
+      s->requests.tail.store(s->requests.head.load());
+      s->accepted.store(session);
+      futex_wake(s->accepted);
+      return;
+    }
+    futex_wait(s->session, session, FUTEX_STEP);
+  }
+}
+
+bool ShmTransport::attach()
+{
+  int fd = shm_open(this->name.c_str(), O_RDWR, 0);
+  if (fd < 0)
+    return false;
+  void* p = mmap(nullptr, sizeof(ShmTransportSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+  ShmTransportSegment* s = (ShmTransportSegment*) p;
+
+  // Masters which exited without detaching are replaced
+  int32_t master = s->master_pid.load();
+  bool claimed = s->version.load(std::memory_order_acquire) == SHM_TRANSPORT_VERSION
+      && process_exists(s->slave_pid.load())
+      && (master == 0 || !process_exists(master))
+      && s->master_pid.compare_exchange_strong(master, getpid());
+  if (!claimed)
+  {
+    munmap(p, sizeof(ShmTransportSegment));
+    return false;
+  }
+  uint32_t session = s->session.fetch_add(1) + 1;
+  futex_wake(s->session);
+
+  auto deadline = std::chrono::steady_clock::now()
+      + std::chrono::duration<double>(SHM_TRANSPORT_ATTACH_TIMEOUT);
+  uint32_t accepted;
+  while ((accepted = s->accepted.load()) != session)
+  {
+    if (std::chrono::steady_clock::now() > deadline || !process_exists(s->slave_pid.load()))
+    {
+      int32_t me = getpid();
+      s->master_pid.compare_exchange_strong(me, 0);
+      munmap(p, sizeof(ShmTransportSegment));
+      return false;
+    }
+    futex_wait(s->accepted, accepted, FUTEX_STEP);
+  }
+  // Replies the slave sent to the last master
+  s->replies.tail.store(s->replies.head.load());
+  this->segment = s;
+  this->peer = s->slave_pid.load();
+  return true;
+}
+
+bool ShmTransport::peer_alive() const
+{
+  if (this->slave)
+    return this->segment->master_pid.load() == this->peer
+        && this->segment->session.load() == this->session && process_exists(this->peer);
+  return this->segment->slave_pid.load() == this->peer && process_exists(this->peer);
+}
+
+// Polls `word` until it differs from `value`, then sleeps on it for up to `timeout` (at most
+// FUTEX_STEP); returns its value, which is still `value` if nothing happened (e.g. the other side
+// is gone)
+uint32_t ShmTransport::wait(std::atomic<uint32_t>& word, std::atomic<uint32_t>& sleeping,
+    uint32_t value, double timeout)
+{
+  // Polling on a single processor only delays the other side
+  static const int spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_TRANSPORT_SPINS : 0;
+  for (int i = 0; i < spins; ++i)
+  {
+    uint32_t now = word.load(std::memory_order_acquire);
+    if (now != value)
+      return now;
+  }
+  // The other side checks the flag after moving the word, so either it wakes us or we see it move
+  sleeping.store(1);
+  if (word.load() == value)
+    futex_wait(word, value, std::min(timeout, FUTEX_STEP));
+  sleeping.store(0);
+  return word.load(std::memory_order_acquire);
+}
+
+bool ShmTransport::send(const char* data, size_t length)
+{
+  ShmTransportRing& ring = this->slave ? this->segment->replies : this->segment->requests;
+  if ((this->slave ? this->segment->master_pid : this->segment->slave_pid).load() != this->peer)
+    return false;
+  uint32_t head = ring.head.load(std::memory_order_relaxed);
+  while (length > 0)
+  {
+    uint32_t tail = ring.tail.load(std::memory_order_acquire);
+    uint32_t space = SHM_TRANSPORT_RING_SIZE - (head - tail);
+    if (space == 0)
+    {
+      if (this->wait(ring.tail, ring.producer_sleeping, tail, FUTEX_STEP) == tail
+          && !this->peer_alive())
+        return false;
+      continue;
+    }
+    size_t offset = head % SHM_TRANSPORT_RING_SIZE;
+    size_t n = std::min((size_t) space, length);
+    size_t first = std::min(n, SHM_TRANSPORT_RING_SIZE - offset);
+    std::memcpy(ring.data + offset, data, first);
+    std::memcpy(ring.data, data + first, n - first);
+    head += n;
+    data += n;
+    length -= n;
+    ring.head.store(head);
+    if (ring.consumer_sleeping.load())
+      futex_wake(ring.head);
+  }
+  return true;
+}
+
+size_t ShmTransport::receive(char* buffer, size_t size, double timeout)
+{
+  ShmTransportRing& ring = this->slave ? this->segment->requests : this->segment->replies;
+  uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+  uint32_t head;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+  while ((head = ring.head.load(std::memory_order_acquire)) == tail)
+  {
+    double left = FUTEX_STEP;
+    if (timeout >= 0.0)
+    {
+      left = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+      if (left <= 0.0)
+        return 0;
+    }
+    if (this->wait(ring.head, ring.consumer_sleeping, tail, left) == tail && !this->peer_alive())
+      return 0;
+  }
+  size_t offset = tail % SHM_TRANSPORT_RING_SIZE;
+  size_t n = std::min((size_t) (head - tail), size);
+  size_t first = std::min(n, SHM_TRANSPORT_RING_SIZE - offset);
+  std::memcpy(buffer, ring.data + offset, first);
+  std::memcpy(buffer + first, ring.data, n - first);
+  ring.tail.store(tail + (uint32_t) n);
+  if (ring.producer_sleeping.load())
+    futex_wake(ring.tail);
+  return n;
+}
@@ -0,0 +1,83 @@
+#ifndef HYPED_MASTERSLAVECOMMS_MASTER_SHMTRANSPORT_HPP_
+#define HYPED_MASTERSLAVECOMMS_MASTER_SHMTRANSPORT_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define SHM_TRANSPORT_VERSION 1
+#define SHM_TRANSPORT_RING_SIZE 8192  // bytes per direction, a power of 2
+#define SHM_TRANSPORT_SPINS 4000      // polls of an empty or full ring before sleeping (multi-core)
+#define SHM_TRANSPORT_ATTACH_TIMEOUT 1.0 // s, masters fall back to TCP if the slave doesn't answer
+
+/*
+ * Shared memory transport between a master and a slave running on the same machine, used by
+ * NetworkMaster and NetworkSlave instead of a loopback TCP connection whenever they can (same
+ * API, no system calls while both sides are busy). The slave listening on a port creates the
+ * segment "/hyped-slave-<port>"; it holds two single-producer single-consumer byte rings,
+ * requests (master to slave) and replies (slave to master), which carry a byte stream like the
+ * TCP connection they replace. Waiting sides poll the ring for a while, then sleep on its head or
+ * tail (a futex word) and are woken by the other side. One master at a time can be attached.
+ */
+
+/// Indices only increase (bytes are at index % SHM_TRANSPORT_RING_SIZE); the consumer sleeps on
+/// `head` while the ring is empty, the producer on `tail` while it is full
+struct ShmTransportRing
+{
+  alignas(64) std::atomic<uint32_t> head; // written by the producer
+  std::atomic<uint32_t> consumer_sleeping;
+  alignas(64) std::atomic<uint32_t> tail; // written by the consumer
+  std::atomic<uint32_t> producer_sleeping;
+  alignas(64) char data[SHM_TRANSPORT_RING_SIZE];
+};
+
+struct ShmTransportSegment
+{
+  std::atomic<uint32_t> version; // set last, once the segment is initialized
+  std::atomic<int32_t> slave_pid;
+  std::atomic<int32_t> master_pid; // 0 while no master is attached
+  std::atomic<uint32_t> session;   // increased by each master attaching, the slave sleeps on it
+  std::atomic<uint32_t> accepted;  // session the slave serves, masters sleep on it
+  ShmTransportRing requests;
+  ShmTransportRing replies;
+};
+
+class ShmTransport
+{
+  public:
+    ShmTransport(int port);
+    ~ShmTransport();
+
+    ShmTransport(ShmTransport const&)  = delete;
+    void operator=(ShmTransport const&) = delete;
+
+    /// Slave side: creates the segment for the port; false if that fails or another live slave
+    /// has it
+    bool create();
+    /// Slave side: waits for a master to attach, discarding what the last one left unread
+    void accept();
+    /// Master side: attaches to the segment of a live slave; false if there's none, another
+    /// master is attached or the slave doesn't accept in time
+    bool attach();
+
+    /// Blocks while the ring is full; false if the other side is gone
+    bool send(const char* data, size_t length);
+    /// Waits for data and copies up to `size` bytes of it; 0 once the other side is gone (for
+    /// the slave, once its master detached) or after `timeout` seconds (if not negative)
+    size_t receive(char* buffer, size_t size, double timeout = -1.0);
+    /// Whether the other side is still there (for the slave, its master still attached)
+    bool peer_alive() const;
+
+  private:
+    uint32_t wait(std::atomic<uint32_t>& word, std::atomic<uint32_t>& sleeping, uint32_t value,
+        double timeout);
+
+    std::string name;
+    ShmTransportSegment* segment;
+    bool slave;
+    int32_t peer; // pid of the attached master, for the slave
+    uint32_t session; // the slave serves, so a master attaching again (same pid) is noticed
+};
+
+#endif // HYPED_MASTERSLAVECOMMS_MASTER_SHMTRANSPORT_HPP_
@@ -0,0 +1,59 @@
+#include "CommandTable.hpp"
+
+#include <algorithm>
+
+#define SEEDS_PER_SIZE 256 // seeds tried before the table is made bigger
+
+
+// FNV-1a, started from the seed
+uint32_t CommandTable::hash(uint32_t seed, const std::string& s)
+{
+  uint32_t h = 2166136261u ^ seed;
+  for (unsigned char c : s)
+    h = (h ^ c) * 16777619u;
+  return h ^ (h >> 15);
+}
+
+bool CommandTable::build(const std::vector<std::string>& commands)
+{
+  std::vector<std::string> sorted(commands);
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+    return false;
+  this->commands = commands;
+
+  // At least twice as many slots as commands, so a seed without collisions turns up quickly
+  uint32_t size = 2;
+  while (size < 2 * commands.size())
+    size *= 2;
+  while (true)
+  {
+    for (uint32_t seed = 0; seed < SEEDS_PER_SIZE; ++seed)
+    {
+      std::vector<int> slots(size, -1);
+      bool collided = false;
+      for (unsigned int i = 0; i < commands.size() && !collided; ++i)
+      {
+        int& slot = slots[hash(seed, commands[i]) & (size - 1)];
+        collided = slot >= 0;
+        slot = i;
+      }
+      if (!collided)
+      {
+        this->seed = seed;
+        this->mask = size - 1;
+        this->slots.swap(slots);
+        return true;
+      }
+    }
+    size *= 2;
+  }
+}
+
+int CommandTable::find(const std::string& command) const
+{
+  if (this->slots.empty())
+    return -1;
+  int i = this->slots[hash(this->seed, command) & this->mask];
+  return i >= 0 && this->commands[i] == command ? i : -1;
+}
@@ -0,0 +1,29 @@
+#ifndef HYPED_MASTERSLAVECOMMS_SLAVE_COMMANDTABLE_HPP_
+#define HYPED_MASTERSLAVECOMMS_SLAVE_COMMANDTABLE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Maps the commands a slave answers to their indices with a perfect hash built at startup: a
+/// seed is searched for under which no two commands share a slot, so a lookup is one hash and
+/// one string compare (to turn away commands that aren't in the table) however many there are
+class CommandTable
+{
+  public:
+    /// False if a command is listed twice
+    bool build(const std::vector<std::string>& commands);
+    /// Index of `command` in the list the table was built from, -1 if it isn't in it
+    int find(const std::string& command) const;
+    int size() const { return this->commands.size(); }
+
+  private:
+    static uint32_t hash(uint32_t seed, const std::string& s);
+
+    uint32_t seed = 0;
+    uint32_t mask = 0;
+    std::vector<int> slots; // command index, or -1
+    std::vector<std::string> commands;
+};
+
+#endif // HYPED_MASTERSLAVECOMMS_SLAVE_COMMANDTABLE_HPP_
@@ -1,24 +1,118 @@
 #include "NetworkSlave.hpp" 
 
-std::string NetworkSlave::Message;
+#include "drivers/clock.hpp"
+#include "drivers/instrumentation.hpp"
+
+std::atomic_bool NetworkSlave::MessageFromShm(false);
+std::atomic<unsigned long> NetworkSlave::MessageConnection(0);
+std::atomic<double> NetworkSlave::MessageTime(0.0);
+std::mutex NetworkSlave::CommandsMutex;
+std::condition_variable NetworkSlave::CommandsPosted;
+std::deque<NetworkSlave::Command> NetworkSlave::Commands;
+std::map<unsigned long, int> NetworkSlave::Connections;
+unsigned long NetworkSlave::LastConnection = 0;
+
+// Hands a message to wait_message()
+void NetworkSlave::Post(const std::string& msg, unsigned long connection)
+{
+  Command c;
+  c.text = msg;
+  c.connection = connection;
+  c.time = Clock::get().now();
+  std::lock_guard<std::mutex> lock(CommandsMutex);
+  if (Commands.size() >= MAXQUEUEDCOMMANDS)
+    Commands.pop_front();
+  Commands.push_back(c);
+  CommandsPosted.notify_one();
+}
+
+void NetworkSlave::PostLines(std::string& received, unsigned long connection)
+{
+  size_t start = 0, end;
+  while ((end = received.find('\n', start)) != std::string::npos)
+  {
+    size_t length = end - start;
+    if (length > 0 && received[end - 1] == '\r')
+      --length;
+    if (length > 0)
+      Post(received.substr(start, length), connection);
+    start = end + 1;
+  }
+  received.erase(0, start);
+  // Nothing the master sends is this long, so it isn't a command
+  if (received.length() > MAXPACKETSIZE)
+  {
+    std::cerr << "Dropped " << received.length() << " bytes without a command" << std::endl;
+    received.clear();
+  }
+}
 
 void* NetworkSlave::Task(void *arg)
 {
   int n;
   int newsockfd=(int)arg;
   char msg[MAXPACKETSIZE];
+  std::string received; // the start of a command which came in part
+  static LatencyHistogram& interval = Instrumentation::get_histogram("network_slave.interval");
+  uint64_t last = 0;
   pthread_detach(pthread_self());
+  unsigned long connection;
+  {
+    std::lock_guard<std::mutex> lock(CommandsMutex);
+    connection = ++LastConnection;
+    Connections[connection] = newsockfd;
+  }
   while(1)
   {
     n=recv(newsockfd,msg,MAXPACKETSIZE,0);
-    if(n==0)
+    // Closed, or reset by a master which gave up on the link and is reconnecting. Its commands
+    // can't be answered any more
+    if(n<=0)
     {
+      std::lock_guard<std::mutex> lock(CommandsMutex);
+      for (auto i = Commands.begin(); i != Commands.end();)
+        i = i->connection == connection ? Commands.erase(i) : i + 1;
+      Connections.erase(connection);
       close(newsockfd);
       break;
     }
-    msg[n]=0;
-    //send(newsockfd,msg,n,0);
-    Message = std::string(msg);
+    // Time between messages from the master, i.e. its request rate and the network's jitter
+    uint64_t now = timestamp_ns();
+    if (last)
+      interval.record(now - last);
+    last = now;
+    received.append(msg, n);
+    PostLines(received, connection);
+  }
+  return 0;
+}
+
+void* NetworkSlave::ShmTask(void *arg)
+{
+  ShmTransport* shm=(ShmTransport*)arg;
+  char msg[MAXPACKETSIZE];
+  std::string received;
+  static LatencyHistogram& interval = Instrumentation::get_histogram("network_slave.interval");
+  pthread_detach(pthread_self());
+  while(1)
+  {
+    shm->accept();
+    received.clear(); // the last master's
+    uint64_t last = 0;
+    size_t n;
+    while((n=shm->receive(msg,MAXPACKETSIZE))>0)
+    {
+      uint64_t now = timestamp_ns();
+      if (last)
+        interval.record(now - last);
+      last = now;
+      received.append(msg, n);
+      PostLines(received, 0);
+    }
+    // Its master detached (or attached again), so what it asked for can't be answered
+    std::lock_guard<std::mutex> lock(CommandsMutex);
+    for (auto i = Commands.begin(); i != Commands.end();)
+      i = i->connection == 0 ? Commands.erase(i) : i + 1;
   }
   return 0;
 }
@@ -32,6 +126,15 @@ void NetworkSlave::setup(int port)
   serverAddress.sin_port=htons(port);
   bind(sockfd,(struct sockaddr *)&serverAddress, sizeof(serverAddress));
   listen(sockfd,5);
+  shm = new ShmTransport(port);
+  if (shm->create())
+    pthread_create(&shmThread,NULL,&ShmTask,(void *)shm);
+  else
+  {
+    perror("shared memory unavailable, serving TCP only");
+    delete shm;
+    shm = nullptr;
+  }
 }
 
 std::string NetworkSlave::receive()
@@ -47,20 +150,48 @@ std::string NetworkSlave::receive()
   return str;
 }
 
-std::string NetworkSlave::getMessage()
+std::string NetworkSlave::wait_message()
 {
-  return Message;
+  std::unique_lock<std::mutex> lock(CommandsMutex);
+  CommandsPosted.wait(lock, []() { return !Commands.empty(); });
+  Command c = Commands.front();
+  Commands.pop_front();
+  // What the answer goes back through, and when the command came for SendReading()
+  MessageFromShm = c.connection == 0;
+  MessageConnection = c.connection;
+  MessageTime = c.time;
+  return c.text;
 }
 
 void NetworkSlave::Send(std::string msg)
 {
-  send(newsockfd,msg.c_str(),msg.length(),0);
+  if (MessageFromShm)
+  {
+    if (shm)
+      shm->send(msg.c_str(),msg.length());
+    return;
+  }
+  // Held while sending so that the connection can't close (and its socket be reused) meanwhile
+  std::lock_guard<std::mutex> lock(CommandsMutex);
+  auto i = Connections.find(MessageConnection);
+  if (i != Connections.end())
+    send(i->second,msg.c_str(),msg.length(),MSG_NOSIGNAL); // a dropped master mustn't kill the slave
+}
+
+void NetworkSlave::SendReading(std::string reading, double sampled)
+{
+  SendReadings(std::vector<std::string>(1, reading), std::vector<double>(1, sampled));
 }
 
-void NetworkSlave::clean()
+void NetworkSlave::SendReadings(const std::vector<std::string>& readings,
+    const std::vector<double>& sampled)
 {
-  Message = "";
-  std::memset(msg, 0, MAXPACKETSIZE);
+  std::string received = std::to_string((double) MessageTime);
+  std::string replied = std::to_string(Clock::get().now());
+  std::string msg;
+  for (unsigned int i = 0; i < readings.size(); ++i)
+    msg += readings[i] + " " + std::to_string(sampled[i]) + " " + received + " " + replied + "\n";
+  Send(msg); // in one go, so the master gets the batch in one round trip
 }
 
 void NetworkSlave::detach()
@@ -13,9 +13,17 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 
+#include "../master/ShmTransport.hpp"
 
-#define MAXPACKETSIZE 4096
+
+#define MAXPACKETSIZE 4096 // also the longest command
+#define MAXQUEUEDCOMMANDS 64 // the oldest go unanswered beyond this
 
 class NetworkSlave
 {
@@ -24,18 +32,49 @@ class NetworkSlave
     struct sockaddr_in serverAddress;
     struct sockaddr_in clientAddress;
     pthread_t serverThread;
-    char msg[ MAXPACKETSIZE ];
-    static std::string Message;
+    pthread_t shmThread;
+    static std::atomic_bool MessageFromShm; // Send() answers through shared memory
+    static std::atomic<unsigned long> MessageConnection; // or on this connection (see Connections)
+    static std::atomic<double> MessageTime; // Clock::get() time the command was received at
 
+    /// Also offers shared memory (see ShmTransport.hpp) to a master on this machine
     void setup(int port);
     std::string receive();
-    std::string getMessage();
+    /// Sleeps until a command comes from the master and takes it; Send() and SendReading() then
+    /// answer it (commands come one at a time, each answered before the next). The master ends
+    /// every command with '\n', as it may send several at once (e.g. after reconnecting)
+    std::string wait_message();
     void Send(std::string msg);
+    /// Replies "<reading> <sampled> <received> <replied>\n" in this slave's Clock::get() time,
+    /// from which NetworkProxi syncs the master's clock to ours and stamps the reading
+    void SendReading(std::string reading, double sampled);
+    /// Answers a batch of commands (sent space-separated in one message) with a SendReading()
+    /// line for each, in order
+    void SendReadings(const std::vector<std::string>& readings,
+        const std::vector<double>& sampled);
     void detach();
-    void clean();
 
   private:
     static void * Task(void * argv);
+    static void * ShmTask(void * argv);
+    static void Post(const std::string& msg, unsigned long connection);
+    /// Posts the complete lines at the start of `received` and takes them out of it
+    static void PostLines(std::string& received, unsigned long connection);
+    ShmTransport* shm = nullptr;
+
+    struct Command
+    {
+      std::string text;
+      unsigned long connection; // it came on, 0 for shared memory
+      double time;
+    };
+    static std::mutex CommandsMutex;
+    static std::condition_variable CommandsPosted;
+    static std::deque<Command> Commands; // not yet taken by wait_message()
+    // Sockets of the open connections by id (ids aren't reused, unlike sockets), so an answer
+    // goes back on the connection its command came on or nowhere
+    static std::map<unsigned long, int> Connections;
+    static unsigned long LastConnection;
 };
 
 #endif // HYPED_MASTERSLAVECOMMS_SLAVE_NETWORKSLAVE_HPP_
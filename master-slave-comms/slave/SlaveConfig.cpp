@@ -0,0 +1,86 @@
+#include "SlaveConfig.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// The BCM names of gpio.hpp
+static const struct
+{
+  const char* name;
+  GpioPinNumber pin;
+} PIN_NAMES[] = {
+  {"PIN4", PIN4}, {"PIN5", PIN5}, {"PIN6", PIN6}, {"PIN12", PIN12}, {"PIN13", PIN13},
+  {"PIN16", PIN16}, {"PIN17", PIN17}, {"PIN18", PIN18}, {"PIN19", PIN19}, {"PIN20", PIN20},
+  {"PIN21", PIN21}, {"PIN22", PIN22}, {"PIN23", PIN23}, {"PIN24", PIN24}, {"PIN25", PIN25},
+  {"PIN26", PIN26}, {"PIN27", PIN27}, {"PIN_TXD", PIN_TXD}, {"PIN_RXD", PIN_RXD}
+};
+
+static bool parse_int(const std::string& word, int& value)
+{
+  char* end;
+  long v = std::strtol(word.c_str(), &end, 10);
+  if (word.empty() || *end != '\0')
+    return false;
+  value = v;
+  return true;
+}
+
+static bool parse_pin(const std::string& word, GpioPinNumber& pin)
+{
+  for (const auto& p : PIN_NAMES)
+    if (word == p.name)
+    {
+      pin = p.pin;
+      return true;
+    }
+  return parse_int(word, pin) && pin >= 0 && pin < NUM_GPIO_PINS;
+}
+
+bool SlaveConfig::load(const std::string& filename, SlaveConfig& config)
+{
+  std::ifstream file(filename);
+  if (!file)
+  {
+    fprintf(stderr, "%s: can't be read\n", filename.c_str());
+    return false;
+  }
+  SlaveConfig c;
+  std::string line;
+  for (int number = 1; std::getline(file, line); ++number)
+  {
+    std::istringstream words(line.substr(0, line.find('#')));
+    std::string key, value, extra;
+    if (!(words >> key))
+      continue;
+    bool ok = static_cast<bool>(words >> value);
+    if (ok && key == "port")
+      ok = parse_int(value, c.port) && !(words >> extra);
+    else if (ok && key == "continuous_mode")
+    {
+      int enabled = 0;
+      ok = parse_int(value, enabled) && (enabled == 0 || enabled == 1) && !(words >> extra);
+      c.continuous_mode = enabled;
+    }
+    else if (ok && key == "intermeasurement_period")
+      ok = parse_int(value, c.intermeasurement_period) && !(words >> extra);
+    else if (ok)
+    {
+      SlaveSensorConfig s;
+      s.type = key;
+      s.command = value;
+      std::string pin;
+      ok = words >> pin && parse_pin(pin, s.pin) && !(words >> extra);
+      c.sensors.push_back(s);
+    }
+    if (!ok)
+    {
+      fprintf(stderr, "%s:%d: can't make sense of \"%s\"\n", filename.c_str(), number,
+          line.c_str());
+      return false;
+    }
+  }
+  config = c;
+  return true;
+}
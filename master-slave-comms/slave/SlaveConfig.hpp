@@ -0,0 +1,39 @@
+#ifndef HYPED_MASTERSLAVECOMMS_SLAVE_SLAVECONFIG_HPP_
+#define HYPED_MASTERSLAVECOMMS_SLAVE_SLAVECONFIG_HPP_
+
+#include <string>
+#include <vector>
+
+#include "drivers/gpio.hpp"
+
+#define SLAVE_DEFAULT_PORT 11999
+#define SLAVE_DEFAULT_INTERMEASUREMENT_PERIOD 10 // ms
+
+/// One sensor line of a slave config
+struct SlaveSensorConfig
+{
+  std::string type;    // driver, e.g. "vl6180"
+  std::string command; // the master's request for its reading, e.g. "proxi-cylinder-front"
+  GpioPinNumber pin;   // wiringPi number
+};
+
+/// What a slave serves, read from a text file at startup. Blank lines and what follows '#' are
+/// ignored; the other lines are
+///   port <number>
+///   continuous_mode <0|1>
+///   intermeasurement_period <ms>
+///   <type> <command> <pin>
+/// where a pin is a wiringPi number or a BCM name from gpio.hpp ("PIN6"). Sensors are made in
+/// the order listed, which for Vl6180s also decides their I2C addresses
+struct SlaveConfig
+{
+  int port = SLAVE_DEFAULT_PORT;
+  bool continuous_mode = true;
+  int intermeasurement_period = SLAVE_DEFAULT_INTERMEASUREMENT_PERIOD;
+  std::vector<SlaveSensorConfig> sensors;
+
+  /// False (after saying why on stderr) if the file can't be read or has a bad line
+  static bool load(const std::string& filename, SlaveConfig& config);
+};
+
+#endif // HYPED_MASTERSLAVECOMMS_SLAVE_SLAVECONFIG_HPP_
@@ -1,97 +1,151 @@
-#include <chrono>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "drivers/clock.hpp"
 #include "drivers/i2c.hpp"
+#include "drivers/interfaces.hpp"
 #include "drivers/vl6180.hpp"
+#include "CommandTable.hpp"
 #include "NetworkSlave.hpp"
+#include "SlaveConfig.hpp"
 
-#define SENSOR1_PIN PIN4
-#define SENSOR2_PIN PIN24
+// Serves the sensors a config file lists (see SlaveConfig.hpp, and slave1.conf to slave4.conf
+// for the pod's slaves): ./slave <config>
 
 NetworkSlave master;
-const int SLAVE_PORT = 11999;
-const std::string NAME = "Slave:1";
-const bool continuous_mode = true;
+SlaveConfig config;
+// Indexed by the command table
+std::vector<Proxi*> sensors;
+CommandTable commands;
+// The Vl6180s, read together; each sensor's index in the group, -1 for other sensors
+Vl6180Group proxis;
+std::vector<int> in_group;
+std::vector<ProxiReading> proxi_readings;
 
-std::vector<Vl6180*> sensors;
 //Create an I2C instance to represent the bus
 I2C i2c;
-// Create factory to produce sensor drivers for that bus
-Vl6180Factory& factory = Vl6180Factory::instance(&i2c);
 
-int proxiMap(std::string command) {
-  if (command == "proxi-ground-front") {
-    return 0;
-  }
-}
-
-inline uint64_t timestamp()
+/// Makes and starts the sensor a config line names; nullptr if there's no such type
+Proxi* make_sensor(const SlaveSensorConfig& s)
 {
-  using namespace std::chrono;
-  return duration_cast<microseconds>(
-      steady_clock::now().time_since_epoch()).count();
+  if (s.type == "vl6180")
+  {
+    // Produce driver instance for the sensor with GPIO0 connected to the pin
+    Vl6180& sensor = Vl6180Factory::instance(&i2c).make_sensor(s.pin);
+    sensor.turn_on();
+    sensor.set_intermeasurement_period(config.intermeasurement_period);
+    sensor.set_continuous_mode(config.continuous_mode);
+    return &sensor;
+  }
+  return nullptr;
 }
 
-
-
-
-
 void * loop(void * m)
 {
   pthread_detach(pthread_self());
+  std::vector<std::string> readings;
+  std::vector<double> sampled;
+  std::vector<int> asked;
   while(1)
   {
-    // Listen for commands from master
-    std::string command = master.getMessage();
-
-    if (command.substr(0, 6) == "proxi-")
+    // Sleeps until the master asks for something: one command, or a batch of them separated by
+    // spaces, answered together (see NetworkSlave::SendReadings)
+    std::istringstream batch(master.wait_message());
+    readings.clear();
+    sampled.clear();
+    asked.clear();
+    bool group_asked = false;
+    std::string command;
+    while (batch >> command)
     {
-      std::string readings = NAME + "\n"; // populate with readings from proxy
-      int dist = sensors[proxiMap(command)]->get_distance();
-      std::string res = std::to_string(dist);  
-      
-      std::cout << "Message:" << command << std::endl;
-      master.Send(res); // send the readings
-      master.clean();
+      int i = commands.find(command);
+      if (i < 0)
+        std::cerr << "Unknown command: " << command << std::endl;
+      asked.push_back(i);
+      group_asked |= i >= 0 && in_group[i] >= 0;
     }
-
-    if (command == "") {
-      // check custom commands here
+    // The Vl6180s range at once rather than one after the other (the master asks for all of a
+    // slave's proxis in one batch); readings which can't be stamped are by the time of the group
+    double group_time = 0.0;
+    if (group_asked)
+    {
+      double t0 = Clock::get().now();
+      proxis.get_distances(proxi_readings.data());
+      group_time = (t0 + Clock::get().now()) / 2.0;
     }
-
+    for (int i : asked)
+    {
+      double t0 = Clock::get().now();
+      // Still answered, so the rest of the batch's replies stay in line with their commands
+      std::string reading = "error";
+      if (i < 0)
+        reading = "unknown";
+      else if (in_group[i] >= 0)
+      {
+        const ProxiReading& r = proxi_readings[in_group[i]];
+        if (r.fresh)
+          reading = std::to_string(r.distance);
+        t0 = r.timestamp >= 0.0 ? r.timestamp : group_time;
+      }
+      else
+      {
+        try
+        {
+          reading = std::to_string(sensors[i]->get_distance());
+        }
+        catch (std::exception& e)
+        {
+          std::cerr << config.sensors[i].command << ": " << e.what() << std::endl;
+        }
+        t0 = (t0 + Clock::get().now()) / 2.0;
+      }
+      readings.push_back(reading);
+      sampled.push_back(t0);
+    }
+    if (!readings.empty())
+      master.SendReadings(readings, sampled); // send the readings and when they were taken
   }
-
-  usleep(1000);
-  master.detach();
-
+  return 0;
 }
-  
 
-int main()
+int main(int argc, char* argv[])
 {
-  // Produce driver instance for the sensor with GPIO0 connected to specified pin
-  Vl6180& sensor_ref = factory.make_sensor(SENSOR1_PIN);
-  // Store pointer to the driver instance
-  sensors.push_back(&sensor_ref);
-
-  // Uncoment the following line and possibly add more to use more sensors
-  //sensors.push_back( &(factory.make_sensor(SENSOR2_PIN)) );
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <config>" << std::endl;
+    return 1;
+  }
+  if (!SlaveConfig::load(argv[1], config))
+    return 1;
 
-  for (unsigned int i = 0; i < sensors.size(); ++i)
+  std::vector<std::string> names;
+  for (const SlaveSensorConfig& s : config.sensors)
+  {
+    Proxi* sensor = make_sensor(s);
+    if (sensor == nullptr)
+    {
+      std::cerr << argv[1] << ": no sensor type " << s.type << std::endl;
+      return 1;
+    }
+    sensors.push_back(sensor);
+    names.push_back(s.command);
+    Vl6180* vl6180 = dynamic_cast<Vl6180*>(sensor);
+    in_group.push_back(vl6180 != nullptr ? proxis.add_sensor(*vl6180) : -1);
+  }
+  proxi_readings.resize(proxis.size());
+  if (!commands.build(names))
   {
-    //std::this_thread::sleep_for(std::chrono::seconds(3));
-    sensors[i]->turn_on();
-    sensors[i]->set_intermeasurement_period(10);
-    sensors[i]->set_continuous_mode(continuous_mode);
+    std::cerr << argv[1] << ": a command is listed twice" << std::endl;
+    return 1;
   }
 
   pthread_t msg;
-  master.setup(SLAVE_PORT);
+  master.setup(config.port);
   if( pthread_create(&msg, NULL, loop, (void *)0) == 0)
   {
     master.receive();
   }
-   return 0;
+  return 0;
 }
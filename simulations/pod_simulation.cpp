@@ -0,0 +1,143 @@
+#include "pod_simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "drivers/clock.hpp"
+
+// Damped oscillation of `x` about `target` at angular frequency `w`; returns the acceleration
+static double oscillate(double& x, double& rate, double target, double w, double damping,
+    double dt)
+{
+  double accl = w * w * (target - x) - 2.0 * damping * w * rate;
+  rate += accl * dt;
+  x += rate * dt;
+  return accl;
+}
+
+PodSimulation::PodSimulation(PodConfig config)
+    : config(config),
+    step_lag(1.0 - std::exp(-config.time_step / config.valve_lag))
+{
+  this->state.position = config.start_position;
+  this->state.brake_gaps[0] = this->state.brake_gaps[1] = config.brake_gap;
+}
+
+void PodSimulation::advance(double t)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->real_time)
+    return;
+  while (this->state.time < t)
+    this->step(std::min(this->config.time_step, t - this->state.time));
+}
+
+void PodSimulation::set_real_time(bool real_time)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->real_time = real_time;
+  this->real_time_start = Clock::get().now();
+  this->real_time_offset = this->state.time;
+}
+
+PodState PodSimulation::get_state()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->sync();
+  return this->state;
+}
+
+double PodSimulation::get_time()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->sync();
+  return this->state.time;
+}
+
+Quaternion PodSimulation::get_rotor(const PodState& state)
+{
+  // Yaw about z, then pitch (nose up is a negative turn about y, which points left)
+  Quaternion yaw(std::cos(state.yaw / 2.0), 0.0, 0.0, std::sin(state.yaw / 2.0));
+  Quaternion pitch(std::cos(state.pitch / 2.0), 0.0, -std::sin(state.pitch / 2.0), 0.0);
+  return yaw * pitch;
+}
+
+void PodSimulation::actuate(RailSide side, BrakeCommand command)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->sync();
+  this->commands[(int) side] = command;
+}
+
+void PodSimulation::sync()
+{
+  if (!this->real_time)
+    return;
+  double t = this->real_time_offset + Clock::get().now() - this->real_time_start;
+  while (this->state.time < t)
+    this->step(std::min(this->config.time_step, t - this->state.time));
+}
+
+void PodSimulation::step(double dt)
+{
+  const PodConfig& c = this->config;
+  PodState& s = this->state;
+
+  // Brake pistons: constant speed while a valve is open, reached with a first-order lag, stopped
+  // by the end stop or once the pads squeeze the rail as hard as the hydraulics allow
+  double max_gap = std::min(c.max_gap, c.contact_gap + c.max_clamp_force / c.pad_stiffness);
+  s.brake_force = 0;
+  double lag = (dt == c.time_step) ? this->step_lag : 1.0 - std::exp(-dt / c.valve_lag);
+  for (int i = 0; i < 2; ++i)
+  {
+    double target_speed = 0.0;
+    if (this->commands[i] == BrakeCommand::extend)
+      target_speed = c.extend_speed;
+    else if (this->commands[i] == BrakeCommand::retract)
+      target_speed = -c.retract_speed;
+    this->piston_speeds[i] += (target_speed - this->piston_speeds[i]) * lag;
+    s.brake_gaps[i] += this->piston_speeds[i] * dt;
+    if (s.brake_gaps[i] < c.min_gap || s.brake_gaps[i] > max_gap)
+    {
+      s.brake_gaps[i] = (s.brake_gaps[i] < c.min_gap) ? c.min_gap : max_gap;
+      this->piston_speeds[i] = 0.0;
+    }
+    double clamp_force = std::max(0.0, s.brake_gaps[i] - c.contact_gap) * c.pad_stiffness;
+    s.brake_force += 2 * c.pad_friction * clamp_force;
+  }
+
+  s.pushing = s.time >= c.push_start && s.position - c.start_position < c.push_distance;
+  double force = s.pushing ? c.mass * c.push_acceleration : 0.0;
+  // Resistance only ever slows the pod down, it can't push it back
+  double resistance = s.brake_force + c.rolling_resistance * c.mass * GRAVITY
+      + 0.5 * c.air_density * c.drag_area * s.velocity * s.velocity;
+  if (s.velocity > 0.0 || force > resistance)
+    s.acceleration = (force - resistance) / c.mass;
+  else
+    s.acceleration = 0.0;
+
+  double velocity = s.velocity + s.acceleration * dt;
+  if (velocity < 0.0)
+  {
+    // Stopped within this step
+    dt = s.velocity / -s.acceleration;
+    velocity = 0.0;
+  }
+  s.position += (s.velocity + velocity) / 2 * dt;
+  s.velocity = velocity;
+
+  // Suspension, level where the pod starts so that it is at rest until pushed
+  double w = 2.0 * M_PI * c.suspension_frequency;
+  double phase = 2.0 * M_PI * (s.position - c.start_position) / c.disturbance_wavelength
+      + c.disturbance_phase;
+  auto disturbance = [&](double amplitude, double offset) {
+    return amplitude * (std::sin(phase + offset) - std::sin(c.disturbance_phase + offset));
+  };
+  s.heave_accl = oscillate(s.heave, s.heave_rate, disturbance(c.heave_disturbance, 0.0), w,
+      c.suspension_damping, dt);
+  oscillate(s.pitch, s.pitch_rate, c.squat * s.acceleration
+      + disturbance(c.pitch_disturbance, 2.0 * M_PI / 3.0), w, c.suspension_damping, dt);
+  oscillate(s.yaw, s.yaw_rate, disturbance(c.yaw_disturbance, 4.0 * M_PI / 3.0), w,
+      c.suspension_damping, dt);
+  s.time += dt;
+}
@@ -0,0 +1,108 @@
+#ifndef HYPED_SIMULATIONS_POD_SIMULATION_HPP_
+#define HYPED_SIMULATIONS_POD_SIMULATION_HPP_
+
+#include <mutex>
+
+#include "drivers/interfaces.hpp"
+#include "drivers/quaternion.hpp"
+
+#define GRAVITY 9.80665 // m/s^2
+
+struct PodConfig
+{
+  double mass = 250.0;              // kg
+  double start_position = -1.0;     // m, along the track (the first stripe is at 0)
+  double time_step = 1.0e-4;        // s, of the integration
+  // Pusher
+  double push_start = 1.0;          // s
+  double push_acceleration = 9.0;   // m/s^2, what the pusher's force alone gives the pod
+  double push_distance = 450.0;     // m travelled from the start before the pusher stops
+  // Resistance
+  double drag_area = 0.6;           // m^2, drag coefficient times frontal area
+  double air_density = 0.01;        // kg/m^3, at tube pressure
+  double rolling_resistance = 0.01; // of the weight
+  // Hydraulic brakes, with gaps as the brake proxis see them (growing as the pistons extend,
+  // like SimulatedCylinder)
+  double brake_gap = 80.0;          // mm, initially
+  double extend_speed = 40.0;       // mm/s
+  double retract_speed = 60.0;      // mm/s
+  double valve_lag = 0.02;          // s, time constant of the piston speed
+  double min_gap = 60.0;            // mm
+  double max_gap = 160.0;           // mm
+  double contact_gap = 120.0;       // mm, pads touch the rail beyond it
+  double pad_stiffness = 400.0;     // N/mm of pad squeeze
+  double max_clamp_force = 3000.0;  // N per brake, where the relief valve stops the piston
+  double pad_friction = 0.35;       // both pads of a brake grip the rail
+  double ride_height = 12.0;        // mm above the rail at the ground proxis
+  double brake_separation = 250.0;  // mm between the front and rear proxi of a brake
+  // Suspension: heave, pitch and yaw each swing about where the pod's acceleration and the
+  // track's irregularities (felt by the skis as forces; the rail itself stays flat and straight
+  // for the proxis) push them
+  double suspension_frequency = 3.0; // Hz, undamped
+  double suspension_damping = 0.3;   // of critical
+  double squat = 0.002;              // rad of pitch (nose up) per m/s^2 of acceleration
+  double heave_disturbance = 1.0;    // mm, amplitude
+  double pitch_disturbance = 0.005;  // rad
+  double yaw_disturbance = 0.005;    // rad
+  double disturbance_wavelength = 25.0; // m along the track
+  double disturbance_phase = 0.0;    // rad, where along the irregularities the pod starts
+};
+
+struct PodState
+{
+  double time = 0;         // s
+  double position = 0;     // m along the track
+  double velocity = 0;     // m/s
+  double acceleration = 0; // m/s^2
+  double brake_gaps[2];    // mm, indexed by RailSide
+  double brake_force = 0;  // N, all brakes together
+  bool pushing = false;
+  double heave = 0;        // mm above the ride height
+  double pitch = 0;        // rad, nose up
+  double yaw = 0;          // rad, nose to the left
+  double heave_rate = 0;   // mm/s
+  double pitch_rate = 0;   // rad/s
+  double yaw_rate = 0;     // rad/s
+  double heave_accl = 0;   // mm/s^2
+};
+
+/// Dynamics of the pod along the track: the pusher, air and rolling resistance and friction from
+/// the hydraulic brakes, whose pistons move like the real ones (see sim_cylinder.hpp), and the
+/// suspension's heave, pitch and yaw. Integrated with a fixed time step, so runs are deterministic and as fast as
+/// the host allows; the simulated sensors (sim_sensors.hpp) read the state at the current
+/// simulated time. With set_real_time() the simulation keeps up with Clock::get() instead, for
+/// code that reads sensors from its own threads.
+class PodSimulation : public BrakeActuator
+{
+  public:
+    PodSimulation(PodConfig config = PodConfig());
+
+    /// Integrates up to simulated time `t` (s); does nothing in real time
+    void advance(double t);
+    /// From now on simulated time follows Clock::get(), continuing from the current time
+    void set_real_time(bool real_time);
+    PodState get_state();
+    double get_time();
+    const PodConfig& get_config() const { return this->config; }
+    /// Attitude of the pod in `state` as MotionTracker::get_rotor() gives it: the rotation from
+    /// the pod frame (x forward, y left, z up) to the track's
+    static Quaternion get_rotor(const PodState& state);
+
+    void actuate(RailSide side, BrakeCommand command) override;
+
+  private:
+    void step(double dt);
+    void sync(); // brings the state up to Clock::get() in real time
+
+    const PodConfig config;
+    const double step_lag; // piston speed change over a full time step, relative to the target
+    std::mutex mutex;
+    PodState state;
+    double piston_speeds[2] = {0, 0}; // mm/s
+    BrakeCommand commands[2] = {BrakeCommand::hold, BrakeCommand::hold};
+    bool real_time = false;
+    double real_time_start = 0;
+    double real_time_offset = 0;
+};
+
+#endif // HYPED_SIMULATIONS_POD_SIMULATION_HPP_
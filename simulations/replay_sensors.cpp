@@ -0,0 +1,104 @@
+#include "replay_sensors.hpp"
+
+#include <algorithm>
+#include <string>
+
+// Empty if the log has no such channel
+static ColumnSpan<double> channel_timestamps(const RunLog& log, const std::string& channel)
+{
+  int c = log.find_channel(channel);
+  return c < 0 ? ColumnSpan<double>() : log.get_timestamps(c);
+}
+
+SampleCursor::SampleCursor(ColumnSpan<double> timestamps)
+    : timestamps(timestamps)
+{}
+
+long SampleCursor::at(double t)
+{
+  long n = this->timestamps.size();
+  while (this->index + 1 < n && this->timestamps[this->index + 1] <= t)
+    ++this->index;
+  return this->index;
+}
+
+
+ReplayImu::ReplayImu(const RunLog& log, int n, Clock& clock, unsigned int seed,
+    double accl_noise, double gyro_noise, Vector3D<double> accl_bias, Vector3D<double> gyro_bias)
+    : accl(log.get_vector3d("accl" + std::to_string(n))),
+    gyro(log.get_vector3d("gyro" + std::to_string(n))),
+    accl_cursor(accl.timestamp), gyro_cursor(gyro.timestamp), clock(clock), rng(seed),
+    accl_noise(0.0, accl_noise), gyro_noise(0.0, gyro_noise), accl_bias(accl_bias),
+    gyro_bias(gyro_bias)
+{}
+
+bool ReplayImu::is_valid() const
+{
+  return !this->accl.timestamp.empty() && !this->gyro.timestamp.empty();
+}
+
+Vector3D<double> ReplayImu::noise(std::normal_distribution<double>& distribution)
+{
+  if (distribution.stddev() == 0.0)
+    return Vector3D<double>();
+  double x = distribution(this->rng);
+  double y = distribution(this->rng);
+  double z = distribution(this->rng);
+  return Vector3D<double>(x, y, z);
+}
+
+Vector3D<double> ReplayImu::get_acceleration()
+{
+  // Before the first sample, the first one stands in (e.g. while calibrating)
+  long i = std::max(0L, this->accl_cursor.at(this->clock.now()));
+  return Vector3D<double>(this->accl.x[i], this->accl.y[i], this->accl.z[i]) + this->accl_bias
+      + this->noise(this->accl_noise);
+}
+
+Vector3D<double> ReplayImu::get_angular_velocity()
+{
+  long i = std::max(0L, this->gyro_cursor.at(this->clock.now()));
+  return Vector3D<double>(this->gyro.x[i], this->gyro.y[i], this->gyro.z[i]) + this->gyro_bias
+      + this->noise(this->gyro_noise);
+}
+
+ImuData ReplayImu::get_imu_data()
+{
+  return ImuData(this->get_acceleration(), this->get_angular_velocity());
+}
+
+
+ReplayStripes::ReplayStripes(const RunLog& log, Clock& clock)
+    : counts(log.get_column("stripes", "count")),
+    distances(log.get_column("stripes", "distance")),
+    cursor(channel_timestamps(log, "stripes")), clock(clock)
+{}
+
+bool ReplayStripes::is_valid() const
+{
+  return !this->counts.empty() && !this->distances.empty();
+}
+
+long ReplayStripes::sample()
+{
+  return this->cursor.at(this->clock.now());
+}
+
+bool ReplayStripes::has_new_stripe()
+{
+  long i = this->sample();
+  return i >= 0 && (int) this->counts[i] != this->read_count;
+}
+
+int ReplayStripes::get_count()
+{
+  long i = this->sample();
+  this->read_count = i < 0 ? 0 : (int) this->counts[i];
+  return this->read_count;
+}
+
+double ReplayStripes::get_distance()
+{
+  long i = this->sample();
+  return i < 0 ? 0.0 : this->distances[i];
+}
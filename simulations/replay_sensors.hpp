@@ -0,0 +1,89 @@
+#ifndef HYPED_SIMULATIONS_REPLAY_SENSORS_HPP_
+#define HYPED_SIMULATIONS_REPLAY_SENSORS_HPP_
+
+#include <random>
+
+#include "drivers/clock.hpp"
+#include "drivers/interfaces.hpp"
+#include "drivers/run_log.hpp"
+#include "drivers/vector3d.hpp"
+
+/*
+ * Sensors replaying the readings in a run log recorded by MotionTracker::set_recorder, so a
+ * tracker can be run again on a recorded run (e.g. with other parameters). Each reads the latest
+ * sample at or before the clock's now(); the log's times are from when the recording tracker
+ * started, so start the replaying one at time 0. The IMU adds its own seeded noise and biases on
+ * top, so the same run can be replayed with many perturbations.
+ */
+
+/// Latest sample of a channel at or before a time, for times that only move forward
+class SampleCursor
+{
+  public:
+    SampleCursor(ColumnSpan<double> timestamps = ColumnSpan<double>());
+
+    /// Index of the sample, or -1 if there is none yet
+    long at(double t);
+
+  private:
+    ColumnSpan<double> timestamps;
+    long index = -1;
+};
+
+/// accl<n> and gyro<n> of the log, i.e. the n-th IMU if the recording tracker only had IMUs
+class ReplayImu : public Imu
+{
+  public:
+    ReplayImu(const RunLog& log, int n, Clock& clock, unsigned int seed, double accl_noise = 0.0,
+        double gyro_noise = 0.0, Vector3D<double> accl_bias = Vector3D<double>(),
+        Vector3D<double> gyro_bias = Vector3D<double>());
+
+    /// Whether the log has both channels
+    bool is_valid() const;
+
+    Vector3D<double> get_acceleration() override;
+    void calibrate_gyro(int n) override {}
+    Vector3D<double> get_angular_velocity() override;
+    ImuData get_imu_data() override;
+
+  private:
+    Vector3D<double> noise(std::normal_distribution<double>& distribution);
+
+    Vector3DColumns accl;
+    Vector3DColumns gyro;
+    SampleCursor accl_cursor;
+    SampleCursor gyro_cursor;
+    Clock& clock;
+    std::mt19937 rng;
+    std::normal_distribution<double> accl_noise;
+    std::normal_distribution<double> gyro_noise;
+    Vector3D<double> accl_bias;
+    Vector3D<double> gyro_bias;
+};
+
+/// The stripes channel of the log
+class ReplayStripes : public StripeCounter
+{
+  public:
+    ReplayStripes(const RunLog& log, Clock& clock);
+
+    bool is_valid() const;
+
+    void calibrate() override {}
+    void start() override {}
+    void stop() override {}
+    bool has_new_stripe() override;
+    int get_count() override;
+    double get_distance() override;
+
+  private:
+    long sample(); // at the clock's now(), -1 before the first
+
+    ColumnSpan<double> counts;
+    ColumnSpan<double> distances;
+    SampleCursor cursor;
+    Clock& clock;
+    int read_count = 0; // at the last get_count()
+};
+
+#endif // HYPED_SIMULATIONS_REPLAY_SENSORS_HPP_
@@ -0,0 +1,139 @@
+#include "sim_sensors.hpp"
+
+#include <cmath>
+
+#include "drivers/stripes.hpp"
+
+SimulatedImu::SimulatedImu(PodSimulation& sim, unsigned int seed, double accl_noise,
+    double gyro_noise, Vector3D<double> accl_bias, Vector3D<double> gyro_bias)
+    : sim(sim), rng(seed), accl_noise(0.0, accl_noise), gyro_noise(0.0, gyro_noise),
+    accl_bias(accl_bias), gyro_bias(gyro_bias)
+{}
+
+Vector3D<double> SimulatedImu::noise(std::normal_distribution<double>& distribution)
+{
+  double x = distribution(this->rng);
+  double y = distribution(this->rng);
+  double z = distribution(this->rng);
+  return Vector3D<double>(x, y, z);
+}
+
+Vector3D<double> SimulatedImu::get_acceleration()
+{
+  PodState state = this->sim.get_state();
+  // What the track frame's acceleration and gravity are in the pod's
+  Quaternion rotor = PodSimulation::get_rotor(state);
+  Vector3D<double> accl = Quaternion::inv(rotor)
+      * Vector3D<double>(state.acceleration, 0.0, GRAVITY + state.heave_accl / 1000.0) * rotor;
+  return accl + this->accl_bias + this->noise(this->accl_noise);
+}
+
+Vector3D<double> SimulatedImu::get_angular_velocity()
+{
+  PodState state = this->sim.get_state();
+  // The yaw rate is about the track's z axis, which pitching tilts away from the pod's
+  Vector3D<double> angv(std::sin(state.pitch) * state.yaw_rate, -state.pitch_rate,
+      std::cos(state.pitch) * state.yaw_rate);
+  return angv + this->gyro_bias + this->noise(this->gyro_noise);
+}
+
+ImuData SimulatedImu::get_imu_data()
+{
+  return ImuData(this->get_acceleration(), this->get_angular_velocity());
+}
+
+
+SimulatedGroundProxi::SimulatedGroundProxi(PodSimulation& sim, Vector3D<double> position,
+    unsigned int seed, double noise)
+    : sim(sim), position(position), rng(seed), noise(0.0, noise)
+{}
+
+int SimulatedGroundProxi::get_distance()
+{
+  PodState state = this->sim.get_state();
+  // Height above the rail, measured along the pitched z axis
+  double height = this->sim.get_config().ride_height + state.heave
+      + this->position.x * std::sin(state.pitch) + this->position.z * std::cos(state.pitch);
+  return (int) std::lround(height / std::cos(state.pitch) + this->noise(this->rng));
+}
+
+
+SimulatedBrakeProxi::SimulatedBrakeProxi(PodSimulation& sim, RailSide side, bool front,
+    unsigned int seed, double noise)
+    : sim(sim), side(side), front(front), rng(seed), noise(0.0, noise)
+{}
+
+int SimulatedBrakeProxi::get_distance()
+{
+  PodState state = this->sim.get_state();
+  // Yawing to the left takes the front of the left brake away from the rail, and the front of
+  // the right brake towards it
+  double offset = (this->front ? 0.5 : -0.5) * this->sim.get_config().brake_separation
+      * std::tan(state.yaw);
+  if (this->side == RailSide::right)
+    offset = -offset;
+  return (int) std::lround(state.brake_gaps[(int) this->side] + offset + this->noise(this->rng));
+}
+
+
+SimulatedStripes::SimulatedStripes(PodSimulation& sim)
+    : sim(sim)
+{}
+
+int SimulatedStripes::count_passed()
+{
+  double position = this->sim.get_state().position;
+  int passed = 0;
+  while (passed < NUM_STRIPES
+      && stripe_locations[passed] * STRIPE_UNIT + STRIPE_WIDTH <= position)
+    ++passed;
+  return passed;
+}
+
+void SimulatedStripes::start()
+{
+  this->start_count = this->count_passed();
+  this->stop_count = 0;
+  this->read_count = 0;
+  this->counting = true;
+}
+
+void SimulatedStripes::stop()
+{
+  this->stop_count = this->count_passed() - this->start_count;
+  this->counting = false;
+}
+
+int SimulatedStripes::current_count()
+{
+  if (this->counting)
+    return this->count_passed() - this->start_count;
+  return this->stop_count;
+}
+
+bool SimulatedStripes::has_new_stripe()
+{
+  return this->current_count() != this->read_count;
+}
+
+int SimulatedStripes::get_count()
+{
+  int count = this->current_count();
+  this->read_count = count;
+  return count;
+}
+
+double SimulatedStripes::get_distance()
+{
+  return this->get_count() * STRIPE_DISTANCE;
+}
+
+bool SimulatedStripes::on_stripe()
+{
+  double position = this->sim.get_state().position;
+  for (int i = 0; i < NUM_STRIPES; ++i)
+    if (position >= stripe_locations[i] * STRIPE_UNIT
+        && position < stripe_locations[i] * STRIPE_UNIT + STRIPE_WIDTH)
+      return true;
+  return false;
+}
@@ -0,0 +1,103 @@
+#ifndef HYPED_SIMULATIONS_SIM_SENSORS_HPP_
+#define HYPED_SIMULATIONS_SIM_SENSORS_HPP_
+
+#include <atomic>
+#include <random>
+
+#include "drivers/interfaces.hpp"
+#include "drivers/vector3d.hpp"
+#include "pod_simulation.hpp"
+
+/*
+ * Sensors reading a PodSimulation through the driver interfaces, so they can stand in for the
+ * real ones anywhere (e.g. in MotionTracker). Each one has its own seeded noise, so a simulation
+ * read in the same order gives the same readings every time. The pod frame is x forward, y left,
+ * z up, with positions in mm from the centre of the pod.
+ */
+
+/// At the centre of the pod
+class SimulatedImu : public Imu
+{
+  public:
+    SimulatedImu(PodSimulation& sim, unsigned int seed, double accl_noise = 0.05,
+        double gyro_noise = 0.002, Vector3D<double> accl_bias = Vector3D<double>(),
+        Vector3D<double> gyro_bias = Vector3D<double>());
+
+    Vector3D<double> get_acceleration() override;
+    void calibrate_gyro(int n) override {}
+    Vector3D<double> get_angular_velocity() override;
+    ImuData get_imu_data() override;
+
+  private:
+    Vector3D<double> noise(std::normal_distribution<double>& distribution);
+
+    PodSimulation& sim;
+    std::mt19937 rng;
+    std::normal_distribution<double> accl_noise;
+    std::normal_distribution<double> gyro_noise;
+    Vector3D<double> accl_bias;
+    Vector3D<double> gyro_bias;
+};
+
+/// Distance to the rail below (mm), along the pod's z axis from `position`
+class SimulatedGroundProxi : public Proxi
+{
+  public:
+    SimulatedGroundProxi(PodSimulation& sim, Vector3D<double> position, unsigned int seed,
+        double noise = 0.5);
+
+    int get_distance() override;
+
+  private:
+    PodSimulation& sim;
+    Vector3D<double> position;
+    std::mt19937 rng;
+    std::normal_distribution<double> noise;
+};
+
+/// Gap of one of the brakes (mm) at its front or rear proxi, PodConfig::brake_separation apart:
+/// the brake's gap, more or less as the pod yaws
+class SimulatedBrakeProxi : public Proxi
+{
+  public:
+    SimulatedBrakeProxi(PodSimulation& sim, RailSide side, bool front, unsigned int seed,
+        double noise = 0.5);
+
+    int get_distance() override;
+
+  private:
+    PodSimulation& sim;
+    RailSide side;
+    bool front;
+    std::mt19937 rng;
+    std::normal_distribution<double> noise;
+};
+
+/// Counts the stripes of stripes.hpp as the Keyence would: from zero at start(), once the sensor
+/// has passed the end of a stripe, with get_distance() assuming STRIPE_DISTANCE per stripe
+class SimulatedStripes : public StripeCounter
+{
+  public:
+    SimulatedStripes(PodSimulation& sim);
+
+    void calibrate() override {}
+    void start() override;
+    void stop() override;
+    bool has_new_stripe() override;
+    int get_count() override;
+    double get_distance() override;
+    /// Whether the sensor is over a stripe now (the Keyence's output)
+    bool on_stripe();
+
+  private:
+    int count_passed(); // by the sensor, from the start of the track
+    int current_count();
+
+    PodSimulation& sim;
+    std::atomic_bool counting {false};
+    std::atomic<int> start_count {0}; // stripes passed before start()
+    std::atomic<int> stop_count {0};  // count when stopped
+    std::atomic<int> read_count {0};  // at the last get_count()
+};
+
+#endif // HYPED_SIMULATIONS_SIM_SENSORS_HPP_
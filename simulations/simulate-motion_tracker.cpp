@@ -0,0 +1,115 @@
+/*
+ * Runs MotionTracker on simulated sensors: the pod is pushed a second after tracking starts and
+ * brakes once the tracked displacement passes the braking point.
+ *   simulate-motion_tracker [-e] [-v] [-d braking_distance]
+ * -e tracks in NavMode::ekf. -v runs on a stepped VirtualClock instead of in real time, as fast
+ * as the tracker can go. Prints the tracked and true position and velocity as it goes.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+#include "drivers/clock.hpp"
+#include "drivers/instrumentation.hpp"
+#include "drivers/motion_tracker.hpp"
+#include "pod_simulation.hpp"
+#include "sim_sensors.hpp"
+
+#define CONTROL_PERIOD 0.01 // s
+#define PRINT_PERIOD 0.5 // s
+#define MAX_RUN_TIME 60.0 // s
+
+int main(int argc, char* argv[])
+{
+  NavMode mode = NavMode::complementary;
+  double braking_distance = 900.0;
+  bool virtual_time = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "evd:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'e':
+        mode = NavMode::ekf;
+        break;
+      case 'v':
+        virtual_time = true;
+        break;
+      case 'd':
+        braking_distance = atof(optarg);
+        break;
+      default:
+        printf("Usage: %s [-e] [-v] [-d braking_distance]\n", argv[0]);
+        return 1;
+    }
+  }
+  // Calibration doesn't sleep, so the clock can be stepped from the start
+  VirtualClock clock(VirtualClockMode::stepped);
+  if (virtual_time)
+    Clock::set(clock);
+
+  PodSimulation sim;
+  SimulatedImu imu1(sim, 1), imu2(sim, 2);
+  Vector3D<double> positions[4] = {Vector3D<double>(500, 1000, 0),
+      Vector3D<double>(500, -1000, 0), Vector3D<double>(-500, -1000, 0),
+      Vector3D<double>(-500, 1000, 0)};
+  SimulatedGroundProxi ground[4] = {SimulatedGroundProxi(sim, positions[0], 3),
+      SimulatedGroundProxi(sim, positions[1], 4), SimulatedGroundProxi(sim, positions[2], 5),
+      SimulatedGroundProxi(sim, positions[3], 6)};
+  SimulatedBrakeProxi left_front(sim, RailSide::left, true, 7);
+  SimulatedBrakeProxi left_rear(sim, RailSide::left, false, 8);
+  SimulatedBrakeProxi right_front(sim, RailSide::right, true, 9);
+  SimulatedBrakeProxi right_rear(sim, RailSide::right, false, 10);
+  SimulatedStripes stripes(sim);
+  MotionTracker mt(stripes, mode);
+  mt.add_imu(imu1);
+  mt.add_imu(imu2);
+  for (int i = 0; i < 4; ++i)
+    mt.add_ground_proxi(ground[i], positions[i]);
+  mt.add_brake_proxis(left_front, left_rear, RailSide::left);
+  mt.add_brake_proxis(right_front, right_rear, RailSide::right);
+  // The pod stays at rest through the calibration
+  mt.start();
+  sim.set_real_time(true);
+
+  bool braking = false;
+  double start_position = sim.get_config().start_position;
+  double next_print = 0;
+  double next_control = 0;
+  while (sim.get_time() < MAX_RUN_TIME)
+  {
+    // Virtual time moves on whenever the tracker sleeps, which is when its readings are due
+    if (virtual_time)
+    {
+      if (clock.step(1) < next_control)
+        continue;
+      next_control += CONTROL_PERIOD;
+    }
+    else
+      std::this_thread::sleep_for(std::chrono::duration<double>(CONTROL_PERIOD));
+    PodState state = sim.get_state();
+    double position = start_position + mt.get_displacement().x;
+    if (state.time >= next_print)
+    {
+      next_print += PRINT_PERIOD;
+      printf("%6.2f s: tracked %8.2f m %6.2f m/s, true %8.2f m %6.2f m/s, %d stripes\n",
+          state.time, position, mt.get_velocity().x, state.position, state.velocity,
+          mt.get_stripe_count());
+    }
+    if (!braking && !state.pushing && position >= braking_distance)
+    {
+      braking = true;
+      sim.actuate(RailSide::left, BrakeCommand::extend);
+      sim.actuate(RailSide::right, BrakeCommand::extend);
+    }
+    if (braking && state.velocity == 0.0)
+      break;
+  }
+  clock.set_mode(VirtualClockMode::jump);
+  mt.stop();
+  printf("%s", Instrumentation::report().c_str());
+  return 0;
+}
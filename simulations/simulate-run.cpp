@@ -0,0 +1,113 @@
+/*
+ * Simulates whole runs as fast as possible: pushed, coasting, then braking once the distance
+ * estimated from the simulated IMU passes the braking point.
+ *   simulate-run [-d braking_distance] [-n runs] [-s seed]
+ * Runs use seeds seed, seed + 1, ... and print one line each, then how much faster than real time
+ * they were simulated.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "drivers/stripes.hpp"
+#include "pod_simulation.hpp"
+#include "sim_sensors.hpp"
+
+#define CONTROL_RATE 1000.0 // Hz
+#define MAX_RUN_TIME 120.0  // s
+
+struct RunResult
+{
+  double time;           // s, until stopped
+  double stop_position;  // m
+  double max_velocity;   // m/s
+  double braking_error;  // m, estimated minus true position when braking started
+  int stripes;
+};
+
+RunResult run(double braking_distance, unsigned int seed)
+{
+  PodSimulation sim;
+  SimulatedImu imu(sim, seed);
+  SimulatedStripes stripes(sim);
+  RunResult result = {0, 0, 0, 0, 0};
+
+  // Dead reckoning from the IMU, trapezoidal like MotionTracker's complementary mode
+  const double dt = 1.0 / CONTROL_RATE;
+  double position = sim.get_config().start_position;
+  double velocity = 0;
+  double previous_accl = 0;
+  bool braking = false;
+  stripes.start();
+  for (int i = 1; i * dt < MAX_RUN_TIME; ++i)
+  {
+    sim.advance(i * dt);
+    double accl = imu.get_acceleration().x;
+    double new_velocity = velocity + (previous_accl + accl) / 2 * dt;
+    position += (velocity + new_velocity) / 2 * dt;
+    velocity = new_velocity;
+    previous_accl = accl;
+
+    PodState state = sim.get_state();
+    if (state.velocity > result.max_velocity)
+      result.max_velocity = state.velocity;
+    if (!braking && !state.pushing && position >= braking_distance)
+    {
+      braking = true;
+      result.braking_error = position - state.position;
+      sim.actuate(RailSide::left, BrakeCommand::extend);
+      sim.actuate(RailSide::right, BrakeCommand::extend);
+    }
+    if (braking && state.velocity == 0.0)
+      break;
+  }
+  PodState state = sim.get_state();
+  result.time = state.time;
+  result.stop_position = state.position;
+  result.stripes = stripes.get_count();
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  double braking_distance = 900.0;
+  int runs = 1;
+  unsigned int seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:n:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'd':
+        braking_distance = atof(optarg);
+        break;
+      case 'n':
+        runs = atoi(optarg);
+        break;
+      case 's':
+        seed = atoi(optarg);
+        break;
+      default:
+        printf("Usage: %s [-d braking_distance] [-n runs] [-s seed]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  const double track_end = stripe_locations[NUM_STRIPES - 1] * STRIPE_UNIT;
+  double simulated_time = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i)
+  {
+    RunResult r = run(braking_distance, seed + i);
+    simulated_time += r.time;
+    printf("seed %u: stopped at %.1f m (%.1f m before the last stripe) after %.2f s, "
+        "max %.1f m/s, %d stripes, braked %+.2f m off\n", seed + i, r.stop_position,
+        track_end - r.stop_position, r.time, r.max_velocity, r.stripes, r.braking_error);
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%.1f s simulated in %.3f s (%.0f times real time)\n", simulated_time, elapsed,
+      simulated_time / elapsed);
+  return 0;
+}
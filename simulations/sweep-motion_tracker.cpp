@@ -0,0 +1,397 @@
+/*
+ * Monte Carlo sweep of MotionTracker parameters: runs thousands of independent trackers, each on
+ * its own virtual clock, across all cores with a work-stealing pool.
+ *   sweep-motion_tracker [-e] [-n runs] [-s seed] [-j threads] [-r run_log] [-d braking_distance]
+ *       [-g gyro_weights] [-b brake_separations] [-c calibration_samples]
+ * -g, -b and -c take comma-separated lists and every combination is a parameter set. Each set is
+ * run with seeds seed, seed + 1, ... (the same for every set, so sets are compared on the same
+ * noise and biases). Runs are simulated (as in simulate-motion_tracker) or, with -r, replay a run
+ * log with perturbed IMUs and compare against the tracker that recorded it. -e tracks in
+ * NavMode::ekf. Results only depend on the seed, not on the number of threads.
+ * Prints the position, velocity and attitude errors of each parameter set and the throughput.
+ * Simulated runs also vary where along the track's irregularities the pod starts, so its pitch
+ * and yaw (which the gyro weight and brake separation are about) differ between seeds.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "drivers/clock.hpp"
+#include "drivers/motion_tracker.hpp"
+#include "drivers/run_log.hpp"
+#include "pod_simulation.hpp"
+#include "replay_sensors.hpp"
+#include "sim_sensors.hpp"
+#include "work_stealing_pool.hpp"
+
+#define SAMPLE_PERIOD 0.01 // s between error samples (and braking decisions)
+#define MAX_RUN_TIME 120.0 // s
+#define MAX_REPLAY_IMUS 4
+// Spread of the per-run sensor errors
+#define ACCL_NOISE 0.05       // m/s^2
+#define GYRO_NOISE 0.002      // rad/s
+#define ACCL_BIAS_SPREAD 0.05 // m/s^2
+#define GYRO_BIAS_SPREAD 0.002 // rad/s
+
+struct RunErrors
+{
+  double time = 0;           // s, simulated or replayed
+  double position_rms = 0;   // m, tracked minus true position
+  double position_max = 0;   // m, largest absolute error
+  double velocity_rms = 0;   // m/s
+  double velocity_max = 0;   // m/s
+  double attitude_rms = 0;   // rad, angle between the tracked and true attitude
+  double attitude_max = 0;   // rad
+  double final_position = 0; // m, error when stopped (or at the end of the log)
+};
+
+class ErrorSums
+{
+  public:
+    void add(double position_error, double velocity_error, double attitude_error)
+    {
+      this->n++;
+      this->position += position_error * position_error;
+      this->velocity += velocity_error * velocity_error;
+      this->attitude += attitude_error * attitude_error;
+      this->errors.position_max = std::max(this->errors.position_max, std::abs(position_error));
+      this->errors.velocity_max = std::max(this->errors.velocity_max, std::abs(velocity_error));
+      this->errors.attitude_max = std::max(this->errors.attitude_max, attitude_error);
+      this->errors.final_position = position_error;
+    }
+
+    RunErrors get(double time)
+    {
+      this->errors.time = time;
+      if (this->n > 0)
+      {
+        this->errors.position_rms = std::sqrt(this->position / this->n);
+        this->errors.velocity_rms = std::sqrt(this->velocity / this->n);
+        this->errors.attitude_rms = std::sqrt(this->attitude / this->n);
+      }
+      return this->errors;
+    }
+
+  private:
+    long n = 0;
+    double position = 0;
+    double velocity = 0;
+    double attitude = 0;
+    RunErrors errors;
+};
+
+/// Angle (rad) of the rotation between two attitudes
+double angle_between(const Quaternion& a, const Quaternion& b)
+{
+  Quaternion d = Quaternion::inv(a) * b;
+  double c = std::abs(d.scal) / Quaternion::norm(d);
+  return 2.0 * std::acos(std::min(1.0, c));
+}
+
+Vector3D<double> draw(std::mt19937& rng, std::normal_distribution<double>& distribution)
+{
+  // One draw per statement, so the order doesn't depend on the compiler
+  double x = distribution(rng);
+  double y = distribution(rng);
+  double z = distribution(rng);
+  return Vector3D<double>(x, y, z);
+}
+
+RunErrors run_simulated(NavMode mode, const MotionTrackerParameters& parameters,
+    unsigned int seed, double braking_distance)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> accl_bias(0.0, ACCL_BIAS_SPREAD);
+  std::normal_distribution<double> gyro_bias(0.0, GYRO_BIAS_SPREAD);
+  Vector3D<double> accl_bias1 = draw(rng, accl_bias), gyro_bias1 = draw(rng, gyro_bias);
+  Vector3D<double> accl_bias2 = draw(rng, accl_bias), gyro_bias2 = draw(rng, gyro_bias);
+  unsigned int seeds[10];
+  for (unsigned int& s : seeds)
+    s = rng();
+  PodConfig config;
+  config.disturbance_phase = std::uniform_real_distribution<double>(0.0, 2.0 * M_PI)(rng);
+
+  VirtualClock clock;
+  PodSimulation sim(config);
+  SimulatedImu imu1(sim, seeds[0], ACCL_NOISE, GYRO_NOISE, accl_bias1, gyro_bias1);
+  SimulatedImu imu2(sim, seeds[1], ACCL_NOISE, GYRO_NOISE, accl_bias2, gyro_bias2);
+  Vector3D<double> positions[4] = {Vector3D<double>(500, 1000, 0),
+      Vector3D<double>(500, -1000, 0), Vector3D<double>(-500, -1000, 0),
+      Vector3D<double>(-500, 1000, 0)};
+  SimulatedGroundProxi ground[4] = {SimulatedGroundProxi(sim, positions[0], seeds[2]),
+      SimulatedGroundProxi(sim, positions[1], seeds[3]),
+      SimulatedGroundProxi(sim, positions[2], seeds[4]),
+      SimulatedGroundProxi(sim, positions[3], seeds[5])};
+  SimulatedBrakeProxi left_front(sim, RailSide::left, true, seeds[6]);
+  SimulatedBrakeProxi left_rear(sim, RailSide::left, false, seeds[7]);
+  SimulatedBrakeProxi right_front(sim, RailSide::right, true, seeds[8]);
+  SimulatedBrakeProxi right_rear(sim, RailSide::right, false, seeds[9]);
+  SimulatedStripes stripes(sim);
+  MotionTracker mt(stripes, mode, parameters, clock);
+  mt.add_imu(imu1);
+  mt.add_imu(imu2);
+  for (int i = 0; i < 4; ++i)
+    mt.add_ground_proxi(ground[i], positions[i]);
+  mt.add_brake_proxis(left_front, left_rear, RailSide::left);
+  mt.add_brake_proxis(right_front, right_rear, RailSide::right);
+  mt.start_stepped();
+
+  ErrorSums sums;
+  bool braking = false;
+  double start_position = sim.get_config().start_position;
+  double next = mt.step();
+  double next_sample = 0;
+  while (clock.now() < MAX_RUN_TIME)
+  {
+    clock.sleep_until(next);
+    sim.advance(clock.now());
+    next = mt.step();
+    if (clock.now() < next_sample)
+      continue;
+    next_sample += SAMPLE_PERIOD;
+    PodState state = sim.get_state();
+    double position = start_position + mt.get_displacement().x;
+    sums.add(position - state.position, mt.get_velocity().x - state.velocity,
+        angle_between(PodSimulation::get_rotor(state), mt.get_rotor()));
+    if (!braking && !state.pushing && position >= braking_distance)
+    {
+      braking = true;
+      sim.actuate(RailSide::left, BrakeCommand::extend);
+      sim.actuate(RailSide::right, BrakeCommand::extend);
+    }
+    if (braking && state.velocity == 0.0)
+      break;
+  }
+  return sums.get(clock.now());
+}
+
+RunErrors run_replayed(const RunLog& log, int num_imus, NavMode mode,
+    const MotionTrackerParameters& parameters, unsigned int seed)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> accl_bias(0.0, ACCL_BIAS_SPREAD);
+  std::normal_distribution<double> gyro_bias(0.0, GYRO_BIAS_SPREAD);
+
+  VirtualClock clock;
+  ReplayStripes stripes(log, clock);
+  MotionTracker mt(stripes, mode, parameters, clock);
+  std::vector<std::unique_ptr<ReplayImu>> imus;
+  for (int i = 0; i < num_imus; ++i)
+  {
+    Vector3D<double> accl = draw(rng, accl_bias);
+    Vector3D<double> gyro = draw(rng, gyro_bias);
+    imus.emplace_back(new ReplayImu(log, i, clock, rng(), ACCL_NOISE, GYRO_NOISE, accl, gyro));
+    mt.add_imu(*imus.back());
+  }
+  mt.start_stepped();
+
+  // The recording tracker's estimate is the reference
+  int nav = log.find_channel("nav");
+  ColumnSpan<double> nav_time = log.get_timestamps(nav);
+  ColumnSpan<double> nav_position = log.get_column(nav, log.find_field(nav, "disp_x"));
+  ColumnSpan<double> nav_velocity = log.get_column(nav, log.find_field(nav, "vel_x"));
+  ColumnSpan<double> nav_rotor[4];
+  const char* rotor_fields[4] = {"rotor_w", "rotor_x", "rotor_y", "rotor_z"};
+  for (int i = 0; i < 4; ++i)
+    nav_rotor[i] = log.get_column(nav, log.find_field(nav, rotor_fields[i]));
+  SampleCursor reference(nav_time);
+  double end = nav_time[nav_time.size() - 1];
+
+  ErrorSums sums;
+  double next = mt.step();
+  double next_sample = 0;
+  while (clock.now() < end)
+  {
+    clock.sleep_until(next);
+    next = mt.step();
+    if (clock.now() < next_sample)
+      continue;
+    next_sample += SAMPLE_PERIOD;
+    long i = reference.at(clock.now());
+    if (i < 0)
+      continue;
+    Quaternion rotor(nav_rotor[0][i], nav_rotor[1][i], nav_rotor[2][i], nav_rotor[3][i]);
+    sums.add(mt.get_displacement().x - nav_position[i], mt.get_velocity().x - nav_velocity[i],
+        angle_between(rotor, mt.get_rotor()));
+  }
+  return sums.get(clock.now());
+}
+
+std::vector<double> parse_list(const char* list)
+{
+  std::vector<double> values;
+  char* end;
+  for (const char* s = list; *s; s = *end ? end + 1 : end)
+  {
+    values.push_back(strtod(s, &end));
+    if (end == s)
+      return std::vector<double>();
+  }
+  return values;
+}
+
+double mean(const std::vector<double>& values)
+{
+  double sum = 0;
+  for (double v : values)
+    sum += v;
+  return sum / values.size();
+}
+
+double percentile(std::vector<double> values, double p)
+{
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, (size_t) (p * values.size()))];
+}
+
+int main(int argc, char* argv[])
+{
+  NavMode mode = NavMode::complementary;
+  int runs = 100;
+  unsigned int seed = 1;
+  unsigned int threads = 0;
+  const char* run_log_file = nullptr;
+  double braking_distance = 900.0;
+  std::vector<double> gyro_weights = {GYRO_WEIGHT};
+  std::vector<double> brake_separations = {BRAKE_PROXI_SEPARATION};
+  std::vector<double> calibration_samples = {CALIBRATION_SAMPLES};
+  int opt;
+  while ((opt = getopt(argc, argv, "en:s:j:r:d:g:b:c:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'e':
+        mode = NavMode::ekf;
+        break;
+      case 'n':
+        runs = atoi(optarg);
+        break;
+      case 's':
+        seed = atoi(optarg);
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 'r':
+        run_log_file = optarg;
+        break;
+      case 'd':
+        braking_distance = atof(optarg);
+        break;
+      case 'g':
+        gyro_weights = parse_list(optarg);
+        break;
+      case 'b':
+        brake_separations = parse_list(optarg);
+        break;
+      case 'c':
+        calibration_samples = parse_list(optarg);
+        break;
+      default:
+        printf("Usage: %s [-e] [-n runs] [-s seed] [-j threads] [-r run_log] "
+            "[-d braking_distance] [-g gyro_weights] [-b brake_separations] "
+            "[-c calibration_samples]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (runs < 1 || gyro_weights.empty() || brake_separations.empty()
+      || calibration_samples.empty())
+  {
+    printf("Need at least one run and one value of every parameter\n");
+    return 1;
+  }
+
+  RunLog log;
+  int num_imus = 0;
+  if (run_log_file)
+  {
+    if (!log.open(run_log_file))
+    {
+      printf("%s is not a run log (version %d)\n", run_log_file, RUN_LOG_VERSION);
+      return 1;
+    }
+    VirtualClock clock;
+    while (num_imus < MAX_REPLAY_IMUS && ReplayImu(log, num_imus, clock, 0).is_valid())
+      ++num_imus;
+    int nav = log.find_channel("nav");
+    if (num_imus == 0 || !ReplayStripes(log, clock).is_valid() || nav < 0
+        || log.get_num_samples(nav) == 0 || log.find_field(nav, "disp_x") < 0
+        || log.find_field(nav, "vel_x") < 0 || log.find_field(nav, "rotor_w") < 0)
+    {
+      printf("%s needs accl0, gyro0, stripes and nav channels from MotionTracker\n",
+          run_log_file);
+      return 1;
+    }
+  }
+
+  std::vector<MotionTrackerParameters> sets;
+  for (double g : gyro_weights)
+    for (double b : brake_separations)
+      for (double c : calibration_samples)
+      {
+        MotionTrackerParameters p;
+        p.gyro_weight = g;
+        p.brake_separation = b;
+        p.calibration_samples = (int) c;
+        p.timed = false;
+        sets.push_back(p);
+      }
+
+  WorkStealingPool pool(threads);
+  std::vector<RunErrors> results(sets.size() * runs);
+  auto start = std::chrono::steady_clock::now();
+  pool.run(results.size(), [&](size_t i) {
+    const MotionTrackerParameters& p = sets[i / runs];
+    unsigned int run_seed = seed + i % runs;
+    if (run_log_file)
+      results[i] = run_replayed(log, num_imus, mode, p, run_seed);
+    else
+      results[i] = run_simulated(mode, p, run_seed, braking_distance);
+  });
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double simulated_time = 0;
+  for (unsigned int s = 0; s < sets.size(); ++s)
+  {
+    std::vector<double> position_rms, position_max, velocity_rms, velocity_max, final_position;
+    std::vector<double> attitude_rms, attitude_max;
+    for (int r = 0; r < runs; ++r)
+    {
+      const RunErrors& e = results[s * runs + r];
+      simulated_time += e.time;
+      position_rms.push_back(e.position_rms);
+      position_max.push_back(e.position_max);
+      velocity_rms.push_back(e.velocity_rms);
+      velocity_max.push_back(e.velocity_max);
+      attitude_rms.push_back(e.attitude_rms * 1000.0);
+      attitude_max.push_back(e.attitude_max * 1000.0);
+      final_position.push_back(e.final_position);
+    }
+    double final_mean = mean(final_position), final_variance = 0;
+    for (double e : final_position)
+      final_variance += (e - final_mean) * (e - final_mean);
+    printf("gyro_weight %.4f, brake_separation %.1f mm, calibration_samples %d:\n",
+        sets[s].gyro_weight, sets[s].brake_separation, sets[s].calibration_samples);
+    printf("  position: rms %.3f m (p95 %.3f), max %.3f m (p95 %.3f); final %+.3f m (sd %.3f)\n",
+        mean(position_rms), percentile(position_rms, 0.95), mean(position_max),
+        percentile(position_max, 0.95), final_mean, std::sqrt(final_variance / runs));
+    printf("  velocity: rms %.3f m/s (p95 %.3f), max %.3f m/s (p95 %.3f)\n",
+        mean(velocity_rms), percentile(velocity_rms, 0.95), mean(velocity_max),
+        percentile(velocity_max, 0.95));
+    printf("  attitude: rms %.2f mrad (p95 %.2f), max %.2f mrad (p95 %.2f)\n",
+        mean(attitude_rms), percentile(attitude_rms, 0.95), mean(attitude_max),
+        percentile(attitude_max, 0.95));
+  }
+  printf("%zu runs (%.0f s tracked) in %.2f s on %u threads: %.1f runs/s, %.0f times real time, "
+      "%lu steals\n", results.size(), simulated_time, elapsed, pool.get_num_threads(),
+      results.size() / elapsed, simulated_time / elapsed, pool.get_steals());
+  return 0;
+}
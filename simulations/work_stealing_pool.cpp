@@ -0,0 +1,137 @@
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned int threads)
+{
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  this->shares.reset(new Share[threads]);
+  for (unsigned int i = 0; i < threads; ++i)
+    this->threads.emplace_back(&WorkStealingPool::work, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->started.notify_all();
+  for (std::thread& t : this->threads)
+    t.join();
+}
+
+void WorkStealingPool::run(size_t n, const std::function<void(size_t)>& task)
+{
+  unsigned int num_threads = this->threads.size();
+  std::unique_lock<std::mutex> lock(this->mutex);
+  for (unsigned int i = 0; i < num_threads; ++i)
+  {
+    std::lock_guard<std::mutex> share_lock(this->shares[i].mutex);
+    this->shares[i].begin = n * i / num_threads;
+    this->shares[i].end = n * (i + 1) / num_threads;
+  }
+  this->task = &task;
+  this->error = nullptr;
+  this->steals = 0;
+  this->active = num_threads;
+  ++this->generation;
+  this->started.notify_all();
+  this->finished.wait(lock, [this]() { return this->active == 0; });
+  this->task = nullptr;
+  if (this->error)
+    std::rethrow_exception(this->error);
+}
+
+void WorkStealingPool::work(unsigned int worker)
+{
+  unsigned long generation = 0;
+  while (true)
+  {
+    const std::function<void(size_t)>* task;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->started.wait(lock, [&]() {
+        return this->stopping || this->generation != generation;
+      });
+      if (this->stopping)
+        return;
+      generation = this->generation;
+      task = this->task;
+    }
+
+    size_t index;
+    while (this->take(worker, index) || (this->steal(worker) && this->take(worker, index)))
+    {
+      try
+      {
+        (*task)(index);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->error)
+          this->error = std::current_exception();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (--this->active == 0)
+      this->finished.notify_all();
+  }
+}
+
+bool WorkStealingPool::take(unsigned int worker, size_t& index)
+{
+  Share& own = this->shares[worker];
+  std::lock_guard<std::mutex> lock(own.mutex);
+  if (own.begin == own.end)
+    return false;
+  index = own.begin++;
+  return true;
+}
+
+bool WorkStealingPool::steal(unsigned int worker)
+{
+  unsigned int num_threads = this->threads.size();
+  while (true)
+  {
+    // Victim with the most left; shares only ever shrink, so retry if it ran out meanwhile
+    unsigned int victim = worker;
+    size_t most = 0;
+    for (unsigned int i = 1; i < num_threads; ++i)
+    {
+      unsigned int other = (worker + i) % num_threads;
+      std::lock_guard<std::mutex> lock(this->shares[other].mutex);
+      size_t left = this->shares[other].end - this->shares[other].begin;
+      if (left > most)
+      {
+        most = left;
+        victim = other;
+      }
+    }
+    if (most == 0)
+      return false;
+
+    size_t begin, end;
+    {
+      std::lock_guard<std::mutex> lock(this->shares[victim].mutex);
+      Share& share = this->shares[victim];
+      if (share.begin == share.end)
+        continue;
+      // The back half, rounded up so a single index can be stolen too
+      begin = share.begin + (share.end - share.begin) / 2;
+      end = share.end;
+      share.end = begin;
+    }
+    {
+      // Nobody steals from an empty share, so this one is still empty
+      std::lock_guard<std::mutex> lock(this->shares[worker].mutex);
+      this->shares[worker].begin = begin;
+      this->shares[worker].end = end;
+    }
+    this->steals.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+}
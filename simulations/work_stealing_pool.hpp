@@ -0,0 +1,66 @@
+#ifndef HYPED_SIMULATIONS_WORK_STEALING_POOL_HPP_
+#define HYPED_SIMULATIONS_WORK_STEALING_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs tasks 0 .. n-1 on a fixed set of worker threads. Each worker starts with an equal,
+ * contiguous share of the indices and takes them from the front; one that runs out steals the
+ * back half of the largest share left, so tasks of uneven length still keep every core busy
+ * without the workers queueing on one shared counter. Which worker runs a task is left to chance,
+ * so tasks should only depend on their index (e.g. seed with it) for results to be repeatable.
+ */
+
+class WorkStealingPool
+{
+  public:
+    /// `threads` 0 means one per core
+    WorkStealingPool(unsigned int threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(WorkStealingPool const&) = delete;
+    void operator=(WorkStealingPool const&)   = delete;
+
+    /// Runs task(i) for every i in [0, n) and returns once all have finished. If tasks throw,
+    /// the rest still run and the first exception is passed on to the caller
+    void run(size_t n, const std::function<void(size_t)>& task);
+    unsigned int get_num_threads() const { return this->threads.size(); }
+    /// Shares stolen during the last run()
+    unsigned long get_steals() const { return this->steals.load(std::memory_order_relaxed); }
+
+  private:
+    // Indices [begin, end) still to run, padded so workers don't share cache lines
+    struct Share
+    {
+      std::mutex mutex;
+      size_t begin = 0;
+      size_t end = 0;
+      char padding[64];
+    };
+
+    void work(unsigned int worker);
+    bool take(unsigned int worker, size_t& index);
+    bool steal(unsigned int worker);
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Share[]> shares;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* task = nullptr;
+    unsigned long generation = 0; // of run() calls
+    unsigned int active = 0;      // workers still running tasks
+    bool stopping = false;
+    std::exception_ptr error;
+    std::atomic<unsigned long> steals {0};
+};
+
+#endif // HYPED_SIMULATIONS_WORK_STEALING_POOL_HPP_